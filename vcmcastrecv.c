@@ -0,0 +1,385 @@
+/**********************************************************************//**
+***************************************************************************
+*** @file    vcmcastrecv.c
+***
+*** @brief   Receiver of the vcmipidemo Multicast Frame Stream (-U).
+***
+*** @author  Copyright (c) 2018 Vision Components.
+*** @author  All rights reserved.
+*** @author  This software embodies materials and concepts which are
+***          confidential to Vision Components.
+***
+***  Joins the group, reads the datagrams in batches by recvmmsg() and
+***  reassembles the frames, counting lost, late and duplicate fragments.
+***  See vcstream.h for the wire format.
+***
+***************************************************************************
+***************************************************************************/
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "vcstream.h"
+
+
+#define  VCMCAST_RCVBUF  (8 << 20)  /**<  Receive Buffer asked for, a full Frame fits in it.  */
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns CLOCK_MONOTONIC in Milliseconds.
+*/
+/*-----------------------------------------------------------------------------*/
+static int64_t  vcmcast_now_ms(void)
+{
+	struct timespec  ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return((int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Joins a Multicast Group and prepares the Reassembly.
+*
+* @param  pcIface  Address of the receiving interface, NULL or "" for any.
+*/
+/*-----------------------------------------------------------------------------*/
+int  vcmcast_open(VCMcastReceiver *rx, const char *pcGroup, int port, const char *pcIface)
+{
+	int                 ee, rc, i, one = 1, size = VCMCAST_RCVBUF;
+	struct sockaddr_in  addr;
+	struct ip_mreq      mreq;
+
+	memset(rx, 0, sizeof(VCMcastReceiver));
+	rx->fd           = -1;
+	rx->deliveredIdx = -1;
+
+	rx->dgram = malloc((size_t)VCMCAST_BATCH * VCMCAST_DATAGRAM_MAX);
+	if(NULL==rx->dgram){ee=-1; goto fail;}
+
+	for(i= 0; i< VCMCAST_BATCH; i++)
+	{
+		rx->iov[i].iov_base            = rx->dgram + (size_t)i * VCMCAST_DATAGRAM_MAX;
+		rx->iov[i].iov_len             = VCMCAST_DATAGRAM_MAX;
+		rx->msg[i].msg_hdr.msg_iov     = &rx->iov[i];
+		rx->msg[i].msg_hdr.msg_iovlen  = 1;
+	}
+
+	rx->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(rx->fd<0){ee=-2; goto fail;}
+
+	// Several receivers on one host share the port.
+	setsockopt(rx->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	setsockopt(rx->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	rc = bind(rx->fd, (struct sockaddr*)&addr, sizeof(addr));
+	if(rc<0){ee=-3; goto fail;}
+
+	memset(&mreq, 0, sizeof(mreq));
+	if(1!=inet_pton(AF_INET, pcGroup, &mreq.imr_multiaddr)){ee=-4; goto fail;}
+	mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+	if((NULL!=pcIface)&&('\0'!=pcIface[0]))
+	{
+		if(1!=inet_pton(AF_INET, pcIface, &mreq.imr_interface)){ee=-4; goto fail;}
+	}
+
+	rc = setsockopt(rx->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+	if(rc<0){ee=-5; goto fail;}
+
+	ee=0;
+fail:
+	if(ee<0)
+	{
+		vcmcast_close(rx);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Gives a pending Frame up, its missing Fragments count as lost.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  vcmcast_give_up(VCMcastReceiver *rx, VCMcastFrame *f)
+{
+	rx->incompleteCount++;
+	rx->lostFragCount += f->fragCount - f->fragReceived;
+	f->activeIff1      = 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Takes a Frame Slot for a new frameId, giving the oldest pending one up if needed.
+*/
+/*-----------------------------------------------------------------------------*/
+static VCMcastFrame *vcmcast_begin(VCMcastReceiver *rx, const VCMcastFragHeader *fh)
+{
+	VCMcastFrame  *f = NULL;
+	int            i;
+
+	for(i= 0; i< VCMCAST_PENDING; i++)
+	{
+		if(i==rx->deliveredIdx){ continue; }
+		if(0==rx->frame[i].activeIff1){ f = &rx->frame[i]; break; }
+		if((NULL==f)||((int32_t)(rx->frame[i].frameId - f->frameId) < 0)){ f = &rx->frame[i]; }
+	}
+	if(1==f->activeIff1)
+	{
+		vcmcast_give_up(rx, f);
+	}
+
+	if(fh->frameBytes > f->dataSize)
+	{
+		free(f->data);
+		f->data     = malloc(fh->frameBytes);
+		f->dataSize = (NULL!=f->data)?(fh->frameBytes):(0);
+	}
+	if((size_t)(fh->fragCount + 7) / 8 > f->maskSize)
+	{
+		free(f->fragMask);
+		f->fragMask = malloc((fh->fragCount + 7) / 8);
+		f->maskSize = (NULL!=f->fragMask)?((fh->fragCount + 7) / 8):(0);
+	}
+	if((NULL==f->data)||(NULL==f->fragMask)){ return(NULL); }
+
+	memset(f->fragMask, 0, (fh->fragCount + 7) / 8);
+	f->activeIff1   = 1;
+	f->frameId      = fh->frameId;
+	f->frameBytes   = fh->frameBytes;
+	f->fragCount    = fh->fragCount;
+	f->fragReceived = 0;
+	f->hdr          = NULL;
+	f->payload      = NULL;
+
+	return(f);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Files a Datagram into its Frame.
+*
+*  Returns the frame if the datagram completed it, else NULL.
+*/
+/*-----------------------------------------------------------------------------*/
+static VCMcastFrame *vcmcast_add(VCMcastReceiver *rx, const uint8_t *dgram, size_t byteCount)
+{
+	VCMcastFragHeader        frag;
+	const VCMcastFragHeader *fh = &frag;
+	VCMcastFrame            *f  = NULL;
+	size_t                   dataBytes;
+	int                      i;
+
+	if(byteCount < sizeof(VCMcastFragHeader))
+	{
+		rx->badCount++;
+		return(NULL);
+	}
+	memcpy(&frag, dgram, sizeof(VCMcastFragHeader));
+	vcmcast_frag_from_le(&frag);
+
+	if((VCMCAST_MAGIC!=fh->magic)||(VCMCAST_VERSION>fh->version)||
+	   (fh->headerBytes < sizeof(VCMcastFragHeader))||(fh->headerBytes > byteCount)||
+	   (fh->fragIdx >= fh->fragCount)||(fh->frameBytes > VCMCAST_FRAME_MAX)||
+	   ((uint64_t)fh->offset + (byteCount - fh->headerBytes) > fh->frameBytes))
+	{
+		rx->badCount++;
+		return(NULL);
+	}
+	dataBytes = byteCount - fh->headerBytes;
+	rx->fragCount++;
+
+	for(i= 0; i< VCMCAST_PENDING; i++)
+	{
+		if((1==rx->frame[i].activeIff1)&&(i!=rx->deliveredIdx)&&(rx->frame[i].frameId==fh->frameId)){ f = &rx->frame[i]; break; }
+	}
+
+	if(NULL==f)
+	{
+		// Not newer than the newest frame seen: delivered, given up or counted lost.
+		if((1==rx->highestValidIff1)&&((int32_t)(fh->frameId - rx->highestId) <= 0))
+		{
+			rx->lateFragCount++;
+			return(NULL);
+		}
+		if(1==rx->highestValidIff1){ rx->lostFrameCount += fh->frameId - rx->highestId - 1; }
+		rx->highestId        = fh->frameId;
+		rx->highestValidIff1 = 1;
+
+		f = vcmcast_begin(rx, fh);
+		if(NULL==f){ return(NULL); }
+	}
+
+	if((fh->frameBytes!=f->frameBytes)||(fh->fragCount!=f->fragCount))
+	{
+		rx->badCount++;
+		return(NULL);
+	}
+	if(0!=(f->fragMask[fh->fragIdx / 8] & (1u << (fh->fragIdx % 8))))
+	{
+		rx->dupFragCount++;
+		return(NULL);
+	}
+
+	memcpy(f->data + fh->offset, dgram + fh->headerBytes, dataBytes);
+	f->fragMask[fh->fragIdx / 8] |= (1u << (fh->fragIdx % 8));
+	f->fragReceived++;
+
+	if(f->fragReceived < f->fragCount){ return(NULL); }
+
+	f->hdr = (VCStreamHeader*)f->data;
+	if(f->frameBytes >= sizeof(VCStreamHeader)){ vcstream_header_from_le(f->hdr); }
+	if((f->frameBytes < sizeof(VCStreamHeader))||(VCSTREAM_MAGIC!=f->hdr->magic)||
+	   ((uint64_t)f->hdr->headerBytes + f->hdr->payloadBytes > f->frameBytes))
+	{
+		rx->badCount++;
+		f->activeIff1 = 0;
+		return(NULL);
+	}
+	f->payload = f->data + f->hdr->headerBytes;
+
+	return(f);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Waits for the next complete Frame.
+*
+*  The frame stays valid until the next call. Returns 1 with a frame,
+*  0 if none completed within timeoutMS (negative: wait forever).
+*/
+/*-----------------------------------------------------------------------------*/
+int  vcmcast_receive(VCMcastReceiver *rx, VCMcastFrame **frame, int timeoutMS)
+{
+	VCMcastFrame   *f;
+	struct pollfd   pfd;
+	int64_t         deadline = vcmcast_now_ms() + timeoutMS;
+	int             rc, waitMS;
+
+	if(rx->deliveredIdx>=0)
+	{
+		rx->frame[rx->deliveredIdx].activeIff1 = 0;
+		rx->deliveredIdx = -1;
+	}
+
+	while(1)
+	{
+		while(rx->batchIdx < rx->batchCount)
+		{
+			rc = rx->batchIdx++;
+			f  = vcmcast_add(rx, rx->dgram + (size_t)rc * VCMCAST_DATAGRAM_MAX, rx->msg[rc].msg_len);
+			if(NULL!=f)
+			{
+				rx->frameCount++;
+				rx->deliveredIdx = (int)(f - rx->frame);
+				*frame = f;
+				return(1);
+			}
+		}
+
+		rx->batchIdx   = 0;
+		rx->batchCount = 0;
+
+		rc = recvmmsg(rx->fd, rx->msg, VCMCAST_BATCH, MSG_DONTWAIT, NULL);
+		if(rc>0)
+		{
+			rx->batchCount = rc;
+			continue;
+		}
+		if((rc<0)&&(EAGAIN!=errno)&&(EWOULDBLOCK!=errno)&&(EINTR!=errno)){ return(-1); }
+
+		waitMS = (timeoutMS<0)?(-1):((int)(deadline - vcmcast_now_ms()));
+		if((timeoutMS>=0)&&(waitMS<=0)){ return(0); }
+
+		pfd.fd      = rx->fd;
+		pfd.events  = POLLIN;
+		pfd.revents = 0;
+		rc = poll(&pfd, 1, waitMS);
+		if((rc<0)&&(EINTR!=errno)){ return(-1); }
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Loss Statistics of a Multicast Receiver.
+*/
+/*-----------------------------------------------------------------------------*/
+void  vcmcast_print_stats(const VCMcastReceiver *rx)
+{
+	printf("  Multicast: %llu Frames, %llu lost, %llu incomplete; %llu Fragments, %llu lost, %llu late, %llu duplicate, %llu invalid.\n",
+			(unsigned long long)rx->frameCount, (unsigned long long)rx->lostFrameCount, (unsigned long long)rx->incompleteCount,
+			(unsigned long long)rx->fragCount, (unsigned long long)rx->lostFragCount, (unsigned long long)rx->lateFragCount,
+			(unsigned long long)rx->dupFragCount, (unsigned long long)rx->badCount);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Leaves the Group and frees the Receiver.
+*/
+/*-----------------------------------------------------------------------------*/
+void  vcmcast_close(VCMcastReceiver *rx)
+{
+	int  i;
+
+	if(rx->fd>=0){ close(rx->fd); }
+	rx->fd = -1;
+
+	for(i= 0; i< VCMCAST_PENDING; i++)
+	{
+		free(rx->frame[i].data);
+		free(rx->frame[i].fragMask);
+		rx->frame[i].data     = NULL;
+		rx->frame[i].fragMask = NULL;
+		rx->frame[i].dataSize = 0;
+		rx->frame[i].maskSize = 0;
+	}
+	free(rx->dgram);
+	rx->dgram = NULL;
+}
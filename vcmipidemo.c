@@ -17,6 +17,7 @@
 *** @endRevisionHistory
 ***************************************************************************
 ***************************************************************************/
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -30,13 +31,32 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <linux/videodev2.h>
+#include <linux/uvcvideo.h>
+#include <linux/usb/video.h>
 #include <linux/fb.h>
 #include <syslog.h>
 #include <time.h>
 #include <sys/time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/auxv.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <math.h>
 
 #include "vclib-excerpt.h"
 #include "vcimgnet.h"
+#include "vcstream.h"
 
 
 //#define DURATION_TEST
@@ -49,6 +69,68 @@
 
 
 
+#define  VCIMU_XU_UNIT       (3)     /**<  UVC Extension Unit of the Module.          */
+#define  VCIMU_XU_SEL_DATA   (12)    /**<  Selector of the IMU Data (IMU_DataAccess). */
+#define  VCIMU_XU_DATA_SIZE  (17)
+#define  VCIMU_GYRO_DPS      (2000.0f / 32768)  /**<  deg/s per LSB.                 */
+#define  VCIMU_ACCEL_MS2     (19.6f   / 32768)  /**<  m/s^2 per LSB.                 */
+#define  VCIMU_RING_SIZE     (4096)  /**<  Samples kept by the IMU Ring.              */
+#define  VCIMU_FRAME_MAX     (256)   /**<  Samples attached to one Frame at most.     */
+#define  VCIMU_TICK_NS       (1000)  /**<  Nominal Period of the Device Timestamp (assumed 1us). */
+#define  VCSHUTTER_NS        (1000)  /**<  Unit of the Shutter Value (assumed 1us).   */
+#define  VCSYNC_WINDOW       (10000.0) /**< Pairs weighted by the Clock Estimators.  */
+#define  VCSYNC_WARMUP       (16)    /**<  Pairs before a Clock Estimate is used.     */
+#define  VCSYNC_OUTLIER      (4.0)   /**<  Residual Deviations of skipped Pairs.      */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  One Sample of the IMU.
+*/
+typedef struct
+{
+	U64   monoNS;      /*!<  Read Time (CLOCK_MONOTONIC).          */
+	U64   deviceTicks; /*!<  deviceTS without wrap-arounds.        */
+	U32   deviceTS;    /*!<  Timestamp of the IMU Device Clock.    */
+	F32   gyro[3];     /*!<  Angular Rate x, y, z in deg/s.        */
+	F32   accel[3];    /*!<  Acceleration x, y, z in m/s^2.        */
+	F64   gyroSum[3];  /*!<  Running Integral of gyro over Ticks.  */
+	F64   accelSum[3]; /*!<  Running Integral of accel over Ticks. */
+} VCImuSample;
+#define  NULL_VCImuSample  { 0, 0, 0, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0} }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Linear Mapping of a Clock to CLOCK_MONOTONIC.
+*
+*    y = y0 + my + rate * (x - x0 - mx), the means keep the doubles small.
+*/
+typedef struct
+{
+	U64   x0, y0;
+	F64   mx, my;
+	F64   rate;        /*!<  Nanoseconds of CLOCK_MONOTONIC per Tick.  */
+	F64   jitter;      /*!<  Residual Deviation in ns.                 */
+} VCClockFit;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Online Estimator of Offset and Drift of a Clock to CLOCK_MONOTONIC.
+*/
+typedef struct
+{
+	U64   x0, y0;      /*!<  First Pair, Origin of the Regression.     */
+	F64   mx, my, vxx, vxy, vrr, rate;
+	U64   count;
+	U64   outlierCount;
+	VCClockFit  fit[2];
+	VCClockFit *volatile active;  /*!<  Published Fit, NULL until settled. */
+} VCClockSync;
+#define  NULL_VCClockSync  { 0 }
+
+
 /*--*STRUCT*----------------------------------------------------------*/
 /**
 *  @brief  Capture Queue Slot.
@@ -60,8 +142,481 @@ typedef struct
 {
 	void    *st;          /*!<   Start Address of Image Data          */
 	size_t   byteCount;   /*!<   Size of the buffer in Bytes          */
+	U64      timestampNS; /*!<   Capture Time of the last dequeued Image (CLOCK_MONOTONIC). */
+	U64      dequeueNS;   /*!<   Time the last Image was dequeued (CLOCK_MONOTONIC).        */
+	U32      sequence;    /*!<   Frame Sequence Number of the Driver, gaps are dropped Frames. */
+	I32      imuCount;    /*!<   IMU Samples read since the previous Capture.  */
+	VCImuSample  imu[VCIMU_FRAME_MAX];
+	I32      imuMidValidIff1;      /*!<  The following are set by imu_at_exposure(). */
+	VCImuSample  imuMid;           /*!<  IMU at the Middle of the Exposure.          */
+	F32      imuDeltaAngle[3];     /*!<  Rotation during the Exposure in deg.        */
+	F32      imuDeltaVelocity[3];  /*!<  Velocity Change during the Exposure in m/s. */
 } QBuf;
-#define  NULL_QBuf { NULL, 0 }
+#define  NULL_QBuf { NULL, 0, 0, 0, 0, 0, {NULL_VCImuSample}, 0, NULL_VCImuSample, {0, 0, 0}, {0, 0, 0} }
+
+
+#define  VCARENA_SLOTS  (3)  /**<  Slots at least: processing, pending and outputting Frame. */
+
+// Interleaved colour layouts in addition to the planar IMAGE_RGB,
+// st points to the first pixel, pitch is in bytes, ccmp1 and ccmp2 are unused.
+#define  VCIMAGE_RGB24   (0x101)  /**<  R, G, B.                                    */
+#define  VCIMAGE_BGR24   (0x102)  /**<  B, G, R.                                    */
+#define  VCIMAGE_RGBA32  (0x103)  /**<  R, G, B, 255.                               */
+#define  VCIMAGE_BGRA32  (0x104)  /**<  B, G, R, 255, same as a 32 Bit Framebuffer. */
+#define  VCSTATS_BINS   (1024) /**< 10 Bit Histogram Bins of the Frame Statistics. */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Frame Statistics accumulated while unpacking a Capture.
+*
+*    8 bit formats count their values as 10 bit values with zero lower bits.
+*    Gradient energy is the sum of squared 8 bit differences to the
+*    same-colour neighbours left and above.
+*/
+typedef struct
+{
+	U32   hist[VCSTATS_BINS];
+	U64   sum;               /*!<  Sum of the 10 Bit Values.                      */
+	U64   gradientEnergy;
+	U32   count;             /*!<  Pixels accumulated.                            */
+	U32   saturatedCount;    /*!<  Pixels at the maximum Value.                   */
+	U32   minimum;
+	U32   maximum;
+	I32   step;              /*!<  Distance of same-colour Neighbours, 1 or 2.    */
+	F32   mean;              /*!<  10 Bit Mean, set by frame_stats_reduce().      */
+	F32   sharpness;         /*!<  Gradient Energy per Pixel, set likewise.       */
+	U32   pad[9];            /*!<  Keeps per Worker Statistics apart by a Cache Line. */
+} VCFrameStats;
+#define  NULL_VCFrameStats  { {0}, 0, 0, 0, 0, 0, 0, 0, 0, 0, {0} }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Frame Arena Slot.
+*
+*    Preallocated buffers for one converted capture, so no memory
+*    is allocated (and first touched) while capturing.
+*/
+typedef struct
+{
+	image         img;       /*!<  Converted Image.                                  */
+	image         imgRaw8;   /*!<  8 Bit Bayer Intermediate, st is NULL if unused.   */
+	volatile I32  refCount;  /*!<  0: Slot is free.                                  */
+	I32           frameNr;   /*!<  Number of the Capture held by the Slot.           */
+	I32           statsValidIff1;
+	VCFrameStats  stats;     /*!<  Statistics of the Capture if statsValidIff1.      */
+	image         imgRect[2];  /*!<  Rectified Eyes, allocated by rectify_init().    */
+	I32           rectEye[2];  /*!<  Eye of each rectified Image, 0: left, 1: right. */
+	I32           rectCount;   /*!<  Rectified Images of the Capture.                */
+	U16          *disp;        /*!<  Disparity in 1/16 Pixels, allocated by stereo_attach(). */
+	I32           dispValidIff1;
+	I32           fileOutIff1; /*!<  Files to write, unless skipped by rate or change gate. */
+	I32           stdOutIff1;  /*!<  ASCII view to print, unless skipped by rate.  */
+	I32           streamOutIff1; /*!<  Frame to stream, unless skipped by rate.    */
+	I32           mcastOutIff1;  /*!<  Frame to multicast, unless skipped by rate. */
+	U64           captureNS;   /*!<  Capture Time (CLOCK_MONOTONIC).                */
+	U8           *jpeg;        /*!<  JPEG of img, allocated by jpeg_init().         */
+	U32           jpegBytes;
+	I32           jpegValidIff1;
+} VCFrameSlot;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Frame Arena.
+*/
+typedef struct
+{
+	VCFrameSlot  *slot;
+	I32           slotCount;
+	VCFrameStats *statsWorker;  /*!<  Band Statistics of each Worker Thread. */
+	U64           exhaustCount; /*!<  Captures dropped since all slots were in use. */
+} VCFrameArena;
+#define  NULL_VCFrameArena  { NULL, 0, NULL, 0 }
+
+
+#define  VCSENCTRL_GAIN      (0)  /**<  V4L2_CID_GAIN.         */
+#define  VCSENCTRL_EXPOSURE  (1)  /**<  V4L2_CID_EXPOSURE.     */
+#define  VCSENCTRL_COUNT     (2)  /**<  Sensor Controls cached. */
+
+static const U32   sensorCtrlId[VCSENCTRL_COUNT]   = { V4L2_CID_GAIN, V4L2_CID_EXPOSURE };
+static const char *sensorCtrlName[VCSENCTRL_COUNT] = { "Gain",        "Exposure"        };
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Cached Range and Value of a Sensor Control.
+*/
+typedef struct
+{
+	U32   id;             /*!<  V4L2_CID_..                              */
+	I32   supportedIff1;
+	I32   validIff1;      /*!<  value holds the current Value.           */
+	I64   minimum;
+	I64   maximum;
+	I64   step;
+	I64   def;
+	I64   value;          /*!<  Last Value read or written.              */
+} VCSensorCtrl;
+
+
+#define  VCLAT_BUCKETS  (16)  /**<  Histogram: [0,64us), [64us,128us), .. */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Latency Statistics with logarithmic Histogram.
+*/
+typedef struct
+{
+	U64   count;
+	U64   sumNS;
+	U64   maxNS;
+	U64   bucket[VCLAT_BUCKETS];
+} VCLatencyStats;
+#define  NULL_VCLatencyStats  { 0, 0, 0, {0} }
+
+
+#define  VCINGEST_DIRECT    (0)    /**<  Convert in place from the mmap()ed Capture Buffer.     */
+#define  VCINGEST_COPY      (1)    /**<  Bulk-copy each Band to a cached Buffer, convert there. */
+#define  VCINGEST_AUTO      (2)    /**<  Pick the faster one when the Sensor is opened.         */
+#define  VCINGEST_PREFETCH  (512)  /**<  Bytes kernel_copy_vec() prefetches ahead.              */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  How Captures are read from the Capture Buffers.
+*
+*    Capture buffers may be mapped uncached or write-combined, then
+*    the converters are much faster on a cached copy of the buffer.
+*/
+typedef struct
+{
+	I32           mode;            /*!<  VCINGEST_DIRECT or VCINGEST_COPY.           */
+	U8           *st;              /*!<  Cached Staging Buffer of byteCount Bytes.   */
+	size_t        byteCount;
+	F32           probeDirectMBs;  /*!<  Measured by ingest_init().                  */
+	F32           probeCopyMBs;
+	volatile U64  copyNS;          /*!<  Copy Time summed over all Workers.          */
+	U64           frameCount;
+} VCIngest;
+#define  NULL_VCIngest  { VCINGEST_DIRECT, NULL, 0, 0, 0, 0, 0 }
+
+
+#define  VCREG_XU_SEL       (14)   /**<  Selector of SensorRegRead/SensorRegWrite of imu_test. */
+#define  VCREG_XU_SIZE      (5)
+#define  VCREG_SHADOW_SIZE  (512)  /**<  Registers shadowed at most, power of 2.              */
+#define  VCREG_BATCH_MAX    (64)   /**<  Register Writes queued at most.                      */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Shadow Copy of one Sensor Register.
+*/
+typedef struct
+{
+	U16   addr;
+	U16   value;
+	U8    usedIff1;
+	U8    validIff1;     /*!<  value is the one of the Device.          */
+	U8    volatileIff1;  /*!<  Changed by the Sensor, never cached.     */
+	U8    pad;
+} VCRegEntry;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Register Access over the Extension Unit with Shadow and Write Batch.
+*
+*    Each register transfer is a round trip over USB, so reads of known
+*    values are served by the shadow and writes are queued, coalesced and
+*    sent back to back. The firmware transfers one register at a time.
+*/
+typedef struct
+{
+	int              fd;
+	pthread_mutex_t  mutex;        /*!<  Keeps Address and Data Transfer of a Read together. */
+	I32              mutexIff1;
+	VCRegEntry       shadow[VCREG_SHADOW_SIZE];
+	U16              pendAddr[VCREG_BATCH_MAX];
+	U16              pendValue[VCREG_BATCH_MAX];
+	I32              pendCount;
+	VCLatencyStats   latRead;      /*!<  Register Reads transferred.      */
+	VCLatencyStats   latWrite;     /*!<  Register Writes transferred.     */
+	U64              readHitCount;
+	U64              writeSkipCount;
+	U64              coalesceCount;
+	U64              flushCount;
+	U64              errorCount;
+} VCSensorRegs;
+
+
+// The flash read access is not used by spi_test, which only sends flash commands
+// by selector 10. Selector, layout and address of the calibration are assumptions.
+#define  VCFLASH_XU_SEL_READ   (11)        /**<  SET_CUR 'R', 24 Bit Address, Length; GET_CUR Data. */
+#define  VCFLASH_XU_SIZE       (64)
+#define  VCFLASH_CHUNK         (56)        /**<  Data Bytes at the End of a GET_CUR Transfer.       */
+#define  VCFLASH_CALIB_ADDR    (0x1F0000)  /**<  Flash Address of the VCCalibHeader.                */
+#define  VCCALIB_MAGIC         (0x4C414356u)  /**<  "VCAL" */
+#define  VCCALIB_CACHE_MAGIC   (0x43434356u)  /**<  "VCCC" */
+#define  VCCALIB_MAX           (1<<20)     /**<  Upper Limit of the Calibration Size.              */
+#define  VCSTEREO_MAGIC        (0x54534356u)  /**<  "VCST" */
+#define  VCRECT_TILE_W         (32)        /**<  Columns of a Remap Tile.                          */
+#define  VCRECT_TILE_H         (16)        /**<  Rows of a Remap Tile, also the Band Alignment.    */
+#define  VCRECT_INVALID        (0xFFFFFFFFu)  /**<  Remap Entry of a Pixel outside the Capture.    */
+#define  VCDISP_INVALID        (0xFFFF)    /**<  Disparity of unmatched Pixels.                    */
+#define  VCDISP_MAX            (128)       /**<  Upper Limit of the Disparity Range.               */
+#define  VCDISP_RADIUS_MAX     (5)         /**<  11x11 Windows at most, their Costs fit 15 Bits.   */
+#define  VCSTEREO_SKEW_NS      (8000000)   /**<  Capture Times of paired Eyes differ by this at most. */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Header of the Calibration in the Flash, the Calibration follows it.
+*
+*    Little endian, as the host.
+*/
+typedef struct
+{
+	U32   magic;       /*!<  VCCALIB_MAGIC                            */
+	U32   version;
+	U32   byteCount;   /*!<  Size of the Calibration after the Header. */
+	U32   crc;         /*!<  CRC-32 of the Calibration.               */
+} VCCalibHeader;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Header of a Calibration Cache File, the Calibration follows it.
+*/
+typedef struct
+{
+	U32            magic;        /*!<  VCCALIB_CACHE_MAGIC                 */
+	char           acSerial[60]; /*!<  Serial Number of the Module.       */
+	VCCalibHeader  header;       /*!<  Copy of the Flash Header.          */
+} VCCalibCache;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Calibration of a Module, loaded by calib_load().
+*/
+typedef struct
+{
+	char       acSerial[60];
+	char       acCachePath[256];
+	const U8  *data;           /*!<  Calibration of byteCount Bytes.          */
+	U32        byteCount;
+	U32        crc;
+	void      *map;            /*!<  Mapped Cache File or NULL.               */
+	size_t     mapBytes;
+	U8        *buf;            /*!<  Calibration kept in Memory or NULL.      */
+	I32        fromCacheIff1;
+	U32        transferCount;  /*!<  Flash Reads over the Extension Unit.     */
+	U64        loadNS;
+} VCCalib;
+#define  NULL_VCCalib  { "", "", NULL, 0, 0, NULL, 0, NULL, 0, 0, 0 }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Intrinsics and Rectification of one Camera of a Stereo Pair.
+*
+*    As by OpenCV's stereoRectify(): the rectified pixel (u, v) shows the
+*    ray  r^T * ((u - p.cx) / p.fx, (v - p.cy) / p.fy, 1)  of the camera,
+*    which is distorted by dist and projected by k.
+*/
+typedef struct
+{
+	F32   k[4];      /*!<  fx, fy, cx, cy of the Sensor.           */
+	F32   dist[5];   /*!<  k1, k2, p1, p2, k3.                     */
+	F32   r[9];      /*!<  Rectifying Rotation, row major.         */
+	F32   p[4];      /*!<  fx, fy, cx, cy of the rectified Image.  */
+} VCStereoEye;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Stereo Calibration, Payload of the Module Calibration or a File.
+*/
+typedef struct
+{
+	U32          magic;     /*!<  VCSTEREO_MAGIC.                                  */
+	U32          version;   /*!<  1.                                               */
+	I32          dx, dy;    /*!<  Size of one Eye, captured as well as rectified.  */
+	VCStereoEye  eye[2];    /*!<  Left, right.                                     */
+	F32          baseline;  /*!<  Distance of the Cameras in m.                    */
+} VCStereoCalib;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Block Matching of the rectified Eyes.
+*
+*    Shared by the cameras of both eyes. An eye captured by a camera of
+*    its own waits as a copy in pending, until the other eye is rectified.
+*    The disparity image is stored in the slot of the eye completing the pair.
+*/
+typedef struct
+{
+	I32             dispCount;      /*!<  Disparities 0..dispCount-1 searched, multiple of 8. */
+	I32             radius;         /*!<  Windows of (2 radius + 1)^2 Pixels.            */
+	I32             censusIff1;     /*!<  Costs of 16 Bit Census instead of Grey Values. */
+	I32             lrCheckIff1;    /*!<  Drop Pixels whose right to left Match differs. */
+	I32             dx, dy;
+	U16            *census[2];      /*!<  Census of the rectified Eyes, if censusIff1.   */
+	U8             *scratch;        /*!<  Row Sums of each Worker.                       */
+	size_t          scratchBytes;   /*!<  Per Worker.                                    */
+	image           pending[2];     /*!<  Eye waiting for the other one.                 */
+	U64             pendingNS[2];   /*!<  Its Capture Time, 0: none waiting.             */
+	U64             pairCount;
+	U64             unpairedCount;  /*!<  Eyes replaced before the other Eye came.       */
+	VCLatencyStats  latDisparity;   /*!<  CPU Time of all Bands of a Pair.               */
+} VCStereo;
+#define  NULL_VCStereo  { 0, 3, 0, 0, 0, 0, {NULL, NULL}, NULL, 0, {NULL_IMAGE, NULL_IMAGE}, {0, 0}, 0, 0, NULL_VCLatencyStats }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Rectification of the Eyes captured by one Camera.
+*
+*    The remap table of an eye has 4 bytes per rectified pixel: the byte
+*    offset of the top left source pixel << 8, the vertical bilinear weight
+*    << 4 and the horizontal one, both in 1/16. It is stored tile by tile,
+*    VCRECT_TILE_W x VCRECT_TILE_H, so the source rows a tile reads stay in cache.
+*/
+typedef struct
+{
+	I32             eyeCount;    /*!<  0: off, 1: one Eye, 2: Side by Side.      */
+	I32             eye[2];      /*!<  Eye of each Table, 0: left, 1: right.     */
+	U32            *map[2];
+	I32             dx, dy;      /*!<  Size of the rectified Images.             */
+	I32             pitch;       /*!<  Layout of the converted Captures the      */
+	I32             stride;      /*!<  Tables were built for, in Bytes.          */
+	VCLatencyStats  latRectify;  /*!<  CPU Time of all Bands of a Frame.         */
+	VCStereo       *stereo;      /*!<  Block Matching of the Eyes or NULL.       */
+	U64             captureNS;   /*!<  Capture Time of the Frame processed.      */
+} VCRectify;
+#define  NULL_VCRectify  { 0, {0, 1}, {NULL, NULL}, 0, 0, 0, 0, NULL_VCLatencyStats, NULL, 0 }
+
+
+/**
+*  Pipelines: name, pixelformat, packedIff1 and stride of the converted
+*  image, 3 for RGB24 and BGR24, 4 for RGBA32 and BGRA32.
+*/
+#define  VCPIPELINE_LIST(X)                                         \
+	X(grey,                V4L2_PIX_FMT_GREY,     1, 1)            \
+	X(grey_padded,         V4L2_PIX_FMT_GREY,     0, 1)            \
+	X(y10,                 V4L2_PIX_FMT_Y10,      1, 1)            \
+	X(y10_padded,          V4L2_PIX_FMT_Y10,      0, 1)            \
+	X(bayer_planar,        V4L2_PIX_FMT_SRGGB10P, 1, 1)            \
+	X(bayer_planar_padded, V4L2_PIX_FMT_SRGGB10P, 0, 1)            \
+	X(bayer_rgb24,         V4L2_PIX_FMT_SRGGB10P, 1, 3)            \
+	X(bayer_rgb24_padded,  V4L2_PIX_FMT_SRGGB10P, 0, 3)            \
+	X(bayer_rgb32,         V4L2_PIX_FMT_SRGGB10P, 1, 4)            \
+	X(bayer_rgb32_padded,  V4L2_PIX_FMT_SRGGB10P, 0, 4)
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Conversion of a Capture Format, specialised at Compile Time.
+*
+*    An instance of process_capture_convert_band() for a pixelformat,
+*    row padding and layout of the converted image, see VCPIPELINE_LIST.
+*    sensor_open() picks it once, process_capture() runs it every frame.
+*/
+typedef struct
+{
+	const char  *pcName;
+	U32          pixelformat;
+	I32          packedIff1;   /*!<  Capture Rows without Padding Bytes.          */
+	I32          stride;       /*!<  Bytes per Pixel converted, 1 if planar.      */
+	void       (*convert)(void *arg, I32 y0, I32 y1, I32 workerIdx);  /*!<  Band Function of the Conversion. */
+	I32          align;        /*!<  Band Heights are Multiples of it.            */
+	I32          statsStep;    /*!<  Distance of same-colour Neighbours.          */
+	U32          statsMax;     /*!<  Saturation Level of the Statistics.          */
+	I32          raw8Iff1;     /*!<  Needs the 8 Bit Bayer Image of the Slot.     */
+} VCPipeline;
+
+
+/**
+*  CPU features the kernel variants are compiled for, see cpu_features().
+*/
+#define  VCCPU_SSSE3   (1u<<0)
+#define  VCCPU_AVX2    (1u<<1)
+#define  VCCPU_NEON    (1u<<2)
+#define  VCCPU_ASIMD   (1u<<3)
+#define  VCCPU_COUNT   (4)
+
+static const char *const  cpuFeatureName[VCCPU_COUNT] = { "ssse3", "avx2", "neon", "asimd" };
+
+#ifndef  HWCAP_ARM_NEON
+#define  HWCAP_ARM_NEON  (1<<12)
+#endif
+#ifndef  HWCAP_ASIMD
+#define  HWCAP_ASIMD     (1<<1)
+#endif
+
+/**
+*  Conversion kernels bound at startup, see kernels_bind().
+*/
+#define  VCKERNEL_UNPACK   (0)   /**<  RAW10 to 8 Bit.                        */
+#define  VCKERNEL_DEBAYER  (1)   /**<  Bayer Row Pair to planar RGB.          */
+#define  VCKERNEL_COPY     (2)   /**<  Capture Buffer Block Copy.             */
+#define  VCKERNEL_PACK     (3)   /**<  Planar RGB to 32 Bit Framebuffer Row.  */
+#define  VCKERNEL_RESIZE   (4)   /**<  Pack of every n-th Pixel.              */
+#define  VCKERNEL_COUNT    (5)
+
+/**
+*  Instruction sets with vectorized kernels: name, target attribute and
+*  the CPU features needed, best first.
+*/
+#if defined(__x86_64__) || defined(__i386__)
+#define  VCKERNEL_ISA_LIST(X)          \
+	X(avx2,  "avx2",      VCCPU_AVX2)  \
+	X(ssse3, "ssse3",     VCCPU_SSSE3)
+#elif defined(__aarch64__)
+#define  VCKERNEL_ISA_LIST(X)          \
+	X(asimd, "+simd",     VCCPU_ASIMD)
+#elif defined(__arm__)
+#define  VCKERNEL_ISA_LIST(X)          \
+	X(neon,  "fpu=neon",  VCCPU_NEON)
+#else
+#define  VCKERNEL_ISA_LIST(X)
+#endif
+
+typedef U8    VCVec16b __attribute__((vector_size(16)));  /**<  16 Lanes of 8 Bit.  */
+typedef void (*VCKernelFn)(void);
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Variant of a Conversion Kernel in the Registry.
+*/
+typedef struct
+{
+	I32          kernel;      /*!<  VCKERNEL_xxx.                       */
+	const char  *pcVariant;
+	U32          cpuMask;     /*!<  VCCPU_xxx Features needed.           */
+	VCKernelFn   fn;          /*!<  Cast to the Type of the Kernel.      */
+} VCKernelVariant;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Conversion Kernels bound to the Variants the CPU supports.
+*/
+typedef struct
+{
+	void       (*unpack) (U32 count, char *bufIn, U8 *bufOut);
+	void       (*debayer)(const U8 *in0, const U8 *in1, U8 *r0, U8 *r1, U8 *g0, U8 *g1, U8 *b0, U8 *b1, I32 dx);
+	void       (*copy)   (U8 *dst, const U8 *src, size_t byteCount);
+	void       (*pack)   (U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count);
+	void       (*resize) (U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count, I32 step);
+	const char  *pcVariant[VCKERNEL_COUNT];
+	U32          cpuFeatures;  /*!<  VCCPU_xxx Features found.          */
+} VCKernels;
 
 
 /*--*STRUCT*----------------------------------------------------------*/
@@ -73,40 +628,9466 @@ typedef struct
 *    the pixel image. Also available are the capture queue slots to
 *    be able to access the recorded images.
 */
-typedef struct
+typedef struct
+{
+	int      fd;  /*!<  File Descriptor of the opened Sensor Device.  */
+
+	QBuf    *qbuf; /*!<  Queue Buffers where Images are recorded to.  */
+	U32      qbufCount; /*!<  Number of Queue Buffers available.      */
+
+	struct v4l2_pix_format  pix;  /*!<  Sensor Attributes.            */
+
+	VCFrameArena  arena;  /*!<  Buffers for the converted Captures.       */
+
+	VCSensorCtrl  ctrl[VCSENCTRL_COUNT];  /*!<  Cached Sensor Controls.   */
+
+	VCIngest      ingest;  /*!<  Strategy to read the Capture Buffers.    */
+
+	VCSensorRegs  regs;    /*!<  Register Access of the Module.           */
+
+	const VCPipeline *pipe;  /*!<  Conversion of the Captures.            */
+} VCMipiSenCfg;
+#define NULL_VCMipiSenCfg  { -1, NULL,0, {0}, NULL_VCFrameArena, {{0}}, NULL_VCIngest, {0}, NULL }
+
+
+#define  VCPOOL_MAX_WORKERS   (16)  /**<  Upper Limit of Worker Threads incl. the calling one. */
+#define  VCPOOL_MAX_STAGES    ( 7)  /**<  Upper Limit of Stages per Pool Job.                 */
+#define  VCPOOL_SPIN_COUNT    (2000) /**< Polls of an idle Worker before it sleeps.           */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Band Function of a Worker Pool Stage.
+*
+*    Processes the rows  y0 <= y < y1  of a stage,
+*    workerIdx tells which worker (0: calling thread) does the work.
+*/
+typedef void (*VCPoolBandFn)(void *arg, I32 y0, I32 y1, I32 workerIdx);
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Stage of a Worker Pool Job.
+*
+*    A stage splits its rows into bands which are processed in parallel.
+*    All bands of a stage are finished before the next stage starts.
+*/
+typedef struct
+{
+	VCPoolBandFn  fn;     /*!<  Function processing a Band of Rows.         */
+	void         *arg;    /*!<  Argument passed to fn.                      */
+	I32           rows;   /*!<  Count of Rows to process.                   */
+	I32           align;  /*!<  Band Heights are multiples of this value.   */
+} VCPoolStage;
+#define  NULL_VCPoolStage  { NULL, NULL, 0, 1 }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Utilisation Counters of a Pool Worker.
+*/
+typedef struct
+{
+	U64   busyNS;     /*!<  Time spent inside band functions.          */
+	U64   barrierNS;  /*!<  Time spent waiting at stage barriers.       */
+	U64   bandCount;  /*!<  Count of processed bands.                   */
+	U64   jobCount;   /*!<  Count of jobs the worker took part in.      */
+	char  pad[32];    /*!<  Keeps workers off each others cache line.   */
+} VCPoolWorkerStats;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Persistent Worker Pool.
+*
+*    The worker threads are created once and wait for jobs,
+*    so there is exactly one fork/join per job, regardless of the count
+*    of stages of the job. The calling thread takes part as worker 0.
+*/
+typedef struct
+{
+	I32                workerCount;  /*!<  Workers incl. the calling thread.    */
+	I32                grain;        /*!<  Rows per Band, 0: automatic.         */
+	I32                cpu[VCPOOL_MAX_WORKERS]; /*!< CPU per worker, -1: unpinned. */
+	pthread_t          thread[VCPOOL_MAX_WORKERS];
+
+	pthread_mutex_t    mutex;
+	pthread_cond_t     condStart;
+	pthread_cond_t     condDone;
+	U32                generation;   /*!<  Incremented for each new job.        */
+	I32                running;      /*!<  Workers still busy with the job.     */
+	I32                quitIff1;
+
+	const VCPoolStage *stage;
+	I32                stageCount;
+	I32                bandHeight[VCPOOL_MAX_STAGES];
+	I32                nextBand  [VCPOOL_MAX_STAGES];
+	I32                arrived   [VCPOOL_MAX_STAGES];
+
+	VCPoolWorkerStats  stats[VCPOOL_MAX_WORKERS];
+	U64                jobCount;     /*!<  Count of finished jobs.              */
+	U64                jobNS;        /*!<  Sum of the wall time of all jobs.    */
+} VCWorkerPool;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Argument of a Pool Worker Thread.
+*/
+typedef struct
+{
+	VCWorkerPool  *pool;
+	I32            idx;
+} VCPoolWorkerArg;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Mapped Framebuffer Device.
+*/
+typedef struct
+{
+	int                       fd;
+	U8                       *st;
+	U32                       byteCount;
+	struct fb_var_screeninfo  vars;
+	struct fb_fix_screeninfo  consts;
+} VCFramebuffer;
+#define  NULL_VCFramebuffer  { -1, NULL, 0, {0}, {"", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, {0, 0}} }
+
+
+#define  VCCAM_MAX  (8)  /**<  Upper Limit of Cameras captured by one Process. */
+
+
+struct VCOutputCfg_;
+
+
+#define  VCMBOX_LATEST     (0)   /**<  Keeps the newest Frame of each Camera, replaces older ones.  */
+#define  VCMBOX_FIFO       (1)   /**<  Queues up to depth Frames, drops new ones while full.         */
+#define  VCMBOX_BLOCK      (2)   /**<  Queues up to depth Frames, the poster waits while full.       */
+#define  VCMBOX_DEPTH_MAX  (16)  /**<  Frames queued at most, at least VCCAM_MAX.                     */
+
+static const char *mailboxPolicyName[3] = { "latest", "fifo", "block" };
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Frame queued in a Mailbox.
+*/
+typedef struct
+{
+	VCFrameSlot                *slot;
+	const struct VCOutputCfg_  *cfg;
+} VCMailItem;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Mailbox of an Output Consumer running in a Thread of its own.
+*
+*    stdout and file output are not time critical, so they can be handed
+*    to a consumer thread at normal priority, each with its own mailbox.
+*    The policy decides what happens while the consumer falls behind,
+*    the capture thread keeps converting into free arena slots meanwhile.
+*/
+typedef struct
+{
+	const char      *pcName;
+	I32              enabledIff1;
+	I32              policy;         /*!<  VCMBOX_..                                */
+	I32              depth;          /*!<  Frames queued at most by FIFO and BLOCK. */
+	int            (*consume)(const struct VCOutputCfg_ *out, VCFrameSlot *slot);
+	pthread_t        thread;
+	pthread_mutex_t  mutex;
+	pthread_cond_t   condFilled;     /*!<  Signals the consumer a queued Frame.     */
+	pthread_cond_t   condFreed;      /*!<  Signals a waiting Poster a free Place.   */
+	VCMailItem       item[VCMBOX_DEPTH_MAX];
+	I32              first;
+	I32              count;          /*!<  Frames queued.                           */
+	I32              countMax;
+	I32              quitIff1;
+	U64              postCount;      /*!<  Frames posted.                           */
+	U64              frameCount;     /*!<  Frames consumed.                         */
+	U64              dropCount;      /*!<  Frames replaced or refused.              */
+	U64              blockCount;     /*!<  Posts which waited for a free Place.     */
+	U64              blockNS;
+} VCMailbox;
+#define  NULL_VCMailbox  { NULL, 0, VCMBOX_LATEST, 4, NULL, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, {{NULL, NULL}}, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+
+
+#define  VCSTREAM_CLIENT_MAX  (8)   /**<  Clients served at once at most.                */
+#define  VCSTREAM_DEPTH_MAX   (8)   /**<  Frames queued per Client at most.              */
+#define  VCSTREAM_IOV_MAX     (4)   /**<  Header and up to three Planes.                 */
+#define  VCSTREAM_EV_LISTEN   (VCSTREAM_CLIENT_MAX + 0)  /**<  epoll Data of the listening Socket, Clients use their Index. */
+#define  VCSTREAM_EV_POST     (VCSTREAM_CLIENT_MAX + 1)  /**<  epoll Data of the eventfd of posted Frames.                  */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Frame queued for a Stream Client.
+*/
+typedef struct
+{
+	VCFrameSlot     *slot;
+	VCStreamHeader   hdr;
+	VCStreamHeader   wire;       /*!<  hdr as sent, little endian.  */
+	U32              zcEnd;      /*!<  Zerocopy Notifications awaited before the Slot is released. */
+} VCStreamItem;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Connection of a Stream Client.
+*
+*    The queue holds the frames sent but not yet notified by the kernel
+*    (sentCount), the frame being sent, and the frames waiting.
+*/
+typedef struct
+{
+	int              fd;             /*!<  -1: unused.                               */
+	char             acPeer[32];
+	I32              zeroCopyIff1;   /*!<  The Socket accepted SO_ZEROCOPY.          */
+	VCStreamItem     item[VCSTREAM_DEPTH_MAX];
+	I32              first;
+	I32              count;
+	I32              sentCount;
+	U64              sentBytes;      /*!<  Bytes sent of the next Frame.             */
+	U32              zcNext;         /*!<  Number of the next zerocopy sendmsg().    */
+	U32              zcDone;         /*!<  Zerocopy sendmsg() calls notified.        */
+	U64              connectNS;
+	U64              frameCount;
+	U64              dropCount;
+	U64              byteCount;
+	U64              zcCount;        /*!<  sendmsg() calls with MSG_ZEROCOPY.        */
+	U64              zcCopiedCount;  /*!<  Of them the kernel copied anyway.         */
+	VCLatencyStats   latSend;        /*!<  Capture to the last Byte handed to the Kernel. */
+} VCStreamClient;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  TCP Server streaming the Frames to its Clients.
+*
+*    The capture thread only leaves the newest frame of each camera in
+*    the inbox. The server thread queues it for every client and sends
+*    from the slot, so a slow client misses frames but never stalls
+*    capturing or the other clients.
+*/
+typedef struct
+{
+	I32              port;           /*!<  0: no Server.                             */
+	I32              depth;          /*!<  Frames queued per Client.                 */
+	I32              clientMax;
+	I32              zeroCopyIff1;   /*!<  Send with MSG_ZEROCOPY where supported.   */
+	int              listenFd;
+	int              epollFd;
+	int              eventFd;        /*!<  Signals posted Frames and quitting.       */
+	pthread_t        thread;
+	pthread_mutex_t  mutex;          /*!<  Guards inbox and quitIff1.                */
+	VCStreamItem     inbox[VCCAM_MAX];
+	I32              quitIff1;
+	U64              postCount;
+	U64              inboxDropCount; /*!<  Frames replaced before the Thread took them. */
+	U64              acceptCount;
+	U64              refuseCount;
+	VCStreamClient   client[VCSTREAM_CLIENT_MAX];
+} VCStreamServer;
+#define  NULL_VCStreamServer  { 0, 2, 4, 1, -1, -1, -1, 0, PTHREAD_MUTEX_INITIALIZER, {{0}}, 0, 0, 0, 0, 0, {{0}} }
+
+
+#define  VCMCAST_MTU_MIN  (576)       /**<  Smallest Datagram every IPv4 Host takes.  */
+#define  VCMCAST_SNDBUF   (4 << 20)   /**<  Send Buffer asked for.                    */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  UDP Multicast Output.
+*
+*    Every receiver joining the group gets the same datagrams, so the
+*    bandwidth does not grow with the receivers. Sent by the thread of
+*    the multicast mailbox.
+*/
+typedef struct
+{
+	char             acGroup[64];
+	I32              port;           /*!<  0: no Multicast.                          */
+	char             acIface[64];    /*!<  Address of the sending Interface, "": by Route. */
+	I32              mtu;            /*!<  Bytes per Datagram incl. IP and UDP Header. */
+	I32              ttl;
+	int              fd;
+	struct sockaddr_in  addr;
+	U32              frameId;
+	VCMcastFragHeader   frag[VCMCAST_BATCH];
+	struct iovec     iov[VCMCAST_BATCH][VCSTREAM_IOV_MAX + 1];
+	struct mmsghdr   msg[VCMCAST_BATCH];
+	U64              frameCount;
+	U64              datagramCount;
+	U64              byteCount;
+	U64              callCount;      /*!<  sendmmsg() Calls.                         */
+	U64              errorCount;     /*!<  Datagrams refused by the Kernel.          */
+	VCLatencyStats   latSend;        /*!<  Capture to the last Datagram sent.        */
+} VCMulticast;
+#define  NULL_VCMulticast  { "", 0, "", 1500, 1, -1, {0}, 0, {{0}}, {{{NULL, 0}}}, {{{0}, 0}}, 0, 0, 0, 0, 0, NULL_VCLatencyStats }
+
+
+#define  VCJPEG_BLOCK_MAX   (448)   /**<  Bytes of a coded Block at most, Stuffing included.  */
+#define  VCJPEG_HEADER_MAX  (1024)  /**<  Bytes of the Headers up to the Scan.               */
+
+static const U8 jpegNaturalOrder[64] = {  0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+                                         12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+                                         35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                         58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+typedef I32  VCVec8i __attribute__((vector_size(32)));  /**<  Row of a Block, 8 Lanes of 32 Bit.  */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Huffman Code of each Symbol of a Table.
+*/
+typedef struct
+{
+	U16   code[256];
+	U8    size[256];   /*!<  Bits of the Code, 0: Symbol unused.  */
+} VCJpegHuff;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Bits of a Slice not yet written.
+*/
+typedef struct
+{
+	U8   *p;      /*!<  Next Byte of the Slice.                */
+	U64   acc;    /*!<  Pending Bits in the lowest bits Bits.  */
+	I32   bits;
+} VCJpegBits;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Baseline JPEG Encoder of a Camera.
+*
+*    Grey captures are one component, colour ones YCbCr 4:2:0. Each
+*    restart interval of restartRows MCU rows is a slice of its own,
+*    encoded by a worker into its place in the slot's JPEG buffer.
+*    The slices are moved together once all are done.
+*/
+typedef struct
+{
+	I32             quality;        /*!<  1..100, 0: no JPEG.                        */
+	I32             restartRows;    /*!<  MCU Rows per Restart Interval.             */
+	I32             dx, dy;
+	I32             colourIff1;
+	I32             mcuSize;        /*!<  8 for grey, 16 for 4:2:0.                  */
+	I32             mcuCols;
+	I32             sliceCount;
+	size_t          sliceCap;       /*!<  Bytes reserved per Slice.                  */
+	size_t          bufSize;        /*!<  Bytes of each Slot's JPEG Buffer.          */
+	U8              header[VCJPEG_HEADER_MAX];
+	I32             headerBytes;
+	I32             recip[2][64];   /*!<  2^18 / 8 Quantizer, transposed like the DCT. */
+	VCJpegHuff      dc[2];          /*!<  Luminance and Chrominance Tables.          */
+	VCJpegHuff      ac[2];
+	U32            *sliceBytes;     /*!<  Bytes of each Slice, set by the Workers.   */
+	U64             frameCount;
+	U64             byteCount;
+	VCLatencyStats  latEncode;      /*!<  Slice Bands of all Workers and Finish.     */
+} VCJpeg;
+#define  NULL_VCJpeg  { 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, {0}, 0, {{0}}, {{{0}, {0}}}, {{{0}, {0}}}, NULL, 0, 0, NULL_VCLatencyStats }
+
+
+#define  VCPREVIEW_ASCII     (0)   /**<  Characters of the Brightness Ramp, two per Pixel. */
+#define  VCPREVIEW_COLOUR    (1)   /**<  Ramp Characters in ANSI 256 Colours.             */
+#define  VCPREVIEW_HALF      (2)   /**<  Coloured Upper Half Blocks, two Pixel Rows each. */
+#define  VCPREVIEW_CELL_MAX  (24)  /**<  Bytes of a Sample at most, Escapes included.     */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  ASCII View of the first Camera at stdout.
+*/
+typedef struct
+{
+	I32             mode;           /*!<  VCPREVIEW_ASCII, _COLOUR or _HALF.          */
+	I32             cols;           /*!<  Characters per Line, 0: every 50th Pixel.   */
+	I32             periodMS;       /*!<  Refreshes this far apart at least.          */
+	I32             ttyIff1;        /*!<  stdout is a Terminal, else nothing is drawn. */
+	char            ramp[256];      /*!<  Character of each Brightness.               */
+	U8              grey[256];      /*!<  ANSI Colour of each Grey Value.             */
+	U8              cube[256];      /*!<  Colour Cube Level 0..5 of each Value.       */
+	char            acNum[256][4];  /*!<  Decimal Digits of each ANSI Colour.         */
+	char           *buf;            /*!<  View with Escapes, written at once.         */
+	size_t          bufSize;
+	I32             lines;          /*!<  Lines of the last Refresh, overwritten next. */
+	U64             nextNS;
+	U64             frameCount;
+	U64             skipCount;
+	U64             byteCount;
+	VCLatencyStats  latRender;
+} VCPreview;
+#define  NULL_VCPreview  { VCPREVIEW_ASCII, 0, 100, 0, {0}, {0}, {0}, {{0}}, NULL, 0, 0, 0, 0, 0, 0, NULL_VCLatencyStats }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Outputs a Camera's Captures are copied to.
+*/
+typedef struct VCOutputCfg_
+{
+	I32              camIdx;
+	I32              stdOutIff1;
+	I32              netSrvOutIff1;
+	VCImgNetCfg     *imgnetCfg;
+	I32              fbOutIff1;
+	char            *pcFramebufferDev;
+	I32              fileOutIff1;
+	char             acFilePrefix[32];  /*!<  Filename without Frame Number.     */
+	VCMailbox       *stdOutBox;         /*!<  Takes stdout output if not NULL.   */
+	VCMailbox       *fileBox;           /*!<  Takes file output if not NULL.     */
+	VCStreamServer  *stream;            /*!<  Streams the Frames if not NULL.    */
+	U64              captureNS;         /*!<  Capture Time of the Frame processed. */
+	VCMulticast     *mcast;             /*!<  Multicasts the Frames if not NULL. */
+	VCMailbox       *mcastBox;          /*!<  Thread sending to mcast.           */
+	VCJpeg          *jpeg;              /*!<  Files and Streams get JPEGs if not NULL. */
+	VCPreview       *preview;           /*!<  ASCII View if stdOutIff1.          */
+} VCOutputCfg;
+#define  NULL_VCOutputCfg  { 0, 0, 0, NULL, 0, NULL, 0, "img", NULL, NULL, NULL, 0, NULL, NULL, NULL, NULL }
+
+
+#define  VCAE_HIST_BINS   (64)  /**<  Histogram Bins of the Auto Exposure Measurement.  */
+#define  VCAE_SUBSAMPLE   ( 4)  /**<  Every n-th Pixel of every n-th Row is measured.   */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Brightness Measurement of a Frame for the Auto Exposure.
+*/
+typedef struct
+{
+	U64   sum;
+	U32   count;
+	U32   hist[VCAE_HIST_BINS];
+	U32   pad[14];              /*!<  Keeps per Worker Measurements apart by a Cache Line. */
+} VCAeMeasure;
+
+
+#define  VCGATE_BLOCK         ( 16)  /**<  Block Size of the decimated Reference in Pixels.        */
+#define  VCGATE_SUBSAMPLE     (  2)  /**<  Every n-th Pixel of every n-th Row is summed.           */
+#define  VCGATE_BLOCKS_X_MAX  (256)  /**<  Blocks per Row at most.                                 */
+#define  VCGATE_NOISE         (  6)  /**<  Difference of Block Means still treated as unchanged.   */
+
+#define  VCGATE_OUT_FILE      (0)    /**<  File Output.                                            */
+#define  VCGATE_OUT_FB        (1)    /**<  Framebuffer Output.                                     */
+#define  VCGATE_OUT_NET       (2)    /**<  vcimgnetsrv Output.                                     */
+#define  VCGATE_OUT_COUNT     (3)
+
+
+#define  VCSINK_FILE    (VCGATE_OUT_FILE)  /**<  File Output.                      */
+#define  VCSINK_FB      (VCGATE_OUT_FB)    /**<  Framebuffer Output.               */
+#define  VCSINK_NET     (VCGATE_OUT_NET)   /**<  vcimgnetsrv Output.               */
+#define  VCSINK_STDOUT  (3)                /**<  ASCII View at stdout, not gated.  */
+#define  VCSINK_STREAM  (4)                /**<  Stream Server, not gated.         */
+#define  VCSINK_MCAST   (5)                /**<  UDP Multicast, not gated.         */
+#define  VCSINK_COUNT   (6)
+
+static const char *sinkName[VCSINK_COUNT] = { "file", "framebuffer", "vcimgnetsrv", "stdout", "stream", "multicast" };
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Change Gate: skips expensive Outputs of unchanged Frames.
+*
+*    The conversion sums the captures into 16x16 block means. Each output
+*    compares them with the means of the frame it output last: its score
+*    is the share of blocks differing by more than VCGATE_NOISE, in 1/1000.
+*    A frame is output if the score reaches the output's threshold, or if
+*    keepAlive frames have passed since its last output.
+*/
+typedef struct
+{
+	I32   enabledIff1;
+	I32   threshold[VCGATE_OUT_COUNT];    /*!<  Score to output, 0: every Frame.           */
+	I32   keepAlive;                      /*!<  Frames output at least every, 0: never forced. */
+	I32   dx, dy;
+	I32   bx, by;                         /*!<  Blocks per Row and per Column.            */
+	U32  *blockSum;                       /*!<  Block Sums of the current Capture.        */
+	U8   *ref[VCGATE_OUT_COUNT];          /*!<  Block Means of the last Frame output.     */
+	I32   refValidIff1[VCGATE_OUT_COUNT];
+	I32   sinceOutput[VCGATE_OUT_COUNT];  /*!<  Frames skipped since the last Output.     */
+	I32   score[VCGATE_OUT_COUNT];        /*!<  Score of the latest Frame.                */
+	U64   frameCount;
+	U64   skipCount[VCGATE_OUT_COUNT];    /*!<  Frames skipped per Output.                */
+} VCChangeGate;
+#define  NULL_VCChangeGate  { 0, {0, 0, 0}, 0, 0, 0, 0, 0, NULL, {NULL, NULL, NULL}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, 0, {0, 0, 0} }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Rate Rule of an Output.
+*/
+typedef struct
+{
+	I32   every;       /*!<  Every n-th Frame, 1: all.                       */
+	U64   periodNS;    /*!<  Capture Time between two Frames, 0: none.       */
+	I32   priority;    /*!<  Due Outputs of higher Priority run first.       */
+	U64   nextNS;      /*!<  Capture Time the next Frame is due from.        */
+	U64   dueCount;
+	U64   skipCount;
+} VCSinkRate;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Output Scheduler of a Camera.
+*
+*    Decides before each capture which outputs are due, by their rate
+*    rules, and in which order they run. Captures no output is due for
+*    are not converted, unless a measurement or the rectification needs them.
+*/
+typedef struct
+{
+	I32         enabledIff1;
+	VCSinkRate  sink[VCSINK_COUNT];
+	I32         order[VCSINK_COUNT];  /*!<  Outputs by descending Priority.              */
+	U64         frameCount;
+	U32         dueMask;              /*!<  Outputs due for the current Capture, 1 << VCSINK_..  */
+	U64         convertSkipCount;     /*!<  Captures not converted.                      */
+} VCOutputSched;
+#define  NULL_VCOutputSched  { 0, {{1, 0, 0, 0, 0, 0}, {1, 0, 3, 0, 0, 0}, {1, 0, 2, 0, 0, 0}, {1, 0, 1, 0, 0, 0}, {1, 0, 2, 0, 0, 0}, {1, 0, 2, 0, 0, 0}}, {VCSINK_FB, VCSINK_NET, VCSINK_STREAM, VCSINK_MCAST, VCSINK_STDOUT, VCSINK_FILE}, 0, 0, 0 }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  State of the Auto Exposure and Gain Controller of a Camera.
+*/
+typedef struct
+{
+	I32   enabledIff1;
+	F32   target;       /*!<  Mean 8 Bit Brightness to reach.                 */
+	F32   tolerance;    /*!<  Relative Deviation of the Mean treated as reached. */
+	F32   damping;      /*!<  Fraction of the Correction applied per Step (0..1]. */
+	I32   period;       /*!<  Frames between two Changes at least.            */
+	I32   latency;      /*!<  Frames until the Sensor applies a Change.       */
+
+	I32   shutterMin, shutterMax;
+	F32   gainMin,    gainMax;
+	I32   shutter;      /*!<  Last requested Shutter.                         */
+	F32   gain;         /*!<  Last requested Gain.                            */
+	F32   mean;         /*!<  Last measured Mean.                             */
+	I32   nextFrame;    /*!<  First Frame which reflects the last Change.     */
+
+	I32   convergedIff1;
+	U64   startNS;      /*!<  Start of the current Settling.                  */
+	U64   settleNS;     /*!<  Duration of the last Settling.                  */
+	U64   settleCount;
+	U64   applyCount;   /*!<  Changes requested from the Sensor.              */
+	U64   costNS;       /*!<  Time spent by the Controller incl. ioctl.       */
+	U64   costMaxNS;
+	U64   costCount;
+} VCAutoExposure;
+#define  NULL_VCAutoExposure  { 0, 110, 0.1f, 0.5f, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
+
+
+#define  VCTONE_NONE   (0)  /**<  Keep the upper 8 Bits.                            */
+#define  VCTONE_GAMMA  (1)  /**<  255 * x^param.                                    */
+#define  VCTONE_LOG    (2)  /**<  255 * log(1 + param * x) / log(1 + param).        */
+#define  VCTONE_CLAHE  (3)  /**<  Equalization of the last Histogram, clipped at param times the mean Bin. */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  10 to 8 Bit Tone Mapping of a Camera.
+*
+*    x is the 10 bit value above the black level, scaled to 0..1.
+*    Two LUTs are kept, the active one maps the current frame while
+*    the other one may be rebuilt.
+*/
+typedef struct
+{
+	I32          kind;         /*!<  VCTONE_..                                 */
+	F32          param;
+	I32          blackLevel;   /*!<  10 Bit Values up to it are mapped to 0.   */
+	U8           lut[2][VCSTATS_BINS];
+	U8 *volatile active;       /*!<  LUT of the next Frame, NULL for VCTONE_NONE. */
+	U64          buildCount;
+} VCToneMap;
+#define  NULL_VCToneMap  { VCTONE_NONE, 0, 0, {{0}}, NULL, 0 }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  IMU Reader Thread and its Sample Ring.
+*
+*    The thread is the only writer of the ring, it publishes a sample
+*    by incrementing head. Readers need no lock, they detect samples
+*    overwritten meanwhile from head, see imu_collect().
+*/
+typedef struct
+{
+	int           fd;             /*!<  Video Device of the Module.                  */
+	pthread_t     thread;
+	volatile I32  quitIff1;
+	I32           periodUS;       /*!<  Minimum Time between Reads, 0: Device Rate.  */
+	VCImuSample   ring[VCIMU_RING_SIZE];
+	volatile U64  head;           /*!<  Samples written, the newest is head-1.       */
+	U32           minDelta;       /*!<  Smallest Device Timestamp Step seen.         */
+	U64           firstNS;
+	U64           lastNS;
+	U64           readCount;
+	U64           duplicateCount; /*!<  Reads without a new Sample.                  */
+	U64           errorCount;
+	U64           dropCount;      /*!<  Samples missed by the Device Timestamps.     */
+	U64           overrunCount;   /*!<  Samples overwritten before being collected.  */
+	U64           truncCount;     /*!<  Samples beyond VCIMU_FRAME_MAX of a Frame.   */
+	U64           attachedCount;  /*!<  Samples attached to Frames.                  */
+	VCClockSync   sync;           /*!<  Device Ticks to CLOCK_MONOTONIC.             */
+	U64           queryCount;     /*!<  imu_at_exposure() Calls and their Time.      */
+	U64           queryNS;
+	U64           queryMissCount;
+} VCImu;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  One of several Cameras captured by the Process.
+*
+*    Each camera has its own capture queue, format, frame arena and
+*    outputs, the worker pool is shared. A camera with priority N may
+*    process up to N captures per round of the capture loop.
+*/
+typedef struct
+{
+	char            acVideoDev[64];
+	I32             idx;
+	I32             priority;          /*!<  Captures per Round, >= 1.              */
+	VCMipiSenCfg    sen;
+	VCOutputCfg     out;
+	I32             streamingIff1;
+	I32             readyIff1;         /*!<  Filled Buffers may be queued.          */
+	I32             frameNr;
+	I32             sequenceValidIff1;
+	U32             lastSequence;
+	U64             frameCount;        /*!<  Captures processed.                    */
+	U64             dropCount;         /*!<  Sequence Numbers skipped by the Driver. */
+	U64             firstNS;           /*!<  Dequeue Time of the first Capture.     */
+	U64             lastNS;            /*!<  Dequeue Time of the latest Capture.    */
+	VCLatencyStats  latWakeup;         /*!<  Capture to Dequeue.                    */
+	VCLatencyStats  latProcess;        /*!<  Dequeue to Processed.                  */
+	VCAutoExposure  ae;
+	I32             statsIff1;         /*!<  Accumulate Frame Statistics.           */
+	VCFrameStats    stats;             /*!<  Statistics of the latest Capture.      */
+	VCToneMap       tone;
+	VCImu          *imu;               /*!<  IMU of the Module or NULL.             */
+	U64             imuCursor;         /*!<  Next IMU Sample to attach.             */
+	VCClockSync     frameSync;         /*!<  V4L2 Timestamps to Dequeue Time.       */
+	VCCalib         calib;             /*!<  Calibration of the Module, if loaded.  */
+	VCRectify       rect;              /*!<  Rectification of the Captures.         */
+	VCChangeGate    gate;              /*!<  Skips Outputs of unchanged Captures.   */
+	VCOutputSched   sched;             /*!<  Rates and Priorities of the Outputs.   */
+	VCJpeg          jpeg;              /*!<  Encoder of the File and Stream Output. */
+} VCCamera;
+#define  NULL_VCCamera  { "", 0, 1, NULL_VCMipiSenCfg, NULL_VCOutputCfg, 0, 0, 0, 0, 0, 0, 0, 0, 0, NULL_VCLatencyStats, NULL_VCLatencyStats, NULL_VCAutoExposure, 0, NULL_VCFrameStats, NULL_VCToneMap, NULL, 0, NULL_VCClockSync, NULL_VCCalib, NULL_VCRectify, NULL_VCChangeGate, NULL_VCOutputSched, NULL_VCJpeg }
+
+
+#define  VCEV_SENSOR(idx)   (1u<<(idx))  /**<  Capture buffers of sensor idx (< 24) are ready. */
+#define  VCEV_TIMER         (1u<<29)     /**<  Statistics interval elapsed.                    */
+#define  VCEV_CONTROL       (1u<<30)     /**<  Control commands are queued.                    */
+#define  VCEV_QUIT          (1u<<31)     /**<  SIGINT or SIGTERM received.                     */
+
+#define  VCCTRL_QUEUE_SIZE      (16)     /**<  Control commands pending at most.               */
+#define  VCCTRL_SET_PARAMETERS  ( 1)     /**<  Apply shutter and gain.                          */
+#define  VCCTRL_QUIT            ( 2)     /**<  Stop streaming and quit.                         */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Control Command passed to the Capture Loop.
+*/
+typedef struct
+{
+	I32   type;      /*!<  VCCTRL_..                        */
+	I32   camIdx;    /*!<  Camera addressed, -1 for all.    */
+	I32   shutter;   /*!<  New Shutter for VCCTRL_SET_PARAMETERS. */
+	F32   gain;      /*!<  New Gain for VCCTRL_SET_PARAMETERS.    */
+} VCControlCmd;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  epoll based Event Loop of the Capture Thread.
+*
+*    All sources are edge triggered: capture devices, a timerfd for
+*    periodic statistics, an eventfd signalling queued control commands
+*    and a signalfd for SIGINT and SIGTERM.
+*/
+typedef struct
+{
+	int              epollFd;
+	int              timerFd;
+	int              eventFd;
+	int              signalFd;
+
+	pthread_mutex_t  mutex;        /*!<  Protects the control command queue. */
+	VCControlCmd     cmd[VCCTRL_QUEUE_SIZE];
+	I32              cmdFirst;
+	I32              cmdCount;
+
+	U64              wakeupCount;  /*!<  Returns of epoll_wait().                   */
+	U64              frameCount;   /*!<  Captures processed, counted by the caller. */
+	U64              waitNS;       /*!<  Time blocked in epoll_wait().              */
+	U64              busyNS;       /*!<  Time between wakeup and next wait.         */
+	U64              lastNS;
+} VCEventLoop;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Thread posting Control Commands read from stdin.
+*
+*    One command per line: 's shutter gain [camera]' applies shutter and
+*    gain to all or one camera, 'q' quits.
+*/
+typedef struct
+{
+	VCEventLoop  *loop;
+	int           stopFd;       /*!<  eventfd waking the thread to stop. */
+	pthread_t     thread;
+	U64           postCount;    /*!<  Commands posted to the loop.       */
+	U64           rejectCount;  /*!<  Lines not understood or not queued. */
+} VCConsole;
+#define  NULL_VCConsole  { NULL, -1, 0, 0, 0 }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Process wide Options of the Command Line.
+*/
+typedef struct
+{
+	I32   threadCount;
+	char  acCpuList[256];    /*!<  CPUs to pin the worker threads to.       */
+	I32   grain;             /*!<  Rows per band.                           */
+	I32   rtPriority;        /*!<  SCHED_FIFO priority, 0 for no real-time. */
+	I32   statsIntervalMS;   /*!<  Period of the statistics.                */
+	I32   kernelScalarIff1;  /*!<  Scalar kernels instead of SIMD ones.     */
+	I32   consoleIff1;       /*!<  Control commands read from stdin.        */
+} VCRunOptions;
+#define  NULL_VCRunOptions  { 0, "", 0, 0, 0, 0, 0 }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Capture Options of the Command Line, applied to every Camera.
+*/
+typedef struct
+{
+	I32             shutter;
+	F32             gain;
+	I32             bufCount;            /*!<  V4L2 buffers per camera.              */
+	I32             colourType;          /*!<  Image type of colour captures.        */
+	I32             ingestMode;          /*!<  VCINGEST_..                           */
+	I32             statsIff1;           /*!<  Frame statistics.                     */
+	I32             imuPeriodUS;         /*!<  IMU read period, -1 for no IMU.       */
+	char            acRegList[256];      /*!<  Sensor register list to apply.        */
+	char            acCalibDir[256];     /*!<  Directory of the calibration cache.   */
+	char            acStereoCalib[256];  /*!<  Stereo calibration, empty for none.   */
+	VCAutoExposure  ae;
+	VCToneMap       tone;
+	VCStereo        stereo;
+} VCCaptureOptions;
+#define  NULL_VCCaptureOptions  { 5000, 10, 3, IMAGE_RGB, VCINGEST_AUTO, 0, -1, "", "", "", NULL_VCAutoExposure, NULL_VCToneMap, NULL_VCStereo }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Output Options of the Command Line, shared by all Cameras.
+*/
+typedef struct
+{
+	I32             stdOutIff1;
+	I32             fbOutIff1;
+	I32             fileOutIff1;
+	char            acFramebufferDev[64];
+	VCChangeGate    gate;
+	VCOutputSched   sched;
+	VCMailbox       stdOutBox;
+	VCMailbox       fileBox;
+	VCMailbox       mcastBox;
+	VCStreamServer  stream;
+	VCMulticast     mcast;
+	VCJpeg          jpeg;
+	VCPreview       preview;
+} VCOutputOptions;
+#define  NULL_VCOutputOptions  { 1, -1, 0, "/dev/fb0", NULL_VCChangeGate, NULL_VCOutputSched, NULL_VCMailbox, NULL_VCMailbox, NULL_VCMailbox, NULL_VCStreamServer, NULL_VCMulticast, NULL_VCJpeg, NULL_VCPreview }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Per Camera State used by process_capture().
+*
+*    All but arena and pipe may be NULL to skip their part of the work.
+*/
+typedef struct
+{
+	VCFrameArena      *arena;
+	const VCPipeline  *pipe;
+	VCAeMeasure       *ae;
+	VCFrameStats      *stats;
+	const U8          *lut;
+	VCIngest          *ingest;
+	VCRectify         *rect;
+	VCChangeGate      *gate;
+	VCOutputSched     *sched;
+} VCProcessCfg;
+#define  NULL_VCProcessCfg  { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Per Frame Work of process_capture() distributed to the Worker Pool.
+*/
+typedef struct
+{
+	char          *st;
+	I32            dx, dy, pitch;
+	image         *imgConverted;  /*!<  Result of the conversion stage.          */
+	image         *imgRaw8;       /*!<  8 Bit Bayer intermediate for debayering. */
+	image         *imgNet;        /*!<  vcimgnetsrv image or NULL.               */
+	VCFramebuffer *fb;            /*!<  Mapped framebuffer or NULL.              */
+	VCAeMeasure   *ae;            /*!<  Auto exposure measurement per worker or NULL. */
+	VCFrameStats  *stats;         /*!<  Frame statistics per worker or NULL.     */
+	const U8      *lut;           /*!<  Tone mapping of RAW10 or NULL.           */
+	VCIngest      *ingest;        /*!<  Staging buffer to copy bands to, or NULL. */
+	VCRectify     *rect;          /*!<  Rectification or NULL.                   */
+	image         *imgRect;       /*!<  Rectified images of the slot.            */
+	volatile U64   rectNS;        /*!<  Time of the rectification bands.         */
+	VCStereo      *stereo;        /*!<  Block matching of a complete pair or NULL. */
+	const image   *imgEye[2];     /*!<  Rectified left and right eye.            */
+	U16           *disp;          /*!<  Disparity image of the slot.             */
+	volatile U64   dispNS;        /*!<  Time of the census and matching bands.   */
+	VCChangeGate  *gate;          /*!<  Change gate measured by the conversion, or NULL. */
+	I32            netStageIff1;  /*!<  vcimgnetsrv copy is a stage of its own.  */
+	VCJpeg        *jpeg;          /*!<  Encoder of the JPEG stage.               */
+	U8            *jpegOut;       /*!<  JPEG buffer of the slot.                 */
+	VCChangeGate  *jpegGate;      /*!<  Gate of the file output if only it takes the JPEG, or NULL. */
+	volatile U64   jpegNS;        /*!<  Time of the JPEG bands.                  */
+	volatile I32   rc;            /*!<  First error of a band, else 0.           */
+} VCFrameJob;
+
+
+int  change_options_by_commandline(int argc, char *argv[], VCRunOptions *run, VCCaptureOptions *capture, VCOutputOptions *output, VCCamera *cam, int *camCount);
+int  sensor_open(char *dev_video_device, VCMipiSenCfg *sen, int qBufCount, int slotCount, int prefaultIff1, int colourType, int ingestMode);
+void ingest_copy(U8 *dst, const U8 *src, size_t byteCount);
+U32  cpu_features(void);
+void kernels_bind(I32 scalarIff1);
+void kernels_print(void);
+void FL_CPY_RAW10P_U8P_NOOFFS(U32 count, char *bufIn, U8 *bufOut);
+int  ingest_init(VCIngest *ig, I32 mode, const void *src, size_t byteCount, I32 prefaultIff1);
+void ingest_destroy(VCIngest *ig);
+I32  ingest_print_stats(const char *pcName, const VCIngest *ig);
+int  sensor_close(VCMipiSenCfg *sen);
+int  sensor_query_controls(VCMipiSenCfg *sen);
+int  sensor_set_controls(VCMipiSenCfg *sen, const I32 *ctrlIdx, const I64 *value, I32 count);
+int  sensor_set_parameters(VCMipiSenCfg  *sen, F32 newGain, I32 newShutter);
+int  sensor_regs_init(VCSensorRegs *regs, int fd);
+void sensor_regs_destroy(VCSensorRegs *regs);
+int  sensor_reg_write(VCSensorRegs *regs, U16 addr, U16 value);
+int  sensor_reg_flush(VCSensorRegs *regs);
+int  sensor_reg_read_many(VCSensorRegs *regs, const U16 *addr, U16 *value, I32 count);
+int  sensor_reg_read(VCSensorRegs *regs, U16 addr, U16 *value);
+void sensor_reg_set_volatile(VCSensorRegs *regs, U16 addr);
+void sensor_reg_invalidate(VCSensorRegs *regs);
+int  sensor_reg_apply_list(VCSensorRegs *regs, const char *pcList, I32 camIdx);
+void sensor_regs_print_stats(const char *pcName, const VCSensorRegs *regs);
+U32  crc32_update(U32 crc, const U8 *p, size_t byteCount);
+int  calib_load(VCCalib *cal, int fd, const char *pcVideoDev, const char *pcCacheDir);
+void calib_unload(VCCalib *cal);
+int  stereo_calib_get(VCStereoCalib *sc, const char *pcSource, const VCCalib *moduleCal);
+int  rectify_init(VCRectify *rect, const VCStereoCalib *sc, I32 firstEye, I32 eyeCount, VCFrameArena *arena);
+void rectify_destroy(VCRectify *rect);
+void rectify_band(const VCRectify *rect, I32 t, const U8 *src, image *dst, I32 y0, I32 y1);
+int  stereo_init(VCStereo *st, const VCStereo *cfg, I32 dx, I32 dy, I32 workerCount);
+int  stereo_attach(VCStereo *st, VCRectify *rect, VCFrameArena *arena);
+void stereo_destroy(VCStereo *st);
+I32  stereo_pair(VCStereo *st, const VCRectify *rect, VCFrameSlot *slot, const image **imgEye);
+void stereo_keep(VCStereo *st, const VCRectify *rect, const VCFrameSlot *slot);
+void stereo_census_band(VCStereo *st, const image **imgEye, I32 y0, I32 y1);
+void stereo_disparity_band(VCStereo *st, const image **imgEye, U16 *disp, I32 y0, I32 y1, I32 workerIdx);
+I32  stereo_print_stats(const char *pcName, VCStereo *st);
+int  jpeg_init(VCJpeg *jp, const VCJpeg *cfg, VCFrameArena *arena);
+void jpeg_destroy(VCJpeg *jp);
+void jpeg_encode_band(const VCJpeg *jp, const image *img, U8 *out, I32 y0, I32 y1);
+U32  jpeg_finish(VCJpeg *jp, U8 *out);
+I32  jpeg_print_stats(const char *pcName, VCJpeg *jp);
+int  sensor_streaming_start(VCMipiSenCfg *sen);
+int  sensor_streaming_stop(VCMipiSenCfg *sen);
+int  capture_buffer_enqueue(I32 bufIdx, VCMipiSenCfg *sen);
+int  capture_buffer_dequeue(I32 *bufIdx, VCMipiSenCfg *sen);
+int  event_loop_create(VCEventLoop *loop, I32 statsIntervalMS);
+int  event_loop_add_sensor(VCEventLoop *loop, VCMipiSenCfg *sen, I32 idx);
+int  event_loop_wait(VCEventLoop *loop, U32 *events);
+int  event_loop_post_control(VCEventLoop *loop, const VCControlCmd *cmd);
+int  event_loop_get_control(VCEventLoop *loop, VCControlCmd *cmd);
+void event_loop_print_stats(VCEventLoop *loop);
+void event_loop_destroy(VCEventLoop *loop);
+int  console_parse(const char *pcLine, VCControlCmd *cmd);
+int  console_start(VCConsole *con, VCEventLoop *loop, I32 excludedCpu);
+void console_stop(VCConsole *con);
+int  imgnet_connect(VCImgNetCfg *imgnetCfg, U32 pixelformat, int dx, int dy);
+int  imgnet_disconnect(VCImgNetCfg *imgnetCfg);
+int  process_capture(VCWorkerPool *pool, const VCProcessCfg *proc, const VCOutputCfg *out, void *st, int dx, int dy, int pitch, int frameNr);
+I32  copy_grey_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
+I32  copy_grey_to_image_band(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1, VCFrameStats *stats);
+I32  convert_raw10_to_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
+I32  convert_raw10_to_image_band(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1, VCFrameStats *stats, const U8 *lut);
+I32  convert_raw10_and_debayer_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
+I32  convert_raw10_and_debayer_image_band(image *imgOut, image *imgU8, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1, VCFrameStats *stats, const U8 *lut);
+I32  simple_debayer_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
+I32  simple_debayer_to_image_band(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1);
+const VCPipeline *pipeline_select(U32 pixelformat, I32 dx, I32 pitch, I32 stride);
+int  copy_image(image *in, image *out);
+int  copy_image_band(image *in, image *out, I32 y0, I32 y1);
+int  copy_image_to_framebuffer(char *pcFramebufferDev, const void *pvDataGREY_OR_R, const void *pvDataGREY_OR_G, const void *pvDataGREY_OR_B, I32 dy, I32 pitch, I32 stride);
+int  framebuffer_open(char *pcFramebufferDev, VCFramebuffer *fb);
+int  framebuffer_close(VCFramebuffer *fb);
+I32  framebuffer_rows(VCFramebuffer *fb, I32 dy);
+void copy_image_to_framebuffer_band(VCFramebuffer *fb, const void *pvDataGREY_OR_R, const void *pvDataGREY_OR_G, const void *pvDataGREY_OR_B, I32 dy, I32 pitch, I32 stride, I32 y0, I32 y1);
+I32  image_pixel_stride(const image *img);
+void image_channels(const image *img, U8 **r, U8 **g, U8 **b);
+int  worker_pool_create(VCWorkerPool *pool, I32 workerCount, const char *pcCpuList, I32 grain);
+void worker_pool_destroy(VCWorkerPool *pool);
+int  worker_pool_run(VCWorkerPool *pool, const VCPoolStage *stage, I32 stageCount);
+I32  worker_pool_print_stats(VCWorkerPool *pool);
+U64  timestamp_ns(void);
+int  worker_pool_set_realtime(VCWorkerPool *pool, I32 priority);
+int  realtime_enable(I32 priority, I32 cpu);
+int  frame_arena_create(VCFrameArena *arena, U32 pixelformat, I32 dx, I32 dy, I32 slotCount, I32 prefaultIff1, I32 colourType);
+void frame_arena_destroy(VCFrameArena *arena);
+VCFrameSlot *frame_arena_acquire(VCFrameArena *arena);
+void frame_slot_release(VCFrameSlot *slot);
+void frame_stats_reset(VCFrameStats *stats, I32 step, U32 saturation);
+void frame_stats_add_row_u8(VCFrameStats *stats, const U8 *row, const U8 *rowPrev, U32 count);
+void frame_stats_reduce(VCFrameStats *stats, const VCFrameStats *band, I32 lastIff1);
+int  mailbox_start(VCMailbox *box, const char *pcName, int (*consume)(const struct VCOutputCfg_ *out, VCFrameSlot *slot), I32 excludedCpu);
+I32  mailbox_slot_count(const VCMailbox *box);
+void mailbox_post(VCMailbox *box, const VCOutputCfg *cfg, VCFrameSlot *slot);
+void mailbox_stop(VCMailbox *box);
+void mailbox_print_stats(const VCMailbox *box);
+int  output_write_files(const VCOutputCfg *out, VCFrameSlot *slot);
+int  output_print_ascii(const VCOutputCfg *out, VCFrameSlot *slot);
+void stream_header_fill(VCStreamHeader *hdr, const VCOutputCfg *cfg, const VCFrameSlot *slot);
+I32  stream_frame_parts(const VCStreamHeader *hdr, const VCStreamHeader *wire, const VCFrameSlot *slot, U8 **base, size_t *len);
+int  stream_start(VCStreamServer *srv, I32 excludedCpu);
+I32  stream_slot_count(const VCStreamServer *srv);
+void stream_post(VCStreamServer *srv, const VCOutputCfg *cfg, VCFrameSlot *slot);
+void stream_client_print_stats(const VCStreamClient *c);
+void stream_print_stats(const VCStreamServer *srv);
+void stream_stop(VCStreamServer *srv);
+int  multicast_open(VCMulticast *mc);
+int  output_send_multicast(const VCOutputCfg *out, VCFrameSlot *slot);
+void multicast_print_stats(VCMulticast *mc);
+void multicast_close(VCMulticast *mc);
+void latency_stats_add(VCLatencyStats *lat, U64 ns);
+int  imu_read(int fd, VCImuSample *s);
+int  imu_start(VCImu *imu, int fd, I32 periodUS, I32 priority, I32 excludedCpu);
+void imu_stop(VCImu *imu);
+I32  imu_collect(VCImu *imu, U64 *cursor, U64 toNS, VCImuSample *out, I32 maxCount);
+I32  imu_print_stats(const char *pcName, const VCImu *imu);
+void clock_sync_add(VCClockSync *cs, U64 x, U64 y);
+I32  clock_sync_map(VCClockSync *cs, U64 x, U64 *y);
+I32  clock_sync_unmap(VCClockSync *cs, U64 y, U64 *x);
+I32  clock_sync_fit(VCClockSync *cs, VCClockFit *fit);
+I32  clock_fit_unmap(const VCClockFit *fit, U64 y, U64 *x);
+I32  clock_sync_print(const char *pcName, VCClockSync *cs, F64 nominalNS);
+I32  imu_sample_at(VCImu *imu, const VCClockFit *fit, U64 monoNS, VCImuSample *out);
+I32  imu_integrate(VCImu *imu, U64 t0NS, U64 t1NS, F32 *dAngle, F32 *dVelocity);
+I32  imu_at_exposure(VCImu *imu, QBuf *qbuf, I64 shutter);
+I32  imu_print_sync_stats(I32 camIdx, VCImu *imu, VCClockSync *frameSync);
+I32  latency_stats_print(const char *pcName, VCLatencyStats *lat);
+void camera_schedule_order(VCCamera *cam, I32 camCount, I32 *order);
+int  camera_process_next(VCCamera *c, VCWorkerPool *pool);
+int  camera_process_ready(VCCamera *cam, I32 camCount, const I32 *order, VCWorkerPool *pool, VCEventLoop *loop);
+I32  camera_print_stats(VCCamera *c);
+void auto_exposure_measure_band(VCAeMeasure *m, image *img, I32 y0, I32 y1);
+int  auto_exposure_init(VCAutoExposure *ae, const VCAutoExposure *cfg, VCMipiSenCfg *sen, F32 gain, I32 shutter);
+int  auto_exposure_update(VCAutoExposure *ae, VCMipiSenCfg *sen, const VCAeMeasure *m, I32 frameNr);
+I32  auto_exposure_print_stats(const char *pcName, VCAutoExposure *ae);
+int  change_gate_init(VCChangeGate *gate, const VCChangeGate *cfg, I32 dx, I32 dy);
+void change_gate_destroy(VCChangeGate *gate);
+void change_gate_measure_band(VCChangeGate *gate, image *img, I32 y0, I32 y1);
+I32  change_gate_score(const VCChangeGate *gate, I32 o);
+I32  change_gate_due(const VCChangeGate *gate, I32 o);
+U32  change_gate_update(VCChangeGate *gate, U32 activeMask);
+I32  change_gate_print_stats(const char *pcName, const VCChangeGate *gate);
+void output_sched_init(VCOutputSched *sched, const VCOutputSched *cfg);
+void output_sched_update(VCOutputSched *sched, const VCOutputCfg *out, U64 captureNS);
+I32  output_sched_print_stats(const char *pcName, const VCOutputSched *sched);
+void tone_map_init(VCToneMap *tm, const VCToneMap *cfg);
+void tone_map_update(VCToneMap *tm, const VCFrameStats *stats);
+const U8 *tone_map_lut(VCToneMap *tm);
+I32  write_image_as_pnm(char *path, image *img);
+I32  write_disparity_as_pgm(char *path, const U16 *disp, I32 dx, I32 dy);
+I32  write_jpeg(char *path, const U8 *data, U32 byteCount);
+void preview_init(VCPreview *pv);
+void preview_destroy(VCPreview *pv);
+int  preview_render(VCPreview *pv, const image *img);
+I32  preview_print_stats(const char *pcName, VCPreview *pv);
+void timemeasurement_start(struct  timeval *timer);
+void timemeasurement_stop(struct  timeval *timer, I64 *s, I64 *us);
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Main Function of vcmipidemo.
+*
+*  This is the main function of the vcmipidemo.
+*/
+/*-----------------------------------------------------------------------------*/
+int  main(int argc, char *argv[])
+{
+	#ifdef DURATION_TEST
+		struct timeval timer;
+		I64            seconds, useconds;
+		int            timerCycles = 100;
+		U64            run=0;
+		int            statusLines;
+	#endif
+
+	int            ee, rc=0, bufIdx, i;
+	int            netSrvIff1 = 0;
+	int            quitIff1  = 0;
+	U32            events;
+	VCEventLoop    loop;
+	int            loopIff1  = 0;
+	VCControlCmd   cmd;
+	VCRunOptions     runOpts     = NULL_VCRunOptions;
+	VCCaptureOptions captureOpts = NULL_VCCaptureOptions;
+	VCOutputOptions  outputOpts  = NULL_VCOutputOptions;
+	VCCamera       cam[VCCAM_MAX];
+	char           acRegName[64];
+	VCStereoCalib  stereoCalib;
+	int            rectCamCount = 0;
+	VCStereo       stereo    = NULL_VCStereo;
+	int            stereoIff1 = 0;
+	VCImu          imu;
+	int            imuIff1   = 0;
+	int            camCount  = 0;
+	int            camOrder[VCCAM_MAX];
+	VCImgNetCfg    imgnetCfg = NULL_VCImgNetCfg;
+	VCWorkerPool   pool;
+	int            poolIff1  = 0;
+	int            stdOutBoxIff1 = 0;
+	int            fileBoxIff1   = 0;
+	int            streamIff1 = 0;
+	int            mcastIff1 = 0;
+	int            mcastBoxIff1 = 0;
+	int            arenaSlotCount;
+	VCConsole      console   = NULL_VCConsole;
+	int            consoleIff1 = 0;
+
+	for(i= 0; i< VCCAM_MAX; i++)
+	{
+		VCCamera  camNuller = NULL_VCCamera;
+
+		cam[i] = camNuller;
+	}
+
+	// Set up configuration and apply command line parameters if set.
+	{
+		rc =  change_options_by_commandline(argc, argv, &runOpts, &captureOpts, &outputOpts, cam, &camCount);
+		if(rc>0){ee=0; goto quit;}
+		if(rc<0){ee=-1+100*rc; goto quit;}
+
+		if(0==camCount)
+		{
+			strcpy(cam[0].acVideoDev, "/dev/video0");
+			camCount = 1;
+		}
+
+		// Piped or redirected, the view would only cost time.
+		if(1==outputOpts.stdOutIff1)
+		{
+			preview_init(&outputOpts.preview);
+			if(0==outputOpts.preview.ttyIff1){ printf("stdout is no terminal, no ASCII view.\n"); outputOpts.stdOutIff1 = 0; }
+		}
+	}
+
+
+	// Blocks SIGINT and SIGTERM for all threads started later,
+	// the capture thread receives them via signalfd to stop cleanly.
+	{
+		rc =  event_loop_create(&loop, runOpts.statsIntervalMS);
+		if(rc<0){ee=-14+100*rc; goto quit;}
+		loopIff1 = 1;
+	}
+
+
+	// Bind the conversion kernels before any thread uses them.
+	{
+		kernels_bind(runOpts.kernelScalarIff1);
+		kernels_print();
+	}
+
+
+	// Start the worker threads once, they are shared by all cameras and reused for every capture.
+	{
+		rc =  worker_pool_create(&pool, runOpts.threadCount, runOpts.acCpuList, runOpts.grain);
+		if(rc<0){ee=-11+100*rc; goto quit;}
+		poolIff1 = 1;
+	}
+
+
+	// stdout and file output move to normal priority threads of their own
+	// in real-time mode or if given a mailbox policy, the stream server
+	// and the multicast run at normal priority as well.
+	{
+		if((1==outputOpts.stdOutIff1)&&((runOpts.rtPriority>0)||(1==outputOpts.stdOutBox.enabledIff1)))
+		{
+			rc =  mailbox_start(&outputOpts.stdOutBox, "stdout", output_print_ascii, (runOpts.rtPriority>0)?(pool.cpu[0]):(-1));
+			if(rc<0){ee=-12+100*rc; goto quit;}
+			stdOutBoxIff1 = 1;
+		}
+		if((1==outputOpts.fileOutIff1)&&((runOpts.rtPriority>0)||(1==outputOpts.fileBox.enabledIff1)))
+		{
+			rc =  mailbox_start(&outputOpts.fileBox, "file", output_write_files, (runOpts.rtPriority>0)?(pool.cpu[0]):(-1));
+			if(rc<0){ee=-12+100*rc; goto quit;}
+			fileBoxIff1 = 1;
+		}
+		if(outputOpts.stream.port>0)
+		{
+			rc =  stream_start(&outputOpts.stream, (runOpts.rtPriority>0)?(pool.cpu[0]):(-1));
+			if(rc<0){ee=-22+100*rc; goto quit;}
+			streamIff1 = 1;
+		}
+		if(outputOpts.mcast.port>0)
+		{
+			rc =  multicast_open(&outputOpts.mcast);
+			if(rc<0){ee=-23+100*rc; goto quit;}
+			mcastIff1 = 1;
+
+			rc =  mailbox_start(&outputOpts.mcastBox, "multicast", output_send_multicast, (runOpts.rtPriority>0)?(pool.cpu[0]):(-1));
+			if(rc<0){ee=-12+100*rc; goto quit;}
+			mcastBoxIff1 = 1;
+		}
+
+		// Besides the frame processed, each mailbox and the stream server may hold frames of a camera.
+		arenaSlotCount = 1;
+		if(1==stdOutBoxIff1){ arenaSlotCount += mailbox_slot_count(&outputOpts.stdOutBox); }
+		if(1==fileBoxIff1)  { arenaSlotCount += mailbox_slot_count(&outputOpts.fileBox);   }
+		if(1==streamIff1)   { arenaSlotCount += stream_slot_count(&outputOpts.stream);     }
+		if(1==mcastBoxIff1) { arenaSlotCount += mailbox_slot_count(&outputOpts.mcastBox);  }
+		arenaSlotCount = max(arenaSlotCount, VCARENA_SLOTS);
+	}
+
+
+	// Real-time mode: the capture thread and the workers get SCHED_FIFO,
+	// memory gets locked before the capture buffers are mapped.
+	if(runOpts.rtPriority>0)
+	{
+		rc =  realtime_enable(runOpts.rtPriority, pool.cpu[0]);
+		if(rc<0){ee=-13+100*rc; goto quit;}
+
+		rc =  worker_pool_set_realtime(&pool, runOpts.rtPriority);
+		if(rc<0){ee=-13+100*rc; goto quit;}
+	}
+
+
+	// Open all cameras, each one has its own capture queue and format.
+	for(i= 0; i< camCount; i++)
+	{
+		cam[i].idx        = i;
+		cam[i].out.camIdx = i;
+		cam[i].statsIff1  = (VCTONE_CLAHE==captureOpts.tone.kind)?(1):(captureOpts.statsIff1);
+		tone_map_init(&cam[i].tone, &captureOpts.tone);
+
+		// Gets capture dimensions for imgnet_connect().
+		rc =  sensor_open(cam[i].acVideoDev, &cam[i].sen, captureOpts.bufCount, arenaSlotCount, (runOpts.rtPriority>0)?(1):(0), captureOpts.colourType, captureOpts.ingestMode);
+		if(rc<0){ee=-2+100*rc; goto quit;}
+		printf("Camera %d reads captures %s (direct %.1f MB/s, copy %.1f MB/s).\n", i,
+				(VCINGEST_COPY==cam[i].sen.ingest.mode)?("from a cached copy"):("in place"),
+				cam[i].sen.ingest.probeDirectMBs, cam[i].sen.ingest.probeCopyMBs);
+		printf("Camera %d converts with the %s pipeline.\n", i, cam[i].sen.pipe->pcName);
+
+		if(1==outputOpts.sched.enabledIff1)
+		{
+			output_sched_init(&cam[i].sched, &outputOpts.sched);
+		}
+
+		if(1==outputOpts.gate.enabledIff1)
+		{
+			rc =  change_gate_init(&cam[i].gate, &outputOpts.gate, cam[i].sen.pix.width, cam[i].sen.pix.height);
+			if(rc<0){ee=-21+100*rc; goto quit;}
+		}
+
+		if(outputOpts.jpeg.quality>0)
+		{
+			rc =  jpeg_init(&cam[i].jpeg, &outputOpts.jpeg, &cam[i].sen.arena);
+			if(rc<0){ee=-24+100*rc; goto quit;}
+			cam[i].out.jpeg = &cam[i].jpeg;
+		}
+
+		if('\0'!=captureOpts.acRegList[0])
+		{
+			rc =  sensor_reg_apply_list(&cam[i].sen.regs, captureOpts.acRegList, i);
+			if(rc<0){ee=-17+100*rc; goto quit;}
+		}
+
+		// Capturing works without calibration, so a missing one is no error.
+		if('\0'!=captureOpts.acCalibDir[0])
+		{
+			rc =  calib_load(&cam[i].calib, cam[i].sen.fd, cam[i].acVideoDev, captureOpts.acCalibDir);
+			if(rc<0){ printf("Camera %d has no calibration (%d).\n", i, rc); }
+			else
+			{
+				printf("Camera %d calibration of module %s: %u bytes from %s in %.1fms (%u flash transfers).\n", i,
+						cam[i].calib.acSerial, cam[i].calib.byteCount, (1==cam[i].calib.fromCacheIff1)?(cam[i].calib.acCachePath):("flash"),
+						(F32)cam[i].calib.loadNS / 1000000, cam[i].calib.transferCount);
+			}
+		}
+
+		// stdout, framebuffer and vcimgnetsrv show the first camera only,
+		// files of further cameras are prefixed by the camera number.
+		cam[i].out.stdOutIff1       = (0==i)?(outputOpts.stdOutIff1):(0);
+		cam[i].out.fbOutIff1        = (0==i)?(outputOpts.fbOutIff1):(0);
+		cam[i].out.pcFramebufferDev = outputOpts.acFramebufferDev;
+		cam[i].out.fileOutIff1      = outputOpts.fileOutIff1;
+		cam[i].out.stdOutBox        = (1==stdOutBoxIff1)?(&outputOpts.stdOutBox):(NULL);
+		cam[i].out.preview          = ((0==i)&&(1==outputOpts.stdOutIff1))?(&outputOpts.preview):(NULL);
+		cam[i].out.fileBox          = (1==fileBoxIff1)?(&outputOpts.fileBox):(NULL);
+		cam[i].out.stream           = (1==streamIff1)?(&outputOpts.stream):(NULL);
+		cam[i].out.mcast            = (1==mcastBoxIff1)?(&outputOpts.mcast):(NULL);
+		cam[i].out.mcastBox         = (1==mcastBoxIff1)?(&outputOpts.mcastBox):(NULL);
+		if(1==camCount){ snprintf(cam[i].out.acFilePrefix, sizeof(cam[i].out.acFilePrefix), "img");          }
+		else           { snprintf(cam[i].out.acFilePrefix, sizeof(cam[i].out.acFilePrefix), "cam%d_img", i); }
+	}
+
+	// Two cameras are the left and right eye, a single camera twice
+	// as wide as the calibration captures both side by side.
+	if('\0'!=captureOpts.acStereoCalib[0])
+	{
+		rc =  stereo_calib_get(&stereoCalib, captureOpts.acStereoCalib, &cam[0].calib);
+		if(rc<0){ee=-18+100*rc; goto quit;}
+
+		for(i= 0; i< min(camCount, 2); i++)
+		{
+			rc =  rectify_init(&cam[i].rect, &stereoCalib, i, ((1==camCount)&&((I32)cam[0].sen.pix.width >= 2 * stereoCalib.dx))?(2):(1), &cam[i].sen.arena);
+			if(rc<0){ee=-19+100*rc; goto quit;}
+			rectCamCount++;
+
+			printf("Camera %d rectifies %s to %dx%d.\n", i, (2==cam[i].rect.eyeCount)?("both eyes side by side"):((0==i)?("the left eye"):("the right eye")), stereoCalib.dx, stereoCalib.dy);
+		}
+	}
+
+	// Block matching needs both eyes rectified.
+	if(captureOpts.stereo.dispCount>0)
+	{
+		if((rectCamCount<2)&&(2!=cam[0].rect.eyeCount)){ printf("Error, disparity needs both eyes rectified (-X).\n"); ee=-20; goto quit; }
+
+		rc =  stereo_init(&stereo, &captureOpts.stereo, stereoCalib.dx, stereoCalib.dy, pool.workerCount);
+		if(rc<0){ee=-20+100*rc; goto quit;}
+		stereoIff1 = 1;
+
+		for(i= 0; i< rectCamCount; i++)
+		{
+			rc =  stereo_attach(&stereo, &cam[i].rect, &cam[i].sen.arena);
+			if(rc<0){ee=-20+100*rc; goto quit;}
+		}
+	}
+
+	// If vcimgnetsrv is started in background, this connects to it to transfer the captures.
+	rc =  imgnet_connect(&imgnetCfg, cam[0].sen.pix.pixelformat, cam[0].sen.pix.width, cam[0].sen.pix.height);
+	if(rc!=0){ netSrvIff1=0; }
+	else     { netSrvIff1=1; }
+	cam[0].out.netSrvOutIff1 = netSrvIff1;
+	cam[0].out.imgnetCfg     = &imgnetCfg;
+
+
+	for(i= 0; i< camCount; i++)
+	{
+		// Apply new Shutter and Gain Settings
+		{
+			rc =  sensor_set_parameters(&cam[i].sen, captureOpts.gain, captureOpts.shutter);
+			if(rc<0){ee=-3+100*rc; goto quit;}
+
+			if(1==captureOpts.ae.enabledIff1)
+			{
+				auto_exposure_init(&cam[i].ae, &captureOpts.ae, &cam[i].sen, captureOpts.gain, captureOpts.shutter);
+			}
+		}
+
+
+		// Pre-Enqueue all capture buffers into the capture queue
+		{
+			for(bufIdx= 0; bufIdx< cam[i].sen.qbufCount; bufIdx++)
+			{
+				rc =  capture_buffer_enqueue(bufIdx, &cam[i].sen);
+				if(rc<0){ee=-4+100*rc; goto quit;}
+			}
+		}
+
+		rc =  event_loop_add_sensor(&loop, &cam[i].sen, i);
+		if(rc<0){ee=-15+100*rc; goto quit;}
+	}
+
+	// The IMU is read from the first camera's device, so it needs to be open.
+	// In real-time mode it is read at the capture priority, but not at the capture CPU.
+	if(captureOpts.imuPeriodUS>=0)
+	{
+		rc =  imu_start(&imu, cam[0].sen.fd, captureOpts.imuPeriodUS, runOpts.rtPriority, (runOpts.rtPriority>0)?(pool.cpu[0]):(-1));
+		if(rc<0){ee=-16+100*rc; goto quit;}
+		imuIff1    = 1;
+		cam[0].imu = &imu;
+	}
+
+	for(i= 0; i< camCount; i++)
+	{
+		rc =  sensor_streaming_start(&cam[i].sen);
+		if(rc<0){ee=-5+100*rc; goto quit;}
+		cam[i].streamingIff1 = 1;
+	}
+
+	camera_schedule_order(cam, camCount, camOrder);
+
+	if(1==runOpts.consoleIff1)
+	{
+		rc =  console_start(&console, &loop, (runOpts.rtPriority>0)?(pool.cpu[0]):(-1));
+		if(rc<0){ee=-25+100*rc; goto quit;}
+		consoleIff1 = 1;
+	}
+
+	#ifdef DURATION_TEST
+		timemeasurement_start(&timer);
+	#endif
+	while(0==quitIff1)
+	{
+		rc =  event_loop_wait(&loop, &events);
+		if(rc<0){ee=-6+100*rc; goto quit;}
+
+		if(0!=(events & VCEV_CONTROL))
+		{
+			while(0==event_loop_get_control(&loop, &cmd))
+			{
+				switch(cmd.type)
+				{
+					case VCCTRL_SET_PARAMETERS:
+						for(i= 0; i< camCount; i++)
+						{
+							if((cmd.camIdx>=0)&&(cmd.camIdx!=i)){ continue; }
+
+							rc =  sensor_set_parameters(&cam[i].sen, cmd.gain, cmd.shutter);
+							if(rc<0){ee=-3+100*rc; goto quit;}
+
+							// The auto exposure continues from the new values.
+							cam[i].ae.shutter = cmd.shutter;
+							cam[i].ae.gain    = cmd.gain;
+						}
+						break;
+					case VCCTRL_QUIT:
+						quitIff1 = 1;
+						break;
+				}
+			}
+		}
+
+		if(0!=(events & VCEV_TIMER))
+		{
+			event_loop_print_stats(&loop);
+			worker_pool_print_stats(&pool);
+			for(i= 0; i< camCount; i++)
+			{
+				camera_print_stats(&cam[i]);
+			}
+		}
+
+		if(0!=(events & VCEV_QUIT))
+		{
+			quitIff1 = 1;
+		}
+
+		// Edge triggered: all buffers filled since the last wakeup get processed.
+		for(i= 0; i< camCount; i++)
+		{
+			if(0!=(events & VCEV_SENSOR(i))){ cam[i].readyIff1 = 1; }
+		}
+
+		rc =  camera_process_ready(cam, camCount, camOrder, &pool, &loop);
+		if(rc<0){ee=-7+100*rc; goto quit;}
+
+		#ifdef DURATION_TEST
+			// Print Out Duration.
+			if(loop.frameCount >= run + timerCycles)
+			{
+				timemeasurement_stop(&timer, &seconds, &useconds);
+				printf("Acquisiton&Copy Duration:%11llds%11lldus  for %llu Cycles ==  %ffps.\n\n", seconds, useconds, (unsigned long long)(loop.frameCount - run), (F32)1000000 * (loop.frameCount - run)/(seconds * 1000000 + useconds));
+				statusLines = 2 + worker_pool_print_stats(&pool);
+				for(i= 0; i< camCount; i++)
+				{
+					statusLines += camera_print_stats(&cam[i]);
+				}
+				if(1!=netSrvIff1){ printf("\033[%dA", statusLines); }
+				run = loop.frameCount;
+				timemeasurement_start(&timer);
+			}
+		#endif
+	}
+
+	for(i= 0; i< camCount; i++)
+	{
+		rc =  sensor_streaming_stop(&cam[i].sen);
+		if(rc<0){ee=-10+100*rc; goto quit;}
+		cam[i].streamingIff1 = 0;
+	}
+
+
+	ee=0;
+quit:
+	if(ee!=0){ printf("\n  '%s' quits with error code: %d\n\n", argv[0], ee); }
+
+	if(1==consoleIff1)
+	{
+		console_stop(&console);
+	}
+
+	if(1==imuIff1)
+	{
+		imu_stop(&imu);
+	}
+
+	// The consumers finish before the arenas they read are freed.
+	if(1==stdOutBoxIff1)
+	{
+		mailbox_stop(&outputOpts.stdOutBox);
+	}
+	preview_destroy(&outputOpts.preview);
+
+	if(1==fileBoxIff1)
+	{
+		mailbox_stop(&outputOpts.fileBox);
+	}
+
+	if(1==streamIff1)
+	{
+		stream_stop(&outputOpts.stream);
+	}
+
+	if(1==mcastBoxIff1)
+	{
+		mailbox_stop(&outputOpts.mcastBox);
+	}
+
+	if(1==mcastIff1)
+	{
+		multicast_print_stats(&outputOpts.mcast);
+		multicast_close(&outputOpts.mcast);
+	}
+
+	for(i= 0; i< camCount; i++)
+	{
+		if(1==cam[i].streamingIff1){ sensor_streaming_stop(&cam[i].sen); }
+		if(cam[i].sen.fd>=0)
+		{
+			snprintf(acRegName, sizeof(acRegName), "%d: Registers", i);
+			sensor_regs_print_stats(acRegName, &cam[i].sen.regs);
+		}
+		calib_unload(&cam[i].calib);
+		rectify_destroy(&cam[i].rect);
+		change_gate_destroy(&cam[i].gate);
+		jpeg_destroy(&cam[i].jpeg);
+		sensor_close(&cam[i].sen);
+	}
+
+	if(1==stereoIff1)
+	{
+		stereo_destroy(&stereo);
+	}
+
+	if(1==netSrvIff1)
+	{
+		imgnet_disconnect(&imgnetCfg);
+	}
+
+	if(1==poolIff1)
+	{
+		worker_pool_print_stats(&pool);
+		worker_pool_destroy(&pool);
+	}
+
+	if(1==loopIff1)
+	{
+		event_loop_print_stats(&loop);
+		event_loop_destroy(&loop);
+	}
+
+	for(i= 0; i< camCount; i++)
+	{
+		camera_print_stats(&cam[i]);
+	}
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band Function: Writes a Band of Framebuffer Rows.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  process_capture_framebuffer_band(void *arg, I32 y0, I32 y1, I32 workerIdx)
+{
+	VCFrameJob *job = (VCFrameJob*)arg;
+	image      *img = job->imgConverted;
+	U8         *r, *g, *b;
+
+	// The block sums are complete, every band decides alike.
+	if((NULL!=job->gate)&&(0==change_gate_due(job->gate, VCGATE_OUT_FB))){ return; }
+
+	image_channels(img, &r, &g, &b);
+	copy_image_to_framebuffer_band(job->fb, r, g, b, img->dy, img->pitch, image_pixel_stride(img), y0, y1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band Function: Copies a Band to vcimgnetsrv if the Change Gate lets it.
+*
+*  Used instead of the copy by the conversion if vcimgnetsrv is gated,
+*  as the decision needs the block sums of all bands, or if it has to
+*  wait for the framebuffer of higher priority.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  process_capture_imgnet_band(void *arg, I32 y0, I32 y1, I32 workerIdx)
+{
+	VCFrameJob *job = (VCFrameJob*)arg;
+	I32         rc;
+
+	if((NULL!=job->gate)&&(0==change_gate_due(job->gate, VCGATE_OUT_NET))){ return; }
+
+	rc =  copy_image_band(job->imgConverted, job->imgNet, y0, y1);
+	if(rc<0)
+	{
+		__sync_bool_compare_and_swap(&job->rc, 0, rc);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band Function: Rectifies Tile Rows of the converted Capture.
+*
+*  The rows of all eyes are stacked, each eye padded to whole tile rows.
+*  Colour captures are rectified from their green channel.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  process_capture_rectify_band(void *arg, I32 y0, I32 y1, I32 workerIdx)
+{
+	VCFrameJob *job  = (VCFrameJob*)arg;
+	VCRectify  *rect = job->rect;
+	I32         eyeRows = (rect->dy + VCRECT_TILE_H - 1) / VCRECT_TILE_H * VCRECT_TILE_H;
+	U64         t0   = timestamp_ns();
+	U8         *r, *g, *b;
+	I32         y, t;
+
+	image_channels(job->imgConverted, &r, &g, &b);
+
+	for(y= y0; y< y1; y+= VCRECT_TILE_H)
+	{
+		t = y / eyeRows;
+		rectify_band(rect, t, g, &job->imgRect[t], y - t * eyeRows, y - t * eyeRows + VCRECT_TILE_H);
+	}
+	__atomic_add_fetch(&job->rectNS, timestamp_ns() - t0, __ATOMIC_RELAXED);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band Function: Census Transform of a Band of both rectified Eyes.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  process_capture_census_band(void *arg, I32 y0, I32 y1, I32 workerIdx)
+{
+	VCFrameJob *job = (VCFrameJob*)arg;
+	U64         t0  = timestamp_ns();
+
+	stereo_census_band(job->stereo, job->imgEye, y0, y1);
+	__atomic_add_fetch(&job->dispNS, timestamp_ns() - t0, __ATOMIC_RELAXED);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band Function: Disparity of a Band of Rows.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  process_capture_disparity_band(void *arg, I32 y0, I32 y1, I32 workerIdx)
+{
+	VCFrameJob *job = (VCFrameJob*)arg;
+	U64         t0  = timestamp_ns();
+
+	stereo_disparity_band(job->stereo, job->imgEye, job->disp, y0, y1, workerIdx);
+	__atomic_add_fetch(&job->dispNS, timestamp_ns() - t0, __ATOMIC_RELAXED);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band Function: Encodes the JPEG Slices of a Band of the converted Image.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  process_capture_jpeg_band(void *arg, I32 y0, I32 y1, I32 workerIdx)
+{
+	VCFrameJob  *job = (VCFrameJob*)arg;
+	U64          t0;
+
+	if((NULL!=job->jpegGate)&&(0==change_gate_due(job->jpegGate, VCGATE_OUT_FILE))){ return; }
+
+	t0 = timestamp_ns();
+	jpeg_encode_band(job->jpeg, job->imgConverted, job->jpegOut, y0, y1);
+	__atomic_add_fetch(&job->jpegNS, timestamp_ns() - t0, __ATOMIC_RELAXED);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Processes a Capture: Copy it to several Outputs.
+*
+*  This function processes a capture image by copying it to selected outputs.
+*
+*  Conversion, vcimgnetsrv copy, framebuffer output and JPEG encoding form
+*  one job of the worker pool, so the worker threads are woken up only once
+*  per capture.
+*  The capture is converted into a preallocated slot of the frame arena.
+*  If the outputs name mailboxes, stdout and file output are handed over
+*  to their consumer threads instead of being done here, likewise the
+*  frame is handed to the stream server and the multicast mailbox.
+*
+* @param  proc   State of the camera used for the capture, its members are:
+*  - arena  Slots to convert the capture into.
+*  - pipe   Conversion of the capture, chosen by sensor_open().
+*  - ae     If not NULL, receives the auto exposure measurement of the capture.
+*  - stats  If not NULL, frame statistics are accumulated by the conversion,
+*           attached to the slot handed to the output thread and copied to it.
+*  - lut    If not NULL, RAW10 formats are mapped through this 1024 entry
+*           LUT instead of keeping the upper 8 bits.
+*  - ingest If not NULL and in VCINGEST_COPY mode, each band of the capture
+*           is copied to its staging buffer and converted from there.
+*  - rect   If not NULL, the eyes are rectified into the slot after the
+*           conversion, and written to files along with the capture.
+*           If its stereo is set and this capture completes a pair of
+*           eyes, their disparity follows in the same job.
+*  - gate   If not NULL, file, framebuffer and vcimgnetsrv output are
+*           skipped while the capture has not changed enough.
+*  - sched  If not NULL, only the outputs of its dueMask are done, in
+*           order of priority, and a capture is not converted at all
+*           if neither an output nor a measurement needs it.
+*/
+/*-----------------------------------------------------------------------------*/
+int  process_capture(VCWorkerPool *pool, const VCProcessCfg *proc, const VCOutputCfg *out, void *st, int dx, int dy, int pitch, int frameNr)
+{
+	VCFrameArena     *arena  = proc->arena;
+	const VCPipeline *pipe   = proc->pipe;
+	VCAeMeasure      *ae     = proc->ae;
+	VCFrameStats     *stats  = proc->stats;
+	const U8         *lut    = proc->lut;
+	VCIngest         *ingest = proc->ingest;
+	VCRectify        *rect   = proc->rect;
+	VCChangeGate     *gate   = proc->gate;
+	VCOutputSched    *sched  = proc->sched;
+	int            rc, ee;
+	VCFrameSlot   *slot         = NULL;
+	image         *imgConverted = NULL;
+	VCFramebuffer  fb           = NULL_VCFramebuffer;
+	VCFrameJob     job;
+	VCPoolStage    stage[VCPOOL_MAX_STAGES] = {NULL_VCPoolStage, NULL_VCPoolStage, NULL_VCPoolStage, NULL_VCPoolStage, NULL_VCPoolStage, NULL_VCPoolStage, NULL_VCPoolStage};
+	I32            stageCount   = 0;
+	I32            i, k, s;
+	U32            sinks;
+	U64            t0;
+	VCAeMeasure    aeWorker[VCPOOL_MAX_WORKERS];
+
+	if(NULL==pipe){ee=-7; goto fail;}
+
+	// Outputs done for this capture.
+	sinks = ((1==out->fileOutIff1  )?(1u<<VCSINK_FILE  ):(0))|
+	        ((1==out->fbOutIff1    )?(1u<<VCSINK_FB    ):(0))|
+	        ((1==out->netSrvOutIff1)?(1u<<VCSINK_NET   ):(0))|
+	        ((1==out->stdOutIff1   )?(1u<<VCSINK_STDOUT):(0))|
+	        ((NULL!=out->stream    )?(1u<<VCSINK_STREAM):(0))|
+	        ((NULL!=out->mcast     )?(1u<<VCSINK_MCAST ):(0));
+	if(NULL!=sched)
+	{
+		sinks &= sched->dueMask;
+		if((0==sinks)&&(NULL==ae)&&(NULL==stats)&&(NULL==rect))
+		{
+			sched->convertSkipCount++;
+			ee=0; goto fail;
+		}
+	}
+
+	// Take a free preallocated image, if the outputs still hold all of them
+	// the capture is dropped and its buffer requeued by the caller.
+	{
+		slot =  frame_arena_acquire(arena);
+		if(NULL==slot)
+		{
+			arena->exhaustCount++;
+			if(NULL!=ae){ memset(ae, 0, sizeof(VCAeMeasure)); }
+			ee=0; goto fail;
+		}
+
+		imgConverted    = &slot->img;
+		slot->frameNr   = frameNr;
+		slot->captureNS = out->captureNS;
+		if((imgConverted->dx != dx)||(imgConverted->dy != dy)){ee=-2; goto fail;}
+	}
+
+	if(0!=(sinks & (1u<<VCSINK_FB)))
+	{
+		rc =  framebuffer_open(out->pcFramebufferDev, &fb);
+		if(rc<0){ee=-9+100*rc; goto fail;}
+	}
+
+
+	// Set up the job: conversion stage, followed by framebuffer stage,
+	// which needs the converted rows of other bands when scaling.
+	// Outputs of the pool run before the rectification and disparity,
+	// so these do not delay them.
+	{
+		job.st           = st;
+		job.dx           = dx;
+		job.dy           = dy;
+		job.pitch        = pitch;
+		job.imgConverted = imgConverted;
+		job.imgRaw8      = (NULL!=slot->imgRaw8.st)?(&slot->imgRaw8):(NULL);
+		job.imgNet       = (0!=(sinks & (1u<<VCSINK_NET)))?(&(out->imgnetCfg->img)):(NULL);
+		job.fb           = (0!=(sinks & (1u<<VCSINK_FB )))?(&fb):(NULL);
+		job.ae           = (NULL!=ae)?(aeWorker):(NULL);
+		job.stats        = (NULL!=stats)?(arena->statsWorker):(NULL);
+		job.lut          = lut;
+		job.ingest       = ((NULL!=ingest)&&(VCINGEST_COPY==ingest->mode))?(ingest):(NULL);
+		job.rect         = rect;
+		job.imgRect      = slot->imgRect;
+		job.rectNS       = 0;
+		job.stereo       = NULL;
+		job.disp         = slot->disp;
+		job.dispNS       = 0;
+		job.gate         = gate;
+		job.netStageIff1 = 0;
+		job.jpeg         = NULL;
+		job.jpegOut      = slot->jpeg;
+		job.jpegGate     = NULL;
+		job.jpegNS       = 0;
+		if((NULL!=out->jpeg)&&(NULL!=slot->jpeg)&&(0!=(sinks & ((1u<<VCSINK_FILE)|(1u<<VCSINK_STREAM)|(1u<<VCSINK_MCAST)))))
+		{
+			job.jpeg = out->jpeg;
+			if((NULL!=gate)&&(0==(sinks & ((1u<<VCSINK_STREAM)|(1u<<VCSINK_MCAST))))){ job.jpegGate = gate; }
+		}
+		if(NULL!=job.imgNet)
+		{
+			if((NULL!=gate)&&(gate->threshold[VCGATE_OUT_NET]>0)){ job.netStageIff1 = 1; }
+			if((NULL!=sched)&&(NULL!=job.fb)&&(sched->sink[VCSINK_FB].priority > sched->sink[VCSINK_NET].priority)){ job.netStageIff1 = 1; }
+		}
+		job.rc           = 0;
+
+		if(NULL!=job.ae)
+		{
+			memset(aeWorker, 0, sizeof(VCAeMeasure) * pool->workerCount);
+		}
+		if(NULL!=job.stats)
+		{
+			for(i= 0; i< pool->workerCount; i++)
+			{
+				frame_stats_reset(&job.stats[i], pipe->statsStep, pipe->statsMax);
+			}
+		}
+		if(NULL!=gate)
+		{
+			memset(gate->blockSum, 0, gate->bx * gate->by * sizeof(U32));
+		}
+		slot->statsValidIff1 = 0;
+		slot->rectCount      = 0;
+		slot->dispValidIff1  = 0;
+
+		if((NULL!=rect)&&(NULL!=rect->stereo)&&(1==stereo_pair(rect->stereo, rect, slot, job.imgEye)))
+		{
+			job.stereo = rect->stereo;
+		}
+
+		if((NULL!=job.imgNet)&&(job.imgNet->type != imgConverted->type)&&(1==image_pixel_stride(imgConverted))){ee=-8; goto fail;}
+		if((1==pipe->raw8Iff1)&&(NULL==job.imgRaw8)){ee=-6; goto fail;}
+
+		stage[stageCount].fn    = pipe->convert;
+		stage[stageCount].arg   = &job;
+		stage[stageCount].rows  = dy;
+		stage[stageCount].align = pipe->align;
+		stageCount++;
+
+		for(i= 0; i< VCSINK_COUNT; i++)
+		{
+			s = (NULL!=sched)?(sched->order[i]):(i);
+
+			if((VCSINK_NET==s)&&(1==job.netStageIff1))
+			{
+				stage[stageCount].fn    = process_capture_imgnet_band;
+				stage[stageCount].arg   = &job;
+				stage[stageCount].rows  = dy;
+				stage[stageCount].align = 1;
+				stageCount++;
+			}
+			if((VCSINK_FB==s)&&(NULL!=job.fb))
+			{
+				stage[stageCount].fn    = process_capture_framebuffer_band;
+				stage[stageCount].arg   = &job;
+				stage[stageCount].rows  = framebuffer_rows(&fb, dy);
+				stage[stageCount].align = 1;
+				stageCount++;
+			}
+		}
+
+		// Remapping reads rows of other bands, so it is a stage of its own.
+		if(NULL!=job.rect)
+		{
+			stage[stageCount].fn    = process_capture_rectify_band;
+			stage[stageCount].arg   = &job;
+			stage[stageCount].rows  = rect->eyeCount * ((rect->dy + VCRECT_TILE_H - 1) / VCRECT_TILE_H * VCRECT_TILE_H);
+			stage[stageCount].align = VCRECT_TILE_H;
+			stageCount++;
+		}
+
+		if(NULL!=job.stereo)
+		{
+			if(1==job.stereo->censusIff1)
+			{
+				stage[stageCount].fn    = process_capture_census_band;
+				stage[stageCount].arg   = &job;
+				stage[stageCount].rows  = job.stereo->dy;
+				stage[stageCount].align = 1;
+				stageCount++;
+			}
+
+			stage[stageCount].fn    = process_capture_disparity_band;
+			stage[stageCount].arg   = &job;
+			stage[stageCount].rows  = job.stereo->dy;
+			stage[stageCount].align = 1;
+			stageCount++;
+		}
+
+		// Encoded in the same job, unless the gate skips the only output taking it,
+		// which the bands decide alike as change_gate_update() after the job.
+		if(NULL!=job.jpeg)
+		{
+			stage[stageCount].fn    = process_capture_jpeg_band;
+			stage[stageCount].arg   = &job;
+			stage[stageCount].rows  = job.jpeg->sliceCount * job.jpeg->restartRows * job.jpeg->mcuSize;
+			stage[stageCount].align = job.jpeg->restartRows * job.jpeg->mcuSize;
+			stageCount++;
+		}
+	}
+
+	rc =  worker_pool_run(pool, stage, stageCount);
+	if(rc<0){ee=-11+100*rc; goto fail;}
+	if(job.rc<0){ee=-5+100*job.rc; goto fail;}
+
+	if(NULL!=ingest){ ingest->frameCount++; }
+
+	// The same decisions the gated stages took, then the references follow.
+	if(NULL!=gate)
+	{
+		sinks = (sinks & ((1u<<VCSINK_STDOUT)|(1u<<VCSINK_STREAM)|(1u<<VCSINK_MCAST))) | change_gate_update(gate, sinks & ((1u<<VCGATE_OUT_COUNT)-1));
+	}
+	slot->fileOutIff1   = (0!=(sinks & (1u<<VCSINK_FILE  )))?(1):(0);
+	slot->stdOutIff1    = (0!=(sinks & (1u<<VCSINK_STDOUT)))?(1):(0);
+	slot->streamOutIff1 = (0!=(sinks & (1u<<VCSINK_STREAM)))?(1):(0);
+	slot->mcastOutIff1  = (0!=(sinks & (1u<<VCSINK_MCAST )))?(1):(0);
+
+	// The slices are complete if an output takes the frame.
+	slot->jpegValidIff1 = 0;
+	if((NULL!=job.jpeg)&&((1==slot->fileOutIff1)||(1==slot->streamOutIff1)||(1==slot->mcastOutIff1)))
+	{
+		t0 = timestamp_ns();
+		slot->jpegBytes     = jpeg_finish(job.jpeg, job.jpegOut);
+		slot->jpegValidIff1 = 1;
+		latency_stats_add(&job.jpeg->latEncode, job.jpegNS + timestamp_ns() - t0);
+	}
+
+	if(NULL!=rect)
+	{
+		latency_stats_add(&rect->latRectify, job.rectNS);
+		for(i= 0; i< rect->eyeCount; i++)
+		{
+			slot->rectEye[i] = rect->eye[i];
+		}
+		slot->rectCount = rect->eyeCount;
+	}
+
+	if(NULL!=job.stereo)
+	{
+		latency_stats_add(&job.stereo->latDisparity, job.dispNS);
+		job.stereo->pairCount++;
+		slot->dispValidIff1 = 1;
+	}
+	else if((NULL!=rect)&&(NULL!=rect->stereo))
+	{
+		stereo_keep(rect->stereo, rect, slot);
+	}
+
+	// Reduce the measurements of the workers.
+	if(NULL!=ae)
+	{
+		*ae = aeWorker[0];
+		for(i= 1; i< pool->workerCount; i++)
+		{
+			ae->sum   += aeWorker[i].sum;
+			ae->count += aeWorker[i].count;
+			for(k= 0; k< VCAE_HIST_BINS; k++)
+			{
+				ae->hist[k] += aeWorker[i].hist[k];
+			}
+		}
+	}
+
+	if(NULL!=stats)
+	{
+		frame_stats_reset(&slot->stats, job.stats[0].step, job.stats[0].maximum);
+		for(i= 0; i< pool->workerCount; i++)
+		{
+			frame_stats_reduce(&slot->stats, &job.stats[i], (i==pool->workerCount-1)?(1):(0));
+		}
+		slot->statsValidIff1 = 1;
+		*stats = slot->stats;
+	}
+
+
+	for(i= 0; i< VCSINK_COUNT; i++)
+	{
+		s = (NULL!=sched)?(sched->order[i]):(VCSINK_COUNT-1 - i);
+
+		if((VCSINK_STDOUT==s)&&(1==slot->stdOutIff1))
+		{
+			if(NULL!=out->stdOutBox){ mailbox_post(out->stdOutBox, out, slot); }
+			else                    { output_print_ascii(out, slot);            }
+		}
+
+		if((VCSINK_STREAM==s)&&(1==slot->streamOutIff1))
+		{
+			stream_post(out->stream, out, slot);
+		}
+
+		if((VCSINK_MCAST==s)&&(1==slot->mcastOutIff1))
+		{
+			mailbox_post(out->mcastBox, out, slot);
+		}
+
+		if((VCSINK_FILE==s)&&(1==slot->fileOutIff1))
+		{
+			if(NULL!=out->fileBox){ mailbox_post(out->fileBox, out, slot); }
+			else
+			{
+				rc =  output_write_files(out, slot);
+				if(rc<0){ee=-10+100*rc; goto fail;}
+			}
+		}
+	}
+
+
+	ee=0;
+fail:
+	framebuffer_close(&fb);
+	if(NULL!=slot){ frame_slot_release(slot); slot = NULL; }
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Parses Command Line Parameters.
+*
+*  This function parses command line parameters.
+*
+* @param  run      Process wide options, preset by NULL_VCRunOptions.
+* @param  capture  Options of all cameras, preset by NULL_VCCaptureOptions.
+* @param  output   Options of the outputs, preset by NULL_VCOutputOptions.
+* @param  cam      Receives the devices given by -d, counted in camCount.
+*/
+/*-----------------------------------------------------------------------------*/
+int  change_options_by_commandline(int argc, char *argv[], VCRunOptions *run, VCCaptureOptions *capture, VCOutputOptions *output, VCCamera *cam, int *camCount)
+{
+	int  opt, i;
+
+	char *pcPriority, *pcParam;
+
+	VCMailbox *box;
+
+	while((opt =  getopt(argc, argv, "g:s:fab:ot:c:n:R:i:d:e:E:L:ST:B:C:I:u:W:K:X:D:G:O:M:P:U:J:A:k:r")) != -1)
+	{
+		switch(opt)
+		{
+			default:
+				printf("_______________________________________________________________________________\n");
+				printf("                                                                               \n");
+				printf("  %s v.%d.%d.%d.\n", DEMO_NAME, DEMO_MAINVERSION, DEMO_VERSION, DEMO_SUBVERSION);
+				printf("  -----------------------------------------------------------------------------\n");
+				printf("                                                                               \n");
+				printf("  Usage: %s [-s sh] [-g gain] [-f] [-a] [-t threads] [-c cpus] [-n rows] [-R prio] [-i ms] [-d dev[:prio]].. [-e mean] [-E n] [-L n] [-S] [-T map[:p]] [-B black] [-C layout] [-I ingest] [-u us] [-W regs] [-K dir] [-X calib] [-D range] [-G file[:fb[:net[:keep]]]] [-O out:rate[:prio]].. [-M out:policy[:n]].. [-P port[:depth[:clients]][:copy]] [-U group:port[:iface[:mtu]]] [-J quality[:rows]] [-A view[:cols[:ms]]] [-k scalar] [-r]\n", argv[0]);
+				printf("                                                                               \n");
+				printf("  -s,  Shutter Time.                                                           \n");
+				printf("  -g,  Gain Value.                                                             \n");
+				printf("  -b,  Buffer Count to use.                                                    \n");
+				printf("  -f,  Output Capture to framebuffer %s.                                       \n", output->acFramebufferDev);
+				printf("  -o,  Output Captures to file in PGM or PPM format (openable by e.g. GIMP)    \n");
+				printf("  -a,  Suppress ASCII capture at stdout.                                       \n");
+				printf("  -t,  Worker Thread Count incl. main thread (default: online CPUs).           \n");
+				printf("  -c,  Pin Worker Threads to CPUs, comma separated list, e.g. 0,1,2,3.         \n");
+				printf("  -n,  Rows per Band given to a Worker Thread (default: automatic).            \n");
+				printf("  -R,  Real-time mode with SCHED_FIFO priority (1..99), capture thread runs    \n");
+				printf("       at the first CPU of -c, stdout and file output at normal priority.      \n");
+				printf("  -i,  Print statistics every given milliseconds (default: only at exit).      \n");
+				printf("  -d,  Capture Device, repeat for several cameras (default: /dev/video0).      \n");
+				printf("       Optional priority: captures per round, e.g. -d /dev/video1:2.           \n");
+				printf("       stdout, framebuffer and vcimgnetsrv show the first camera.              \n");
+				printf("  -e,  Auto exposure to the given mean brightness (0..255), -s and -g are the   \n");
+				printf("       start values.                                                           \n");
+				printf("  -E,  Auto exposure changes shutter and gain every n frames at most.          \n");
+				printf("  -L,  Frames until the sensor applies new shutter and gain (default: 2).     \n");
+				printf("  -S,  Accumulate histogram, mean, min/max, saturation and sharpness while     \n");
+				printf("       converting the captures.                                                \n");
+				printf("  -T,  Tone mapping of RAW10 instead of the upper 8 bits: gamma[:exponent],     \n");
+				printf("       log[:strength] or clahe[:clip] (equalization, implies -S).              \n");
+				printf("  -B,  Black level (10 bit) subtracted by the tone mapping.                    \n");
+				printf("  -C,  Colour layout the debayering writes: planar (default), rgb, bgr, rgba   \n");
+				printf("       or bgra (same as a 32 bit framebuffer, copied row by row).              \n");
+				printf("  -I,  Capture buffer ingest: direct (convert in place), copy (bulk-copy to    \n");
+				printf("       cached memory first) or auto (default: the faster one at startup).      \n");
+				printf("  -u,  Read the IMU of the first camera in a thread, at most every given       \n");
+				printf("       microseconds (0: as fast as it answers), and attach it to the frames.   \n");
+				printf("  -W,  Sensor registers to write and read at start, e.g. 0x11a=0x20,0x11b:     \n");
+				printf("       writes are sent as one batch, then reads are printed.                  \n");
+				printf("  -K,  Load the calibration from the module flash, cached in the directory     \n");
+				printf("       per module serial, the flash is read again only if it changed.          \n");
+				printf("  -X,  Rectify with the stereo calibration of a file or 'flash' (the module's, \n");
+				printf("       needs -K): two cameras are left and right eye, one camera twice as      \n");
+				printf("       wide as the calibration is side by side, rectified files with -o.       \n");
+				printf("  -D,  Disparity of the rectified eyes (-X): range[:radius][:census][:lr], e.g.\n");
+				printf("       64:3:census:lr for disparities 0..63 in 7x7 windows of census costs     \n");
+				printf("       (default: SAD), lr drops pixels failing the right to left check.        \n");
+				printf("       Written as 16 bit files of 1/16 pixels with -o.                         \n");
+				printf("  -G,  Skip file, framebuffer and vcimgnetsrv output of unchanged frames: the  \n");
+				printf("       changed 16x16 blocks in 1/1000 each output needs (0: every frame, an    \n");
+				printf("       omitted one repeats the one before), keep: output every n frames at     \n");
+				printf("       least, e.g. 20:5:5:300.                                                 \n");
+				printf("  -O,  Rate of an output (stdout, fb, net, stream, mcast or file): every n-th  \n");
+				printf("       frame, or n per second with hz, e.g. file:2hz or stdout:10. Optional    \n");
+				printf("       priority, due outputs of higher priority run first (default: fb 3,      \n");
+				printf("       net 2, stream 2, mcast 2, stdout 1, file 0). Captures no output is due  \n");
+				printf("       for are not converted (unless -e, -S or -X need them).                  \n");
+				printf("  -M,  Hand stdout, file or mcast output to a thread of its own:               \n");
+				printf("       out:policy[:depth], latest keeps the newest frame per camera, fifo      \n");
+				printf("       queues depth frames and drops new ones while full, block makes capture  \n");
+				printf("       wait (default depth 4), e.g. file:fifo:8. Real-time mode (-R) uses      \n");
+				printf("       latest for stdout and file output, mcast always has a thread (latest).  \n");
+				printf("  -P,  Stream frames to TCP clients at the port, with depth frames queued per  \n");
+				printf("       client (default 2) and up to clients at once (default 4). A slow client \n");
+				printf("       misses its oldest frames not sent yet. Sent zerocopy where supported,   \n");
+				printf("       copy turns that off. See vcstream.h for the protocol.                   \n");
+				printf("  -U,  Multicast frames to the UDP group and port, in datagrams of mtu bytes   \n");
+				printf("       (default 1500), sent from the interface of the given address, e.g.      \n");
+				printf("       239.255.0.1:5001:192.168.1.10. Receivers that fall behind lose frames,  \n");
+				printf("       the sender never waits for them. See vcstreamclient.c -m.               \n");
+				printf("  -J,  Files, stream and multicast get baseline JPEGs of the quality (1..100)  \n");
+				printf("       instead of PGM/PPM files and raw planes. Encoded in slices of rows MCU  \n");
+				printf("       rows each (default 1, 8 or 16 pixel rows) in parallel, e.g. 75:2.       \n");
+				printf("  -A,  ASCII view at stdout as ascii ramp, colour (ANSI 256 colours) or half   \n");
+				printf("       (coloured half blocks, two pixel rows per character), cols characters   \n");
+				printf("       wide (default every 50th pixel), redrawn every ms at most (default 100),\n");
+				printf("       e.g. half:160. Not drawn if stdout is no terminal.                      \n");
+				printf("  -k,  Conversion kernels: scalar forces the scalar variants instead of the    \n");
+				printf("       vectorized ones the CPU supports, to verify them against.               \n");
+				printf("  -r,  Read commands from stdin, one per line: s shutter gain [camera] sets    \n");
+				printf("       shutter and gain of all or one camera (0, 1, ..), q quits.              \n");
+				printf("_______________________________________________________________________________\n");
+				printf("                                                                               \n");
+				return(+1);
+			case 's':  capture->shutter        = atol(optarg);  printf("Setting Shutter Value to %d.\n",capture->shutter);  break;
+			case 'g':  capture->gain           = atof(optarg);  printf("Setting Gain Value to %f.\n",   capture->gain   );  break;
+			case 'f':  output->fbOutIff1       = 1;             printf("Activating /dev/fb0 framebuffer output.\n");break;
+			case 'a':  output->stdOutIff1      = 0;             printf("Suppressing ASCII capture at stdout.\n" );  break;
+			case 'o':  output->fileOutIff1     = 1;             printf("Activating file output of captures.\n" );   break;
+			case 'b':  capture->bufCount       = atol(optarg);  printf("Setting Buffer Count to %d.\n",capture->bufCount);  break;
+			case 't':  run->threadCount        = atol(optarg);  printf("Setting Worker Thread Count to %d.\n",run->threadCount);  break;
+			case 'c':  strncpy(run->acCpuList, optarg, 255); run->acCpuList[255]=0;  printf("Pinning Worker Threads to CPUs %s.\n",run->acCpuList);  break;
+			case 'n':  run->grain              = atol(optarg);  printf("Setting Rows per Band to %d.\n",run->grain);  break;
+			case 'R':
+				run->rtPriority = atol(optarg);
+				if((run->rtPriority<sched_get_priority_min(SCHED_FIFO))||(run->rtPriority>sched_get_priority_max(SCHED_FIFO)))
+				{
+					printf("Error, real-time priority '%s' not within %d..%d.\n", optarg, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+					return(-1);
+				}
+				printf("Activating real-time mode with priority %d.\n",run->rtPriority);
+				break;
+			case 'i':  run->statsIntervalMS    = atol(optarg);  printf("Printing statistics every %dms.\n",run->statsIntervalMS);  break;
+			case 'd':
+				if(*camCount>=VCCAM_MAX){ printf("Error, at most %d cameras supported.\n", VCCAM_MAX); return(-1); }
+
+				strncpy(cam[*camCount].acVideoDev, optarg, sizeof(cam[*camCount].acVideoDev)-1);
+				cam[*camCount].acVideoDev[sizeof(cam[*camCount].acVideoDev)-1] = 0;
+				pcPriority = strchr(cam[*camCount].acVideoDev, ':');
+				if(NULL!=pcPriority)
+				{
+					*pcPriority++ = 0;
+					cam[*camCount].priority = max(1, atol(pcPriority));
+				}
+				printf("Adding Camera %d: %s, priority %d.\n", *camCount, cam[*camCount].acVideoDev, cam[*camCount].priority);
+				(*camCount)++;
+				break;
+			case 'e':  capture->ae.enabledIff1 = 1; capture->ae.target = min(max(atof(optarg), 1), 254);  printf("Activating auto exposure to mean %.0f.\n",capture->ae.target);  break;
+			case 'E':  capture->ae.period  = atol(optarg);  printf("Changing auto exposure every %d frames at most.\n",capture->ae.period);  break;
+			case 'L':  capture->ae.latency = atol(optarg);  printf("Setting sensor control latency to %d frames.\n",capture->ae.latency);  break;
+			case 'S':  capture->statsIff1  = 1;             printf("Activating frame statistics.\n");  break;
+			case 'T':
+				pcParam = strchr(optarg, ':');
+				if     (0==strncmp(optarg, "gamma", 5)){ capture->tone.kind = VCTONE_GAMMA; capture->tone.param = (NULL!=pcParam)?(atof(pcParam+1)):(1/2.2f); }
+				else if(0==strncmp(optarg, "log",   3)){ capture->tone.kind = VCTONE_LOG;   capture->tone.param = (NULL!=pcParam)?(atof(pcParam+1)):(100);    }
+				else if(0==strncmp(optarg, "clahe", 5)){ capture->tone.kind = VCTONE_CLAHE; capture->tone.param = (NULL!=pcParam)?(atof(pcParam+1)):(4);      }
+				else { printf("Error, unknown tone mapping '%s'.\n", optarg); return(-1); }
+				capture->tone.param = max(capture->tone.param, 0.01f);
+				printf("Activating tone mapping %s (%.2f).\n", optarg, capture->tone.param);
+				break;
+			case 'B':  capture->tone.blackLevel = atol(optarg);  printf("Setting black level to %d.\n",capture->tone.blackLevel);  break;
+			case 'C':
+				if     (0==strcmp(optarg, "planar")){ capture->colourType = IMAGE_RGB;      }
+				else if(0==strcmp(optarg, "rgb"   )){ capture->colourType = VCIMAGE_RGB24;  }
+				else if(0==strcmp(optarg, "bgr"   )){ capture->colourType = VCIMAGE_BGR24;  }
+				else if(0==strcmp(optarg, "rgba"  )){ capture->colourType = VCIMAGE_RGBA32; }
+				else if(0==strcmp(optarg, "bgra"  )){ capture->colourType = VCIMAGE_BGRA32; }
+				else { printf("Error, unknown colour layout '%s'.\n", optarg); return(-1); }
+				printf("Setting colour layout to %s.\n", optarg);
+				break;
+			case 'I':
+				if     (0==strcmp(optarg, "direct")){ capture->ingestMode = VCINGEST_DIRECT; }
+				else if(0==strcmp(optarg, "copy"  )){ capture->ingestMode = VCINGEST_COPY;   }
+				else if(0==strcmp(optarg, "auto"  )){ capture->ingestMode = VCINGEST_AUTO;   }
+				else { printf("Error, unknown ingest '%s'.\n", optarg); return(-1); }
+				printf("Setting capture ingest to %s.\n", optarg);
+				break;
+			case 'W':  strncpy(capture->acRegList, optarg, 255);  capture->acRegList[255] = '\0';  break;
+			case 'K':  strncpy(capture->acCalibDir, optarg, 255); capture->acCalibDir[255] = '\0'; break;
+			case 'X':  strncpy(capture->acStereoCalib, optarg, 255); capture->acStereoCalib[255] = '\0';  printf("Rectifying with the stereo calibration of %s.\n", capture->acStereoCalib);  break;
+			case 'D':
+				capture->stereo.dispCount = atol(optarg);
+				for(pcParam= strchr(optarg, ':'); NULL!=pcParam; pcParam= strchr(pcParam, ':'))
+				{
+					pcParam++;
+					if     (0==strncmp(pcParam, "census", 6)){ capture->stereo.censusIff1  = 1; }
+					else if(0==strncmp(pcParam, "sad",    3)){ capture->stereo.censusIff1  = 0; }
+					else if(0==strncmp(pcParam, "lr",     2)){ capture->stereo.lrCheckIff1 = 1; }
+					else                                      { capture->stereo.radius      = atol(pcParam); }
+				}
+				capture->stereo.dispCount = (min(max(capture->stereo.dispCount, 8), VCDISP_MAX) + 7) & ~7;
+				capture->stereo.radius    =  min(max(capture->stereo.radius, 1), VCDISP_RADIUS_MAX);
+				printf("Activating disparity 0..%d in %dx%d windows of %s costs%s.\n", capture->stereo.dispCount-1, 2*capture->stereo.radius+1, 2*capture->stereo.radius+1,
+						(1==capture->stereo.censusIff1)?("census"):("SAD"), (1==capture->stereo.lrCheckIff1)?(", left right checked"):(""));
+				break;
+			case 'G':
+				pcParam = optarg;
+				for(i= 0; i< VCGATE_OUT_COUNT; i++)
+				{
+					output->gate.threshold[i] = (i>0)?(output->gate.threshold[i-1]):(0);
+					if(NULL!=pcParam)
+					{
+						output->gate.threshold[i] = min(max(atol(pcParam), 0), 1000);
+						pcParam = strchr(pcParam, ':');
+						if(NULL!=pcParam){ pcParam++; }
+					}
+				}
+				if(NULL!=pcParam){ output->gate.keepAlive = max(atol(pcParam), 0); }
+				output->gate.enabledIff1 = 1;
+				printf("Activating change gate: file %d, framebuffer %d, vcimgnetsrv %d of 1000 blocks changed, keep-alive every %d frames.\n",
+						output->gate.threshold[VCGATE_OUT_FILE], output->gate.threshold[VCGATE_OUT_FB], output->gate.threshold[VCGATE_OUT_NET], output->gate.keepAlive);
+				break;
+			case 'O':
+				if     (0==strncmp(optarg, "stdout", 6)){ i = VCSINK_STDOUT; }
+				else if(0==strncmp(optarg, "fb",     2)){ i = VCSINK_FB;     }
+				else if(0==strncmp(optarg, "net",    3)){ i = VCSINK_NET;    }
+				else if(0==strncmp(optarg, "stream", 6)){ i = VCSINK_STREAM; }
+				else if(0==strncmp(optarg, "mcast",  5)){ i = VCSINK_MCAST;  }
+				else if(0==strncmp(optarg, "file",   4)){ i = VCSINK_FILE;   }
+				else { printf("Error, unknown output '%s'.\n", optarg); return(-1); }
+
+				pcParam = strchr(optarg, ':');
+				if(NULL==pcParam){ printf("Error, rate of output '%s' missing.\n", optarg); return(-1); }
+				pcParam++;
+				if(NULL!=strpbrk(pcParam, "hH"))
+				{
+					output->sched.sink[i].every    = 1;
+					output->sched.sink[i].periodNS = (U64)(1000000000.0 / max(atof(pcParam), 0.01));
+				}
+				else
+				{
+					output->sched.sink[i].every    = max(atol(pcParam), 1);
+					output->sched.sink[i].periodNS = 0;
+				}
+				pcParam = strchr(pcParam, ':');
+				if(NULL!=pcParam){ output->sched.sink[i].priority = atol(pcParam+1); }
+				output->sched.enabledIff1 = 1;
+				printf("Scheduling %s output every %d frames, at most %.2f per second, priority %d.\n", sinkName[i], output->sched.sink[i].every,
+						(output->sched.sink[i].periodNS>0)?(1000000000.0 / output->sched.sink[i].periodNS):(0.0), output->sched.sink[i].priority);
+				break;
+			case 'M':
+				if     (0==strncmp(optarg, "stdout", 6)){ box = &output->stdOutBox; }
+				else if(0==strncmp(optarg, "file",   4)){ box = &output->fileBox;   }
+				else if(0==strncmp(optarg, "mcast",  5)){ box = &output->mcastBox;  }
+				else { printf("Error, unknown output '%s'.\n", optarg); return(-1); }
+
+				pcParam = strchr(optarg, ':');
+				if(NULL==pcParam){ printf("Error, policy of output '%s' missing.\n", optarg); return(-1); }
+				pcParam++;
+				if     (0==strncmp(pcParam, "latest", 6)){ box->policy = VCMBOX_LATEST; }
+				else if(0==strncmp(pcParam, "fifo",   4)){ box->policy = VCMBOX_FIFO;   }
+				else if(0==strncmp(pcParam, "block",  5)){ box->policy = VCMBOX_BLOCK;  }
+				else { printf("Error, unknown mailbox policy '%s'.\n", pcParam); return(-1); }
+				pcParam = strchr(pcParam, ':');
+				if(NULL!=pcParam){ box->depth = min(max(atol(pcParam+1), 1), VCMBOX_DEPTH_MAX); }
+				box->enabledIff1 = 1;
+				printf("Handing %s output to a thread, mailbox %s of %d frames.\n", (box==&output->fileBox)?("file"):((box==&output->mcastBox)?("multicast"):("stdout")),
+						mailboxPolicyName[box->policy], (VCMBOX_LATEST==box->policy)?(1):(box->depth));
+				break;
+			case 'P':
+				output->stream.port = atol(optarg);
+				if((output->stream.port<=0)||(output->stream.port>65535)){ printf("Error, invalid stream port '%s'.\n", optarg); return(-1); }
+				pcParam = strchr(optarg, ':');
+				if((NULL!=pcParam)&&(pcParam[1]>='0')&&(pcParam[1]<='9'))
+				{
+					output->stream.depth = min(max(atol(pcParam+1), 1), VCSTREAM_DEPTH_MAX);
+					pcParam = strchr(pcParam+1, ':');
+					if((NULL!=pcParam)&&(pcParam[1]>='0')&&(pcParam[1]<='9'))
+					{
+						output->stream.clientMax = min(max(atol(pcParam+1), 1), VCSTREAM_CLIENT_MAX);
+					}
+				}
+				if(NULL!=strstr(optarg, "copy")){ output->stream.zeroCopyIff1 = 0; }
+				printf("Streaming frames at TCP port %d to %d clients at most, %d frames queued per client%s.\n",
+						output->stream.port, output->stream.clientMax, output->stream.depth, (1==output->stream.zeroCopyIff1)?(""):(", copied"));
+				break;
+			case 'J':
+				output->jpeg.quality = atol(optarg);
+				if((output->jpeg.quality<1)||(output->jpeg.quality>100)){ printf("Error, invalid JPEG quality '%s'.\n", optarg); return(-1); }
+				pcParam = strchr(optarg, ':');
+				if(NULL!=pcParam){ output->jpeg.restartRows = max(atol(pcParam+1), 1); }
+				printf("Encoding JPEGs of quality %d in slices of %d MCU rows.\n", output->jpeg.quality, output->jpeg.restartRows);
+				break;
+			case 'A':
+				if     (0==strncmp(optarg, "ascii",  5)){ output->preview.mode = VCPREVIEW_ASCII;  }
+				else if(0==strncmp(optarg, "colour", 6)){ output->preview.mode = VCPREVIEW_COLOUR; }
+				else if(0==strncmp(optarg, "half",   4)){ output->preview.mode = VCPREVIEW_HALF;   }
+				else{ printf("Error, unknown ASCII view '%s'.\n", optarg); return(-1); }
+				pcParam = strchr(optarg, ':');
+				if(NULL!=pcParam)
+				{
+					output->preview.cols = max(atol(pcParam+1), 0);
+					pcParam = strchr(pcParam+1, ':');
+					if(NULL!=pcParam){ output->preview.periodMS = max(atol(pcParam+1), 0); }
+				}
+				printf("ASCII view %s, %d characters wide, every %d ms at most.\n", optarg, output->preview.cols, output->preview.periodMS);
+				break;
+			case 'r':  run->consoleIff1 = 1;  printf("Reading commands from stdin.\n");  break;
+			case 'k':
+				if(0!=strcmp(optarg, "scalar")){ printf("Error, unknown kernel variant '%s'.\n", optarg); return(-1); }
+				run->kernelScalarIff1 = 1;
+				break;
+			case 'U':
+				snprintf(output->mcast.acGroup, sizeof(output->mcast.acGroup), "%s", optarg);
+				pcParam = strchr(output->mcast.acGroup, ':');
+				if(NULL==pcParam){ printf("Error, port of multicast group '%s' missing.\n", optarg); return(-1); }
+				*pcParam++  = '\0';
+				output->mcast.port = atol(pcParam);
+				if((output->mcast.port<=0)||(output->mcast.port>65535)){ printf("Error, invalid multicast port '%s'.\n", optarg); return(-1); }
+				pcParam = strchr(pcParam, ':');
+				if(NULL!=pcParam)
+				{
+					snprintf(output->mcast.acIface, sizeof(output->mcast.acIface), "%s", pcParam+1);
+					pcParam = strchr(output->mcast.acIface, ':');
+					if(NULL!=pcParam){ *pcParam++ = '\0'; output->mcast.mtu = atol(pcParam); }
+				}
+				printf("Multicasting frames to %s:%d%s%s in datagrams of %d bytes.\n", output->mcast.acGroup, output->mcast.port,
+						('\0'!=output->mcast.acIface[0])?(" from "):(""), output->mcast.acIface, output->mcast.mtu);
+				break;
+			case 'u':  capture->imuPeriodUS = max(atol(optarg), 0);  printf("Reading the IMU every %d us at most.\n",capture->imuPeriodUS);  break;
+		}
+	}
+
+	if(argc<2)
+	{
+		printf("  Hint: Activate framebuffer output by command line option (see:  %s -? )\n", argv[0]);
+	}
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Connects to a running vcimgnetsrv.
+*
+*  This function connects to a running vcimgnetsrv.
+*  Normally the vcimgnetsrv application is started beforehand in background
+*  using the following command:
+*
+*   vcimgnetsrv &
+*/
+/*-----------------------------------------------------------------------------*/
+int  imgnet_connect(VCImgNetCfg *imgnetCfg, U32 pixelformat, int dx, int dy)
+{
+	//predefine dimensions for the image to be transferred
+	imgnetCfg->img.type  = (V4L2_PIX_FMT_SRGGB10P==pixelformat)?(IMAGE_RGB):(IMAGE_GREY);
+	imgnetCfg->img.dx    = dx;
+	imgnetCfg->img.dy    = dy;
+	imgnetCfg->img.pitch = imgnetCfg->img.dx;
+	imgnetCfg->img.st    = NULL;
+	imgnetCfg->img.ccmp1 = NULL;
+	imgnetCfg->img.ccmp2 = NULL;
+
+	return(vcimgnet_attach(&(imgnetCfg->img), imgnetCfg));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Disconnects from a running vcimgnetsrv.
+*
+*  This function disconnects from a running vcimgnetsrv.
+*  The vcimgnetsrv application will keep running.
+*/
+/*-----------------------------------------------------------------------------*/
+int  imgnet_disconnect(VCImgNetCfg *imgnetCfg)
+{
+	return(vcimgnet_detach(imgnetCfg));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Tells the Sensor to Start Streaming Recordings.
+*
+*  This function tells the sensor to start streaming recordings.
+*  To get access to the streamed images
+*  buffers (which will be filled by the stream) must be enqueued,
+*  waited until one is filled, and dequeued.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_streaming_start(VCMipiSenCfg *sen)
+{
+	I32                 ee, rc;
+	enum v4l2_buf_type  type;
+
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	rc =  ioctl(sen->fd, VIDIOC_STREAMON, &type);
+	if(rc<0){ee=-1; goto fail;}
+
+
+ 	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_STREAMON) throws Error!\n", __FUNCTION__);
+			break;
+	}
+	return(ee);
+}
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Tells the Sensor to Stop Streaming Recordings.
+*
+*  This function tells the sensor to stop streaming recordings.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_streaming_stop(VCMipiSenCfg *sen)
+{
+	I32                 ee, rc;
+	enum v4l2_buf_type  type;
+
+
+	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	rc =  ioctl(sen->fd, VIDIOC_STREAMOFF, &type);
+	if(rc<0){ee=-1; goto fail;}
+
+
+ 	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_STREAMOFF) throws Error!\n", __FUNCTION__);
+			break;
+	}
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Opens the Capture Device and Retreives its Attributes.
+*
+*  This function opens the capture device and retreives its attributes.
+*  slotCount images are preallocated for the converted captures.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_open(char *dev_video_device, VCMipiSenCfg *sen, int qbufCount, int slotCount, int prefaultIff1, int colourType, int ingestMode)
+{
+	I32    ee, rc, i;
+
+
+	// Reset Allocation Markers
+	// prohibits closing of un-open device and prevents wrong deallocation or unmapping.
+	{
+		sen->fd        =   -1;
+		sen->qbuf      = NULL;
+		sen->qbufCount =   -1;
+		sen->arena.slot        = NULL;
+		sen->arena.slotCount   = 0;
+		sen->arena.statsWorker = NULL;
+		sen->pipe              = NULL;
+	}
+
+
+	// Open the Device.
+	{
+		sen->fd =  open(dev_video_device, O_RDWR | O_NONBLOCK, 0);
+		if(sen->fd<0){ee=-1; goto fail;}
+	}
+
+
+	// Check the Capabilities of the Device.
+	{
+		struct v4l2_capability  cap;
+
+		rc =  ioctl(sen->fd, VIDIOC_QUERYCAP, &cap);
+		if(rc<0){ee=-2; goto fail;}
+
+		// Check if device can Capture Videos and supports mmap access.
+		if(0==(cap.capabilities & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING)))
+		{ee=-3; goto fail;}
+
+		syslog(LOG_DEBUG, "%s:  Initialized Capture Device '%s' (fd:%d):\n", __FILE__, dev_video_device, sen->fd);
+	}
+
+
+	// Retreive Dimensions of the Camera Device.
+	{
+		struct v4l2_format  format;
+
+		format.type                = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		format.fmt.pix.width       = UINT_MAX;
+		format.fmt.pix.height      = UINT_MAX;
+		format.fmt.pix.pixelformat = V4L2_PIX_FMT_Y10;
+
+		rc = ioctl(sen->fd, VIDIOC_G_FMT, &format);
+		if(rc<0){ee=-4; goto fail;}
+
+		sen->pix = format.fmt.pix;
+
+		syslog(LOG_DEBUG, "%s:    Pixel Format used:        %d          \n", __FILE__, sen->pix.pixelformat );
+		syslog(LOG_DEBUG, "%s:    Maximum Pixel Width:      %d          \n", __FILE__, sen->pix.width       );
+		syslog(LOG_DEBUG, "%s:    Maximum Pixel Height:     %d          \n", __FILE__, sen->pix.height      );
+		syslog(LOG_DEBUG, "%s:    Bytes Per Line:           %d          \n", __FILE__, sen->pix.bytesperline);
+	}
+
+
+	// Cache the Ranges of the Sensor Controls.
+	{
+		rc =  sensor_query_controls(sen);
+		if(rc<0){ee=-9; goto fail;}
+
+		rc =  sensor_regs_init(&sen->regs, sen->fd);
+		if(rc<0){ee=-10; goto fail;}
+	}
+
+
+	// Allocate Capture Buffer Pointer 'Array'
+	{
+		QBuf  imgBufNuller = NULL_QBuf;
+
+		sen->qbuf =  malloc(sizeof(QBuf) * qbufCount);
+		if(NULL==sen->qbuf){ee=-99; goto fail;}
+
+		for(i= 0; i< qbufCount; i++)
+		{
+			sen->qbuf[i] = imgBufNuller;
+		}
+	}
+
+	// Request the Count of Capture Buffers
+	{
+		struct v4l2_requestbuffers  req;
+
+		memset(&req, 0, sizeof(struct v4l2_requestbuffers));
+		req.memory = V4L2_MEMORY_MMAP;
+		req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		req.count  = qbufCount;
+
+		rc =  ioctl(sen->fd, VIDIOC_REQBUFS, &req);
+		if(rc<0){ee=-5; goto fail;}
+
+		if(req.count != qbufCount){ee=-6; goto fail;}
+	}
+
+	// Map the capture buffer memory addresses to the Capture Buffer Pointer 'Array'
+	{
+		struct v4l2_buffer  buf;
+
+		sen->qbufCount = 0;
+		for(i= 0; i< qbufCount; i++)
+		{
+			memset(&buf, 0, sizeof(struct v4l2_buffer));
+			buf.memory = V4L2_MEMORY_MMAP;
+			buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			buf.index  = sen->qbufCount;
+
+			rc =  ioctl(sen->fd, VIDIOC_QUERYBUF, &buf);
+			if(rc<0){ee=-7; goto fail;}
+
+			sen->qbuf[sen->qbufCount].byteCount = buf.length;
+			sen->qbuf[sen->qbufCount].st        = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED | ((1==prefaultIff1)?(MAP_POPULATE):(0)), sen->fd, buf.m.offset);
+			if(MAP_FAILED==sen->qbuf[sen->qbufCount].st){ee=-8; goto fail;}
+
+			sen->qbufCount++;
+		}
+	}
+
+	// Preallocate the images the captures are converted to.
+	{
+		rc =  frame_arena_create(&sen->arena, sen->pix.pixelformat, sen->pix.width, sen->pix.height, slotCount, prefaultIff1, colourType);
+		if(rc<0){ee=-99; goto fail;}
+	}
+
+	// The conversion specialised for the format, row padding and image layout.
+	{
+		sen->pipe =  pipeline_select(sen->pix.pixelformat, sen->pix.width, sen->pix.bytesperline, image_pixel_stride(&sen->arena.slot[0].img));
+		if(NULL==sen->pipe){ee=-11; goto fail;}
+
+		syslog(LOG_DEBUG, "%s:    Pipeline:                 %s          \n", __FILE__, sen->pipe->pcName);
+	}
+
+	// Decide whether captures are converted in place or from a cached copy.
+	{
+		rc =  ingest_init(&sen->ingest, ingestMode, sen->qbuf[0].st, sen->qbuf[0].byteCount, prefaultIff1);
+		if(rc<0){ee=-99; goto fail;}
+	}
+
+
+	ee = 0;
+fail:
+	if(ee<0)
+	{
+		sensor_close(sen);
+	}
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  Could not open device '%s' for Reading/Writing!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -2:
+			if(errno == EINVAL)
+				syslog(LOG_ERR, "%s():  Device '%s' is no V4L2 Device!\n", __FUNCTION__, dev_video_device);
+			else
+				syslog(LOG_ERR, "%s():  ioctl(VIDIOC_QUERYCAP) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -3:
+			syslog(LOG_ERR, "%s():  Device '%s' is no Capture Device or doesn't support mmap as IO Method!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -4:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_G_FMT) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -5:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_REQBUFS) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -6:
+			syslog(LOG_ERR, "%s():  Requested buffers differ from returned buffers!\n", __FUNCTION__);
+			break;
+		case -7:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_QUERYBUF) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -8:
+			syslog(LOG_ERR, "%s():  mmap() failed for Buffer %d!\n", __FUNCTION__, sen->qbufCount);
+			break;
+		case -9:
+			syslog(LOG_ERR, "%s():  Could not query the controls of Device '%s'!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -10:
+			syslog(LOG_ERR, "%s():  Could not set up the register access of Device '%s'!\n", __FUNCTION__, dev_video_device);
+			break;
+		case -11:
+			syslog(LOG_ERR, "%s():  Pixelformat %c%c%c%c (0x%08x) with %d bytes per line unsupported!\n", __FUNCTION__,
+					(char)((sen->pix.pixelformat >>  0)&0xFF), (char)((sen->pix.pixelformat >>  8)&0xFF),
+					(char)((sen->pix.pixelformat >> 16)&0xFF), (char)((sen->pix.pixelformat >> 24)&0xFF),
+					sen->pix.pixelformat, sen->pix.bytesperline);
+			break;
+		case -99:
+			syslog(LOG_ERR, "%s():  Out of Memory!\n", __FUNCTION__);
+			break;
+		default:
+			syslog(LOG_ERR, "%s():  Unknown error code: %d!\n", __FUNCTION__, ee);
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Closes the Capture Device.
+*
+*  This function closes the capture device.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_close(VCMipiSenCfg *sen)
+{
+	I32  ee, rc, i;
+
+
+	// checks if device has been opened (see sensor_open() and NULL_VCMipiSenCfg)
+	if(sen->fd>=0)
+	{
+		//rc = uninit_mmap();
+		if(NULL!=sen->qbuf)
+		{
+			for(i=sen->qbufCount; i> 0; i--)
+			{
+				rc =  munmap(sen->qbuf[i-1].st, sen->qbuf[i-1].byteCount);
+				if(rc<0){ee=-1-10*i; goto fail;}
+
+				sen->qbufCount--;
+			}
+
+			free(sen->qbuf);
+			sen->qbuf = NULL;
+		}
+
+		frame_arena_destroy(&sen->arena);
+		ingest_destroy(&sen->ingest);
+		sensor_regs_destroy(&sen->regs);
+
+		// Close Video Device.
+		{
+			rc =  close(sen->fd);
+			if(rc<0){return -2;}
+
+			sen->fd = -1;
+		}
+	}
+
+	ee=0;
+fail:
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Enqueues a Buffer into the Capture Queue.
+*
+*  This function enqueues a buffer into the capture queue.
+*
+*  If the sensor acquires images, e.g. by being in streaming mode,
+*  buffers enqueued at the capture queue will be filled with recorded data.
+*  After successful waiting for a recording,
+*  the image can be accessed by dequeuing the buffer from the capture queue.
+*/
+/*-----------------------------------------------------------------------------*/
+int  capture_buffer_enqueue(I32 bufIdx, VCMipiSenCfg *sen)
+{
+	I32                 ee, rc;
+	struct v4l2_buffer  buf;
+
+	memset(&buf, 0, sizeof(struct v4l2_buffer));
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.index  = bufIdx;
+
+	rc =  ioctl(sen->fd, VIDIOC_QBUF, &buf);
+	if(rc<0){ee=-9; goto fail;}
+
+
+	ee = 0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -9:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_QBUF) throws Error!\n", __FUNCTION__);
+			break;
+		default:
+			syslog(LOG_ERR, "%s():  Unknown error code: %d!\n", __FUNCTION__, ee);
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Dequeues a Buffer from the Capture Queue.
+*
+*  This function dequeues a buffer from the capture queue.
+*
+*  If the sensor acquires images, e.g. by being in streaming mode,
+*  buffers enqueued at the capture queue will be filled with recorded data.
+*  After successful waiting for a recording,
+*  the image can be accessed by dequeuing the buffer from the capture queue.
+*/
+/*-----------------------------------------------------------------------------*/
+int  capture_buffer_dequeue(I32 *bufIdx, VCMipiSenCfg *sen)
+{
+	I32                 ee, rc;
+	struct v4l2_buffer  buf;
+
+	memset(&buf, 0, sizeof(struct v4l2_buffer));
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	rc =  ioctl(sen->fd, VIDIOC_DQBUF, &buf);
+	if(rc<0)
+	{
+		if(EAGAIN==errno){ee=+1; goto fail;} // Buffer is not available.
+		else             {ee=-1; goto fail;}
+	}
+
+	if(buf.index >= sen->qbufCount)
+	{
+		ee=-2; goto fail;
+	}
+
+	*bufIdx = buf.index;
+
+	sen->qbuf[buf.index].dequeueNS   = timestamp_ns();
+	sen->qbuf[buf.index].timestampNS = 0;
+	sen->qbuf[buf.index].sequence    = buf.sequence;
+	if(V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC==(buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK))
+	{
+		sen->qbuf[buf.index].timestampNS = (U64)buf.timestamp.tv_sec * 1000000000ULL + (U64)buf.timestamp.tv_usec * 1000ULL;
+	}
+
+
+	ee = 0;
+fail:
+	switch(ee)
+	{
+		case +1: // Buffer not available, expected when draining the queue.
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_DQBUF) throws Error!\n", __FUNCTION__);
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  Buffer index returned exceeds limits: %d>=%d!\n", __FUNCTION__, buf.index, sen->qbufCount);
+			break;
+		default:
+			syslog(LOG_ERR, "%s():  Unknown error code: %d!\n", __FUNCTION__, ee);
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Creates the Event Loop of the Capture Thread.
+*
+*  This function blocks SIGINT and SIGTERM for the calling thread and
+*  all threads it starts afterwards, they are received by a signalfd
+*  instead. So call it before any thread is started.
+*
+* @param  statsIntervalMS  Period of VCEV_TIMER, 0 disables the timer.
+*/
+/*-----------------------------------------------------------------------------*/
+int  event_loop_create(VCEventLoop *loop, I32 statsIntervalMS)
+{
+	I32                 ee, rc;
+	sigset_t            sigmask;
+	struct epoll_event  ev;
+
+	memset(loop, 0, sizeof(VCEventLoop));
+	loop->epollFd  = -1;
+	loop->timerFd  = -1;
+	loop->eventFd  = -1;
+	loop->signalFd = -1;
+	pthread_mutex_init(&loop->mutex, NULL);
+
+	loop->epollFd =  epoll_create1(EPOLL_CLOEXEC);
+	if(loop->epollFd<0){ee=-1; goto fail;}
+
+	// Signals
+	{
+		sigemptyset(&sigmask);
+		sigaddset(&sigmask, SIGINT);
+		sigaddset(&sigmask, SIGTERM);
+
+		rc =  pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+		if(rc!=0){ee=-2; goto fail;}
+
+		loop->signalFd =  signalfd(-1, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+		if(loop->signalFd<0){ee=-3; goto fail;}
+
+		ev.events   = EPOLLIN | EPOLLET;
+		ev.data.u32 = VCEV_QUIT;
+		rc =  epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->signalFd, &ev);
+		if(rc<0){ee=-4; goto fail;}
+	}
+
+	// Control Commands
+	{
+		loop->eventFd =  eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(loop->eventFd<0){ee=-3; goto fail;}
+
+		ev.events   = EPOLLIN | EPOLLET;
+		ev.data.u32 = VCEV_CONTROL;
+		rc =  epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->eventFd, &ev);
+		if(rc<0){ee=-4; goto fail;}
+	}
+
+	// Statistics Timer
+	if(statsIntervalMS>0)
+	{
+		struct itimerspec  its;
+
+		loop->timerFd =  timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if(loop->timerFd<0){ee=-3; goto fail;}
+
+		its.it_interval.tv_sec  = (statsIntervalMS / 1000);
+		its.it_interval.tv_nsec = (statsIntervalMS % 1000) * 1000000L;
+		its.it_value            = its.it_interval;
+
+		rc =  timerfd_settime(loop->timerFd, 0, &its, NULL);
+		if(rc<0){ee=-5; goto fail;}
+
+		ev.events   = EPOLLIN | EPOLLET;
+		ev.data.u32 = VCEV_TIMER;
+		rc =  epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->timerFd, &ev);
+		if(rc<0){ee=-4; goto fail;}
+	}
+
+	loop->lastNS = timestamp_ns();
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  pthread_sigmask() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			break;
+		default:
+			syslog(LOG_ERR, "%s():  Could not set up event sources (%d, %d(%s))!\n", __FUNCTION__, ee, errno, strerror(errno));
+			break;
+	}
+	if(ee<0)
+	{
+		event_loop_destroy(loop);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Adds a Capture Device to the Event Loop.
+*
+*  The device must be opened non-blocking (see sensor_open()),
+*  since all filled buffers are dequeued until none is left.
+*
+* @param  idx  Reported as VCEV_SENSOR(idx) by event_loop_wait().
+*/
+/*-----------------------------------------------------------------------------*/
+int  event_loop_add_sensor(VCEventLoop *loop, VCMipiSenCfg *sen, I32 idx)
+{
+	I32                 rc;
+	struct epoll_event  ev;
+
+	if((idx<0)||(idx>=24)){ return(ERR_PARAM); }
+
+	ev.events   = EPOLLIN | EPOLLET;
+	ev.data.u32 = VCEV_SENSOR(idx);
+
+	rc =  epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, sen->fd, &ev);
+	if(rc<0)
+	{
+		syslog(LOG_ERR, "%s():  epoll_ctl() throws Error (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+		return(-1);
+	}
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Waits for the next Events of the Capture Thread.
+*
+*  This function blocks until at least one event source is ready and
+*  returns all ready sources at once as a bit mask of VCEV_.. values.
+*  Timer, eventfd and signalfd are read here, capture devices have to be
+*  drained by the caller, since all sources are edge triggered.
+*/
+/*-----------------------------------------------------------------------------*/
+int  event_loop_wait(VCEventLoop *loop, U32 *events)
+{
+	I32                 ee, rc, i;
+	struct epoll_event  ev[8];
+	U64                 t0, t1, u64;
+
+	*events = 0;
+
+	while(1)
+	{
+		t0 = timestamp_ns();
+		rc =  epoll_wait(loop->epollFd, ev, sizeof(ev)/sizeof(ev[0]), -1);
+		t1 = timestamp_ns();
+
+		loop->busyNS += t0 - loop->lastNS;
+		loop->waitNS += t1 - t0;
+		loop->lastNS  = t1;
+
+		if(rc<0)
+		{
+			// Ignore interrupt based returns.
+			if(EINTR==errno){continue;        }
+			else            {ee=-1; goto fail;}
+		}
+		break;
+	}
+	loop->wakeupCount++;
+
+	for(i= 0; i< rc; i++)
+	{
+		*events |= ev[i].data.u32;
+	}
+
+	if(0!=(*events & VCEV_TIMER))
+	{
+		while(read(loop->timerFd, &u64, sizeof(u64)) == sizeof(u64));
+	}
+	if(0!=(*events & VCEV_CONTROL))
+	{
+		while(read(loop->eventFd, &u64, sizeof(u64)) == sizeof(u64));
+	}
+	if(0!=(*events & VCEV_QUIT))
+	{
+		struct signalfd_siginfo  si;
+
+		while(read(loop->signalFd, &si, sizeof(si)) == sizeof(si))
+		{
+			syslog(LOG_DEBUG, "%s():  Received signal %d, quitting.\n", __FUNCTION__, si.ssi_signo);
+		}
+	}
+
+
+	ee = 0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  epoll_wait() failed (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Queues a Control Command for the Capture Thread.
+*
+*  This function may be called by any thread.
+*  Returns +1 if the queue is full.
+*/
+/*-----------------------------------------------------------------------------*/
+int  event_loop_post_control(VCEventLoop *loop, const VCControlCmd *cmd)
+{
+	I32  ee;
+	U64  one = 1;
+
+	pthread_mutex_lock(&loop->mutex);
+	if(loop->cmdCount >= VCCTRL_QUEUE_SIZE)
+	{
+		ee=+1;
+	}
+	else
+	{
+		loop->cmd[(loop->cmdFirst + loop->cmdCount) % VCCTRL_QUEUE_SIZE] = *cmd;
+		loop->cmdCount++;
+		ee=0;
+	}
+	pthread_mutex_unlock(&loop->mutex);
+
+	if(0==ee)
+	{
+		if(write(loop->eventFd, &one, sizeof(one)) != sizeof(one)){ ee=-1; }
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Takes the oldest queued Control Command.
+*
+*  Returns +1 if no command is queued.
+*/
+/*-----------------------------------------------------------------------------*/
+int  event_loop_get_control(VCEventLoop *loop, VCControlCmd *cmd)
+{
+	I32  ee;
+
+	pthread_mutex_lock(&loop->mutex);
+	if(0==loop->cmdCount)
+	{
+		ee=+1;
+	}
+	else
+	{
+		*cmd = loop->cmd[loop->cmdFirst];
+		loop->cmdFirst = (loop->cmdFirst + 1) % VCCTRL_QUEUE_SIZE;
+		loop->cmdCount--;
+		ee=0;
+	}
+	pthread_mutex_unlock(&loop->mutex);
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Wakeups per Frame and the Time spent in the Event Loop.
+*/
+/*-----------------------------------------------------------------------------*/
+void  event_loop_print_stats(VCEventLoop *loop)
+{
+	U64  totalNS = max(1, loop->waitNS + loop->busyNS);
+
+	printf("  Event Loop: %llu Wakeups, %llu Frames, %5.2f Wakeups/Frame, %5.1f%% waiting, %5.1f%% busy.\n",
+			(unsigned long long)loop->wakeupCount, (unsigned long long)loop->frameCount,
+			(F32)loop->wakeupCount / max(1, loop->frameCount),
+			(F32)100 * loop->waitNS / totalNS, (F32)100 * loop->busyNS / totalNS);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Closes all Event Sources of the Event Loop.
+*
+*  Capture devices added are not closed, see sensor_close().
+*/
+/*-----------------------------------------------------------------------------*/
+void  event_loop_destroy(VCEventLoop *loop)
+{
+	if(loop->timerFd >=0){ close(loop->timerFd ); loop->timerFd  = -1; }
+	if(loop->eventFd >=0){ close(loop->eventFd ); loop->eventFd  = -1; }
+	if(loop->signalFd>=0){ close(loop->signalFd); loop->signalFd = -1; }
+	if(loop->epollFd >=0){ close(loop->epollFd ); loop->epollFd  = -1; }
+	pthread_mutex_destroy(&loop->mutex);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Caches Ranges and Values of the Sensor Controls.
+*
+*  This function queries range and step of all VCSENCTRL_.. controls
+*  once by VIDIOC_QUERY_EXT_CTRL and reads their current values by a
+*  single VIDIOC_G_EXT_CTRLS, so sensor_set_controls() can validate
+*  without kernel round trips. Controls the driver lacks are marked
+*  unsupported, which is no error.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_query_controls(VCMipiSenCfg *sen)
+{
+	I32                          ee, rc, i, count;
+	struct v4l2_query_ext_ctrl   query;
+	struct v4l2_queryctrl        queryOld;
+	struct v4l2_ext_controls     ctrls;
+	struct v4l2_ext_control      ctrl[VCSENCTRL_COUNT];
+	I32                          ctrlIdx[VCSENCTRL_COUNT];
+	VCSensorCtrl                *c;
+
+	for(i= 0; i< VCSENCTRL_COUNT; i++)
+	{
+		c = &sen->ctrl[i];
+		memset(c, 0, sizeof(VCSensorCtrl));
+		c->id   = sensorCtrlId[i];
+		c->step = 1;
+
+		memset(&query, 0, sizeof(query));
+		query.id = c->id;
+
+		rc =  ioctl(sen->fd, VIDIOC_QUERY_EXT_CTRL, &query);
+		if((rc<0)&&(ENOTTY==errno))
+		{
+			// Kernel older than 3.19.
+			memset(&queryOld, 0, sizeof(queryOld));
+			queryOld.id = c->id;
+
+			rc =  ioctl(sen->fd, VIDIOC_QUERYCTRL, &queryOld);
+			query.flags         = queryOld.flags;
+			query.minimum       = queryOld.minimum;
+			query.maximum       = queryOld.maximum;
+			query.step          = queryOld.step;
+			query.default_value = queryOld.default_value;
+		}
+		if(rc<0)
+		{
+			if(EINVAL!=errno){ee=-1; goto fail;} //general error.
+			continue;                            //unsupported.
+		}
+		if(0!=(query.flags & V4L2_CTRL_FLAG_DISABLED)){ continue; }
+
+		c->supportedIff1 = 1;
+		c->minimum       = query.minimum;
+		c->maximum       = query.maximum;
+		c->step          = max(1, query.step);
+		c->def           = query.default_value;
+
+		syslog(LOG_DEBUG, "%s():  %s Range: %lld..%lld, Step %lld.\n", __FUNCTION__, sensorCtrlName[i], (long long)c->minimum, (long long)c->maximum, (long long)c->step);
+	}
+
+
+	// Current values, so unchanged ones are not written again.
+	{
+		count = 0;
+		for(i= 0; i< VCSENCTRL_COUNT; i++)
+		{
+			if(1!=sen->ctrl[i].supportedIff1){ continue; }
+
+			memset(&ctrl[count], 0, sizeof(struct v4l2_ext_control));
+			ctrl[count].id   = sen->ctrl[i].id;
+			ctrlIdx[count]   = i;
+			count++;
+		}
+
+		if(count>0)
+		{
+			memset(&ctrls, 0, sizeof(ctrls));
+			ctrls.count    = count;
+			ctrls.controls = ctrl;
+
+			rc =  ioctl(sen->fd, VIDIOC_G_EXT_CTRLS, &ctrls);
+			if(rc>=0)
+			{
+				for(i= 0; i< count; i++)
+				{
+					sen->ctrl[ctrlIdx[i]].value      = ctrl[i].value;
+					sen->ctrl[ctrlIdx[i]].validIff1  = 1;
+				}
+			}
+		}
+	}
+
+
+	ee = 0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_QUERY_EXT_CTRL) throws Error (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Applies a Set of Sensor Controls at once.
+*
+*  This function validates the values against the cached ranges, rounds
+*  them to the control step and writes all changed ones atomically by a
+*  single VIDIOC_S_EXT_CTRLS. If nothing changed, no ioctl is made,
+*  so it is cheap enough to be called for every frame.
+*  When the settings become operational depends on the sensor and its configuration.
+*
+* @param  ctrlIdx  VCSENCTRL_.. of each value.
+* @param  value    New values.
+* @param  count    Number of values, at most VCSENCTRL_COUNT.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_set_controls(VCMipiSenCfg *sen, const I32 *ctrlIdx, const I64 *value, I32 count)
+{
+	I32                        ee, rc, i, changed = 0;
+	I64                        val;
+	VCSensorCtrl              *c = NULL;
+	struct v4l2_ext_controls   ctrls;
+	struct v4l2_ext_control    ctrl[VCSENCTRL_COUNT];
+	I32                        changedIdx[VCSENCTRL_COUNT];
+
+	if((count<0)||(count>VCSENCTRL_COUNT)){ee=-1; goto fail;}
+
+	for(i= 0; i< count; i++)
+	{
+		if((ctrlIdx[i]<0)||(ctrlIdx[i]>=VCSENCTRL_COUNT)){ee=-1; goto fail;}
+
+		c = &sen->ctrl[ctrlIdx[i]];
+		if(1!=c->supportedIff1){ee=-2; goto fail;}
+
+		val = value[i];
+		if((val < c->minimum)||(val > c->maximum)){ee=-3; goto fail;}
+
+		val = c->minimum + ((val - c->minimum + c->step/2) / c->step) * c->step;
+		if(val > c->maximum){ val -= c->step; }
+
+		if((1==c->validIff1)&&(val==c->value)){ continue; }
+
+		memset(&ctrl[changed], 0, sizeof(struct v4l2_ext_control));
+		ctrl[changed].id    = c->id;
+		ctrl[changed].value = val;
+		changedIdx[changed] = ctrlIdx[i];
+		changed++;
+	}
+
+	if(changed>0)
+	{
+		memset(&ctrls, 0, sizeof(ctrls));
+		ctrls.count    = changed;
+		ctrls.controls = ctrl;
+
+		rc =  ioctl(sen->fd, VIDIOC_S_EXT_CTRLS, &ctrls);
+		if(rc<0){ee=-4; goto fail;}
+
+		for(i= 0; i< changed; i++)
+		{
+			sen->ctrl[changedIdx[i]].value     = ctrl[i].value;
+			sen->ctrl[changedIdx[i]].validIff1 = 1;
+
+			syslog(LOG_DEBUG, "%s():  Requested New %s Value: %d.\n", __FUNCTION__, sensorCtrlName[changedIdx[i]], ctrl[i].value);
+		}
+	}
+
+
+	ee = 0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  Invalid control index or count!\n", __FUNCTION__);
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  %s control is unsupported!\n", __FUNCTION__, sensorCtrlName[ctrlIdx[i]]);
+			break;
+		case -3:
+			syslog(LOG_ERR, "%s():  %s Value %lld is out of range %lld..%lld!\n", __FUNCTION__, sensorCtrlName[ctrlIdx[i]], (long long)value[i], (long long)c->minimum, (long long)c->maximum);
+			break;
+		case -4:
+			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_S_EXT_CTRLS) throws Error (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			for(i= 0; i< changed; i++)
+			{
+				sen->ctrl[changedIdx[i]].validIff1 = 0;
+			}
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Requests new Settings to the Sensor Device.
+*
+*  This function requests new Settings to the Sensor Device
+*  like an exposure time or gain, both in one VIDIOC_S_EXT_CTRLS.
+*  The gain is rounded to the nearest step of the gain control.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_set_parameters(VCMipiSenCfg  *sen, F32 newGain, I32 newShutter)
+{
+	I32  ctrlIdx[2] = { VCSENCTRL_GAIN,                   VCSENCTRL_EXPOSURE };
+	I64  value[2]   = { (I64)(newGain + ((newGain<0)?(-0.5f):(0.5f))), newShutter         };
+
+	return(sensor_set_controls(sen, ctrlIdx, value, 2));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prepares the Register Access of a Sensor.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_regs_init(VCSensorRegs *regs, int fd)
+{
+	memset(regs, 0, sizeof(VCSensorRegs));
+	regs->fd = fd;
+
+	if(0!=pthread_mutex_init(&regs->mutex, NULL)){ return(-1); }
+	regs->mutexIff1 = 1;
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Releases the Register Access of a Sensor, pending Writes are dropped.
+*/
+/*-----------------------------------------------------------------------------*/
+void  sensor_regs_destroy(VCSensorRegs *regs)
+{
+	if(1==regs->mutexIff1)
+	{
+		pthread_mutex_destroy(&regs->mutex);
+		regs->mutexIff1 = 0;
+	}
+	regs->pendCount = 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns the Shadow Entry of a Register, NULL if it has none.
+*
+*  Open addressing with linear probing, createIff1 adds a missing entry.
+*  If the shadow is full, further registers are not cached.
+*/
+/*-----------------------------------------------------------------------------*/
+static VCRegEntry *sensor_reg_entry(VCSensorRegs *regs, U16 addr, I32 createIff1)
+{
+	U32  i, k = ((U32)addr * 2654435761u) >> 16;
+
+	for(i= 0; i< VCREG_SHADOW_SIZE; i++)
+	{
+		VCRegEntry *e = &regs->shadow[(k + i) & (VCREG_SHADOW_SIZE-1)];
+
+		if((1==e->usedIff1)&&(addr==e->addr)){ return(e); }
+		if(0==e->usedIff1)
+		{
+			if(0==createIff1){ return(NULL); }
+			e->usedIff1 = 1;
+			e->addr     = addr;
+			return(e);
+		}
+	}
+
+	return(NULL);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  One Register Transfer over the Extension Unit.
+*
+*  Same access as SensorRegRead()/SensorRegWrite() of imu_test: a write sends
+*  1, address and value, a read sends 0 and the address and then gets the
+*  value at bytes 3 and 4, all big endian. Caller holds the mutex.
+*/
+/*-----------------------------------------------------------------------------*/
+static I32  sensor_reg_transfer(VCSensorRegs *regs, I32 writeIff1, U16 addr, U16 *value)
+{
+	struct uvc_xu_control_query  query;
+	U8   data[VCREG_XU_SIZE];
+	U64  t0 = timestamp_ns();
+	I32  rc;
+
+	memset(&query, 0, sizeof(query));
+	query.unit     = VCIMU_XU_UNIT;
+	query.selector = VCREG_XU_SEL;
+	query.query    = UVC_SET_CUR;
+	query.size     = VCREG_XU_SIZE;
+	query.data     = data;
+
+	data[0] = (1==writeIff1)?(1):(0);
+	data[1] = addr >> 8;
+	data[2] = addr & 0xFF;
+	data[3] = (1==writeIff1)?(*value >> 8):(0);
+	data[4] = (1==writeIff1)?(*value & 0xFF):(0);
+
+	rc =  ioctl(regs->fd, UVCIOC_CTRL_QUERY, &query);
+	if((rc>=0)&&(0==writeIff1))
+	{
+		query.query = UVC_GET_CUR;
+		rc =  ioctl(regs->fd, UVCIOC_CTRL_QUERY, &query);
+		*value = (data[3] << 8) | data[4];
+	}
+
+	latency_stats_add((1==writeIff1)?(&regs->latWrite):(&regs->latRead), timestamp_ns() - t0);
+	if(rc<0){ regs->errorCount++; }
+
+	return((rc<0)?(-1):(0));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sends the pending Register Writes, Caller holds the Mutex.
+*/
+/*-----------------------------------------------------------------------------*/
+static I32  sensor_reg_flush_locked(VCSensorRegs *regs)
+{
+	I32          ee = 0, i;
+	VCRegEntry  *e;
+
+	for(i= 0; i< regs->pendCount; i++)
+	{
+		e = sensor_reg_entry(regs, regs->pendAddr[i], 1);
+
+		if(sensor_reg_transfer(regs, 1, regs->pendAddr[i], &regs->pendValue[i])<0)
+		{
+			if(NULL!=e){ e->validIff1 = 0; }
+			ee = -1;
+			continue;
+		}
+		if(NULL!=e)
+		{
+			e->value     = regs->pendValue[i];
+			e->validIff1 = 1;
+		}
+	}
+	if(regs->pendCount>0){ regs->flushCount++; }
+	regs->pendCount = 0;
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Queues a Register Write.
+*
+*  Writing the value the shadow holds is skipped. A write to a register
+*  which is still pending replaces the pending value at its position.
+*  The writes are sent by sensor_reg_flush(), or when the batch is full.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_reg_write(VCSensorRegs *regs, U16 addr, U16 value)
+{
+	I32          ee = 0, i;
+	VCRegEntry  *e;
+
+	pthread_mutex_lock(&regs->mutex);
+
+	for(i= 0; i< regs->pendCount; i++)
+	{
+		if(regs->pendAddr[i]==addr)
+		{
+			regs->pendValue[i] = value;
+			regs->coalesceCount++;
+			goto fail;
+		}
+	}
+
+	e = sensor_reg_entry(regs, addr, 0);
+	if((NULL!=e)&&(1==e->validIff1)&&(0==e->volatileIff1)&&(e->value==value))
+	{
+		regs->writeSkipCount++;
+		goto fail;
+	}
+
+	if(regs->pendCount>=VCREG_BATCH_MAX)
+	{
+		ee =  sensor_reg_flush_locked(regs);
+	}
+	regs->pendAddr [regs->pendCount] = addr;
+	regs->pendValue[regs->pendCount] = value;
+	regs->pendCount++;
+
+fail:
+	pthread_mutex_unlock(&regs->mutex);
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sends all queued Register Writes back to back.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_reg_flush(VCSensorRegs *regs)
+{
+	I32  ee;
+
+	pthread_mutex_lock(&regs->mutex);
+	ee =  sensor_reg_flush_locked(regs);
+	pthread_mutex_unlock(&regs->mutex);
+
+	if(ee<0)
+	{
+		syslog(LOG_ERR, "%s():  Writing a Register failed (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Reads several Registers, only the ones unknown are transferred.
+*
+*  Values are taken from the pending writes or the shadow if possible,
+*  except for registers marked by sensor_reg_set_volatile().
+*  The remaining ones are read back to back under one lock.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_reg_read_many(VCSensorRegs *regs, const U16 *addr, U16 *value, I32 count)
+{
+	I32          ee = 0, i, k;
+	VCRegEntry  *e;
+
+	pthread_mutex_lock(&regs->mutex);
+
+	for(i= 0; i< count; i++)
+	{
+		for(k= regs->pendCount-1; (k>=0)&&(regs->pendAddr[k]!=addr[i]); k--);
+		if(k>=0)
+		{
+			value[i] = regs->pendValue[k];
+			regs->readHitCount++;
+			continue;
+		}
+
+		e = sensor_reg_entry(regs, addr[i], 1);
+		if((NULL!=e)&&(1==e->validIff1)&&(0==e->volatileIff1))
+		{
+			value[i] = e->value;
+			regs->readHitCount++;
+			continue;
+		}
+
+		if(sensor_reg_transfer(regs, 0, addr[i], &value[i])<0){ee=-1; break;}
+		if(NULL!=e)
+		{
+			e->value     = value[i];
+			e->validIff1 = 1;
+		}
+	}
+
+	pthread_mutex_unlock(&regs->mutex);
+
+	if(ee<0)
+	{
+		syslog(LOG_ERR, "%s():  Reading Register 0x%x failed (%d(%s))!\n", __FUNCTION__, addr[i], errno, strerror(errno));
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Reads a Register, see sensor_reg_read_many().
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_reg_read(VCSensorRegs *regs, U16 addr, U16 *value)
+{
+	return(sensor_reg_read_many(regs, &addr, value, 1));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Marks a Register the Sensor changes itself, it is always read from the Device.
+*/
+/*-----------------------------------------------------------------------------*/
+void  sensor_reg_set_volatile(VCSensorRegs *regs, U16 addr)
+{
+	VCRegEntry  *e;
+
+	pthread_mutex_lock(&regs->mutex);
+	e = sensor_reg_entry(regs, addr, 1);
+	if(NULL!=e){ e->volatileIff1 = 1; }
+	pthread_mutex_unlock(&regs->mutex);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Forgets all shadowed Values, e.g. after the Sensor was reset.
+*/
+/*-----------------------------------------------------------------------------*/
+void  sensor_reg_invalidate(VCSensorRegs *regs)
+{
+	I32  i;
+
+	pthread_mutex_lock(&regs->mutex);
+	for(i= 0; i< VCREG_SHADOW_SIZE; i++)
+	{
+		regs->shadow[i].validIff1 = 0;
+	}
+	pthread_mutex_unlock(&regs->mutex);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Applies a Register List like "0x11a=0x20,0x11b,0x11c" to a Sensor.
+*
+*  Entries with a value are written as one batch first, then the entries
+*  without are read as one batch and printed.
+*/
+/*-----------------------------------------------------------------------------*/
+int  sensor_reg_apply_list(VCSensorRegs *regs, const char *pcList, I32 camIdx)
+{
+	I32    ee, rc, i, readCount = 0;
+	U16    addr[VCREG_BATCH_MAX], value[VCREG_BATCH_MAX];
+	char  *pcEnd;
+	const char *pc = pcList;
+
+	while(('\0'!=*pc)&&(readCount<VCREG_BATCH_MAX))
+	{
+		U16 a = (U16)strtoul(pc, &pcEnd, 0);
+		if(pcEnd==pc){ee=-1; goto fail;}
+		pc = pcEnd;
+
+		if('='==*pc)
+		{
+			U16 v = (U16)strtoul(pc+1, &pcEnd, 0);
+			if(pcEnd==pc+1){ee=-1; goto fail;}
+			pc = pcEnd;
+
+			rc =  sensor_reg_write(regs, a, v);
+			if(rc<0){ee=-2; goto fail;}
+		}
+		else
+		{
+			addr[readCount++] = a;
+		}
+		if(','==*pc){ pc++; }
+	}
+
+	rc =  sensor_reg_flush(regs);
+	if(rc<0){ee=-2; goto fail;}
+
+	rc =  sensor_reg_read_many(regs, addr, value, readCount);
+	if(rc<0){ee=-3; goto fail;}
+
+	for(i= 0; i< readCount; i++)
+	{
+		printf("Camera %d REG[0x%x] = 0x%x\n", camIdx, addr[i], value[i]);
+	}
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  Malformed register list '%s'!\n", __FUNCTION__, pcList);
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  Could not write the registers of camera %d!\n", __FUNCTION__, camIdx);
+			break;
+		case -3:
+			syslog(LOG_ERR, "%s():  Could not read the registers of camera %d!\n", __FUNCTION__, camIdx);
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Transfers, Shadow Hits and Latencies of the Register Access.
+*/
+/*-----------------------------------------------------------------------------*/
+void  sensor_regs_print_stats(const char *pcName, const VCSensorRegs *regs)
+{
+	printf("  %-22s reads %llu (+%llu from shadow) mean %.1fus worst %.1fus, writes %llu (+%llu unchanged, %llu coalesced, %llu batches) mean %.1fus worst %.1fus, %llu failed.\n", pcName,
+			(unsigned long long)regs->latRead.count,  (unsigned long long)regs->readHitCount,
+			(F32)regs->latRead.sumNS  / 1000 / max(1, regs->latRead.count),  (F32)regs->latRead.maxNS  / 1000,
+			(unsigned long long)regs->latWrite.count, (unsigned long long)regs->writeSkipCount,
+			(unsigned long long)regs->coalesceCount,  (unsigned long long)regs->flushCount,
+			(F32)regs->latWrite.sumNS / 1000 / max(1, regs->latWrite.count), (F32)regs->latWrite.maxNS / 1000,
+			(unsigned long long)regs->errorCount);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Updates a CRC-32 (IEEE 802.3, as zlib) by a Block of Bytes.
+*
+*  Start with crc 0.
+*/
+/*-----------------------------------------------------------------------------*/
+U32  crc32_update(U32 crc, const U8 *p, size_t byteCount)
+{
+	static U32  table[256];
+	static I32  tableIff1 = 0;
+	U32         c;
+	I32         i, k;
+
+	if(0==tableIff1)
+	{
+		for(i= 0; i< 256; i++)
+		{
+			c = i;
+			for(k= 0; k< 8; k++){ c = (c & 1)?(0xEDB88320u ^ (c >> 1)):(c >> 1); }
+			table[i] = c;
+		}
+		tableIff1 = 1;
+	}
+
+	crc = ~crc;
+	while(byteCount--)
+	{
+		crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	}
+
+	return(~crc);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Reads a Range of the SPI Flash of the Module over the Extension Unit.
+*
+*  Each transfer sets the 24 bit address and length and gets up to
+*  VCFLASH_CHUNK bytes back, see VCFLASH_XU_SEL_READ.
+*/
+/*-----------------------------------------------------------------------------*/
+static I32  flash_read(int fd, U32 addr, U8 *dst, U32 byteCount, U32 *transferCount)
+{
+	struct uvc_xu_control_query  query;
+	U8   data[VCFLASH_XU_SIZE];
+	U32  n;
+
+	memset(&query, 0, sizeof(query));
+	query.unit     = VCIMU_XU_UNIT;
+	query.selector = VCFLASH_XU_SEL_READ;
+	query.size     = VCFLASH_XU_SIZE;
+	query.data     = data;
+
+	while(byteCount>0)
+	{
+		n = min(byteCount, (U32)VCFLASH_CHUNK);
+
+		memset(data, 0, sizeof(data));
+		data[0] = 'R';
+		data[1] = (addr >> 16) & 0xFF;
+		data[2] = (addr >>  8) & 0xFF;
+		data[3] = (addr >>  0) & 0xFF;
+		data[4] = n;
+
+		query.query = UVC_SET_CUR;
+		if(ioctl(fd, UVCIOC_CTRL_QUERY, &query)<0){ return(-1); }
+		query.query = UVC_GET_CUR;
+		if(ioctl(fd, UVCIOC_CTRL_QUERY, &query)<0){ return(-1); }
+		(*transferCount)++;
+
+		memcpy(dst, data + VCFLASH_XU_SIZE - VCFLASH_CHUNK, n);
+		dst       += n;
+		addr      += n;
+		byteCount -= n;
+	}
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Reads the USB Serial Number of the Module of a Video Device from sysfs.
+*/
+/*-----------------------------------------------------------------------------*/
+static I32  calib_read_serial(const char *pcVideoDev, char *pcSerial, I32 size)
+{
+	char        acPath[256];
+	const char *pcName = strrchr(pcVideoDev, '/');
+	FILE       *fp;
+	I32         n;
+
+	pcName = (NULL!=pcName)?(pcName+1):(pcVideoDev);
+
+	// device is the UVC interface, the serial belongs to the USB device above it.
+	snprintf(acPath, sizeof(acPath), "/sys/class/video4linux/%s/device/../serial", pcName);
+	fp = fopen(acPath, "r");
+	if(NULL==fp){ return(-1); }
+
+	n = (NULL!=fgets(pcSerial, size, fp))?(strlen(pcSerial)):(0);
+	fclose(fp);
+
+	while((n>0)&&(('\n'==pcSerial[n-1])||(' '==pcSerial[n-1]))){ pcSerial[--n] = '\0'; }
+	for(n= n-1; n>=0; n--)
+	{
+		if(('/'==pcSerial[n])||('.'==pcSerial[n])){ pcSerial[n] = '_'; }
+	}
+
+	return(('\0'!=pcSerial[0])?(0):(-1));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Maps the cached Calibration of a Module, if it matches the Flash Header.
+*
+* @return 0 if mapped, -1 if there is no matching cache.
+*/
+/*-----------------------------------------------------------------------------*/
+static I32  calib_map_cache(VCCalib *cal, const VCCalibHeader *flashHeader)
+{
+	I32                  fd;
+	struct stat          st;
+	const VCCalibCache  *cache;
+
+	fd = open(cal->acCachePath, O_RDONLY);
+	if(fd<0){ return(-1); }
+
+	if((fstat(fd, &st)<0)||((size_t)st.st_size != sizeof(VCCalibCache) + flashHeader->byteCount))
+	{
+		close(fd);
+		return(-1);
+	}
+
+	cal->map      = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	cal->mapBytes = st.st_size;
+	close(fd);
+	if(MAP_FAILED==cal->map){ cal->map = NULL; return(-1); }
+
+	// Same module, same flash contents, and not corrupted on disk.
+	cache = (const VCCalibCache*)cal->map;
+	if(  (VCCALIB_CACHE_MAGIC!=cache->magic)
+	   ||(0!=strncmp(cache->acSerial, cal->acSerial, sizeof(cache->acSerial)))
+	   ||(0!=memcmp(&cache->header, flashHeader, sizeof(VCCalibHeader)))
+	   ||(crc32_update(0, (const U8*)(cache+1), flashHeader->byteCount) != flashHeader->crc))
+	{
+		munmap(cal->map, cal->mapBytes);
+		cal->map = NULL;
+		return(-1);
+	}
+
+	cal->data = (const U8*)(cache+1);
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Writes a Calibration Cache File atomically.
+*
+*  The data goes to a temporary file next to it, which is synced and then
+*  renamed to pcPath. On any error the temporary file is removed again.
+*
+* @return 0, or <0 if the cache could not be written.
+*/
+/*-----------------------------------------------------------------------------*/
+static I32  calib_write_cache(const char *pcPath, const U8 *buf, size_t byteCount)
+{
+	I32   ee, rc, fd = -1;
+	char  acTmpPath[280];
+
+	snprintf(acTmpPath, sizeof(acTmpPath), "%s.%d", pcPath, (int)getpid());
+	fd = open(acTmpPath, O_WRONLY | O_CREAT | O_TRUNC, 00644);
+	if(fd<0){ee=-1; goto fail;}
+
+	if(write(fd, buf, byteCount) != (ssize_t)byteCount){ee=-2; goto fail;}
+
+	rc =  fsync(fd);
+	if(rc<0){ee=-3; goto fail;}
+
+	rc =  close(fd);
+	fd = -1;
+	if(rc<0){ee=-4; goto fail;}
+
+	rc =  rename(acTmpPath, pcPath);
+	if(rc<0){ee=-5; goto fail;}
+
+	ee=0;
+fail:
+	if(fd>=0){ close(fd); }
+	if((ee<0)&&(ee!=-1)){ unlink(acTmpPath); }
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Loads the Calibration stored on the Module, from a local Cache if possible.
+*
+*  This function reads the small calibration header from the SPI flash.
+*  If the cache file of the module's serial number holds the same header,
+*  the cache is memory-mapped and the flash is not read further.
+*  Otherwise the calibration is read from the flash, verified by its
+*  CRC-32, written to the cache file (atomically by rename) and mapped.
+*  If the cache cannot be written, the calibration is kept in memory.
+*
+* @param  pcCacheDir  Directory of the cache files.
+*/
+/*-----------------------------------------------------------------------------*/
+int  calib_load(VCCalib *cal, int fd, const char *pcVideoDev, const char *pcCacheDir)
+{
+	I32            ee, rc;
+	U64            t0 = timestamp_ns();
+	VCCalibHeader  header;
+	VCCalibCache   cache;
+	U8            *buf = NULL;
+
+	memset(cal, 0, sizeof(VCCalib));
+
+	rc =  calib_read_serial(pcVideoDev, cal->acSerial, sizeof(cal->acSerial));
+	if(rc<0){ strcpy(cal->acSerial, "unknown"); }
+	snprintf(cal->acCachePath, sizeof(cal->acCachePath), "%s/vccalib-%s.bin", pcCacheDir, cal->acSerial);
+
+	rc =  flash_read(fd, VCFLASH_CALIB_ADDR, (U8*)&header, sizeof(header), &cal->transferCount);
+	if(rc<0){ee=-1; goto fail;}
+	if((VCCALIB_MAGIC!=header.magic)||(0==header.byteCount)||(header.byteCount>VCCALIB_MAX)){ee=-2; goto fail;}
+
+	cal->byteCount = header.byteCount;
+	cal->crc       = header.crc;
+
+	if(0==calib_map_cache(cal, &header))
+	{
+		cal->fromCacheIff1 = 1;
+		ee=0; goto fail;
+	}
+
+	// Cache missing or stale: read the flash and write a new cache file.
+	buf = malloc(sizeof(VCCalibCache) + header.byteCount);
+	if(NULL==buf){ee=-99; goto fail;}
+
+	rc =  flash_read(fd, VCFLASH_CALIB_ADDR + sizeof(header), buf + sizeof(VCCalibCache), header.byteCount, &cal->transferCount);
+	if(rc<0){ee=-1; goto fail;}
+	if(crc32_update(0, buf + sizeof(VCCalibCache), header.byteCount) != header.crc){ee=-3; goto fail;}
+
+	memset(&cache, 0, sizeof(cache));
+	cache.magic  = VCCALIB_CACHE_MAGIC;
+	cache.header = header;
+	memcpy(cache.acSerial, cal->acSerial, sizeof(cache.acSerial)-1);
+	memcpy(buf, &cache, sizeof(cache));
+
+	rc =  calib_write_cache(cal->acCachePath, buf, sizeof(VCCalibCache) + header.byteCount);
+	if((0==rc)&&(0==calib_map_cache(cal, &header)))
+	{
+		ee=0; goto fail;
+	}
+	syslog(LOG_WARNING, "%s():  Could not write the calibration cache '%s', keeping it in memory.\n", __FUNCTION__, cal->acCachePath);
+
+	cal->buf  = buf;
+	cal->data = buf + sizeof(VCCalibCache);
+	buf       = NULL;
+
+	ee=0;
+fail:
+	if(NULL!=buf){ free(buf); }
+	cal->loadNS = timestamp_ns() - t0;
+
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  Could not read the flash of '%s' (%d(%s))!\n", __FUNCTION__, pcVideoDev, errno, strerror(errno));
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  No calibration in the flash of '%s'!\n", __FUNCTION__, pcVideoDev);
+			break;
+		case -3:
+			syslog(LOG_ERR, "%s():  Checksum of the calibration of '%s' is wrong!\n", __FUNCTION__, pcVideoDev);
+			break;
+		case -99:
+			syslog(LOG_ERR, "%s():  Out of Memory!\n", __FUNCTION__);
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Releases a loaded Calibration.
+*/
+/*-----------------------------------------------------------------------------*/
+void  calib_unload(VCCalib *cal)
+{
+	if(NULL!=cal->map){ munmap(cal->map, cal->mapBytes); }
+	if(NULL!=cal->buf){ free(cal->buf); }
+	cal->map  = NULL;
+	cal->buf  = NULL;
+	cal->data = NULL;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Gets the Stereo Calibration from a File or the Module Calibration.
+*
+*  Both hold a VCStereoCalib as is, little endian.
+*
+* @param  pcSource   "flash" for the calibration of the module, else a file name.
+* @param  moduleCal  Calibration loaded by calib_load().
+*/
+/*-----------------------------------------------------------------------------*/
+int  stereo_calib_get(VCStereoCalib *sc, const char *pcSource, const VCCalib *moduleCal)
+{
+	I32    ee;
+	FILE  *fp = NULL;
+
+	if(0==strcmp(pcSource, "flash"))
+	{
+		if(NULL==moduleCal->data){ee=-1; goto fail;}
+		if(moduleCal->byteCount < sizeof(VCStereoCalib)){ee=-2; goto fail;}
+
+		memcpy(sc, moduleCal->data, sizeof(VCStereoCalib));
+	}
+	else
+	{
+		fp = fopen(pcSource, "rb");
+		if(NULL==fp){ee=-3; goto fail;}
+
+		if(1!=fread(sc, sizeof(VCStereoCalib), 1, fp)){ee=-2; goto fail;}
+	}
+
+	if((VCSTEREO_MAGIC!=sc->magic)||(1!=sc->version)){ee=-4; goto fail;}
+	if((sc->dx<2)||(sc->dy<2)){ee=-5; goto fail;}
+
+	ee=0;
+fail:
+	if(NULL!=fp){ fclose(fp); }
+	switch(ee)
+	{
+		case  0: break;
+		case -1: syslog(LOG_ERR, "%s():  No module calibration loaded (-K)!\n", __FUNCTION__); break;
+		case -2: syslog(LOG_ERR, "%s():  Stereo calibration of '%s' is too short!\n", __FUNCTION__, pcSource); break;
+		case -3: syslog(LOG_ERR, "%s():  Could not open '%s'!\n", __FUNCTION__, pcSource); break;
+		default: syslog(LOG_ERR, "%s():  '%s' holds no stereo calibration (%d)!\n", __FUNCTION__, pcSource, ee); break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns the Bytes from one Pixel to the next within a Colour Channel.
+*
+*  1 for grey and planar RGB images, 3 or 4 for interleaved ones.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  image_pixel_stride(const image *img)
+{
+	switch(img->type)
+	{
+		case VCIMAGE_RGB24:
+		case VCIMAGE_BGR24:   return(3);
+		case VCIMAGE_RGBA32:
+		case VCIMAGE_BGRA32:  return(4);
+		default:              return(1);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns the Addresses of the first Red, Green and Blue Value of an Image.
+*
+*  Grey images return st for all three channels. Together with
+*  image_pixel_stride() and pitch, outputs can read all image layouts
+*  without converting them first.
+*/
+/*-----------------------------------------------------------------------------*/
+void  image_channels(const image *img, U8 **r, U8 **g, U8 **b)
+{
+	U8 *st = (U8*)img->st;
+
+	switch(img->type)
+	{
+		case IMAGE_RGB:       *r = st;   *g = (U8*)img->ccmp1;  *b = (U8*)img->ccmp2;  break;
+		case VCIMAGE_RGB24:
+		case VCIMAGE_RGBA32:  *r = st;   *g = st+1;  *b = st+2;  break;
+		case VCIMAGE_BGR24:
+		case VCIMAGE_BGRA32:  *r = st+2; *g = st+1;  *b = st;    break;
+		default:              *r = st;   *g = st;    *b = st;    break;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copies an Image Buffer to another Image Buffer.
+*
+*  This function copies an image buffer to another image buffer.
+*/
+/*-----------------------------------------------------------------------------*/
+int copy_image(image *in, image *out)
+{
+	return(copy_image_band(in, out, 0, INT_MAX));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copies a Band of Rows of an Image Buffer to another Image Buffer.
+*
+*  This function copies the rows  y0 <= y < y1  of an image buffer
+*  to another image buffer, all color planes are copied within one pass.
+*  An interleaved colour image is copied to a planar IMAGE_RGB one
+*  by deinterleaving the rows.
+*/
+/*-----------------------------------------------------------------------------*/
+int copy_image_band(image *in, image *out, I32 y0, I32 y1)
+{
+	int  ee, x, y;
+	int  dx=min(in->dx,out->dx);
+	int  dy=min(min(in->dy,out->dy), y1);
+	I32  stride = image_pixel_stride(in);
+	U8  *r, *g, *b;
+
+	if((IMAGE_RGB==out->type)&&(stride>1))
+	{
+		image_channels(in, &r, &g, &b);
+		for(y= y0; y< dy; y++)
+		{
+			U8 *outR = (U8*)out->st    + y * out->pitch;
+			U8 *outG = (U8*)out->ccmp1 + y * out->pitch;
+			U8 *outB = (U8*)out->ccmp2 + y * out->pitch;
+			I32 i    = y * in->pitch;
+
+			for(x= 0; x< dx; x++, i+= stride)
+			{
+				outR[x] = r[i];
+				outG[x] = g[i];
+				outB[x] = b[i];
+			}
+		}
+		ee=0; goto fail;
+	}
+
+	if(in->type != out->type) { ee=-1; goto fail; }
+
+	for(y= y0; y< dy; y++)
+	{
+		memcpy((U8*)out->st + y * out->pitch, (U8*)in->st + y * in->pitch, dx * stride);
+		if(IMAGE_RGB==out->type)
+		{
+			memcpy((U8*)out->ccmp1 + y * out->pitch,  (U8*)in->ccmp1 + y * in->pitch, dx);
+			memcpy((U8*)out->ccmp2 + y * out->pitch,  (U8*)in->ccmp2 + y * in->pitch, dx);
+		}
+	}
+
+	ee=0;
+fail:
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Outputs Image Pixels to a Framebuffer Device.
+*
+*  This function outputs Image Pixels to to a framebuffer device.
+*
+* @param  pitch      Bytes per image row.
+* @param  stride     Bytes from one pixel to the next, see image_pixel_stride().
+*/
+/*-----------------------------------------------------------------------------*/
+int  copy_image_to_framebuffer(char *pcFramebufferDev, const void *pvDataGREY_OR_R, const void *pvDataGREY_OR_G, const void *pvDataGREY_OR_B, I32 dy, I32 pitch, I32 stride)
+{
+	I32            rc, ee;
+	VCFramebuffer  fb = NULL_VCFramebuffer;
+
+	rc =  framebuffer_open(pcFramebufferDev, &fb);
+	if(rc<0){ee=rc; goto fail;}
+
+	copy_image_to_framebuffer_band(&fb, pvDataGREY_OR_R, pvDataGREY_OR_G, pvDataGREY_OR_B, dy, pitch, stride, 0, framebuffer_rows(&fb, dy));
+
+	ee=0;
+fail:
+	framebuffer_close(&fb);
+
+	return ee;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Opens and Maps a Framebuffer Device.
+*
+*  This function opens a framebuffer device and maps it to memory.
+*  Close it using framebuffer_close().
+*/
+/*-----------------------------------------------------------------------------*/
+int  framebuffer_open(char *pcFramebufferDev, VCFramebuffer *fb)
+{
+	I32  rc, ee;
+
+	fb->fd = -1;
+	fb->st = NULL;
+
+	// Open the framebuffer for reading and writing
+	{
+		fb->fd =  open(pcFramebufferDev, O_RDWR);
+		if(fb->fd<0){ee=-1; goto fail;}
+	}
+
+	// Get framebuffer information
+	{
+		// Variable information
+		rc =  ioctl(fb->fd, FBIOGET_VSCREENINFO, &fb->vars  );
+		if(rc<0){ee=-2+10*rc; goto fail;}
+
+		// Constant information
+		rc =  ioctl(fb->fd, FBIOGET_FSCREENINFO, &fb->consts);
+		if(rc<0){ee=-3+10*rc; goto fail;}
+	}
+
+	// Map the framebuffer to memory
+	{
+		fb->byteCount = fb->vars.xres * fb->vars.yres * fb->vars.bits_per_pixel / 8;
+
+		fb->st =  mmap(NULL, fb->byteCount, PROT_READ | PROT_WRITE, MAP_SHARED, fb->fd, 0);
+		if(MAP_FAILED==fb->st){ fb->st = NULL; ee=-4; goto fail;}
+	}
+
+	ee=0;
+fail:
+	return ee;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Unmaps and Closes a Framebuffer Device.
+*/
+/*-----------------------------------------------------------------------------*/
+int  framebuffer_close(VCFramebuffer *fb)
+{
+	if(NULL!=fb->st){  munmap(fb->st, fb->byteCount);  fb->st = NULL; }
+	if(fb->fd>=0   ){  close(fb->fd);                  fb->fd = -1;   }
+
+	return 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns the Count of Framebuffer Rows written for an Image.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  framebuffer_rows(VCFramebuffer *fb, I32 dy)
+{
+	return(min((I32)fb->vars.yres, dy));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Probes the Instruction Set Extensions of the running CPU.
+*
+*  cpuid on x86, which also checks that the system saves the AVX
+*  registers, the auxiliary vector of the kernel on ARM.
+*
+* @return VCCPU_xxx flags.
+*/
+/*-----------------------------------------------------------------------------*/
+U32  cpu_features(void)
+{
+	U32  features = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("ssse3")){ features |= VCCPU_SSSE3; }
+	if(__builtin_cpu_supports("avx2" )){ features |= VCCPU_AVX2;  }
+#elif defined(__aarch64__)
+	if(0!=(getauxval(AT_HWCAP) & HWCAP_ASIMD   )){ features |= VCCPU_ASIMD; }
+#elif defined(__arm__)
+	if(0!=(getauxval(AT_HWCAP) & HWCAP_ARM_NEON)){ features |= VCCPU_NEON;  }
+#endif
+
+	return(features);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Unpack Kernel, scalar: One Line from RAW10 to 8 Bit, see FL_CPY_RAW10P_U8P_NOOFFS().
+*/
+/*-----------------------------------------------------------------------------*/
+static void  kernel_unpack_scalar(U32 count, char *bufIn, U8 *bufOut)
+{
+	FL_CPY_RAW10P_U8P_NOOFFS(count, bufIn, bufOut);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Debayer Kernel, scalar: A Pair of Bayer Rows to planar RGB.
+*
+*  Each 2x2 cell becomes 2x2 pixels of its red, blue and the green of
+*  the same row, see simple_debayer_to_image_band().
+*/
+/*-----------------------------------------------------------------------------*/
+static void  kernel_debayer_scalar(const U8 *in0, const U8 *in1, U8 *r0, U8 *r1, U8 *g0, U8 *g1, U8 *b0, U8 *b1, I32 dx)
+{
+	I32  x;
+
+	for(x= 0; x< dx; x+=2)
+	{
+		r0[x] = in0[x];    r0[x+1] = in0[x];
+		g0[x] = in0[x+1];  g0[x+1] = in0[x+1];
+		g1[x] = in1[x];    g1[x+1] = in1[x];
+		b1[x] = in1[x+1];  b1[x+1] = in1[x+1];
+	}
+	memcpy(r1, r0, dx);
+	memcpy(b0, b1, dx);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copy Kernel, scalar: Copies a Block of a Capture Buffer.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  kernel_copy_scalar(U8 *dst, const U8 *src, size_t byteCount)
+{
+	memcpy(dst, src, byteCount);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Pack Kernel, scalar: Planar Red, Green and Blue to 32 Bit Framebuffer Pixels.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  kernel_pack_scalar(U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count)
+{
+	I32  x;
+
+	for(x= 0; x< count; x++)
+	{
+		out[x] = ((U32)r[x] << 16) | ((U32)g[x] << 8) | ((U32)b[x] << 0);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Resize Kernel, scalar: Packs every step-th Pixel, see kernel_pack_scalar().
+*/
+/*-----------------------------------------------------------------------------*/
+static void  kernel_resize_scalar(U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count, I32 step)
+{
+	I32  x;
+
+	for(x= 0; x< count; x++)
+	{
+		out[x] = ((U32)r[x*step] << 16) | ((U32)g[x*step] << 8) | ((U32)b[x*step] << 0);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Unpack Kernel, vectorized: 12 Pixels of three RAW10 Groups per Shuffle.
+*
+*  The 16 byte load reads one byte past the three groups and the 16 byte
+*  store four pixels past them, which the next store overwrites, so both
+*  stay inside the line while at least 16 pixels are left.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  kernel_unpack_vec(U32 count, char *bufIn, U8 *bufOut)
+{
+	const VCVec16b  pick = { 0, 1, 2, 3,  5, 6, 7, 8,  10, 11, 12, 13,  15, 15, 15, 15 };
+	VCVec16b        v;
+
+	while(count >= 16)
+	{
+		memcpy(&v, bufIn, 16);
+		v = __builtin_shuffle(v, pick);
+		memcpy(bufOut, &v, 16);
+
+		bufIn  += 15;
+		bufOut += 12;
+		count  -= 12;
+	}
+	FL_CPY_RAW10P_U8P_NOOFFS(count, bufIn, bufOut);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Debayer Kernel, vectorized: 16 Pixels of a Pair of Rows per Iteration.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  kernel_debayer_vec(const U8 *in0, const U8 *in1, U8 *r0, U8 *r1, U8 *g0, U8 *g1, U8 *b0, U8 *b1, I32 dx)
+{
+	const VCVec16b  even = { 0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14 };
+	const VCVec16b  odd  = even + 1;
+	VCVec16b        v, w, r, b;
+	I32             x;
+
+	for(x= 0; x+16 <= dx; x+= 16)
+	{
+		memcpy(&v, in0 + x, 16);
+		memcpy(&w, in1 + x, 16);
+
+		r = __builtin_shuffle(v, even);
+		b = __builtin_shuffle(w, odd);
+		v = __builtin_shuffle(v, odd);
+		w = __builtin_shuffle(w, even);
+
+		memcpy(r0 + x, &r, 16);  memcpy(r1 + x, &r, 16);
+		memcpy(g0 + x, &v, 16);  memcpy(g1 + x, &w, 16);
+		memcpy(b0 + x, &b, 16);  memcpy(b1 + x, &b, 16);
+	}
+	if(x < dx)
+	{
+		kernel_debayer_scalar(in0 + x, in1 + x, r0 + x, r1 + x, g0 + x, g1 + x, b0 + x, b1 + x, dx - x);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copy Kernel, vectorized: 64 Bytes per Iteration with Prefetching.
+*
+*  Reads 64 bytes per iteration as four 16 byte vectors and prefetches
+*  VCINGEST_PREFETCH bytes ahead, so uncached or write-combined memory is
+*  read in bursts rather than by the byte and 4 byte loads of the converters.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  kernel_copy_vec(U8 *dst, const U8 *src, size_t byteCount)
+{
+	VCVec16b  v0, v1, v2, v3;
+	size_t    i;
+
+	for(i= 0; i+64 <= byteCount; i+= 64)
+	{
+		__builtin_prefetch(src + i + VCINGEST_PREFETCH, 0, 0);
+
+		memcpy(&v0, src + i +  0, 16);
+		memcpy(&v1, src + i + 16, 16);
+		memcpy(&v2, src + i + 32, 16);
+		memcpy(&v3, src + i + 48, 16);
+
+		memcpy(dst + i +  0, &v0, 16);
+		memcpy(dst + i + 16, &v1, 16);
+		memcpy(dst + i + 32, &v2, 16);
+		memcpy(dst + i + 48, &v3, 16);
+	}
+	memcpy(dst + i, src + i, byteCount - i);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Stores 16 Pixels of Red, Green and Blue as 32 Bit Framebuffer Pixels.
+*
+*  Blue and green, then red and zero are interleaved to pairs, the pairs
+*  to the bytes B, G, R, 0 of four pixels per store.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  kernel_store_xrgb(U32 *out, VCVec16b r, VCVec16b g, VCVec16b b)
+{
+	const VCVec16b  lo   = { 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23 };
+	const VCVec16b  hi   = lo + 8;
+	const VCVec16b  quad = { 0, 1, 16, 17, 2, 3, 18, 19, 4, 5, 20, 21, 6, 7, 22, 23 };
+	const VCVec16b  zero = { 0 };
+	VCVec16b        bg, rz, o;
+
+	bg = __builtin_shuffle(b, g,    lo);
+	rz = __builtin_shuffle(r, zero, lo);
+	o  = __builtin_shuffle(bg, rz, quad    );  memcpy(out +  0, &o, 16);
+	o  = __builtin_shuffle(bg, rz, quad + 8);  memcpy(out +  4, &o, 16);
+
+	bg = __builtin_shuffle(b, g,    hi);
+	rz = __builtin_shuffle(r, zero, hi);
+	o  = __builtin_shuffle(bg, rz, quad    );  memcpy(out +  8, &o, 16);
+	o  = __builtin_shuffle(bg, rz, quad + 8);  memcpy(out + 12, &o, 16);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Pack Kernel, vectorized: 16 Pixels per Iteration, see kernel_store_xrgb().
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  kernel_pack_vec(U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count)
+{
+	VCVec16b  vr, vg, vb;
+	I32       x;
+
+	for(x= 0; x+16 <= count; x+= 16)
+	{
+		memcpy(&vr, r + x, 16);
+		memcpy(&vg, g + x, 16);
+		memcpy(&vb, b + x, 16);
+		kernel_store_xrgb(out + x, vr, vg, vb);
+	}
+	kernel_pack_scalar(out + x, r + x, g + x, b + x, count - x);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Resize Kernel, vectorized: Halves by Shuffles, other Steps scalar.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  kernel_resize_vec(U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count, I32 step)
+{
+	const VCVec16b  even = { 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30 };
+	VCVec16b        v0, v1, vr, vg, vb;
+	I32             x = 0;
+
+	if(2==step)
+	{
+		for(x= 0; x+16 <= count; x+= 16)
+		{
+			memcpy(&v0, r + 2*x, 16);  memcpy(&v1, r + 2*x + 16, 16);  vr = __builtin_shuffle(v0, v1, even);
+			memcpy(&v0, g + 2*x, 16);  memcpy(&v1, g + 2*x + 16, 16);  vg = __builtin_shuffle(v0, v1, even);
+			memcpy(&v0, b + 2*x, 16);  memcpy(&v1, b + 2*x + 16, 16);  vb = __builtin_shuffle(v0, v1, even);
+			kernel_store_xrgb(out + x, vr, vg, vb);
+		}
+	}
+	kernel_resize_scalar(out + x, r + x*step, g + x*step, b + x*step, count - x, step);
+}
+
+
+// The vectorized kernels compiled for each instruction set of
+// VCKERNEL_ISA_LIST, and the registry of all variants, best first.
+#define  VCKERNEL_INSTANCE(isa, pcTarget, cpuMask)                                                                   \
+static __attribute__((target(pcTarget))) void  kernel_unpack_##isa(U32 count, char *bufIn, U8 *bufOut)               \
+{                                                                                                                    \
+	kernel_unpack_vec(count, bufIn, bufOut);                                                                         \
+}                                                                                                                    \
+static __attribute__((target(pcTarget))) void  kernel_debayer_##isa(const U8 *in0, const U8 *in1, U8 *r0, U8 *r1, U8 *g0, U8 *g1, U8 *b0, U8 *b1, I32 dx) \
+{                                                                                                                    \
+	kernel_debayer_vec(in0, in1, r0, r1, g0, g1, b0, b1, dx);                                                        \
+}                                                                                                                    \
+static __attribute__((target(pcTarget))) void  kernel_copy_##isa(U8 *dst, const U8 *src, size_t byteCount)          \
+{                                                                                                                    \
+	kernel_copy_vec(dst, src, byteCount);                                                                            \
+}                                                                                                                    \
+static __attribute__((target(pcTarget))) void  kernel_pack_##isa(U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count) \
+{                                                                                                                    \
+	kernel_pack_vec(out, r, g, b, count);                                                                            \
+}                                                                                                                    \
+static __attribute__((target(pcTarget))) void  kernel_resize_##isa(U32 *out, const U8 *r, const U8 *g, const U8 *b, I32 count, I32 step) \
+{                                                                                                                    \
+	kernel_resize_vec(out, r, g, b, count, step);                                                                    \
+}
+
+#define  VCKERNEL_ENTRIES(isa, pcTarget, cpuMask)                        \
+	{ VCKERNEL_UNPACK,  #isa, cpuMask, (VCKernelFn)kernel_unpack_##isa  }, \
+	{ VCKERNEL_DEBAYER, #isa, cpuMask, (VCKernelFn)kernel_debayer_##isa }, \
+	{ VCKERNEL_COPY,    #isa, cpuMask, (VCKernelFn)kernel_copy_##isa    }, \
+	{ VCKERNEL_PACK,    #isa, cpuMask, (VCKernelFn)kernel_pack_##isa    }, \
+	{ VCKERNEL_RESIZE,  #isa, cpuMask, (VCKernelFn)kernel_resize_##isa  },
+
+VCKERNEL_ISA_LIST(VCKERNEL_INSTANCE)
+
+static const VCKernelVariant  kernelTable[] =
+{
+	VCKERNEL_ISA_LIST(VCKERNEL_ENTRIES)
+	{ VCKERNEL_UNPACK,  "scalar", 0, (VCKernelFn)kernel_unpack_scalar  },
+	{ VCKERNEL_DEBAYER, "scalar", 0, (VCKernelFn)kernel_debayer_scalar },
+	{ VCKERNEL_COPY,    "scalar", 0, (VCKernelFn)kernel_copy_scalar    },
+	{ VCKERNEL_PACK,    "scalar", 0, (VCKernelFn)kernel_pack_scalar    },
+	{ VCKERNEL_RESIZE,  "scalar", 0, (VCKernelFn)kernel_resize_scalar  },
+};
+
+// Scalar until kernels_bind() ran.
+static VCKernels  kernels = { kernel_unpack_scalar, kernel_debayer_scalar, kernel_copy_scalar, kernel_pack_scalar, kernel_resize_scalar,
+                              { "scalar", "scalar", "scalar", "scalar", "scalar" }, 0 };
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Binds each Kernel to the best Variant the CPU supports.
+*
+*  Called once at startup, before any thread uses the kernels.
+*
+* @param  scalarIff1  Binds the scalar variants, to verify the others against.
+*/
+/*-----------------------------------------------------------------------------*/
+void  kernels_bind(I32 scalarIff1)
+{
+	const VCKernelVariant  *v;
+	I32                     k, i;
+
+	kernels.cpuFeatures = cpu_features();
+
+	for(k= 0; k< VCKERNEL_COUNT; k++)
+	{
+		for(i= 0; i< (I32)(sizeof(kernelTable) / sizeof(kernelTable[0])); i++)
+		{
+			v = &kernelTable[i];
+			if(v->kernel!=k){ continue; }
+			if((1==scalarIff1)&&(0!=strcmp(v->pcVariant, "scalar"))){ continue; }
+			if(v->cpuMask != (v->cpuMask & kernels.cpuFeatures)){ continue; }
+
+			switch(k)
+			{
+				case VCKERNEL_UNPACK:   kernels.unpack  = (void (*)(U32, char*, U8*))v->fn;  break;
+				case VCKERNEL_DEBAYER:  kernels.debayer = (void (*)(const U8*, const U8*, U8*, U8*, U8*, U8*, U8*, U8*, I32))v->fn;  break;
+				case VCKERNEL_COPY:     kernels.copy    = (void (*)(U8*, const U8*, size_t))v->fn;  break;
+				case VCKERNEL_PACK:     kernels.pack    = (void (*)(U32*, const U8*, const U8*, const U8*, I32))v->fn;  break;
+				case VCKERNEL_RESIZE:   kernels.resize  = (void (*)(U32*, const U8*, const U8*, const U8*, I32, I32))v->fn;  break;
+			}
+			kernels.pcVariant[k] = v->pcVariant;
+			break;
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the CPU Features found and the Variant bound to each Kernel.
+*/
+/*-----------------------------------------------------------------------------*/
+void  kernels_print(void)
+{
+	char  acFeatures[64] = "";
+	I32   i;
+
+	for(i= 0; i< VCCPU_COUNT; i++)
+	{
+		if(0!=(kernels.cpuFeatures & (1u<<i)))
+		{
+			strncat(acFeatures, " ",            sizeof(acFeatures) - strlen(acFeatures) - 1);
+			strncat(acFeatures, cpuFeatureName[i], sizeof(acFeatures) - strlen(acFeatures) - 1);
+		}
+	}
+
+	printf("CPU features:%s. Kernels: unpack %s, debayer %s, copy %s, pack %s, resize %s.\n", ('\0'!=acFeatures[0])?(acFeatures):(" none"),
+			kernels.pcVariant[VCKERNEL_UNPACK], kernels.pcVariant[VCKERNEL_DEBAYER], kernels.pcVariant[VCKERNEL_COPY],
+			kernels.pcVariant[VCKERNEL_PACK],   kernels.pcVariant[VCKERNEL_RESIZE]);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Outputs a Band of Image Rows to a mapped Framebuffer.
+*
+*  This function writes the framebuffer rows  y0 <= y < y1,
+*  the image is approx. scaled down to the framebuffer size.
+*  The channels are read in place, planar or interleaved by stride.
+*  A VCIMAGE_BGRA32 image of the framebuffer width is copied row by row.
+*/
+/*-----------------------------------------------------------------------------*/
+void  copy_image_to_framebuffer_band(VCFramebuffer *fb, const void *pvDataGREY_OR_R, const void *pvDataGREY_OR_G, const void *pvDataGREY_OR_B, I32 dy, I32 pitch, I32 stride, I32 y0, I32 y1)
+{
+	U8   *pInR   = NULL, *pInG   = NULL, *pInB   = NULL;
+	U8   *pOut   = NULL;
+	I32   x, y, scaler;
+	I32   dx     = pitch / stride;
+
+	// Approx. scale up/down to framebuffer size.
+	scaler =  max(1,  min(dx/(I32)fb->vars.xres, dy/(I32)fb->vars.yres));
+
+	// Same layout as the framebuffer: B, G, R, X.
+	if((4==stride)&&(1==scaler)&&(32==fb->vars.bits_per_pixel)&&((U8*)pvDataGREY_OR_B + 2 == (U8*)pvDataGREY_OR_R))
+	{
+		for(y = y0; y < min(y1, framebuffer_rows(fb, dy)); y++)
+		{
+			memcpy(fb->st + (y + fb->vars.yoffset) * fb->consts.line_length + fb->vars.xoffset * 4,
+			       (U8*)pvDataGREY_OR_B + y * pitch, 4 * min((I32)fb->vars.xres, dx));
+		}
+		return;
+	}
+
+	// Planar: pack or resize a row per kernel call.
+	if((1==stride)&&(32==fb->vars.bits_per_pixel))
+	{
+		for(y = y0; y < min(y1, framebuffer_rows(fb, dy)); y++)
+		{
+			size_t  o   = (size_t)(scaler * y) * pitch;
+			U32    *out = (U32*)(fb->st + (y + fb->vars.yoffset) * fb->consts.line_length + fb->vars.xoffset * 4);
+
+			if(1==scaler){ kernels.pack(  out, (U8*)pvDataGREY_OR_R + o, (U8*)pvDataGREY_OR_G + o, (U8*)pvDataGREY_OR_B + o, min((I32)fb->vars.xres, dx));         }
+			else         { kernels.resize(out, (U8*)pvDataGREY_OR_R + o, (U8*)pvDataGREY_OR_G + o, (U8*)pvDataGREY_OR_B + o, min((I32)fb->vars.xres, dx), scaler); }
+		}
+		return;
+	}
+
+	// Write pixel per pixel (slow)
+	for(y = y0; y < min(y1, framebuffer_rows(fb, dy)); y++)
+	{
+		pInR = ((U8*)pvDataGREY_OR_R) + (scaler * y) * pitch;
+		pInG = ((U8*)pvDataGREY_OR_G) + (scaler * y) * pitch;
+		pInB = ((U8*)pvDataGREY_OR_B) + (scaler * y) * pitch;
+		pOut =       fb->st  + (y + fb->vars.yoffset) * fb->consts.line_length
+		                     +      fb->vars.xoffset  * fb->vars.bits_per_pixel/8;
+
+		for(x = 0; x < min((I32)fb->vars.xres, dx); x++)
+		{
+			*((U32*) pOut) = ((*pInR) << 16) | ((*pInG) << 8) | ((*pInB) << 0);
+
+			pInR += scaler * stride;
+			pInG += scaler * stride;
+			pInB += scaler * stride;
+			pOut += fb->vars.bits_per_pixel/8;
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sets up the ASCII View at stdout.
+*
+*  Fills the lookup tables of the brightness ramp and the ANSI colours,
+*  the buffer is allocated by the first refresh. stdout not being a
+*  terminal leaves ttyIff1 cleared.
+*/
+/*-----------------------------------------------------------------------------*/
+void  preview_init(VCPreview *pv)
+{
+	I32  v;
+
+	for(v= 0; v< 256; v++)
+	{
+		pv->ramp[v] =  (v< 40)?(' ')
+		              :(v< 89)?('-')
+		              :(v<138)?('+')
+		              :(v<178)?('*')
+		              :(v<216)?('X')
+		              :(        '#');
+
+		// Nearest of the 24 greys 8..238 or black and white, nearest
+		// of the cube levels 0, 95, 135, 175, 215 and 255.
+		pv->grey[v] = (v<3)?(16):(v>246)?(231):(232 + min((v - 3) / 10, 23));
+		pv->cube[v] = (v<48)?(0):(v<115)?(1):((v - 35) / 40);
+		snprintf(pv->acNum[v], sizeof(pv->acNum[v]), "%d", v);
+	}
+
+	pv->ttyIff1    = (1==isatty(STDOUT_FILENO))?(1):(0);
+	pv->buf        = NULL;
+	pv->bufSize    = 0;
+	pv->lines      = 0;
+	pv->nextNS     = 0;
+	pv->frameCount = 0;
+	pv->skipCount  = 0;
+	pv->byteCount  = 0;
+	memset(&pv->latRender, 0, sizeof(VCLatencyStats));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Frees the Buffer of the ASCII View.
+*/
+/*-----------------------------------------------------------------------------*/
+void  preview_destroy(VCPreview *pv)
+{
+	free(pv->buf);
+	pv->buf     = NULL;
+	pv->bufSize = 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Appends a String to the Buffer of the ASCII View.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline char  *preview_put(char *p, const char *pcStr)
+{
+	while('\0'!=*pcStr){ *p++ = *pcStr++; }
+
+	return(p);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Appends a Border Line of the ASCII View.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline char  *preview_put_border(char *p, const char *pcLeft, const char *pcRight, I32 width)
+{
+	p = preview_put(p, pcLeft);
+	memset(p, '=', width);
+	p = preview_put(p + width, pcRight);
+
+	return(p);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Draws an Image as ASCII View to stdout.
+*
+*  The whole view is built in one buffer, each character a lookup of
+*  the brightness ramp, colour changes only where the colour changes,
+*  and goes out with a single write(). The cursor moves back up to
+*  overwrite the last view, which works only as long as no other lines
+*  are printed in between. Refreshes closer than periodMS are skipped.
+*
+* @return 1 if drawn, 0 if skipped.
+*/
+/*-----------------------------------------------------------------------------*/
+int  preview_render(VCPreview *pv, const image *img)
+{
+	U8       *pr, *pg, *pb;
+	const U8 *r, *g, *b;
+	I32       stride = image_pixel_stride(img);
+	I32       colourIff1 = (IMAGE_GREY!=img->type)?(1):(0);
+	I32       samples, step, width, lines, lineStep, x, y, o, o2, luma, fg, bg, fgLast, bgLast;
+	size_t    need, len, n;
+	ssize_t   rc;
+	char     *p;
+	U64       now = timestamp_ns();
+
+	if((0==pv->ttyIff1)||(now < pv->nextNS)){ pv->skipCount++; return(0); }
+	pv->nextNS = now + (U64)pv->periodMS * 1000000;
+
+	// Square samples: two characters of a sample, or half a character
+	// each with half blocks, in cols characters or every 50th pixel.
+	samples  = (VCPREVIEW_HALF==pv->mode)?(pv->cols):(pv->cols / 2);
+	step     = (samples>0)?((img->dx + samples - 1) / samples):((VCPREVIEW_HALF==pv->mode)?(25):(50));
+	step     = max(step, 1);
+	samples  = (img->dx + step - 1) / step;
+	width    = (VCPREVIEW_HALF==pv->mode)?(samples):(2 * samples);
+	lineStep = (VCPREVIEW_HALF==pv->mode)?(2 * step):(step);
+	lines    = (img->dy + lineStep - 1) / lineStep;
+
+	need = 16 + (size_t)(lines + 2) * (16 + (size_t)samples * VCPREVIEW_CELL_MAX);
+	if(need > pv->bufSize)
+	{
+		free(pv->buf);
+		pv->buf     = malloc(need);
+		pv->bufSize = (NULL!=pv->buf)?(need):(0);
+		if(NULL==pv->buf){ return(-1); }
+	}
+
+	image_channels(img, &pr, &pg, &pb);
+
+	p = pv->buf;
+	if(pv->lines>0){ p += sprintf(p, "\033[%dA", pv->lines); }
+	p = preview_put_border(p, "//", "\\\\\n", width);
+
+	for(y= 0; y< img->dy; y+= lineStep)
+	{
+		r  = pr + (size_t)y * img->pitch;
+		g  = pg + (size_t)y * img->pitch;
+		b  = pb + (size_t)y * img->pitch;
+		o2 = (y + step < img->dy)?(step * img->pitch):(-1);
+		fgLast = -1;
+		bgLast = -1;
+
+		*p++ = '|';
+		*p++ = '|';
+		for(x= 0, o= 0; x< img->dx; x+= step, o+= step * stride)
+		{
+			fg = (1==colourIff1)?(16 + 36 * pv->cube[r[o]] + 6 * pv->cube[g[o]] + pv->cube[b[o]]):(pv->grey[r[o]]);
+
+			switch(pv->mode)
+			{
+				case VCPREVIEW_HALF:
+					// Upper half the sample of this row, lower half the one below.
+					if(o2<0)              { bg = 16; }
+					else if(1==colourIff1){ bg = 16 + 36 * pv->cube[r[o+o2]] + 6 * pv->cube[g[o+o2]] + pv->cube[b[o+o2]]; }
+					else                  { bg = pv->grey[r[o+o2]]; }
+
+					if((fg!=fgLast)||(bg!=bgLast))
+					{
+						p = preview_put(p, "\033[");
+						if(fg!=fgLast){ p = preview_put(p, "38;5;");  p = preview_put(p, pv->acNum[fg]); }
+						if((fg!=fgLast)&&(bg!=bgLast)){ *p++ = ';'; }
+						if(bg!=bgLast){ p = preview_put(p, "48;5;");  p = preview_put(p, pv->acNum[bg]); }
+						*p++ = 'm';
+						fgLast = fg;
+						bgLast = bg;
+					}
+					p = preview_put(p, "\xe2\x96\x80");
+					break;
+				case VCPREVIEW_COLOUR:
+					if(fg!=fgLast)
+					{
+						p = preview_put(p, "\033[38;5;");
+						p = preview_put(p, pv->acNum[fg]);
+						*p++ = 'm';
+						fgLast = fg;
+					}
+					// fall through
+				default:
+					luma = (1==colourIff1)?((77 * r[o] + 150 * g[o] + 29 * b[o]) >> 8):(r[o]);
+					*p++ = pv->ramp[luma];
+					*p++ = pv->ramp[luma];
+					break;
+			}
+		}
+		if(VCPREVIEW_ASCII!=pv->mode){ p = preview_put(p, "\033[0m"); }
+		p = preview_put(p, "||\n");
+	}
+
+	p   = preview_put_border(p, "\\\\", "//\n", width);
+	len = p - pv->buf;
+
+	// Lines printf()ed before go out first.
+	fflush(stdout);
+	for(n= 0; n< len; )
+	{
+		rc = write(STDOUT_FILENO, pv->buf + n, len - n);
+		if(rc<0)
+		{
+			if(EINTR==errno){ continue; }
+			return(-2);
+		}
+		n += rc;
+	}
+
+	pv->lines      = lines + 2;
+	pv->frameCount++;
+	pv->byteCount += len;
+	latency_stats_add(&pv->latRender, timestamp_ns() - now);
+
+	return(1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Refreshes and Render Time of the ASCII View.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  preview_print_stats(const char *pcName, VCPreview *pv)
+{
+	I32  lines = latency_stats_print(pcName, &pv->latRender);
+
+	printf("  %-22s %8llu Refreshes, %llu frames skipped, %s, %.1f KB per refresh.\n", pcName,
+			(unsigned long long)pv->frameCount, (unsigned long long)pv->skipCount,
+			(VCPREVIEW_HALF==pv->mode)?("half blocks"):(VCPREVIEW_COLOUR==pv->mode)?("256 colours"):("ascii"),
+			(F64)pv->byteCount / 1024 / max(1, pv->frameCount));
+
+	return(lines + 1);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts One Line from RAW10 to 8 Bit through a Tone Mapping LUT.
+*
+*  This function decodes the full 10 bit value of each pixel and maps it
+*  through the 1024 entry lut instead of keeping the upper 8 bits only.
+*  The lut stays in L1 cache, the four results of a group are assembled
+*  in a register and stored at once (little endian), like the plain copy.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  FL_CPY_RAW10P_U8P_NOOFFS_LUT(U32 count, char *bufIn, U8 *bufOut, const U8 *lut)
+{
+	U32  lo;
+	U8  *in = (U8*)bufIn;
+
+	while(count >= 4)
+	{
+		lo = in[4];
+		*((U32*)bufOut) =  ((U32)lut[((U32)in[0] << 2) | ((lo     ) & 3)]      )
+		                 | ((U32)lut[((U32)in[1] << 2) | ((lo >> 2) & 3)] <<  8)
+		                 | ((U32)lut[((U32)in[2] << 2) | ((lo >> 4) & 3)] << 16)
+		                 | ((U32)lut[((U32)in[3] << 2) | ((lo >> 6) & 3)] << 24);
+		in+=5;
+		bufOut+=4;
+
+		count -= 4;
+	}
+
+	while(count--)
+	{
+		*bufOut = lut[(U32)(*in) << 2];
+		in++;
+		bufOut++;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts One Line from RAW10 to 8 Bit Grey Value and accumulates Statistics.
+*
+*  This function does the same as FL_CPY_RAW10P_U8P_NOOFFS(), or maps the
+*  pixels through lut like FL_CPY_RAW10P_U8P_NOOFFS_LUT() if it is not NULL,
+*  but also decodes the full 10 bit values of each group of four pixels while
+*  it is in registers. Only the histogram and the squared differences of the
+*  upper 8 bits to the same-colour neighbours left and above are accumulated
+*  per pixel, everything else is derived from the histogram by frame_stats_reduce().
+*
+* @param  bufInPrev  RAW10 data stats->step rows above, NULL for the first rows.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  FL_CPY_RAW10P_U8P_NOOFFS_STATS(U32 count, char *bufIn, const char *bufInPrev, U8 *bufOut, const U8 *lut, VCFrameStats *stats)
+{
+	U32  x, k, lo, v;
+	I32  d, step = stats->step;
+	U32  grad = 0;
+	U32 *hist = stats->hist;
+	U8  *in   = (U8*)bufIn;
+	U8   left[4+2] = {0};   /*!<  Upper 8 Bits of the two previous and the current Pixels. */
+
+	for(x= 0; x+4 <= count; x+= 4)
+	{
+		lo = in[4];
+		left[0] = left[4];
+		left[1] = left[5];
+
+		for(k= 0; k< 4; k++)
+		{
+			v = ((U32)in[k] << 2) | ((lo >> (2*k)) & 3);
+			hist[v]++;
+			bufOut[x+k] = (NULL!=lut)?(lut[v]):(in[k]);
+
+			left[2+k] = in[k];
+			if(x+k >= step){ d = (I32)in[k] - left[2+k-step]; grad += d*d; }
+		}
+		if(NULL!=bufInPrev)
+		{
+			for(k= 0; k< 4; k++)
+			{
+				d = (I32)in[k] - (U8)bufInPrev[k]; grad += d*d;
+			}
+			bufInPrev+=5;
+		}
+
+		in+=5;
+	}
+
+	// Incomplete group: lower bits are unknown.
+	for(; x< count; x++)
+	{
+		v = (U32)(*in) << 2;
+		hist[v]++;
+		bufOut[x] = (NULL!=lut)?(lut[v]):(*in);
+
+		if(x >= step){ d = (I32)*in - in[-step - ((x%4 < (U32)step)?(1):(0))]; grad += d*d; }  // Skip the lower bits byte.
+		if(NULL!=bufInPrev){ d = (I32)*in - (U8)(*bufInPrev); grad += d*d; bufInPrev++; }
+
+		in++;
+	}
+
+	stats->gradientEnergy += grad;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Accumulates Statistics of an 8 Bit Line.
+*
+*  The 8 bit values are counted as 10 bit values with zero lower bits.
+*
+* @param  rowPrev  Line stats->step rows above, NULL for the first rows.
+*/
+/*-----------------------------------------------------------------------------*/
+void  frame_stats_add_row_u8(VCFrameStats *stats, const U8 *row, const U8 *rowPrev, U32 count)
+{
+	U32  x;
+	I32  d, step = stats->step;
+	U32  grad = 0;
+	U32 *hist = stats->hist;
+
+	for(x= 0; x< count; x++)
+	{
+		hist[(U32)row[x] << 2]++;
+
+		if(x >= step)      { d = (I32)row[x] - row[x-step];  grad += d*d; }
+		if(NULL!=rowPrev)  { d = (I32)row[x] - rowPrev[x];   grad += d*d; }
+	}
+
+	stats->gradientEnergy += grad;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Resets Frame Statistics before Accumulation.
+*
+* @param  step        Distance of same-colour neighbours: 1 for grey, 2 for Bayer images.
+* @param  saturation  Value counted as saturated: 1023 for 10 bit, 1020 for 8 bit formats.
+*/
+/*-----------------------------------------------------------------------------*/
+void  frame_stats_reset(VCFrameStats *stats, I32 step, U32 saturation)
+{
+	memset(stats, 0, sizeof(VCFrameStats));
+	stats->step    = step;
+	stats->maximum = saturation;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Adds the Statistics of a Band to those of the Frame.
+*
+*  After the last band, count, sum, minimum, maximum and saturated pixels
+*  are derived from the histogram, mean (10 bit scale) and sharpness
+*  (mean squared gradient) from those. The maximum given to
+*  frame_stats_reset() is the saturation value until then.
+*/
+/*-----------------------------------------------------------------------------*/
+void  frame_stats_reduce(VCFrameStats *stats, const VCFrameStats *band, I32 lastIff1)
+{
+	I32  i;
+	U32  saturation;
+
+	for(i= 0; i< VCSTATS_BINS; i++)
+	{
+		stats->hist[i] += band->hist[i];
+	}
+	stats->gradientEnergy += band->gradientEnergy;
+
+	if(1==lastIff1)
+	{
+		saturation            = stats->maximum;
+		stats->count          = 0;
+		stats->sum            = 0;
+		stats->saturatedCount = 0;
+		stats->minimum        = 0;
+		stats->maximum        = 0;
+
+		for(i= 0; i< VCSTATS_BINS; i++)
+		{
+			if(0==stats->hist[i]){ continue; }
+
+			if(0==stats->count){ stats->minimum = i; }
+			stats->maximum  = i;
+			stats->count   += stats->hist[i];
+			stats->sum     += (U64)i * stats->hist[i];
+			if(i >= saturation){ stats->saturatedCount += stats->hist[i]; }
+		}
+
+		stats->mean      = (F32)stats->sum            / max(1, stats->count);
+		stats->sharpness = (F32)stats->gradientEnergy / max(1, stats->count);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts One Line from RAW10 to 8 Bit Grey Value (Offset-Free).
+*
+*  This function converts one line of an image from RAW10 to an 8 bit grey value.
+*
+*  The RAW10 format has four bytes with each containing the uppermost 8 bits
+*  of the pixels followed by one byte with the two lowermost bits of each of
+*  the four preceeding pixels packed together:
+*
+*    X0, X1, X2, X3, LowerBitsOfX0..3,  X4, X5, X6, X7, LowerBitsOfX4..7, etc.
+*
+*  The algorithm simply copies the first four Bytes and skips over the following
+*  byte with the lowermost bit information.
+*
+*  Since the starting position is relevant to know where the byte with the
+*  lower bits is and to jump over it, this function needs the byte with the
+*  lower bits at fifth position, like being shown at the example above.
+*
+*   there is   so it is important where the buffer begins: trackOffset==0->X0,trackOffset<4->X1..3.
+*
+* @param  count      Length of the conversion, should be the width of the output image.
+* @param  bufIn      RAW10 encoded data: if the output image has width bytes,
+*                    this buffer should have at least (width * 10)/8 bytes.
+* @param  bufOut     8 Bit Grey Value Output Address.
+*/
+/*-----------------------------------------------------------------------------*/
+inline void  FL_CPY_RAW10P_U8P_NOOFFS(U32 count, char *bufIn, U8 *bufOut)
+{
+	while(count >= 4)
+	{
+		*((U32*)bufOut) = *((U32*)bufIn);
+		bufIn+=5;
+		bufOut+=4;
+
+		count -= 4;
+	}
+
+	while(count--)
+	{
+		*bufOut = (U8)(*bufIn);
+		bufIn++;
+		bufOut++;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts One Line from RAW10 to 8 Bit Grey Value.
+*
+*  This function converts one line of an image from RAW10 to an 8 bit grey value.
+*
+*  The RAW10 format has four bytes with each containing the uppermost 8 bits
+*  of the pixels followed by one byte with the two lowermost bits of each of
+*  the four preceeding pixels packed together:
+*
+*    X0, X1, X2, X3, LowerBitsOfX0..3,  X4, X5, X6, X7, LowerBitsOfX4..7, etc.
+*
+*  The algorithm simply copies the first four Bytes and skips over the following
+*  byte with the lowermost bit information.
+*
+*  Since the starting position is relevant to know where the byte with the
+*  lower bits is and to jump over it, the trackOffset parameter encodes this:
+*
+*  - If trackOffset==0 the first byte is X0.
+*  - If trackOffset==1 the first byte is X1.
+*  - If trackOffset==2 the first byte is X2.
+*  - If trackOffset==3 the first byte is X3.
+*  - Values of trackOffset > 3 are not allowed, especially the input buffer
+*    is not allowed to start at the lowermost bits byte.
+*
+* @param  count       Length of the conversion, should be the width of the output image.
+* @param  bufIn       RAW10 encoded data: if the output image has width bytes,
+*                     this buffer should have at least (width * 10)/8 bytes.
+* @param  trackOffset See text.
+* @param  bufOut      8 Bit Grey Value Output Address.
+*/
+/*-----------------------------------------------------------------------------*/
+inline void  FL_CPY_RAW10P_U8P(U32 count, U8 trackOffset, char *bufIn, U8 *bufOut)
+{
+	while((trackOffset<4)&&(count-- > 0))
+	{
+		*bufOut = (U8)(*bufIn);
+		bufIn++;
+		bufOut++;
+		trackOffset+=1;
+	}
+
+	bufIn++;
+
+	while(count >= 4)
+	{
+		*((U32*)bufOut) = *((U32*)bufIn);
+		bufIn+=5;
+		bufOut+=4;
+
+		count -= 4;
+	}
+
+	while(count--)
+	{
+		*bufOut = (U8)(*bufIn);
+		bufIn++;
+		bufOut++;
+	}
+}
+
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts Image from RAW10 Format to 8 Bit Grey Value.
+*
+*  This function converts an image from RAW10 format to 8 bit grey value.
+*
+*  The RAW10 format has four bytes with each containing the uppermost 8 bits
+*  of the pixels followed by one byte with the two lowermost bits of each of
+*  the four preceeding pixels packed together:
+*
+*    X0, X1, X2, X3, LowerBitsOfX0..3,  X4, X5, X6, X7, LowerBitsOfX4..7, etc.
+*
+*  Since the starting position is relevant to know where the byte with the
+*  lower bits is and to jump over it, the trackOffset parameter encodes this:
+*
+*  - If trackOffset==0 the first byte is X0.
+*  - If trackOffset==1 the first byte is X1.
+*  - If trackOffset==2 the first byte is X2.
+*  - If trackOffset==3 the first byte is X3.
+*  - Values of trackOffset > 3 are not allowed, especially the input buffer
+*    is not allowed to start at the lowermost bits byte.
+*
+* @param  bufIn       RAW10 encoded data: if the output image has width*height bytes,
+*                     this buffer should have at least height*(width * 10)/8 bytes.
+* @param  trackOffset See text.
+* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
+* @param  v4lDx,v4lDy Dimensions of the input buffer.
+* @param  v4lPitch    Currently the same as v4lDx.
+* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
+* @param  imgOut      8 Bit Grey Value Output image.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  convert_raw10_to_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+{
+	return(convert_raw10_to_image_band(imgOut, bufIn, trackOffset, v4lX0, v4lY0, v4lDx, v4lDy, v4lPitch, v4lPaddingBytes, 0, INT_MAX, NULL, NULL));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts offset-free RAW10 Rows to 8 Bit, Core of the Band Functions.
+*
+*  This function converts the rows  y0 <= y < y1, see
+*  convert_raw10_to_image_band(). If packedIff1, input and output rows
+*  follow each other without padding, and a band without statistics is
+*  converted as one run.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  raw10_rows(U8 *out, I32 outPitch, char *in, I32 inPitch, I32 dx, I32 y0, I32 y1, VCFrameStats *stats, const U8 *lut, const I32 packedIff1)
+{
+	I32  y;
+
+	if((1==packedIff1)&&(NULL==stats))
+	{
+		in  += (size_t)y0 * inPitch;
+		out += (size_t)y0 * outPitch;
+		if(NULL!=lut){ FL_CPY_RAW10P_U8P_NOOFFS_LUT((U32)(y1 - y0) * dx, in, out, lut); }
+		else         { kernels.unpack(              (U32)(y1 - y0) * dx, in, out);      }
+		return;
+	}
+
+	for(y= y0; y< y1; y++)
+	{
+		char *row = in  + (size_t)y * inPitch;
+		U8   *dst = out + (size_t)y * outPitch;
+
+		if(NULL!=stats)
+		{
+			FL_CPY_RAW10P_U8P_NOOFFS_STATS(dx, row, (y >= stats->step)?(row - stats->step * inPitch):(NULL), dst, lut, stats);
+		}
+		else if(NULL!=lut)
+		{
+			FL_CPY_RAW10P_U8P_NOOFFS_LUT(dx, row, dst, lut);
+		}
+		else
+		{
+			kernels.unpack(dx, row, dst);
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts a Band of Rows from RAW10 Format to 8 Bit Grey Value.
+*
+*  This function converts the output rows  y0 <= y < y1  of an image
+*  from RAW10 format to 8 bit grey value, see convert_raw10_to_image().
+*
+*  With an offset (trackOffset, v4lX0 or v4lY0 not 0) the input position
+*  and track offset of each row are computed from the row number, so any
+*  band can be converted on its own as well.
+*
+* @param  stats       If not NULL, the statistics of the band are added to it.
+*                     They use the full 10 bits in the offset-free case only,
+*                     with an offset the upper 8 bits before the LUT.
+* @param  lut         If not NULL, the 10 bit values are mapped through this
+*                     1024 entry LUT instead of keeping the upper 8 bits,
+*                     again the lower bits are used in the offset-free case only.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  convert_raw10_to_image_band(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1, VCFrameStats *stats, const U8 *lut)
+{
+	I32   dx = min(imgOut->dx, v4lDx - v4lX0);
+	I32   y, x, yEnd, step;
+	U64   q;
+	char *in;
+	U8   *out, *raw, *rows = NULL;
+
+	if(IMAGE_GREY!=imgOut->type)
+	{
+		return(ERR_TYPE);
+	}
+	if(v4lDx > v4lPitch)
+	{
+		return(ERR_PARAM);
+	}
+	if((v4lX0 >= v4lDx)||(v4lY0 >= v4lDy))
+	{
+		return(ERR_PARAM);
+	}
+	if(trackOffset > 3)
+	{
+		return(ERR_PARAM);
+	}
+
+
+	if((0==trackOffset)&&(0==v4lX0)&&(0==v4lY0))
+	{
+		raw10_rows(imgOut->st, imgOut->pitch, bufIn, (v4lPitch*5)/4 + v4lPaddingBytes, dx, y0, min(min(imgOut->dy,v4lDy), y1), stats, lut, 0);
+	}
+	else
+	{
+		// The statistics compare with the rows step above, which may belong
+		// to another band: the band keeps its own copies of the last rows,
+		// starting step rows above it.
+		step = (NULL!=stats)?(stats->step):(0);
+		yEnd = min(min(imgOut->dy, v4lDy - v4lY0), y1);
+		if(NULL!=stats)
+		{
+			rows = malloc((size_t)(step + 1) * dx);
+			if(NULL==rows){ return(ERR_MEMORY); }
+		}
+
+		for(y= max(y0 - step, 0); y< yEnd; y++)
+		{
+			// Pixel q counted from the group start of bufIn, 4 pixels in 5 bytes.
+			q   = trackOffset + (U64)(y + v4lY0) * v4lPitch + v4lX0;
+			in  = bufIn + (q - trackOffset) + q/4 + (size_t)(y + v4lY0) * v4lPaddingBytes;
+			out = imgOut->st + (size_t)y * imgOut->pitch;
+			raw = (NULL!=rows)?(rows + (size_t)(y % (step + 1)) * dx):(out);
+
+			FL_CPY_RAW10P_U8P(dx, (U8)(q%4), in, raw);
+			if(y < y0){ continue; }
+
+			if(NULL!=stats)
+			{
+				frame_stats_add_row_u8(stats, raw, (y >= step)?(rows + (size_t)((y - step) % (step + 1)) * dx):(NULL), dx);
+			}
+			if(NULL!=lut)
+			{
+				for(x= 0; x< dx; x++)
+				{
+					out[x] = lut[(U32)raw[x] << 2];
+				}
+			}
+			else if(raw!=out)
+			{
+				memcpy(out, raw, dx);
+			}
+		}
+
+		free(rows);
+	}
+
+	return(ERR_NONE);
+}
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copys Image from GREY Format to 8 Bit Grey Value.
+*
+*  This function copys an image from GREY format to 8 bit grey value.
+*  It is just a copy routine, since the data format is already the same.
+*
+* @param  bufIn       GREY encoded data.
+* @param  ignoredTrackOffset Ignored.
+* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
+* @param  v4lDx,v4lDy Dimensions of the input buffer.
+* @param  v4lPitch    Currently the same as v4lDx.
+* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
+* @param  imgOut      8 Bit Grey Value Output image.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  copy_grey_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+{
+	return(copy_grey_to_image_band(imgOut, bufIn, v4lX0, v4lY0, v4lDx, v4lDy, v4lPitch, v4lPaddingBytes, 0, INT_MAX, NULL));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copies Rows of GREY Data, Core of the Band Functions.
+*
+*  This function copies the rows  y0 <= y < y1. If packedIff1, input and
+*  output rows follow each other without padding, and a band without
+*  statistics is copied at once.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  grey_rows(U8 *out, I32 outPitch, const char *in, I32 inPitch, I32 dx, I32 y0, I32 y1, VCFrameStats *stats, const I32 packedIff1)
+{
+	I32  y;
+
+	if((1==packedIff1)&&(NULL==stats))
+	{
+		memcpy(out + (size_t)y0 * dx, in + (size_t)y0 * dx, (size_t)(y1 - y0) * dx);
+		return;
+	}
+
+	for(y= y0; y< y1; y++)
+	{
+		memcpy(out + (size_t)y * outPitch, in + (size_t)y * inPitch, dx);
+
+		if(NULL!=stats)
+		{
+			frame_stats_add_row_u8(stats, out + (size_t)y * outPitch, (y >= stats->step)?((U8*)in + (size_t)(y - stats->step) * inPitch):(NULL), dx);
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copys a Band of Rows from GREY Format to 8 Bit Grey Value.
+*
+*  This function copys the output rows  y0 <= y < y1,
+*  see copy_grey_to_image().
+*
+* @param  stats       If not NULL, the statistics of the band are added to it.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  copy_grey_to_image_band(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1, VCFrameStats *stats)
+{
+	I32   dx = min(imgOut->dx, v4lDx - v4lX0);
+
+	if(IMAGE_GREY!=imgOut->type)
+	{
+		return(ERR_TYPE);
+	}
+	if(v4lDx > v4lPitch)
+	{
+		return(ERR_PARAM);
+	}
+	if((v4lX0 >= v4lDx)||(v4lY0 >= v4lDy))
+	{
+		return(ERR_PARAM);
+	}
+
+
+	grey_rows(imgOut->st, imgOut->pitch, bufIn + v4lX0 + v4lY0 * (v4lPitch + v4lPaddingBytes), v4lPitch + v4lPaddingBytes, dx, y0, min(min(imgOut->dy,v4lDy), y1), stats, 0);
+
+
+	return(ERR_NONE);
+}
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Direct conversion from raw10 Bayer RGB data to IMAGE_RGB.
+*
+*  This function does a direct conversion from raw10 Bayer RGB data to IMAGE_RGB.
+*
+* @param  bufIn       Bayer encoded data.
+* @param  ignoredTrackOffset Ignored.
+* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
+* @param  v4lDx,v4lDy Dimensions of the input buffer.
+* @param  v4lPitch    Currently the same as v4lDx.
+* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
+* @param  imgOut      8 Bit RGB Value Output image.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  convert_raw10_and_debayer_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+{
+	int    rc, ee;
+	image  imgU8 = NULL_IMAGE;
+
+	// Allocate temporary image
+	{
+		imgU8.type = IMAGE_GREY;
+		imgU8.dx   = v4lDx;
+		imgU8.dy   = v4lDy;
+		imgU8.pitch= imgU8.dx;
+		imgU8.ccmp1= NULL;
+		imgU8.ccmp2= NULL;
+		imgU8.st   =  malloc(sizeof(U8) * imgU8.dy * imgU8.pitch);
+		if(NULL==imgU8.st){ee=-1; goto fail;}
+	}
+
+	rc =  convert_raw10_and_debayer_image_band(imgOut, &imgU8, bufIn, trackOffset, v4lX0, v4lY0, v4lDx, v4lDy, v4lPitch, v4lPaddingBytes, 0, INT_MAX, NULL, NULL);
+	if(rc<0){ee=rc; goto fail;}
+
+ 	ee=0;
+fail:
+	if(NULL!=imgU8.st){ free(imgU8.st);  imgU8.st=NULL; }
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band of the direct conversion from raw10 Bayer RGB data to IMAGE_RGB.
+*
+*  This function converts the rows  y0 <= y < y1  from raw10 to the
+*  8 bit Bayer image imgU8 and debayers them while they are still in cache.
+*  y0 must be even, since debayering works on pairs of rows.
+*
+* @param  imgU8       8 Bit Bayer intermediate image of the input dimensions.
+* @param  stats       If not NULL, the statistics of the Bayer data are added to it.
+* @param  lut         If not NULL, the tone mapping of the Bayer data.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  convert_raw10_and_debayer_image_band(image *imgOut, image *imgU8, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1, VCFrameStats *stats, const U8 *lut)
+{
+	int    rc, ee;
+
+	rc =  convert_raw10_to_image_band(imgU8,  bufIn, trackOffset,  v4lX0, v4lY0, v4lDx, v4lDy, v4lPitch, v4lPaddingBytes, y0, y1, stats, lut);
+	if(rc<0){ee=-2+10*rc; goto fail;}
+
+	rc =  simple_debayer_to_image_band(imgOut, (char*)imgU8->st,  0, 0, imgU8->dx, imgU8->dy, imgU8->pitch, 0, y0, y1);
+	if(rc<0){ee=-3+10*rc; goto fail;}
+
+ 	ee=0;
+fail:
+	return(ee);
+}
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Simple and SLOW debayering for sensor image data.
+*
+*  This function does a simple and SLOW debayering for sensor image data.
+*
+* @param  bufIn       GREY encoded data.
+* @param  ignoredTrackOffset Ignored.
+* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
+* @param  v4lDx,v4lDy Dimensions of the input buffer.
+* @param  v4lPitch    Currently the same as v4lDx.
+* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
+* @param  imgOut      8 Bit Grey Value Output image.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  simple_debayer_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+{
+	return(simple_debayer_to_image_band(imgOut, bufIn, v4lX0, v4lY0, v4lDx, v4lDy, v4lPitch, v4lPaddingBytes, 0, INT_MAX));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Debayers Pairs of Rows, Core of the Band Functions.
+*
+*  This function debayers the rows  y0 <= y < dy  of the 8 bit Bayer data
+*  at bufIn, see simple_debayer_to_image_band(). y0 must be even.
+*
+* @param  stride  Bytes per pixel of imgOut, 1 if planar.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  debayer_rows(image *imgOut, const U8 *bufIn, I32 inPitch, I32 dx, I32 dy, I32 y0, const I32 stride)
+{
+	I32   y;
+
+	// Interleaved output: each 2x2 Bayer cell is written in one pass,
+	// the upper row with the first green, the lower row with the second one.
+	if(stride>1)
+	{
+		U8 *r, *g, *b;
+		I32 ro, go, bo;
+
+		image_channels(imgOut, &r, &g, &b);
+		ro = r - (U8*)imgOut->st;
+		go = g - (U8*)imgOut->st;
+		bo = b - (U8*)imgOut->st;
+
+		for(y= y0; y< dy; y+=2)
+		{
+			I32        x;
+			const U8  *in0  =  bufIn + (y+0) * inPitch;
+			const U8  *in1  =  bufIn + (y+1) * inPitch;
+			U8        *out0 =  (U8*)imgOut->st + (y+0) * imgOut->pitch;
+			U8        *out1 =  (U8*)imgOut->st + (y+1) * imgOut->pitch;
+			I32        rows =  (y+1 < dy)?(2):(1);
+
+			for(x= 0; x< dx; x+=2)
+			{
+				U8  vr = in0[x], vg0 = in0[x+1], vg1 = in1[x], vb = in1[x+1];
+
+				out0[ro] = vr;  out0[go] = vg0;  out0[bo] = vb;
+				out0[stride+ro] = vr;  out0[stride+go] = vg0;  out0[stride+bo] = vb;
+				if(4==stride){ out0[3] = 255;  out0[stride+3] = 255; }
+				out0 += 2*stride;
+
+				if(2==rows)
+				{
+					out1[ro] = vr;  out1[go] = vg1;  out1[bo] = vb;
+					out1[stride+ro] = vr;  out1[stride+go] = vg1;  out1[stride+bo] = vb;
+					if(4==stride){ out1[3] = 255;  out1[stride+3] = 255; }
+					out1 += 2*stride;
+				}
+			}
+		}
+
+		return;
+	}
+
+	for(y= y0; y< dy; y+=2)
+	{
+		size_t  o0 = (size_t)(y+0) * imgOut->pitch;
+		size_t  o1 = (size_t)(y+1) * imgOut->pitch;
+
+		kernels.debayer(bufIn + (y+0) * inPitch, bufIn + (y+1) * inPitch,
+		                (U8*)imgOut->st    + o0, (U8*)imgOut->st    + o1,
+		                (U8*)imgOut->ccmp1 + o0, (U8*)imgOut->ccmp1 + o1,
+		                (U8*)imgOut->ccmp2 + o0, (U8*)imgOut->ccmp2 + o1, dx);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Simple debayering of a Band of Rows.
+*
+*  This function debayers the output rows  y0 <= y < y1,
+*  see simple_debayer_to_image(). y0 must be even.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  simple_debayer_to_image_band(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes, I32 y0, I32 y1)
+{
+	I32   dx = min(imgOut->dx, v4lDx - v4lX0);
+	I32   dy = min(min(imgOut->dy, v4lDy - v4lY0), y1);
+	I32   stride = image_pixel_stride(imgOut);
+
+	if((IMAGE_RGB!=imgOut->type)&&(1==stride))
+	{
+		return(ERR_TYPE);
+	}
+	if(v4lDx > v4lPitch)
+	{
+		return(ERR_PARAM);
+	}
+	if((v4lX0 >= v4lDx)||(v4lY0 >= v4lDy))
+	{
+		return(ERR_PARAM);
+	}
+	if(0!=(y0%2))
+	{
+		return(ERR_PARAM);
+	}
+
+	debayer_rows(imgOut, (U8*)bufIn + v4lX0 + v4lY0 * (v4lPitch + v4lPaddingBytes), v4lPitch + v4lPaddingBytes, dx, dy, y0, stride);
+
+	return(ERR_NONE);
+}
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Band Function Template: Converts a Band of the Capture and feeds Row Outputs.
+*
+*  This function converts the rows  y0 <= y < y1  of the capture and
+*  copies them to the vcimgnetsrv image while they are still in cache.
+*  VCPIPELINE_LIST instantiates it for each format, row padding and
+*  layout of the converted image, so the compiler drops the other
+*  formats and the strides of the hot loops are constants.
+*
+* @param  fmt         V4L2 pixelformat of the capture.
+* @param  packedIff1  Capture rows follow each other without padding bytes.
+* @param  stride      Bytes per pixel of the converted image, 1 if planar.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline __attribute__((always_inline)) void  process_capture_convert_band(VCFrameJob *job, I32 y0, I32 y1, I32 workerIdx, const U32 fmt, const I32 packedIff1, const I32 stride)
+{
+	VCFrameStats *stats = (NULL!=job->stats)?(&job->stats[workerIdx]):(NULL);
+	I32           rc    = 0;
+	char         *st    = job->st;
+
+	// Pull the input rows of the band into cached memory first,
+	// they are converted right after, while still in cache.
+	if(NULL!=job->ingest)
+	{
+		size_t  first = (size_t)y0 * job->pitch;
+		size_t  last  = min((size_t)min(y1, job->dy) * job->pitch, job->ingest->byteCount);
+		U64     t0    = timestamp_ns();
+
+		if(last > first)
+		{
+			ingest_copy(job->ingest->st + first, (U8*)job->st + first, last - first);
+		}
+		st = (char*)job->ingest->st;
+		__atomic_add_fetch(&job->ingest->copyNS, timestamp_ns() - t0, __ATOMIC_RELAXED);
+	}
+
+	y1 = min(y1, job->dy);
+	if(y0 < y1)
+	{
+		switch(fmt)
+		{
+			case V4L2_PIX_FMT_GREY:
+					grey_rows(job->imgConverted->st, job->imgConverted->pitch, st, job->pitch, job->dx, y0, y1, stats, packedIff1);
+				break;
+			case V4L2_PIX_FMT_Y10:
+					raw10_rows(job->imgConverted->st, job->imgConverted->pitch, st, job->pitch, job->dx, y0, y1, stats, job->lut, packedIff1);
+				break;
+			case V4L2_PIX_FMT_SRGGB10P:
+					raw10_rows(job->imgRaw8->st, job->imgRaw8->pitch, st, job->pitch, job->dx, y0, y1, stats, job->lut, packedIff1);
+					debayer_rows(job->imgConverted, job->imgRaw8->st, job->imgRaw8->pitch, job->dx, y1, y0, stride);
+				break;
+		}
+	}
+	if((rc>=0)&&(NULL!=job->imgNet)&&(0==job->netStageIff1))
+	{
+		rc =  copy_image_band(job->imgConverted, job->imgNet, y0, y1);
+	}
+	if((rc>=0)&&(NULL!=job->ae))
+	{
+		auto_exposure_measure_band(&job->ae[workerIdx], job->imgConverted, y0, y1);
+	}
+	if((rc>=0)&&(NULL!=job->gate))
+	{
+		change_gate_measure_band(job->gate, job->imgConverted, y0, y1);
+	}
+	if(rc<0)
+	{
+		__sync_bool_compare_and_swap(&job->rc, 0, rc);
+	}
+}
+
+
+// One band function per line of VCPIPELINE_LIST, and the table of them.
+#define  VCPIPELINE_BAND(name, fmt, packedIff1, stride)                                       \
+static void  process_capture_convert_##name##_band(void *arg, I32 y0, I32 y1, I32 workerIdx)  \
+{                                                                                             \
+	process_capture_convert_band((VCFrameJob*)arg, y0, y1, workerIdx, fmt, packedIff1, stride); \
+}
+
+#define  VCPIPELINE_ENTRY(name, fmt, packedIff1, stride)                                      \
+	{ #name, fmt, packedIff1, stride, process_capture_convert_##name##_band,                  \
+	  (V4L2_PIX_FMT_SRGGB10P==fmt)?(2):(1), (V4L2_PIX_FMT_SRGGB10P==fmt)?(2):(1),             \
+	  (V4L2_PIX_FMT_GREY==fmt)?(255<<2):(VCSTATS_BINS-1), (V4L2_PIX_FMT_SRGGB10P==fmt)?(1):(0) },
+
+VCPIPELINE_LIST(VCPIPELINE_BAND)
+
+static const VCPipeline  pipelineTable[] = { VCPIPELINE_LIST(VCPIPELINE_ENTRY) };
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Picks the Pipeline of a Capture Format.
+*
+*  Rows are packed if bytesperline is exactly the width in that format,
+*  for RAW10 in whole groups of four pixels.
+*
+* @param  stride  Bytes per pixel of the converted image, 1 if planar or grey.
+* @return The pipeline, NULL if the format or layout is not supported.
+*/
+/*-----------------------------------------------------------------------------*/
+const VCPipeline  *pipeline_select(U32 pixelformat, I32 dx, I32 pitch, I32 stride)
+{
+	I32  i, rowBytes, packedIff1;
+
+	rowBytes   = (V4L2_PIX_FMT_GREY==pixelformat)?(dx):((dx * 10) / 8);
+	packedIff1 = ((pitch==rowBytes)&&((V4L2_PIX_FMT_GREY==pixelformat)||(0==dx % 4)))?(1):(0);
+	if(pitch < rowBytes){ return(NULL); }
+
+	for(i= 0; i< (I32)(sizeof(pipelineTable) / sizeof(pipelineTable[0])); i++)
+	{
+		if((pipelineTable[i].pixelformat==pixelformat)&&(pipelineTable[i].packedIff1==packedIff1)&&(pipelineTable[i].stride==stride))
+		{
+			return(&pipelineTable[i]);
+		}
+	}
+
+	return(NULL);
+}
+
+
+
+
+
+void  timemeasurement_start(struct  timeval *timer)
+{
+	gettimeofday(timer,(struct timezone *)0);
+}
+
+void  timemeasurement_stop(struct  timeval *timer, I64 *s, I64 *us)
+{
+	struct  timeval  end;
+
+	gettimeofday(&end,(struct timezone *)0);
+	*s  = end.tv_sec  - timer->tv_sec;
+	*us = end.tv_usec - timer->tv_usec;
+	if(*us < 0){ *us += 1000000; *s = *s - 1; }
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns the Time of CLOCK_MONOTONIC in Nanoseconds.
+*/
+/*-----------------------------------------------------------------------------*/
+U64  timestamp_ns(void)
+{
+	struct timespec  ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return((U64)ts.tv_sec * 1000000000ULL + (U64)ts.tv_nsec);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Processes the Share of a Worker of the current Pool Job.
+*
+*  This function grabs bands of each stage until none are left and waits
+*  at the end of each stage until all workers arrived, so the next stage
+*  may access rows written by other workers.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  worker_pool_work(VCWorkerPool *pool, I32 workerIdx)
+{
+	VCPoolWorkerStats *stats = &pool->stats[workerIdx];
+	I32                s, band, y0, y1, spin;
+	U64                t0, t1;
+
+	for(s= 0; s< pool->stageCount; s++)
+	{
+		const VCPoolStage *stage = &pool->stage[s];
+
+		t0 = timestamp_ns();
+		while(1)
+		{
+			band = __sync_fetch_and_add(&pool->nextBand[s], 1);
+			y0   = band * pool->bandHeight[s];
+			if(y0 >= stage->rows){ break; }
+			y1   = min(y0 + pool->bandHeight[s], stage->rows);
+
+			stage->fn(stage->arg, y0, y1, workerIdx);
+			stats->bandCount++;
+		}
+		t1 = timestamp_ns();
+		stats->busyNS += t1 - t0;
+
+		// Stage barrier, the last stage needs none since the job is joined anyway.
+		// Release publishes the rows of this worker, acquire makes those of the others visible.
+		if(s+1 < pool->stageCount)
+		{
+			__atomic_add_fetch(&pool->arrived[s], 1, __ATOMIC_ACQ_REL);
+			for(spin= 0; __atomic_load_n(&pool->arrived[s], __ATOMIC_ACQUIRE) < pool->workerCount; spin++)
+			{
+				if(spin >= VCPOOL_SPIN_COUNT){ sched_yield(); }
+			}
+			stats->barrierNS += timestamp_ns() - t1;
+		}
+	}
+	stats->jobCount++;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Main Loop of a Pool Worker Thread.
+*
+*  Polls shortly for a new job to avoid the wakeup latency at high frame
+*  rates, then sleeps until worker_pool_run() or worker_pool_destroy()
+*  signals.
+*/
+/*-----------------------------------------------------------------------------*/
+static void *worker_pool_thread(void *pvArg)
+{
+	VCPoolWorkerArg *arg  = (VCPoolWorkerArg*)pvArg;
+	VCWorkerPool    *pool = arg->pool;
+	I32              idx  = arg->idx;
+	U32              seen = 0;
+	I32              spin;
+
+	free(arg);
+
+	while(1)
+	{
+		for(spin= 0; (spin< VCPOOL_SPIN_COUNT)&&(seen==__atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE))&&(0==__atomic_load_n(&pool->quitIff1, __ATOMIC_ACQUIRE)); spin++)
+		{
+			sched_yield();
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		while((seen==pool->generation)&&(0==pool->quitIff1))
+		{
+			pthread_cond_wait(&pool->condStart, &pool->mutex);
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if(0!=pool->quitIff1){ break; }
+
+		worker_pool_work(pool, idx);
+
+		// Release publishes the rows of this worker to worker_pool_run().
+		if(0==__atomic_sub_fetch(&pool->running, 1, __ATOMIC_ACQ_REL))
+		{
+			pthread_mutex_lock(&pool->mutex);
+			pthread_cond_signal(&pool->condDone);
+			pthread_mutex_unlock(&pool->mutex);
+		}
+	}
+
+	return(NULL);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Pins a Thread to one CPU.
+*/
+/*-----------------------------------------------------------------------------*/
+static int  worker_pool_pin(pthread_t thread, I32 cpu)
+{
+	cpu_set_t  set;
+
+	if(cpu<0){ return(0); }
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	return(pthread_setaffinity_np(thread, sizeof(cpu_set_t), &set));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Creates a Pool of persistent Worker Threads.
+*
+*  This function starts workerCount-1 threads, the calling thread is the
+*  remaining worker when running jobs with worker_pool_run().
+*
+* @param  workerCount  Count of workers incl. the calling thread,
+*                      values < 1 use the count of online CPUs.
+* @param  pcCpuList    Comma separated CPUs to pin workers 0,1,.. to,
+*                      empty string or NULL for no pinning.
+* @param  grain        Rows per band, values < 1 select an automatic height.
+*/
+/*-----------------------------------------------------------------------------*/
+int  worker_pool_create(VCWorkerPool *pool, I32 workerCount, const char *pcCpuList, I32 grain)
+{
+	I32   ee, rc, i;
+	const char *pc = pcCpuList;
+
+	memset(pool, 0, sizeof(VCWorkerPool));
+
+	if(workerCount<1){ workerCount = sysconf(_SC_NPROCESSORS_ONLN); }
+	pool->workerCount = max(1, min(VCPOOL_MAX_WORKERS, workerCount));
+	pool->grain       = max(0, grain);
+
+	for(i= 0; i< VCPOOL_MAX_WORKERS; i++)
+	{
+		pool->cpu[i] = -1;
+	}
+	for(i= 0; (NULL!=pc)&&(0!=*pc)&&(i< pool->workerCount); i++)
+	{
+		pool->cpu[i] = atoi(pc);
+		pc           = strchr(pc, ',');
+		if(NULL!=pc){ pc++; }
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->condStart, NULL);
+	pthread_cond_init(&pool->condDone, NULL);
+
+	for(i= 1; i< pool->workerCount; i++)
+	{
+		VCPoolWorkerArg *arg = malloc(sizeof(VCPoolWorkerArg));
+		if(NULL==arg){ee=-99; goto fail;}
+
+		arg->pool = pool;
+		arg->idx  = i;
+
+		rc =  pthread_create(&pool->thread[i], NULL, worker_pool_thread, arg);
+		if(rc!=0){ free(arg); pool->workerCount = i; ee=-2; goto fail;}
+
+		rc =  worker_pool_pin(pool->thread[i], pool->cpu[i]);
+		if(rc!=0){ pool->workerCount = i+1; ee=-1; goto fail;}
+	}
+
+	rc =  worker_pool_pin(pthread_self(), pool->cpu[0]);
+	if(rc!=0){ee=-1; goto fail;}
+
+	syslog(LOG_DEBUG, "%s():  Started %d Workers.\n", __FUNCTION__, pool->workerCount);
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  Could not pin worker to CPU (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  pthread_create() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			break;
+		case -99:
+			syslog(LOG_ERR, "%s():  Out of Memory!\n", __FUNCTION__);
+			break;
+	}
+	if(ee<0)
+	{
+		worker_pool_destroy(pool);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Stops and Joins all Worker Threads of a Pool.
+*/
+/*-----------------------------------------------------------------------------*/
+void  worker_pool_destroy(VCWorkerPool *pool)
+{
+	I32  i;
+
+	pthread_mutex_lock(&pool->mutex);
+	__atomic_store_n(&pool->quitIff1, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pool->condStart);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for(i= 1; i< pool->workerCount; i++)
+	{
+		pthread_join(pool->thread[i], NULL);
+	}
+	pool->workerCount = 0;
+
+	pthread_cond_destroy(&pool->condDone);
+	pthread_cond_destroy(&pool->condStart);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Runs a Job of one or more Stages on the Worker Pool.
+*
+*  This function wakes up all workers once, processes its own share as
+*  worker 0 and returns when all stages are finished.
+*  A NULL pool processes all stages in the calling thread.
+*/
+/*-----------------------------------------------------------------------------*/
+int  worker_pool_run(VCWorkerPool *pool, const VCPoolStage *stage, I32 stageCount)
+{
+	I32  s, bands, align;
+	U64  t0;
+
+	if((stageCount<1)||(stageCount>VCPOOL_MAX_STAGES)){ return(ERR_PARAM); }
+
+	if(NULL==pool)
+	{
+		for(s= 0; s< stageCount; s++)
+		{
+			stage[s].fn(stage[s].arg, 0, stage[s].rows, 0);
+		}
+		return(ERR_NONE);
+	}
+
+	t0 = timestamp_ns();
+
+	// Band height: some bands per worker to balance the load, aligned as requested.
+	for(s= 0; s< stageCount; s++)
+	{
+		align = max(1, stage[s].align);
+		if(pool->grain>0){ bands = max(1, stage[s].rows / pool->grain);   }
+		else             { bands = 4 * pool->workerCount;                  }
+
+		pool->bandHeight[s] = ((stage[s].rows + bands - 1) / bands + align - 1) / align * align;
+		pool->bandHeight[s] = max(align, pool->bandHeight[s]);
+		pool->nextBand  [s] = 0;
+		pool->arrived   [s] = 0;
+	}
+	pool->stage      = stage;
+	pool->stageCount = stageCount;
+	pool->running    = pool->workerCount - 1;
+
+	if(pool->workerCount>1)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		// Release publishes the job set up above to workers still spinning.
+		__atomic_add_fetch(&pool->generation, 1, __ATOMIC_RELEASE);
+		pthread_cond_broadcast(&pool->condStart);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	worker_pool_work(pool, 0);
+
+	if(pool->workerCount>1)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		// The last worker decrements before it takes the mutex to signal.
+		while(__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)>0)
+		{
+			pthread_cond_wait(&pool->condDone, &pool->mutex);
+		}
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	pool->jobCount++;
+	pool->jobNS += timestamp_ns() - t0;
+
+	return(ERR_NONE);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Utilisation of each Worker of the Pool.
+*
+*  Utilisation is the time a worker spent in band functions relative to
+*  the wall time of all jobs, barrier is the time spent waiting for
+*  slower workers between stages.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  worker_pool_print_stats(VCWorkerPool *pool)
+{
+	I32  i;
+	U64  jobNS = max(1, pool->jobNS);
+
+	printf("  Worker Pool: %d Workers, %llu Jobs, %8.3fms per Job.\n", pool->workerCount, (unsigned long long)pool->jobCount, (F32)pool->jobNS / 1000000 / max(1, pool->jobCount));
+	for(i= 0; i< pool->workerCount; i++)
+	{
+		VCPoolWorkerStats *stats = &pool->stats[i];
+
+		printf("    Worker %2d (CPU %2d): %5.1f%% busy, %5.1f%% barrier, %8llu Bands.\n", i, pool->cpu[i],
+				(F32)100 * stats->busyNS / jobNS, (F32)100 * stats->barrierNS / jobNS, (unsigned long long)stats->bandCount);
+	}
+
+	return(1 + pool->workerCount);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Gives the Worker Threads of a Pool SCHED_FIFO Priority.
+*
+*  The calling thread (worker 0) is not changed, see realtime_enable().
+*/
+/*-----------------------------------------------------------------------------*/
+int  worker_pool_set_realtime(VCWorkerPool *pool, I32 priority)
+{
+	I32                 rc, i;
+	struct sched_param  param;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+
+	for(i= 1; i< pool->workerCount; i++)
+	{
+		rc =  pthread_setschedparam(pool->thread[i], SCHED_FIFO, &param);
+		if(rc!=0)
+		{
+			syslog(LOG_ERR, "%s():  pthread_setschedparam() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			return(-1);
+		}
+	}
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Switches the Calling Thread and Process to Real-Time Operation.
+*
+*  This function locks all current and future memory of the process,
+*  prefaults the stack, and gives the calling thread SCHED_FIFO priority
+*  pinned to cpu (if cpu >= 0).
+*  Buffers mapped or allocated afterwards should be prefaulted as well,
+*  see sensor_open() and frame_arena_create().
+*/
+/*-----------------------------------------------------------------------------*/
+int  realtime_enable(I32 priority, I32 cpu)
+{
+	I32                 ee, rc;
+	struct sched_param  param;
+
+	rc =  mlockall(MCL_CURRENT | MCL_FUTURE);
+	if(rc<0){ee=-1; goto fail;}
+
+	// Touch the stack once, so it will not fault while capturing.
+	{
+		volatile U8  au8Stack[64 * 1024];
+
+		memset((void*)au8Stack, 0, sizeof(au8Stack));
+	}
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+
+	rc =  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if(rc!=0){ee=-2; goto fail;}
+
+	if(cpu>=0)
+	{
+		cpu_set_t  set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+
+		rc =  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+		if(rc!=0){ee=-3; goto fail;}
+	}
+
+	syslog(LOG_DEBUG, "%s():  Capture thread runs with SCHED_FIFO priority %d at CPU %d.\n", __FUNCTION__, priority, cpu);
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  mlockall() throws Error (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  pthread_setschedparam() throws Error (%d(%s)), missing CAP_SYS_NICE?\n", __FUNCTION__, rc, strerror(rc));
+			break;
+		case -3:
+			syslog(LOG_ERR, "%s():  pthread_setaffinity_np() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Allocates one Image Plane of a Frame Arena.
+*/
+/*-----------------------------------------------------------------------------*/
+static U8 *frame_arena_alloc_plane(I32 byteCount, I32 prefaultIff1)
+{
+	void  *pv = NULL;
+
+	if(0!=posix_memalign(&pv, 4096, byteCount)){ return(NULL); }
+
+	if(1==prefaultIff1)
+	{
+		memset(pv, 0, byteCount);
+	}
+
+	return((U8*)pv);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Preallocates the Images Captures are converted to.
+*
+*  This function allocates slotCount images of the type process_capture()
+*  converts the pixelformat to. Page aligned, and written once
+*  if prefaultIff1 is 1, so no page faults occur while capturing.
+*
+* @param  colourType  Layout of colour images: IMAGE_RGB (planar) or VCIMAGE_...
+*/
+/*-----------------------------------------------------------------------------*/
+int  frame_arena_create(VCFrameArena *arena, U32 pixelformat, I32 dx, I32 dy, I32 slotCount, I32 prefaultIff1, I32 colourType)
+{
+	I32  ee, i;
+	I32  byteCount = dx * dy;
+
+	arena->slot        = calloc(slotCount, sizeof(VCFrameSlot));
+	arena->slotCount    = 0;
+	arena->statsWorker  = NULL;
+	arena->exhaustCount = 0;
+	if(NULL==arena->slot){ee=-1; goto fail;}
+
+	arena->statsWorker = (VCFrameStats*)frame_arena_alloc_plane(sizeof(VCFrameStats) * VCPOOL_MAX_WORKERS, prefaultIff1);
+	if(NULL==arena->statsWorker){ee=-6; goto fail;}
+
+	for(i= 0; i< slotCount; i++)
+	{
+		VCFrameSlot *slot = &arena->slot[arena->slotCount];
+		image        imgNuller = NULL_IMAGE;
+
+		slot->img     = imgNuller;
+		slot->imgRaw8 = imgNuller;
+		arena->slotCount++;
+
+		slot->img.type  = (V4L2_PIX_FMT_SRGGB10P==pixelformat)?(colourType):(IMAGE_GREY);
+		slot->img.dx    = dx;
+		slot->img.dy    = dy;
+		slot->img.pitch = dx * image_pixel_stride(&slot->img);
+		slot->img.st    = frame_arena_alloc_plane(byteCount * image_pixel_stride(&slot->img), prefaultIff1);
+		if(NULL==slot->img.st){ee=-2; goto fail;}
+
+		if(IMAGE_RGB==slot->img.type)
+		{
+			slot->img.ccmp1 = frame_arena_alloc_plane(byteCount, prefaultIff1);
+			if(NULL==slot->img.ccmp1){ee=-3; goto fail;}
+			slot->img.ccmp2 = frame_arena_alloc_plane(byteCount, prefaultIff1);
+			if(NULL==slot->img.ccmp2){ee=-4; goto fail;}
+		}
+
+		if(V4L2_PIX_FMT_SRGGB10P==pixelformat)
+		{
+
+			slot->imgRaw8.type  = IMAGE_GREY;
+			slot->imgRaw8.dx    = dx;
+			slot->imgRaw8.dy    = dy;
+			slot->imgRaw8.pitch = dx;
+			slot->imgRaw8.st    = frame_arena_alloc_plane(byteCount, prefaultIff1);
+			if(NULL==slot->imgRaw8.st){ee=-5; goto fail;}
+		}
+	}
+
+	ee=0;
+fail:
+	if(ee<0)
+	{
+		syslog(LOG_ERR, "%s():  Out of Memory (%d)!\n", __FUNCTION__, ee);
+		frame_arena_destroy(arena);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Frees all Images of a Frame Arena.
+*/
+/*-----------------------------------------------------------------------------*/
+void  frame_arena_destroy(VCFrameArena *arena)
+{
+	I32  i;
+
+	if(NULL==arena->slot){ return; }
+
+	for(i= 0; i< arena->slotCount; i++)
+	{
+		free(arena->slot[i].img.st);
+		free(arena->slot[i].img.ccmp1);
+		free(arena->slot[i].img.ccmp2);
+		free(arena->slot[i].imgRaw8.st);
+		free(arena->slot[i].imgRect[0].st);
+		free(arena->slot[i].imgRect[1].st);
+		free(arena->slot[i].disp);
+		free(arena->slot[i].jpeg);
+	}
+	free(arena->slot);
+	free(arena->statsWorker);
+	arena->slot        = NULL;
+	arena->slotCount   = 0;
+	arena->statsWorker = NULL;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copies a Block of a Capture Buffer with wide Loads and Prefetching.
+*
+*  Runs the copy kernel, see kernel_copy_vec(), so uncached or
+*  write-combined memory is read in bursts rather than by the byte and
+*  4 byte loads of the converters.
+*/
+/*-----------------------------------------------------------------------------*/
+void  ingest_copy(U8 *dst, const U8 *src, size_t byteCount)
+{
+	kernels.copy(dst, src, byteCount);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Reads a Buffer byte-wise like the Converters do, returns the Time in ns.
+*/
+/*-----------------------------------------------------------------------------*/
+static U64  ingest_scan(const U8 *src, size_t byteCount)
+{
+	volatile U32  sink;
+	U32           sum = 0;
+	U64           t0  = timestamp_ns();
+	size_t        i;
+
+	for(i= 0; i< byteCount; i++)
+	{
+		sum += src[i];
+	}
+	sink = sum;
+	(void)sink;
+
+	return(timestamp_ns() - t0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sets up the Capture Ingest of a Sensor.
+*
+*  This function allocates the cached staging buffer and measures both
+*  strategies on the first mapped capture buffer: reading it in place,
+*  and bulk-copying it to the staging buffer and reading it there.
+*  VCINGEST_AUTO picks the faster one, which is VCINGEST_COPY only if
+*  the capture buffers are mapped uncached or write-combined.
+*
+* @param  mode         VCINGEST_DIRECT, VCINGEST_COPY or VCINGEST_AUTO.
+* @param  src          A mapped capture buffer.
+*/
+/*-----------------------------------------------------------------------------*/
+int  ingest_init(VCIngest *ig, I32 mode, const void *src, size_t byteCount, I32 prefaultIff1)
+{
+	I32  ee, i;
+	U64  tDirect = ~0ull, tCopy = ~0ull, t0;
+
+	ig->st        = frame_arena_alloc_plane(byteCount, prefaultIff1);
+	if(NULL==ig->st){ee=-1; goto fail;}
+	ig->byteCount = byteCount;
+
+	// First pass faults the pages in, the minimum of the others counts.
+	for(i= 0; i< 4; i++)
+	{
+		t0 = ingest_scan(src, byteCount);
+		if(i>0){ tDirect = min(tDirect, t0); }
+
+		t0 = timestamp_ns();
+		ingest_copy(ig->st, src, byteCount);
+		t0 = timestamp_ns() - t0 + ingest_scan(ig->st, byteCount);
+		if(i>0){ tCopy   = min(tCopy,   t0); }
+	}
+	ig->probeDirectMBs = (F32)byteCount * 1000 / max(tDirect, 1);
+	ig->probeCopyMBs   = (F32)byteCount * 1000 / max(tCopy,   1);
+
+	if(VCINGEST_AUTO==mode)
+	{
+		mode = (tCopy < tDirect)?(VCINGEST_COPY):(VCINGEST_DIRECT);
+	}
+	ig->mode = mode;
+
+	ee=0;
+fail:
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Frees the Staging Buffer of the Capture Ingest.
+*/
+/*-----------------------------------------------------------------------------*/
+void  ingest_destroy(VCIngest *ig)
+{
+	free(ig->st);
+	ig->st        = NULL;
+	ig->byteCount = 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Ingest Strategy, its Probe and the Copy Time per Frame.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  ingest_print_stats(const char *pcName, const VCIngest *ig)
+{
+	printf("  %-22s %-6s (probe: direct %7.1f MB/s, copy %7.1f MB/s), copy %6.3f ms/frame.\n", pcName,
+			(VCINGEST_COPY==ig->mode)?("copy"):("direct"), ig->probeDirectMBs, ig->probeCopyMBs,
+			(ig->frameCount>0)?((F32)ig->copyNS / ig->frameCount / 1000000):(0.0f));
+
+	return(1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Takes a free Slot of a Frame Arena.
+*
+*  Returns NULL if all slots are in use. Release it by frame_slot_release().
+*/
+/*-----------------------------------------------------------------------------*/
+VCFrameSlot *frame_arena_acquire(VCFrameArena *arena)
+{
+	I32  i;
+
+	for(i= 0; i< arena->slotCount; i++)
+	{
+		if(__sync_bool_compare_and_swap(&arena->slot[i].refCount, 0, 1))
+		{
+			return(&arena->slot[i]);
+		}
+	}
+
+	return(NULL);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Drops a Reference to a Frame Arena Slot.
+*/
+/*-----------------------------------------------------------------------------*/
+void  frame_slot_release(VCFrameSlot *slot)
+{
+	__sync_fetch_and_sub(&slot->refCount, 1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Fills the Remap Table of an Eye, Tile by Tile.
+*
+*  Rectified pixels whose source is outside the capture become VCRECT_INVALID,
+*  the last row and column are reached by a weight of 15/16.
+*
+* @param  srcX0  First column of the eye in a side by side capture.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  rectify_build_table(U32 *map, const VCStereoEye *e, I32 dx, I32 dy, I32 srcX0, I32 pitch, I32 stride)
+{
+	I32  tx, ty, tw, th, u, v, x0, y0, sx, sy;
+	F64  x, y, wx, wy, w, r2, radial, xd, yd, fsx, fsy;
+
+	for(ty= 0; ty*VCRECT_TILE_H < dy; ty++)
+	{
+		th = min(VCRECT_TILE_H, dy - ty*VCRECT_TILE_H);
+
+		for(tx= 0; tx*VCRECT_TILE_W < dx; tx++)
+		{
+			tw = min(VCRECT_TILE_W, dx - tx*VCRECT_TILE_W);
+
+			for(v= ty*VCRECT_TILE_H; v< ty*VCRECT_TILE_H + th; v++)
+			{
+				for(u= tx*VCRECT_TILE_W; u< tx*VCRECT_TILE_W + tw; u++)
+				{
+					// Ray of the rectified pixel in camera coordinates.
+					x  = (u - e->p[2]) / e->p[0];
+					y  = (v - e->p[3]) / e->p[1];
+					wx = e->r[0]*x + e->r[3]*y + e->r[6];
+					wy = e->r[1]*x + e->r[4]*y + e->r[7];
+					w  = e->r[2]*x + e->r[5]*y + e->r[8];
+					if(w<=1e-6){ *map++ = VCRECT_INVALID; continue; }
+					x  = wx / w;
+					y  = wy / w;
+
+					// Lens distortion and projection onto the sensor, in 1/16 pixels.
+					r2     = x*x + y*y;
+					radial = 1 + r2*(e->dist[0] + r2*(e->dist[1] + r2*e->dist[4]));
+					xd     = x*radial + 2*e->dist[2]*x*y + e->dist[3]*(r2 + 2*x*x);
+					yd     = y*radial + e->dist[2]*(r2 + 2*y*y) + 2*e->dist[3]*x*y;
+					fsx    = (e->k[0]*xd + e->k[2]) * 16 + 0.5;
+					fsy    = (e->k[1]*yd + e->k[3]) * 16 + 0.5;
+					if(!((fsx>=0)&&(fsx< (dx-1)*16+1)&&(fsy>=0)&&(fsy< (dy-1)*16+1))){ *map++ = VCRECT_INVALID; continue; }
+
+					sx = (I32)fsx;
+					sy = (I32)fsy;
+					x0 = min(sx>>4, dx-2);
+					y0 = min(sy>>4, dy-2);
+
+					*map++ = ((U32)(y0*pitch + (srcX0 + x0)*stride) << 8) | ((U32)min(sy - y0*16, 15) << 4) | (U32)min(sx - x0*16, 15);
+				}
+			}
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sets up the Rectification of the Eyes captured by a Camera.
+*
+*  This function builds the remap tables for the layout of the images
+*  of the frame arena, and allocates the rectified images of each slot.
+*
+* @param  firstEye  Eye of the camera, or of its left half: 0 left, 1 right.
+* @param  eyeCount  2 if the camera captures both eyes side by side.
+*/
+/*-----------------------------------------------------------------------------*/
+int  rectify_init(VCRectify *rect, const VCStereoCalib *sc, I32 firstEye, I32 eyeCount, VCFrameArena *arena)
+{
+	I32     ee, i, t;
+	image  *img, *imgRect;
+	size_t  pixelCount = (size_t)sc->dx * sc->dy;
+
+	rect->eyeCount = 0;
+	if((arena->slotCount<1)||(firstEye + eyeCount > 2)){ee=-1; goto fail;}
+
+	img = &arena->slot[0].img;
+	if((img->dx < eyeCount * sc->dx)||(img->dy != sc->dy)){ee=-2; goto fail;}
+	// The byte offsets of the table entries have 24 bits.
+	if((size_t)img->dy * img->pitch > (1u<<24)){ee=-3; goto fail;}
+
+	rect->dx     = sc->dx;
+	rect->dy     = sc->dy;
+	rect->pitch  = img->pitch;
+	rect->stride = image_pixel_stride(img);
+
+	for(t= 0; t< eyeCount; t++)
+	{
+		rect->eye[t] = firstEye + t;
+		rect->map[t] = (U32*)frame_arena_alloc_plane(pixelCount * sizeof(U32), 0);
+		if(NULL==rect->map[t]){ee=-4; goto fail;}
+
+		rectify_build_table(rect->map[t], &sc->eye[firstEye + t], sc->dx, sc->dy, t * sc->dx, rect->pitch, rect->stride);
+	}
+
+	for(i= 0; i< arena->slotCount; i++)
+	{
+		for(t= 0; t< eyeCount; t++)
+		{
+			imgRect        = &arena->slot[i].imgRect[t];
+			imgRect->type  = IMAGE_GREY;
+			imgRect->dx    = sc->dx;
+			imgRect->dy    = sc->dy;
+			imgRect->pitch = sc->dx;
+			imgRect->st    = frame_arena_alloc_plane(pixelCount, 1);
+			if(NULL==imgRect->st){ee=-4; goto fail;}
+		}
+	}
+	rect->eyeCount = eyeCount;
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case  0: break;
+		case -2: syslog(LOG_ERR, "%s():  Captures of %dx%d do not fit %d eyes of %dx%d!\n", __FUNCTION__, img->dx, img->dy, eyeCount, sc->dx, sc->dy); break;
+		case -4: syslog(LOG_ERR, "%s():  Out of Memory!\n", __FUNCTION__); break;
+		default: syslog(LOG_ERR, "%s():  Error %d!\n", __FUNCTION__, ee); break;
+	}
+	if(ee<0)
+	{
+		rectify_destroy(rect);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Frees the Remap Tables, the rectified Images go with the Frame Arena.
+*/
+/*-----------------------------------------------------------------------------*/
+void  rectify_destroy(VCRectify *rect)
+{
+	free(rect->map[0]);
+	free(rect->map[1]);
+	rect->map[0]   = NULL;
+	rect->map[1]   = NULL;
+	rect->eyeCount = 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Interpolates one Pixel by a Remap Table Entry.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline U8  rectify_pixel(U32 e, const U8 *src, I32 pitch, I32 stride)
+{
+	const U8 *p;
+	U32       fx = e & 15, fy = (e>>4) & 15;
+	U32       top, bottom;
+
+	if(VCRECT_INVALID==e){ return(0); }
+	p = src + (e>>8);
+
+	top    = p[0]     * (16 - fx) + p[stride]         * fx;
+	bottom = p[pitch] * (16 - fx) + p[pitch + stride] * fx;
+
+	return((U8)((top * (16 - fy) + bottom * fy + 128) >> 8));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Interpolates a Run of Pixels by consecutive Remap Table Entries.
+*
+*  The four source pixels of 8 entries are gathered, then interpolated
+*  as 8 lanes of 16 bits.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  rectify_run(const U32 *map, const U8 *src, U8 *dst, I32 count, I32 pitch, I32 stride)
+{
+	typedef U16  VCVec8 __attribute__((vector_size(16)));
+	VCVec8     a, b, c, d, fx, fy;
+	U16        va[8], vb[8], vc[8], vd[8], vx[8], vy[8];
+	const U8  *p;
+	U32        e;
+	I32        i, k;
+
+	for(i= 0; i+8 <= count; i+= 8)
+	{
+		for(k= 0; k< 8; k++)
+		{
+			e = map[i+k];
+			if(VCRECT_INVALID==e)
+			{
+				va[k] = vb[k] = vc[k] = vd[k] = vx[k] = vy[k] = 0;
+				continue;
+			}
+			p     = src + (e>>8);
+			va[k] = p[0];
+			vb[k] = p[stride];
+			vc[k] = p[pitch];
+			vd[k] = p[pitch + stride];
+			vx[k] = e & 15;
+			vy[k] = (e>>4) & 15;
+		}
+		memcpy(&a,  va, 16);
+		memcpy(&b,  vb, 16);
+		memcpy(&c,  vc, 16);
+		memcpy(&d,  vd, 16);
+		memcpy(&fx, vx, 16);
+		memcpy(&fy, vy, 16);
+
+		a = a * (16 - fx) + b * fx;
+		c = c * (16 - fx) + d * fx;
+		a = (a * (16 - fy) + c * fy + 128) >> 8;
+
+		for(k= 0; k< 8; k++)
+		{
+			dst[i+k] = (U8)a[k];
+		}
+	}
+	for(; i< count; i++)
+	{
+		dst[i] = rectify_pixel(map[i], src, pitch, stride);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Rectifies the Tile Rows of an Eye within the Rows  y0 <= y < y1.
+*
+*  y0 is a multiple of VCRECT_TILE_H.
+*
+* @param  t    Table of the rectification, 1 for the right half of a side by side capture.
+* @param  src  Converted capture, its green channel for colour.
+*/
+/*-----------------------------------------------------------------------------*/
+void  rectify_band(const VCRectify *rect, I32 t, const U8 *src, image *dst, I32 y0, I32 y1)
+{
+	const U32 *map;
+	I32        tx, ty, tw, th, y;
+
+	y1 = min(y1, rect->dy);
+
+	for(ty= y0 / VCRECT_TILE_H; ty*VCRECT_TILE_H < y1; ty++)
+	{
+		th  = min(VCRECT_TILE_H, rect->dy - ty*VCRECT_TILE_H);
+		map = rect->map[t] + (size_t)ty * VCRECT_TILE_H * rect->dx;
+
+		for(tx= 0; tx*VCRECT_TILE_W < rect->dx; tx++)
+		{
+			tw = min(VCRECT_TILE_W, rect->dx - tx*VCRECT_TILE_W);
+
+			for(y= ty*VCRECT_TILE_H; y< ty*VCRECT_TILE_H + th; y++)
+			{
+				rectify_run(map, src, (U8*)dst->st + y * dst->pitch + tx*VCRECT_TILE_W, tw, rect->pitch, rect->stride);
+				map += tw;
+			}
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sets up the Block Matching of rectified Eyes of dx x dy Pixels.
+*
+* @param  cfg          Range, window, costs and check, as set by -D.
+* @param  workerCount  Workers of the pool, each one gets its own row sums.
+*/
+/*-----------------------------------------------------------------------------*/
+int  stereo_init(VCStereo *st, const VCStereo *cfg, I32 dx, I32 dy, I32 workerCount)
+{
+	I32       ee, e;
+	VCStereo  stNuller = NULL_VCStereo;
+
+	*st             = stNuller;
+	st->dispCount   = cfg->dispCount;
+	st->radius      = cfg->radius;
+	st->censusIff1  = cfg->censusIff1;
+	st->lrCheckIff1 = cfg->lrCheckIff1;
+	st->dx          = dx;
+	st->dy          = dy;
+	if((st->dispCount<8)||(st->dispCount>VCDISP_MAX)||(0!=(st->dispCount & 7))){ee=-1; goto fail;}
+	if((st->radius<1)||(st->radius>VCDISP_RADIUS_MAX)||(dx <= st->dispCount + 2*st->radius)||(dy <= 2*st->radius)){ee=-1; goto fail;}
+
+	// Column sums of all disparities, the window sums, the rows added and
+	// subtracted, and the rows of the left right check, all 16 bit.
+	st->scratchBytes = (((size_t)(dx + 1) * st->dispCount + 2 * (2*dx + st->dispCount) + 2 * (dx + st->dispCount) + dx) * sizeof(I16) + 63) & ~(size_t)63;
+	st->scratch      = frame_arena_alloc_plane(st->scratchBytes * workerCount, 1);
+	if(NULL==st->scratch){ee=-2; goto fail;}
+
+	for(e= 0; e< 2; e++)
+	{
+		st->pending[e].type  = IMAGE_GREY;
+		st->pending[e].dx    = dx;
+		st->pending[e].dy    = dy;
+		st->pending[e].pitch = dx;
+		st->pending[e].st    = frame_arena_alloc_plane(dx * dy, 1);
+		if(NULL==st->pending[e].st){ee=-2; goto fail;}
+
+		// Zeroed once, the census of the border pixels is never written.
+		if(1==st->censusIff1)
+		{
+			st->census[e] = (U16*)frame_arena_alloc_plane(dx * dy * sizeof(U16), 1);
+			if(NULL==st->census[e]){ee=-2; goto fail;}
+		}
+	}
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case  0: break;
+		case -1: syslog(LOG_ERR, "%s():  Disparity range %d and radius %d do not fit %dx%d!\n", __FUNCTION__, st->dispCount, st->radius, dx, dy); break;
+		default: syslog(LOG_ERR, "%s():  Out of Memory!\n", __FUNCTION__); break;
+	}
+	if(ee<0)
+	{
+		stereo_destroy(st);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Lets the Captures of a Camera take Part in the Block Matching.
+*
+*  This function allocates the disparity images of the slots of the
+*  camera's frame arena, one of them receives the disparity of a pair.
+*/
+/*-----------------------------------------------------------------------------*/
+int  stereo_attach(VCStereo *st, VCRectify *rect, VCFrameArena *arena)
+{
+	I32  i;
+
+	if((rect->dx!=st->dx)||(rect->dy!=st->dy)){ return(-1); }
+
+	for(i= 0; i< arena->slotCount; i++)
+	{
+		arena->slot[i].disp = (U16*)frame_arena_alloc_plane(st->dx * st->dy * sizeof(U16), 1);
+		if(NULL==arena->slot[i].disp){ return(-2); }
+	}
+	rect->stereo = st;
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Frees the Buffers of the Block Matching, Disparity Images go with the Frame Arenas.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stereo_destroy(VCStereo *st)
+{
+	free(st->scratch);
+	free(st->pending[0].st);
+	free(st->pending[1].st);
+	free(st->census[0]);
+	free(st->census[1]);
+	st->scratch        = NULL;
+	st->pending[0].st  = NULL;
+	st->pending[1].st  = NULL;
+	st->census[0]      = NULL;
+	st->census[1]      = NULL;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Finds the other Eye of the Capture being processed.
+*
+*  A side by side capture holds both eyes. Otherwise the other eye is
+*  the one waiting in pending, if captured within VCSTEREO_SKEW_NS,
+*  it is taken out of pending then.
+*
+* @param  imgEye  Receives the rectified left and right eye.
+* @return 1 if the pair is complete, else 0.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  stereo_pair(VCStereo *st, const VCRectify *rect, VCFrameSlot *slot, const image **imgEye)
+{
+	I32  e = rect->eye[0], o = 1 - rect->eye[0];
+	U64  skew;
+
+	if(2==rect->eyeCount)
+	{
+		imgEye[rect->eye[0]] = &slot->imgRect[0];
+		imgEye[rect->eye[1]] = &slot->imgRect[1];
+		return(1);
+	}
+
+	if(0==st->pendingNS[o]){ return(0); }
+
+	skew = (st->pendingNS[o] > rect->captureNS)?(st->pendingNS[o] - rect->captureNS):(rect->captureNS - st->pendingNS[o]);
+	if(skew > VCSTEREO_SKEW_NS){ return(0); }
+
+	imgEye[e]        = &slot->imgRect[0];
+	imgEye[o]        = &st->pending[o];
+	st->pendingNS[o] = 0;
+
+	return(1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Keeps the rectified Eye of an unpaired Capture until the other Eye comes.
+*
+*  The eye is copied, so the slot stays free for the outputs and the
+*  frame arena needs no further slots.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stereo_keep(VCStereo *st, const VCRectify *rect, const VCFrameSlot *slot)
+{
+	I32  e = rect->eye[0];
+
+	if(0!=st->pendingNS[e]){ st->unpairedCount++; }
+
+	memcpy(st->pending[e].st, slot->imgRect[0].st, st->dx * st->dy);
+	st->pendingNS[e] = max(rect->captureNS, 1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Census Transform of the Rows  y0 <= y < y1  of both Eyes.
+*
+*  16 bits per pixel, one for each pixel of the outer ring of its 5x5
+*  window, set if darker than the centre. 16 columns are compared at once.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stereo_census_band(VCStereo *st, const image **imgEye, I32 y0, I32 y1)
+{
+	typedef U8  VCVec16 __attribute__((vector_size(16)));
+	static const I8  ring[16][2] = { {-2,-2}, {-1,-2}, {0,-2}, {1,-2}, {2,-2}, {2,-1}, {2,0}, {2,1},
+	                                 { 2, 2}, { 1, 2}, {0, 2}, {-1,2}, {-2,2}, {-2,1}, {-2,0}, {-2,-1} };
+	VCVec16    c, n, hi, lo;
+	const U8  *row;
+	U16       *out, bits;
+	I32        e, x, y, k, pitch;
+
+	for(e= 0; e< 2; e++)
+	{
+		pitch = imgEye[e]->pitch;
+
+		for(y= max(y0, 2); y< min(y1, st->dy - 2); y++)
+		{
+			row = (const U8*)imgEye[e]->st + y * pitch;
+			out = st->census[e] + y * st->dx;
+
+			for(x= 2; x+16 <= st->dx - 2; x+= 16)
+			{
+				memcpy(&c, row + x, 16);
+				hi = lo = c ^ c;
+				for(k= 0; k< 16; k++)
+				{
+					memcpy(&n, row + ring[k][1] * pitch + ring[k][0] + x, 16);
+					if(k<8){ hi = (hi << 1) | ((VCVec16)(n < c) & 1); }
+					else   { lo = (lo << 1) | ((VCVec16)(n < c) & 1); }
+				}
+				for(k= 0; k< 16; k++)
+				{
+					out[x+k] = (hi[k] << 8) | lo[k];
+				}
+			}
+			for(; x< st->dx - 2; x++)
+			{
+				bits = 0;
+				for(k= 0; k< 16; k++)
+				{
+					bits = (bits << 1) | (row[ring[k][1] * pitch + ring[k][0] + x] < row[x]);
+				}
+				out[x] = bits;
+			}
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Loads the Left Row and the reversed Right Row a Cost Row is made of.
+*
+*  Grey values, or census for census costs. The right row is reversed, so
+*  the right pixels x - d of all disparities of x are consecutive. It is
+*  padded by dispCount zeros for the disparities beyond the left border.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stereo_load_row(const VCStereo *st, const image **imgEye, I16 *row, I32 y)
+{
+	I32        W = st->dx, k;
+	const U8  *l, *r;
+
+	if(1==st->censusIff1)
+	{
+		for(k= 0; k< W; k++)
+		{
+			row[k]     = (I16)st->census[0][y * W + k];
+			row[W + k] = (I16)st->census[1][y * W + W-1-k];
+		}
+	}
+	else
+	{
+		l = (const U8*)imgEye[0]->st + y * imgEye[0]->pitch;
+		r = (const U8*)imgEye[1]->st + y * imgEye[1]->pitch;
+		for(k= 0; k< W; k++)
+		{
+			row[k]     = l[k];
+			row[W + k] = r[W-1-k];
+		}
+	}
+	memset(row + 2*W, 0, st->dispCount * sizeof(I16));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Adds the Costs of Row yAdd to the Column Sums and subtracts those of Row ySub.
+*
+*  colSum holds dispCount sums per column x, of the costs of the left pixel
+*  x and the right pixel x - d, in 16 bit lanes of 8 disparities: |l - r|
+*  for SAD, the count of differing census bits otherwise.
+*
+* @param  rowAdd  Scratch of 2 dx + dispCount values, as rowSub.
+* @param  ySub    Row leaving the window, -1 if none.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stereo_update_columns(const VCStereo *st, const image **imgEye, I16 *colSum, I16 *rowAdd, I16 *rowSub, I32 yAdd, I32 ySub)
+{
+	typedef I16  VCVec8s __attribute__((vector_size(16)));
+	typedef U16  VCVec8u __attribute__((vector_size(16)));
+	VCVec8s     zero = {0}, lAdd, lSub, r, cost, sign, sum;
+	VCVec8u     bits;
+	I32         W = st->dx, D = st->dispCount, x, d, i, n;
+	const I16  *q;
+	I16        *cs;
+
+	stereo_load_row(st, imgEye, rowAdd, yAdd);
+	if(ySub>=0)
+	{
+		stereo_load_row(st, imgEye, rowSub, ySub);
+	}
+
+	for(x= 0; x< W; x++)
+	{
+		cs   = colSum + x * D;
+		lAdd = zero + rowAdd[x];
+		lSub = zero + (I16)((ySub>=0)?(rowSub[x]):(0));
+
+		for(d= 0; d< D; d+= 8)
+		{
+			memcpy(&sum, cs + d, 16);
+
+			// Once for the row entering, once for the row leaving the window.
+			for(i= 0, n= (ySub>=0)?(2):(1); i< n; i++)
+			{
+				q = (0==i)?(rowAdd):(rowSub);
+				memcpy(&r, q + W + W-1-x + d, 16);
+				if(1==st->censusIff1)
+				{
+					bits = (VCVec8u)(((0==i)?(lAdd):(lSub)) ^ r);
+					bits = bits - ((bits >> 1) & 0x5555);
+					bits = (bits & 0x3333) + ((bits >> 2) & 0x3333);
+					bits = (bits + (bits >> 4)) & 0x0F0F;
+					cost = (VCVec8s)((bits + (bits >> 8)) & 0x1F);
+				}
+				else
+				{
+					cost = ((0==i)?(lAdd):(lSub)) - r;
+					sign = cost >> 15;
+					cost = (cost ^ sign) - sign;
+				}
+				if(0==i){ sum += cost; }
+				else    { sum -= cost; }
+			}
+
+			memcpy(cs + d, &sum, 16);
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Finds the Disparity of each Pixel of a Row from the Column Sums.
+*
+*  The window sums of all disparities are updated column by column.
+*  Only disparities whose window lies inside the right eye are searched,
+*  the first minimum wins. It is refined by a parabola through its
+*  neighbours to 1/16 pixel. For the left right check the best match of
+*  each right pixel is collected on the way, in arrays reversed like the
+*  right rows, so 8 disparities are compared at once. Left pixels whose
+*  right pixel matches a disparity more than 1 apart are dropped.
+*
+* @param  minRCost  Scratch of dx + dispCount values, as minRDisp.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stereo_match_row(const VCStereo *st, const I16 *colSum, I16 *win, I16 *minRCost, I16 *minRDisp, I16 *best, U16 *out)
+{
+	typedef I16  VCVec8s __attribute__((vector_size(16)));
+	VCVec8s  lane = {0, 1, 2, 3, 4, 5, 6, 7};
+	VCVec8s  v, w, m, mv, mi, rc, rd;
+	I32      W = st->dx, D = st->dispCount, r = st->radius;
+	I32      x, d, k, q, dMax, bd, minCost, c0, c2, den, sub;
+
+	for(x= 0; x< W; x++)
+	{
+		out[x] = VCDISP_INVALID;
+	}
+	if(1==st->lrCheckIff1)
+	{
+		for(x= 0; x< W + D; x++)
+		{
+			minRCost[x] = 0x7FFF;
+			minRDisp[x] = -2;
+		}
+	}
+
+	memset(win, 0, D * sizeof(I16));
+	for(x= 0; x< 2*r; x++)
+	{
+		for(d= 0; d< D; d+= 8)
+		{
+			memcpy(&w, win + d, 16);
+			memcpy(&v, colSum + x * D + d, 16);
+			w += v;
+			memcpy(win + d, &w, 16);
+		}
+	}
+
+	for(x= r; x< W-r; x++)
+	{
+		for(d= 0; d< D; d+= 8)
+		{
+			memcpy(&w, win + d, 16);
+			memcpy(&v, colSum + (x+r) * D + d, 16);
+			w += v;
+			memcpy(win + d, &w, 16);
+		}
+
+		dMax = min(D-1, x-r);
+		q    = W-1-x;  // Reversed index of the right pixel of disparity 0.
+		if(D-1==dMax)
+		{
+			// Minimum and its disparity per lane, then over the lanes.
+			memcpy(&mv, win, 16);
+			mi = lane;
+			for(d= 8; d< D; d+= 8)
+			{
+				memcpy(&v, win + d, 16);
+				m  = v < mv;
+				mv = (v & m) | (mv & ~m);
+				mi = ((lane + (I16)d) & m) | (mi & ~m);
+			}
+			minCost = mv[0];
+			bd      = mi[0];
+			for(k= 1; k< 8; k++)
+			{
+				if((mv[k] < minCost)||((mv[k]==minCost)&&(mi[k] < bd))){ minCost = mv[k]; bd = mi[k]; }
+			}
+
+			if(1==st->lrCheckIff1)
+			{
+				for(d= 0; d< D; d+= 8)
+				{
+					memcpy(&v,  win + d, 16);
+					memcpy(&rc, minRCost + q + d, 16);
+					memcpy(&rd, minRDisp + q + d, 16);
+					m  = v < rc;
+					rc = (v & m) | (rc & ~m);
+					rd = ((lane + (I16)d) & m) | (rd & ~m);
+					memcpy(minRCost + q + d, &rc, 16);
+					memcpy(minRDisp + q + d, &rd, 16);
+				}
+			}
+		}
+		else
+		{
+			bd = 0;
+			for(d= 1; d<= dMax; d++){ if(win[d] < win[bd]){ bd = d; } }
+			minCost = win[bd];
+
+			if(1==st->lrCheckIff1)
+			{
+				for(d= 0; d<= dMax; d++)
+				{
+					if(win[d] < minRCost[q + d]){ minRCost[q + d] = win[d]; minRDisp[q + d] = d; }
+				}
+			}
+		}
+
+		sub = 0;
+		if((bd>0)&&(bd<dMax))
+		{
+			c0  = win[bd-1];
+			c2  = win[bd+1];
+			den = c0 + c2 - 2*minCost;
+			if(den>0){ sub = (8 * (c0 - c2)) / den; }
+		}
+		out[x]  = (U16)max(bd * 16 + sub, 0);
+		best[x] = bd;
+
+		for(d= 0; d< D; d+= 8)
+		{
+			memcpy(&w, win + d, 16);
+			memcpy(&v, colSum + (x-r) * D + d, 16);
+			w -= v;
+			memcpy(win + d, &w, 16);
+		}
+	}
+
+	if(1==st->lrCheckIff1)
+	{
+		for(x= r; x< W-r; x++)
+		{
+			if(abs(minRDisp[W-1-(x - best[x])] - best[x]) > 1){ out[x] = VCDISP_INVALID; }
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Computes the Disparity of the Rows  y0 <= y < y1.
+*
+*  The column sums of the band's first row are built from scratch, then
+*  moved down row by row by adding the row entering the window and
+*  subtracting the one leaving it. Rows and columns closer than the window
+*  radius to the border, and pixels without match, are VCDISP_INVALID.
+*
+* @param  disp       Disparity image, in 1/16 pixels of the left eye.
+* @param  workerIdx  Selects the row sums of the worker.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stereo_disparity_band(VCStereo *st, const image **imgEye, U16 *disp, I32 y0, I32 y1, I32 workerIdx)
+{
+	I32   W = st->dx, D = st->dispCount, r = st->radius;
+	I32   x, y, ys, ye;
+	I16  *colSum   = (I16*)(st->scratch + st->scratchBytes * workerIdx);
+	I16  *win      = colSum + W * D;
+	I16  *rowAdd   = win + D;
+	I16  *rowSub   = rowAdd + 2*W + D;
+	I16  *minRCost = rowSub + 2*W + D;
+	I16  *minRDisp = minRCost + W + D;
+	I16  *best     = minRDisp + W + D;
+
+	y1 = min(y1, st->dy);
+	ys = max(y0, r);
+	ye = min(y1, st->dy - r);
+
+	for(y= y0; y< y1; y++)
+	{
+		if((y<ys)||(y>=ye))
+		{
+			for(x= 0; x< W; x++){ disp[y * W + x] = VCDISP_INVALID; }
+		}
+	}
+	if(ys>=ye){ return; }
+
+	memset(colSum, 0, W * D * sizeof(I16));
+	for(y= ys-r; y<= ys+r; y++)
+	{
+		stereo_update_columns(st, imgEye, colSum, rowAdd, rowSub, y, -1);
+	}
+
+	for(y= ys; y< ye; y++)
+	{
+		if(y>ys)
+		{
+			stereo_update_columns(st, imgEye, colSum, rowAdd, rowSub, y+r, y-r-1);
+		}
+		stereo_match_row(st, colSum, win, minRCost, minRDisp, best, disp + y * W);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Matching Time per Pair and the Pairing of the Eyes.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  stereo_print_stats(const char *pcName, VCStereo *st)
+{
+	I32  lines = latency_stats_print(pcName, &st->latDisparity);
+
+	printf("  %-22s %8llu Pairs, %llu eyes unpaired, disparity 0..%d, %dx%d %s windows%s.\n", pcName,
+			(unsigned long long)st->pairCount, (unsigned long long)st->unpairedCount, st->dispCount-1,
+			2*st->radius+1, 2*st->radius+1, (1==st->censusIff1)?("census"):("SAD"), (1==st->lrCheckIff1)?(", left right checked"):(""));
+
+	return(lines + 1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sets up the Code of each Symbol from the Code Lengths of a Huffman Table (Annex C).
+*
+* @param  bits  Count of Codes of 1..16 Bits.
+* @param  val   Symbols by increasing Code Length.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  jpeg_huff_build(VCJpegHuff *h, const U8 *bits, const U8 *val)
+{
+	I32  len, i, k = 0;
+	U32  code = 0;
+
+	memset(h, 0, sizeof(VCJpegHuff));
+	for(len= 1; len<= 16; len++)
+	{
+		for(i= 0; i< bits[len-1]; i++, k++)
+		{
+			h->code[val[k]] = code++;
+			h->size[val[k]] = len;
+		}
+		code <<= 1;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Appends a Marker Segment Header of the given Length to the JPEG Header.
+*/
+/*-----------------------------------------------------------------------------*/
+static U8 *jpeg_put_marker(U8 *p, U8 marker, I32 length)
+{
+	*p++ = 0xFF;
+	*p++ = marker;
+	*p++ = (U8)(length >> 8);
+	*p++ = (U8)(length);
+
+	return(p);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sets up the JPEG Encoder of a Camera and the JPEG Buffers of its Frame Arena.
+*
+*  The quantizers are the tables of Annex K scaled to the quality as by
+*  the IJG, the Huffman tables those of Annex K. The headers are the
+*  same for every frame, so they are written to each slot's buffer once,
+*  the slices follow them. The buffers hold the worst case, most of it
+*  is never touched.
+*
+* @param  cfg  Quality and restart rows, as set by -J.
+*/
+/*-----------------------------------------------------------------------------*/
+int  jpeg_init(VCJpeg *jp, const VCJpeg *cfg, VCFrameArena *arena)
+{
+	static const U8  quantBase[2][64] = {
+		{ 16, 11, 10, 16, 24, 40, 51, 61,  12, 12, 14, 19, 26, 58, 60, 55,  14, 13, 16, 24, 40, 57, 69, 56,  14, 17, 22, 29, 51, 87, 80, 62,
+		  18, 22, 37, 56, 68,109,103, 77,  24, 35, 55, 64, 81,104,113, 92,  49, 64, 78, 87,103,121,120,101,  72, 92, 95, 98,112,100,103, 99 },
+		{ 17, 18, 24, 47, 99, 99, 99, 99,  18, 21, 26, 66, 99, 99, 99, 99,  24, 26, 56, 99, 99, 99, 99, 99,  47, 66, 99, 99, 99, 99, 99, 99,
+		  99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99 } };
+	static const U8  dcBits[2][16] = { {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0}, {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0} };
+	static const U8  dcVal[12]     = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+	static const U8  acBits[2][16] = { {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D}, {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77} };
+	static const U8  acVal[2][162] = {
+		{ 0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xA1,0x08,
+		  0x23,0x42,0xB1,0xC1,0x15,0x52,0xD1,0xF0,0x24,0x33,0x62,0x72,0x82,0x09,0x0A,0x16,0x17,0x18,0x19,0x1A,0x25,0x26,0x27,0x28,
+		  0x29,0x2A,0x34,0x35,0x36,0x37,0x38,0x39,0x3A,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
+		  0x5A,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6A,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7A,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+		  0x8A,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9A,0xA2,0xA3,0xA4,0xA5,0xA6,0xA7,0xA8,0xA9,0xAA,0xB2,0xB3,0xB4,0xB5,0xB6,
+		  0xB7,0xB8,0xB9,0xBA,0xC2,0xC3,0xC4,0xC5,0xC6,0xC7,0xC8,0xC9,0xCA,0xD2,0xD3,0xD4,0xD5,0xD6,0xD7,0xD8,0xD9,0xDA,0xE1,0xE2,
+		  0xE3,0xE4,0xE5,0xE6,0xE7,0xE8,0xE9,0xEA,0xF1,0xF2,0xF3,0xF4,0xF5,0xF6,0xF7,0xF8,0xF9,0xFA },
+		{ 0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,
+		  0xA1,0xB1,0xC1,0x09,0x23,0x33,0x52,0xF0,0x15,0x62,0x72,0xD1,0x0A,0x16,0x24,0x34,0xE1,0x25,0xF1,0x17,0x18,0x19,0x1A,0x26,
+		  0x27,0x28,0x29,0x2A,0x35,0x36,0x37,0x38,0x39,0x3A,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x53,0x54,0x55,0x56,0x57,0x58,
+		  0x59,0x5A,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6A,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7A,0x82,0x83,0x84,0x85,0x86,0x87,
+		  0x88,0x89,0x8A,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9A,0xA2,0xA3,0xA4,0xA5,0xA6,0xA7,0xA8,0xA9,0xAA,0xB2,0xB3,0xB4,
+		  0xB5,0xB6,0xB7,0xB8,0xB9,0xBA,0xC2,0xC3,0xC4,0xC5,0xC6,0xC7,0xC8,0xC9,0xCA,0xD2,0xD3,0xD4,0xD5,0xD6,0xD7,0xD8,0xD9,0xDA,
+		  0xE2,0xE3,0xE4,0xE5,0xE6,0xE7,0xE8,0xE9,0xEA,0xF2,0xF3,0xF4,0xF5,0xF6,0xF7,0xF8,0xF9,0xFA } };
+	const image  *img = &arena->slot[0].img;
+	I32           ee, i, t, k, n, q, scale, tableCount, compCount, mcuRows;
+	U8            quant[2][64];
+	U8           *p;
+
+	*jp             = *cfg;
+	jp->sliceBytes  = NULL;
+	jp->quality     = min(max(jp->quality, 1), 100);
+	jp->dx          = img->dx;
+	jp->dy          = img->dy;
+	jp->colourIff1  = (IMAGE_GREY!=img->type)?(1):(0);
+	jp->mcuSize     = (1==jp->colourIff1)?(16):(8);
+	jp->mcuCols     = (jp->dx + jp->mcuSize - 1) / jp->mcuSize;
+	mcuRows         = (jp->dy + jp->mcuSize - 1) / jp->mcuSize;
+	jp->restartRows = min(max(jp->restartRows, 1), mcuRows);
+	jp->sliceCount  = (mcuRows + jp->restartRows - 1) / jp->restartRows;
+	jp->sliceCap    = (size_t)jp->restartRows * jp->mcuCols * ((1==jp->colourIff1)?(6):(1)) * VCJPEG_BLOCK_MAX + 16;
+	tableCount      = (1==jp->colourIff1)?(2):(1);
+	compCount       = (1==jp->colourIff1)?(3):(1);
+	if((jp->dx>65535)||(jp->dy>65535)||(jp->restartRows * jp->mcuCols > 65535)){ee=-1; goto fail;}
+
+	// Quantizers as in the DQT segment, and the reciprocals of 8 times
+	// them, as the DCT leaves its coefficients 8 times too large.
+	scale = (jp->quality<50)?(5000 / jp->quality):(200 - 2 * jp->quality);
+	for(t= 0; t< 2; t++)
+	{
+		for(n= 0; n< 64; n++)
+		{
+			q = min(max((quantBase[t][n] * scale + 50) / 100, 1), 255);
+			quant[t][n] = (U8)q;
+			jp->recip[t][((n & 7) << 3) | (n >> 3)] = ((1 << 18) + 4 * q) / (8 * q);
+		}
+		jpeg_huff_build(&jp->dc[t], dcBits[t], dcVal);
+		jpeg_huff_build(&jp->ac[t], acBits[t], acVal[t]);
+	}
+
+	// SOI, JFIF, quantizers, frame, Huffman tables, restart interval and scan header.
+	p = jp->header;
+	*p++ = 0xFF;
+	*p++ = 0xD8;
+	p = jpeg_put_marker(p, 0xE0, 16);
+	memcpy(p, "JFIF\0\1\1\0\0\1\0\1\0\0", 14);
+	p += 14;
+	p = jpeg_put_marker(p, 0xDB, 2 + 65 * tableCount);
+	for(t= 0; t< tableCount; t++)
+	{
+		*p++ = t;
+		for(k= 0; k< 64; k++)
+		{
+			*p++ = quant[t][jpegNaturalOrder[k]];
+		}
+	}
+	p = jpeg_put_marker(p, 0xC0, 8 + 3 * compCount);
+	*p++ = 8;
+	*p++ = (U8)(jp->dy >> 8);  *p++ = (U8)jp->dy;
+	*p++ = (U8)(jp->dx >> 8);  *p++ = (U8)jp->dx;
+	*p++ = compCount;
+	for(i= 0; i< compCount; i++)
+	{
+		*p++ = 1 + i;
+		*p++ = ((0==i)&&(1==jp->colourIff1))?(0x22):(0x11);
+		*p++ = (0==i)?(0):(1);
+	}
+	for(t= 0; t< tableCount; t++)
+	{
+		p = jpeg_put_marker(p, 0xC4, 2 + 17 + 12);
+		*p++ = 0x00 | t;
+		memcpy(p, dcBits[t], 16);  p += 16;
+		memcpy(p, dcVal, 12);      p += 12;
+		p = jpeg_put_marker(p, 0xC4, 2 + 17 + 162);
+		*p++ = 0x10 | t;
+		memcpy(p, acBits[t], 16);  p += 16;
+		memcpy(p, acVal[t], 162);  p += 162;
+	}
+	p = jpeg_put_marker(p, 0xDD, 4);
+	*p++ = (U8)((jp->restartRows * jp->mcuCols) >> 8);
+	*p++ = (U8)(jp->restartRows * jp->mcuCols);
+	p = jpeg_put_marker(p, 0xDA, 6 + 2 * compCount);
+	*p++ = compCount;
+	for(i= 0; i< compCount; i++)
+	{
+		*p++ = 1 + i;
+		*p++ = (0==i)?(0x00):(0x11);
+	}
+	*p++ = 0;
+	*p++ = 63;
+	*p++ = 0;
+	jp->headerBytes = p - jp->header;
+	jp->bufSize     = jp->headerBytes + jp->sliceCount * jp->sliceCap + 2;
+
+	jp->sliceBytes = calloc(jp->sliceCount, sizeof(U32));
+	if(NULL==jp->sliceBytes){ee=-2; goto fail;}
+
+	for(i= 0; i< arena->slotCount; i++)
+	{
+		arena->slot[i].jpeg = frame_arena_alloc_plane(jp->bufSize, 0);
+		if(NULL==arena->slot[i].jpeg){ee=-2; goto fail;}
+		memcpy(arena->slot[i].jpeg, jp->header, jp->headerBytes);
+	}
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case  0:  break;
+		case -1:  syslog(LOG_ERR, "%s():  Captures of %dx%d pixels do not fit %d restart rows!\n", __FUNCTION__, jp->dx, jp->dy, jp->restartRows);  break;
+		default:  syslog(LOG_ERR, "%s():  Out of memory!\n", __FUNCTION__);  break;
+	}
+	if(ee<0)
+	{
+		jpeg_destroy(jp);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Frees the Slice Sizes of the JPEG Encoder, JPEG Buffers go with the Frame Arenas.
+*/
+/*-----------------------------------------------------------------------------*/
+void  jpeg_destroy(VCJpeg *jp)
+{
+	free(jp->sliceBytes);
+	jp->sliceBytes = NULL;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Appends size Bits of a Code to a Slice, 0xFF Bytes get a 0x00 stuffed.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  jpeg_put_bits(VCJpegBits *bw, U32 code, I32 size)
+{
+	U8  byte;
+
+	bw->acc  = (bw->acc << size) | code;
+	bw->bits += size;
+	while(bw->bits >= 8)
+	{
+		bw->bits -= 8;
+		byte      = (U8)(bw->acc >> bw->bits);
+		*bw->p++  = byte;
+		if(0xFF==byte){ *bw->p++ = 0x00; }
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Fetches count Pixels of a Channel Row, repeating the last Pixel past the Edge.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  jpeg_fetch_row(U8 *px, const U8 *row, I32 stride, I32 x0, I32 dx, I32 count)
+{
+	I32  i;
+
+	if((1==stride)&&(x0 + count <= dx))
+	{
+		memcpy(px, row + x0, count);
+		return;
+	}
+	for(i= 0; i< count; i++)
+	{
+		px[i] = row[min(x0 + i, dx - 1) * stride];
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts the 16x16 Pixels of an MCU to four Y and one Cb and Cr Block.
+*
+*  8 pixels are converted at once. Chroma is taken from the mean of
+*  2x2 pixels. All samples are level shifted by -128.
+*
+* @param  blk  Rows of the Blocks Y0, Y1, Y2, Y3, Cb and Cr.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  jpeg_load_mcu_ycc(const image *img, I32 x0, I32 y0, VCVec8i blk[6][8])
+{
+	typedef U8  VCVec8b __attribute__((vector_size(8)));
+	VCVec8b   v;
+	VCVec8i   r, g, b;
+	U8        px[3][16];
+	I32       sum[3][8];
+	U8       *ch[3];
+	I32       stride = image_pixel_stride(img);
+	I32       row, y, c, h, i;
+
+	image_channels(img, &ch[0], &ch[1], &ch[2]);
+	memset(sum, 0, sizeof(sum));
+
+	for(row= 0; row< 16; row++)
+	{
+		y = min(y0 + row, img->dy - 1);
+		for(c= 0; c< 3; c++)
+		{
+			jpeg_fetch_row(px[c], ch[c] + (size_t)y * img->pitch, stride, x0, img->dx, 16);
+		}
+
+		for(h= 0; h< 2; h++)
+		{
+			memcpy(&v, px[0] + 8*h, 8);  r = __builtin_convertvector(v, VCVec8i);
+			memcpy(&v, px[1] + 8*h, 8);  g = __builtin_convertvector(v, VCVec8i);
+			memcpy(&v, px[2] + 8*h, 8);  b = __builtin_convertvector(v, VCVec8i);
+			blk[(row >> 3) * 2 + h][row & 7] = ((19595 * r + 38470 * g + 7471 * b + 32768) >> 16) - 128;
+		}
+
+		for(c= 0; c< 3; c++)
+		{
+			for(i= 0; i< 8; i++)
+			{
+				sum[c][i] += px[c][2*i] + px[c][2*i+1];
+			}
+		}
+
+		// Sums of 4 pixels, so 4 times the weights.
+		if(1==(row & 1))
+		{
+			memcpy(&r, sum[0], sizeof(r));
+			memcpy(&g, sum[1], sizeof(g));
+			memcpy(&b, sum[2], sizeof(b));
+			blk[4][row >> 1] = (-11059 * r - 21709 * g + 32768 * b + (1 << 17)) >> 18;
+			blk[5][row >> 1] = ( 32768 * r - 27439 * g -  5329 * b + (1 << 17)) >> 18;
+			memset(sum, 0, sizeof(sum));
+		}
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Loads the 8x8 Pixels of a grey MCU, level shifted by -128.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  jpeg_load_mcu_grey(const image *img, I32 x0, I32 y0, VCVec8i *blk)
+{
+	typedef U8  VCVec8b __attribute__((vector_size(8)));
+	VCVec8b   v;
+	U8        px[8];
+	I32       row;
+
+	for(row= 0; row< 8; row++)
+	{
+		jpeg_fetch_row(px, (U8*)img->st + (size_t)min(y0 + row, img->dy - 1) * img->pitch, 1, x0, img->dx, 8);
+		memcpy(&v, px, 8);
+		blk[row] = __builtin_convertvector(v, VCVec8i) - 128;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  One Pass of the integer forward DCT of the IJG (Loeffler, Ligtenberg, Moschytz).
+*
+*  Transforms across the 8 vectors, so all 8 lanes at once. The first
+*  pass leaves its results 4 times larger, the second one 8 times.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  jpeg_fdct_pass(VCVec8i *d, I32 secondIff1)
+{
+	VCVec8i  t0, t1, t2, t3, t4, t5, t6, t7, t10, t11, t12, t13, z1, z2, z3, z4, z5;
+	I32      shift = (1==secondIff1)?(15):(11);
+	I32      round = 1 << (shift - 1);
+
+	t0 = d[0] + d[7];  t7 = d[0] - d[7];
+	t1 = d[1] + d[6];  t6 = d[1] - d[6];
+	t2 = d[2] + d[5];  t5 = d[2] - d[5];
+	t3 = d[3] + d[4];  t4 = d[3] - d[4];
+
+	t10 = t0 + t3;  t13 = t0 - t3;
+	t11 = t1 + t2;  t12 = t1 - t2;
+
+	if(1==secondIff1)
+	{
+		d[0] = (t10 + t11 + 2) >> 2;
+		d[4] = (t10 - t11 + 2) >> 2;
+	}
+	else
+	{
+		d[0] = (t10 + t11) << 2;
+		d[4] = (t10 - t11) << 2;
+	}
+
+	z1   = (t12 + t13) * 4433;
+	d[2] = (z1 + t13 *   6270  + round) >> shift;
+	d[6] = (z1 + t12 * (-15137) + round) >> shift;
+
+	z1 = t4 + t7;
+	z2 = t5 + t6;
+	z3 = t4 + t6;
+	z4 = t5 + t7;
+	z5 = (z3 + z4) * 9633;
+
+	t4 *=  2446;
+	t5 *= 16819;
+	t6 *= 25172;
+	t7 *= 12299;
+	z1 *= -7373;
+	z2 *= -20995;
+	z3  = z3 * -16069 + z5;
+	z4  = z4 *  -3196 + z5;
+
+	d[7] = (t4 + z1 + z3 + round) >> shift;
+	d[5] = (t5 + z2 + z4 + round) >> shift;
+	d[3] = (t6 + z2 + z3 + round) >> shift;
+	d[1] = (t7 + z1 + z4 + round) >> shift;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Transforms, quantizes and Huffman codes one Block.
+*
+*  The DCT runs down the columns, the block is transposed and it runs
+*  again. The coefficients are left transposed, the reciprocals of the
+*  quantizers and the zigzag scan follow that. Quantized coefficients
+*  are limited to the 11 bits baseline codes.
+*
+* @param  d     Rows of the level shifted Samples, overwritten.
+* @param  t     0: Luminance, 1: Chrominance Tables.
+* @param  pred  DC of the previous Block of the Component.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  jpeg_encode_block(const VCJpeg *jp, VCVec8i *d, I32 t, I32 *pred, VCJpegBits *bw)
+{
+	VCVec8i            recip, sign, a, m;
+	I32                coef[64], tmp[64];
+	I32                i, k, v, run, nbits, mag;
+	const VCJpegHuff  *dc = &jp->dc[t];
+	const VCJpegHuff  *ac = &jp->ac[t];
+
+	jpeg_fdct_pass(d, 0);
+	memcpy(tmp, d, sizeof(tmp));
+	for(i= 0; i< 64; i++)
+	{
+		coef[i] = tmp[((i & 7) << 3) | (i >> 3)];
+	}
+	memcpy(d, coef, sizeof(coef));
+	jpeg_fdct_pass(d, 1);
+
+	for(i= 0; i< 8; i++)
+	{
+		memcpy(&recip, &jp->recip[t][8*i], sizeof(recip));
+		sign = d[i] >> 31;
+		a    = (d[i] ^ sign) - sign;
+		a    = (a * recip + (1 << 17)) >> 18;
+		m    = a > 1023;
+		a    = (a & ~m) | (1023 & m);
+		d[i] = (a ^ sign) - sign;
+	}
+	memcpy(coef, d, sizeof(coef));
+
+	// DC difference, then runs of zeros and the AC coefficients in zigzag order.
+	v     = coef[0] - *pred;
+	*pred = coef[0];
+	mag   = (v<0)?(-v):(v);
+	nbits = (0==mag)?(0):(32 - __builtin_clz(mag));
+	if(v<0){ v--; }
+	jpeg_put_bits(bw, ((U32)dc->code[nbits] << nbits) | ((U32)v & ((1u << nbits) - 1)), dc->size[nbits] + nbits);
+
+	run = 0;
+	for(k= 1; k< 64; k++)
+	{
+		i = jpegNaturalOrder[k];
+		v = coef[((i & 7) << 3) | (i >> 3)];
+		if(0==v){ run++; continue; }
+
+		while(run>15)
+		{
+			jpeg_put_bits(bw, ac->code[0xF0], ac->size[0xF0]);
+			run -= 16;
+		}
+		nbits = 32 - __builtin_clz((v<0)?(-v):(v));
+		if(v<0){ v--; }
+		jpeg_put_bits(bw, ((U32)ac->code[(run << 4) | nbits] << nbits) | ((U32)v & ((1u << nbits) - 1)), ac->size[(run << 4) | nbits] + nbits);
+		run = 0;
+	}
+	if(run>0)
+	{
+		jpeg_put_bits(bw, ac->code[0x00], ac->size[0x00]);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Encodes the Slices of the Rows  y0 <= y < y1  of an Image.
+*
+*  Each slice is a restart interval, so it starts with fresh DC
+*  predictions and does not depend on the others. It is written to its
+*  place in the JPEG buffer, padded to a byte and, unless it is the last
+*  one, followed by its restart marker. y0 is a multiple of the slice height.
+*/
+/*-----------------------------------------------------------------------------*/
+void  jpeg_encode_band(const VCJpeg *jp, const image *img, U8 *out, I32 y0, I32 y1)
+{
+	VCVec8i     blk[6][8];
+	VCJpegBits  bw;
+	I32         pred[3];
+	I32         sliceH = jp->restartRows * jp->mcuSize;
+	I32         s, mx, my, myEnd, b;
+	U8         *start;
+
+	for(s= y0 / sliceH; (s * sliceH < y1)&&(s < jp->sliceCount); s++)
+	{
+		start   = out + jp->headerBytes + s * jp->sliceCap;
+		bw.p    = start;
+		bw.acc  = 0;
+		bw.bits = 0;
+		pred[0] = pred[1] = pred[2] = 0;
+		myEnd   = min((s + 1) * jp->restartRows, (jp->dy + jp->mcuSize - 1) / jp->mcuSize);
+
+		for(my= s * jp->restartRows; my< myEnd; my++)
+		{
+			for(mx= 0; mx< jp->mcuCols; mx++)
+			{
+				if(1==jp->colourIff1)
+				{
+					jpeg_load_mcu_ycc(img, mx * 16, my * 16, blk);
+					for(b= 0; b< 4; b++)
+					{
+						jpeg_encode_block(jp, blk[b], 0, &pred[0], &bw);
+					}
+					jpeg_encode_block(jp, blk[4], 1, &pred[1], &bw);
+					jpeg_encode_block(jp, blk[5], 1, &pred[2], &bw);
+				}
+				else
+				{
+					jpeg_load_mcu_grey(img, mx * 8, my * 8, blk[0]);
+					jpeg_encode_block(jp, blk[0], 0, &pred[0], &bw);
+				}
+			}
+		}
+
+		// Padded with 1 bits.
+		if(bw.bits>0){ jpeg_put_bits(&bw, 0x7F, 7); }
+		if(s < jp->sliceCount-1)
+		{
+			*bw.p++ = 0xFF;
+			*bw.p++ = 0xD0 + (s & 7);
+		}
+		jp->sliceBytes[s] = bw.p - start;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Moves the Slices behind the Headers together and ends the JPEG.
+*
+* @return Bytes of the JPEG.
+*/
+/*-----------------------------------------------------------------------------*/
+U32  jpeg_finish(VCJpeg *jp, U8 *out)
+{
+	size_t  pos = jp->headerBytes + jp->sliceBytes[0];
+	I32     s;
+
+	for(s= 1; s< jp->sliceCount; s++)
+	{
+		memmove(out + pos, out + jp->headerBytes + s * jp->sliceCap, jp->sliceBytes[s]);
+		pos += jp->sliceBytes[s];
+	}
+	out[pos++] = 0xFF;
+	out[pos++] = 0xD9;
+
+	jp->frameCount++;
+	jp->byteCount += pos;
+
+	return((U32)pos);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Encode Time and Size of the JPEGs.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  jpeg_print_stats(const char *pcName, VCJpeg *jp)
+{
+	I32  lines = latency_stats_print(pcName, &jp->latEncode);
+
+	printf("  %-22s %8llu JPEGs, quality %d, %s, %d slices, mean %.1f KB, %.2f bits/pixel.\n", pcName,
+			(unsigned long long)jp->frameCount, jp->quality, (1==jp->colourIff1)?("YCbCr 4:2:0"):("grey"), jp->sliceCount,
+			(F64)jp->byteCount / 1024 / max(1, jp->frameCount), (F64)jp->byteCount * 8 / max(1, jp->frameCount) / ((F64)jp->dx * jp->dy));
+
+	return(lines + 1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Main Loop of a Mailbox Thread.
+*
+*  Takes the frames in order of posting and hands them to the consumer.
+*  After mailbox_stop() the frames still queued are consumed first.
+*/
+/*-----------------------------------------------------------------------------*/
+static void *mailbox_main(void *pvArg)
+{
+	VCMailbox   *box = (VCMailbox*)pvArg;
+	VCMailItem   item;
+
+	while(1)
+	{
+		pthread_mutex_lock(&box->mutex);
+		while((0==box->count)&&(0==box->quitIff1))
+		{
+			pthread_cond_wait(&box->condFilled, &box->mutex);
+		}
+		if(0==box->count)
+		{
+			pthread_mutex_unlock(&box->mutex);
+			break;
+		}
+		item       = box->item[box->first];
+		box->first = (box->first + 1) % VCMBOX_DEPTH_MAX;
+		box->count--;
+		pthread_cond_signal(&box->condFreed);
+		pthread_mutex_unlock(&box->mutex);
+
+		box->consume(item.cfg, item.slot);
+		box->frameCount++;
+
+		frame_slot_release(item.slot);
+	}
+
+	return(NULL);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Creates a Thread with explicit Scheduling.
+*
+*  The thread is created with SCHED_FIFO at priority if it is > 0, else
+*  with SCHED_OTHER, and never inherits the scheduling of the caller.
+*  It may run at all online CPUs except excludedCpu (if >= 0), which is
+*  meant to be the isolated CPU of the real-time capture thread.
+*  Returns the error number of pthread_create().
+*/
+/*-----------------------------------------------------------------------------*/
+static int  thread_create_sched(pthread_t *thread, void *(*fn)(void *pvArg), void *pvArg, I32 priority, I32 excludedCpu)
+{
+	I32                 rc, i;
+	pthread_attr_t      attr;
+	struct sched_param  param;
+	cpu_set_t           set;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = max(priority, 0);
+	CPU_ZERO(&set);
+	for(i= 0; i< sysconf(_SC_NPROCESSORS_ONLN); i++)
+	{
+		if(i!=excludedCpu){ CPU_SET(i, &set); }
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, (priority>0)?(SCHED_FIFO):(SCHED_OTHER));
+	pthread_attr_setschedparam(&attr, &param);
+	if(CPU_COUNT(&set)>0)
+	{
+		pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &set);
+	}
+
+	rc =  pthread_create(thread, &attr, fn, pvArg);
+	pthread_attr_destroy(&attr);
+
+	return(rc);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Parses a Control Command Line.
+*
+*  Returns 0 for a command, +1 for an empty line and -1 for a line
+*  not understood.
+*/
+/*-----------------------------------------------------------------------------*/
+int  console_parse(const char *pcLine, VCControlCmd *cmd)
+{
+	I32   n, shutter, camIdx = -1;
+	F32   gain;
+	char  c;
+
+	while((' '==*pcLine)||('\t'==*pcLine)||('\r'==*pcLine)){ pcLine++; }
+
+	switch(*pcLine)
+	{
+		case '\0':
+			return(+1);
+		case 'q':
+			n =  sscanf(pcLine, "q %c", &c);
+			if(n>0){ return(-1); }
+			cmd->type   = VCCTRL_QUIT;
+			cmd->camIdx = -1;
+			return(0);
+		case 's':
+			n =  sscanf(pcLine, "s %d %f %d %c", &shutter, &gain, &camIdx, &c);
+			if((n<2)||(n>3)||(shutter<=0)||(gain<0)||((3==n)&&((camIdx<0)||(camIdx>=VCCAM_MAX)))){ return(-1); }
+			cmd->type    = VCCTRL_SET_PARAMETERS;
+			cmd->camIdx  = camIdx;
+			cmd->shutter = shutter;
+			cmd->gain    = gain;
+			return(0);
+	}
+
+	return(-1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Thread Function reading Control Commands from stdin.
+*
+*  Each complete line is parsed and posted to the event loop, the thread
+*  ends at end of input or when stopFd is signalled.
+*/
+/*-----------------------------------------------------------------------------*/
+static void *console_main(void *pvArg)
+{
+	VCConsole     *con = (VCConsole*) pvArg;
+	struct pollfd  pfd[2];
+	char           acLine[256], *pcEnd;
+	I32            fill = 0, rc, n;
+	VCControlCmd   cmd;
+
+	pfd[0].fd     = STDIN_FILENO;
+	pfd[0].events = POLLIN;
+	pfd[1].fd     = con->stopFd;
+	pfd[1].events = POLLIN;
+
+	while(1)
+	{
+		rc =  poll(pfd, 2, -1);
+		if(rc<0)
+		{
+			if(EINTR==errno){ continue; }
+			syslog(LOG_ERR, "%s():  poll() failed (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			break;
+		}
+		if(0!=pfd[1].revents){ break; }
+		if(0==pfd[0].revents){ continue; }
+
+		n =  read(STDIN_FILENO, acLine + fill, sizeof(acLine) - 1 - fill);
+		if(n<0)
+		{
+			if((EINTR==errno)||(EAGAIN==errno)){ continue; }
+			syslog(LOG_ERR, "%s():  read() failed (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			break;
+		}
+		if(0==n){ break; }
+		fill += n;
+		acLine[fill] = '\0';
+
+		// Lines too long for the buffer are dropped as a whole.
+		while(NULL!=(pcEnd = strchr(acLine, '\n')))
+		{
+			*pcEnd = '\0';
+			rc =  console_parse(acLine, &cmd);
+			if(0==rc)
+			{
+				rc =  event_loop_post_control(con->loop, &cmd);
+				if(0==rc){ con->postCount++; }
+				else     { con->rejectCount++; printf("Command '%s' not queued.\n", acLine); }
+			}
+			else if(rc<0)
+			{
+				con->rejectCount++;
+				printf("Command '%s' not understood.\n", acLine);
+			}
+
+			fill -= (I32)(pcEnd + 1 - acLine);
+			memmove(acLine, pcEnd + 1, fill + 1);
+		}
+		if(fill>=(I32)sizeof(acLine) - 1)
+		{
+			con->rejectCount++;
+			fill = 0;
+		}
+	}
+
+	return(NULL);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Starts the Thread posting Control Commands read from stdin.
+*
+*  The thread runs at all CPUs except excludedCpu (if >= 0).
+*/
+/*-----------------------------------------------------------------------------*/
+int  console_start(VCConsole *con, VCEventLoop *loop, I32 excludedCpu)
+{
+	I32  ee, rc = 0;
+
+	memset(con, 0, sizeof(VCConsole));
+	con->loop   = loop;
+	con->stopFd =  eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(con->stopFd<0){ee=-1; goto fail;}
+
+	rc =  thread_create_sched(&con->thread, console_main, con, 0, excludedCpu);
+	if(rc!=0){ee=-2; goto fail;}
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  eventfd() failed (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  pthread_create() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			close(con->stopFd);
+			con->stopFd = -1;
+			break;
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Stops and Joins the Thread reading Control Commands.
+*/
+/*-----------------------------------------------------------------------------*/
+void  console_stop(VCConsole *con)
+{
+	U64  one = 1;
+
+	if(write(con->stopFd, &one, sizeof(one)) < 0){ /* The counter is already set. */ }
+
+	pthread_join(con->thread, NULL);
+
+	printf("  Console: %llu Commands posted, %llu rejected.\n",
+			(unsigned long long)con->postCount, (unsigned long long)con->rejectCount);
+
+	close(con->stopFd);
+	con->stopFd = -1;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Starts the Thread of a Mailbox at normal Priority.
+*
+*  The policy and depth of box are kept, everything else is reset.
+*  The thread runs at all CPUs except excludedCpu (if >= 0).
+*
+* @param  consume  Output done by the thread for each frame.
+*/
+/*-----------------------------------------------------------------------------*/
+int  mailbox_start(VCMailbox *box, const char *pcName, int (*consume)(const struct VCOutputCfg_ *out, VCFrameSlot *slot), I32 excludedCpu)
+{
+	I32                 ee, rc;
+	I32                 policy = box->policy;
+	I32                 depth  = box->depth;
+
+	memset(box, 0, sizeof(VCMailbox));
+	box->pcName      = pcName;
+	box->enabledIff1 = 1;
+	box->policy      = policy;
+	box->depth       = min(max(depth, 1), VCMBOX_DEPTH_MAX);
+	box->consume     = consume;
+
+	pthread_mutex_init(&box->mutex, NULL);
+	pthread_cond_init(&box->condFilled, NULL);
+	pthread_cond_init(&box->condFreed, NULL);
+
+	rc =  thread_create_sched(&box->thread, mailbox_main, box, 0, excludedCpu);
+	if(rc!=0){ee=-1; goto fail;}
+
+	ee=0;
+fail:
+	if(ee<0)
+	{
+		syslog(LOG_ERR, "%s():  pthread_create() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+		pthread_cond_destroy(&box->condFreed);
+		pthread_cond_destroy(&box->condFilled);
+		pthread_mutex_destroy(&box->mutex);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Arena Slots a Mailbox may hold of one Camera.
+*
+*  The frames queued plus the one being consumed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  mailbox_slot_count(const VCMailbox *box)
+{
+	return(((VCMBOX_LATEST==box->policy)?(1):(min(max(box->depth, 1), VCMBOX_DEPTH_MAX))) + 1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Hands a converted Frame over to the Thread of a Mailbox.
+*
+*  The mailbox holds a reference to the slot until it is consumed.
+*  VCMBOX_LATEST replaces a frame of the same camera still queued,
+*  VCMBOX_FIFO drops the new frame while depth frames are queued,
+*  VCMBOX_BLOCK waits until the thread took one. cfg must stay valid
+*  until the mailbox is stopped.
+*/
+/*-----------------------------------------------------------------------------*/
+void  mailbox_post(VCMailbox *box, const VCOutputCfg *cfg, VCFrameSlot *slot)
+{
+	VCFrameSlot *dropped = NULL;
+	I32          i, k;
+	U64          t0;
+
+	__sync_fetch_and_add(&slot->refCount, 1);
+
+	pthread_mutex_lock(&box->mutex);
+	box->postCount++;
+
+	if(VCMBOX_LATEST==box->policy)
+	{
+		for(i= 0; i< box->count; i++)
+		{
+			k = (box->first + i) % VCMBOX_DEPTH_MAX;
+			if(box->item[k].cfg->camIdx == cfg->camIdx)
+			{
+				dropped            = box->item[k].slot;
+				box->item[k].slot  = slot;
+				slot               = NULL;
+				break;
+			}
+		}
+	}
+	else
+	{
+		if((VCMBOX_BLOCK==box->policy)&&(box->count >= box->depth))
+		{
+			t0 = timestamp_ns();
+			while((box->count >= box->depth)&&(0==box->quitIff1))
+			{
+				pthread_cond_wait(&box->condFreed, &box->mutex);
+			}
+			box->blockCount++;
+			box->blockNS += timestamp_ns() - t0;
+		}
+		if(box->count >= box->depth)
+		{
+			dropped = slot;
+			slot    = NULL;
+		}
+	}
+
+	if(NULL!=slot)
+	{
+		k = (box->first + box->count) % VCMBOX_DEPTH_MAX;
+		box->item[k].slot = slot;
+		box->item[k].cfg  = cfg;
+		box->count++;
+		box->countMax = max(box->countMax, box->count);
+		pthread_cond_signal(&box->condFilled);
+	}
+	if(NULL!=dropped)
+	{
+		box->dropCount++;
+	}
+	pthread_mutex_unlock(&box->mutex);
+
+	if(NULL!=dropped)
+	{
+		frame_slot_release(dropped);
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Stops and Joins the Thread of a Mailbox.
+*
+*  Frames still queued are consumed before, a poster waiting at a
+*  blocking mailbox is released.
+*/
+/*-----------------------------------------------------------------------------*/
+void  mailbox_stop(VCMailbox *box)
+{
+	pthread_mutex_lock(&box->mutex);
+	box->quitIff1 = 1;
+	pthread_cond_broadcast(&box->condFilled);
+	pthread_cond_broadcast(&box->condFreed);
+	pthread_mutex_unlock(&box->mutex);
+
+	pthread_join(box->thread, NULL);
+
+	mailbox_print_stats(box);
+
+	pthread_cond_destroy(&box->condFreed);
+	pthread_cond_destroy(&box->condFilled);
+	pthread_mutex_destroy(&box->mutex);
+	box->enabledIff1 = 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Frames a Mailbox passed on and dropped, and the Time Posters waited.
+*/
+/*-----------------------------------------------------------------------------*/
+void  mailbox_print_stats(const VCMailbox *box)
+{
+	printf("  Mailbox %-8s %6s %2d: %llu Frames posted, %llu output, %llu dropped, %llu waits for %.1fms, %d queued at most.\n",
+			box->pcName, mailboxPolicyName[box->policy], (VCMBOX_LATEST==box->policy)?(1):(box->depth),
+			(unsigned long long)box->postCount, (unsigned long long)box->frameCount, (unsigned long long)box->dropCount,
+			(unsigned long long)box->blockCount, (F32)box->blockNS / 1000000, box->countMax);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Writes a Frame and its rectified Eyes and Disparity to Files.
+*
+*  Used by process_capture() directly and as consumer of the file mailbox.
+*/
+/*-----------------------------------------------------------------------------*/
+int  output_write_files(const VCOutputCfg *out, VCFrameSlot *slot)
+{
+	I32   ee, rc, i;
+	char  acFilename[256];
+
+	snprintf(acFilename, 255, "%s%05d", out->acFilePrefix, slot->frameNr);
+
+	if(1==slot->jpegValidIff1){ rc =  write_jpeg(acFilename, slot->jpeg, slot->jpegBytes); }
+	else                      { rc =  write_image_as_pnm(acFilename, &slot->img);         }
+	if(rc<0){ee=-1+100*rc; goto fail;}
+
+	for(i= 0; i< slot->rectCount; i++)
+	{
+		snprintf(acFilename, 255, "rect%c%05d", (0==slot->rectEye[i])?('L'):('R'), slot->frameNr);
+
+		rc =  write_image_as_pnm(acFilename, &slot->imgRect[i]);
+		if(rc<0){ee=-2+100*rc; goto fail;}
+	}
+
+	if(1==slot->dispValidIff1)
+	{
+		snprintf(acFilename, 255, "disp%05d", slot->frameNr);
+
+		rc =  write_disparity_as_pgm(acFilename, slot->disp, slot->imgRect[0].dx, slot->imgRect[0].dy);
+		if(rc<0){ee=-3+100*rc; goto fail;}
+	}
+
+	ee=0;
+fail:
+	if(ee<0)
+	{
+		syslog(LOG_ERR, "%s():  Could not write '%s'!\n", __FUNCTION__, acFilename);
+	}
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints a Frame as ASCII View to stdout.
+*
+*  Used by process_capture() directly and as consumer of the stdout mailbox.
+*/
+/*-----------------------------------------------------------------------------*/
+int  output_print_ascii(const VCOutputCfg *out, VCFrameSlot *slot)
+{
+	if(NULL!=out->preview){ preview_render(out->preview, &slot->img); }
+
+	return(0);
+}
+
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Fills the Stream Header of a Frame, sendNS and dropCount are left 0.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stream_header_fill(VCStreamHeader *hdr, const VCOutputCfg *cfg, const VCFrameSlot *slot)
+{
+	memset(hdr, 0, sizeof(VCStreamHeader));
+	hdr->magic        = VCSTREAM_MAGIC;
+	hdr->version      = VCSTREAM_VERSION;
+	hdr->headerBytes  = sizeof(VCStreamHeader);
+	hdr->camIdx       = cfg->camIdx;
+	hdr->frameNr      = slot->frameNr;
+	hdr->captureNS    = slot->captureNS;
+	hdr->planeCount   = (NULL!=slot->img.ccmp1)?(3):(1);
+	hdr->dx           = slot->img.dx;
+	hdr->dy           = slot->img.dy;
+	hdr->pitch        = slot->img.pitch;
+	hdr->payloadBytes = hdr->planeCount * slot->img.pitch * slot->img.dy;
+	switch(slot->img.type)
+	{
+		case VCIMAGE_RGB24:   hdr->layout = VCSTREAM_LAYOUT_RGB24;   break;
+		case VCIMAGE_BGR24:   hdr->layout = VCSTREAM_LAYOUT_BGR24;   break;
+		case VCIMAGE_RGBA32:  hdr->layout = VCSTREAM_LAYOUT_RGBA32;  break;
+		case VCIMAGE_BGRA32:  hdr->layout = VCSTREAM_LAYOUT_BGRA32;  break;
+		default:              hdr->layout = VCSTREAM_LAYOUT_PLANAR;  break;
+	}
+	if(1==slot->jpegValidIff1)
+	{
+		hdr->codec        = VCSTREAM_CODEC_JPEG;
+		hdr->payloadBytes = slot->jpegBytes;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns the Parts a Frame is sent from: the Header, then the JPEG or the Planes.
+*
+*  The parts are sized by hdr, the header sent is wire, hdr converted by
+*  vcstream_header_to_le().
+*/
+/*-----------------------------------------------------------------------------*/
+I32  stream_frame_parts(const VCStreamHeader *hdr, const VCStreamHeader *wire, const VCFrameSlot *slot, U8 **base, size_t *len)
+{
+	base[0] = (U8*)wire;  len[0] = sizeof(VCStreamHeader);
+	if(VCSTREAM_CODEC_JPEG==hdr->codec)
+	{
+		base[1] = slot->jpeg;  len[1] = hdr->payloadBytes;
+		return(2);
+	}
+	base[1] = slot->img.st;     len[1] = (size_t)hdr->pitch * hdr->dy;
+	base[2] = slot->img.ccmp1;  len[2] = len[1];
+	base[3] = slot->img.ccmp2;  len[3] = len[1];
+
+	return(1 + hdr->planeCount);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Arena Slots the Stream Server may hold of one Camera.
+*
+*  The frame waiting for the thread plus the queues of all clients.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  stream_slot_count(const VCStreamServer *srv)
+{
+	return(1 + min(max(srv->clientMax, 1), VCSTREAM_CLIENT_MAX) * min(max(srv->depth, 1), VCSTREAM_DEPTH_MAX));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Hands a converted Frame over to the Stream Server.
+*
+*  Called by the capture thread, so it only takes a reference to the
+*  slot and wakes the server thread up. A frame of the same camera the
+*  thread has not taken yet is replaced.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stream_post(VCStreamServer *srv, const VCOutputCfg *cfg, VCFrameSlot *slot)
+{
+	VCStreamItem *it      = &srv->inbox[cfg->camIdx];
+	VCFrameSlot  *dropped = NULL;
+	U64           one     = 1;
+
+	__sync_fetch_and_add(&slot->refCount, 1);
+
+	pthread_mutex_lock(&srv->mutex);
+	srv->postCount++;
+	if(NULL!=it->slot)
+	{
+		dropped = it->slot;
+		srv->inboxDropCount++;
+	}
+	it->slot  = slot;
+	it->zcEnd = 0;
+	stream_header_fill(&it->hdr, cfg, slot);
+	pthread_mutex_unlock(&srv->mutex);
+
+	if(NULL!=dropped)
+	{
+		frame_slot_release(dropped);
+	}
+
+	if(write(srv->eventFd, &one, sizeof(one)) < 0){ /* The counter is already set. */ }
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Releases the Frames of a Client's Queue the Kernel is done with.
+*
+*  Sent frames stay queued until the zerocopy notifications of all
+*  sendmsg() calls they took have been received, as the kernel reads
+*  the slot's planes until then.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stream_client_retire(VCStreamClient *c)
+{
+	VCStreamItem  *it;
+
+	while(c->sentCount > 0)
+	{
+		it = &c->item[c->first];
+		if((I32)(c->zcDone - it->zcEnd) < 0){ break; }
+
+		frame_slot_release(it->slot);
+		it->slot  = NULL;
+		c->first  = (c->first + 1) % VCSTREAM_DEPTH_MAX;
+		c->count--;
+		c->sentCount--;
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Reads the Zerocopy Notifications from the Error Queue of a Client.
+*
+*  TCP completes its sends in order, so a notification covering the
+*  calls lo..hi means all calls up to hi are done.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stream_client_reap(VCStreamClient *c)
+{
+	struct msghdr              msg;
+	struct cmsghdr            *cm;
+	struct sock_extended_err  *serr;
+	char                       acControl[128];
+
+	while(1)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control    = acControl;
+		msg.msg_controllen = sizeof(acControl);
+
+		if(recvmsg(c->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0){ break; }
+
+		for(cm= CMSG_FIRSTHDR(&msg); NULL!=cm; cm= CMSG_NXTHDR(&msg, cm))
+		{
+			if(!(((SOL_IP==cm->cmsg_level)&&(IP_RECVERR==cm->cmsg_type))||((SOL_IPV6==cm->cmsg_level)&&(IPV6_RECVERR==cm->cmsg_type)))){ continue; }
+
+			serr = (struct sock_extended_err*)CMSG_DATA(cm);
+			if(SO_EE_ORIGIN_ZEROCOPY!=serr->ee_origin){ continue; }
+
+			if((I32)(serr->ee_data + 1 - c->zcDone) > 0){ c->zcDone = serr->ee_data + 1; }
+			if(0!=(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED))
+			{
+				c->zcCopiedCount += serr->ee_data - serr->ee_info + 1;
+			}
+		}
+	}
+
+	stream_client_retire(c);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Queues a Frame for a Client, the latest Frame wins.
+*
+*  If the queue is full, the oldest frame of the same camera whose
+*  sending has not started yet makes room, else the new frame is dropped.
+*  Either way the client misses a frame and its drop counter grows.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stream_client_enqueue(VCStreamServer *srv, VCStreamClient *c, const VCStreamItem *in)
+{
+	I32  i, k, started;
+
+	if(c->count >= srv->depth)
+	{
+		c->dropCount++;
+
+		started = c->sentCount + ((c->sentBytes>0)?(1):(0));
+		for(i= started; i< c->count; i++)
+		{
+			k = (c->first + i) % VCSTREAM_DEPTH_MAX;
+			if(c->item[k].hdr.camIdx == in->hdr.camIdx){ break; }
+		}
+		if(i>=c->count){ return; }
+
+		frame_slot_release(c->item[k].slot);
+		for(; i< c->count-1; i++)
+		{
+			c->item[(c->first + i) % VCSTREAM_DEPTH_MAX] = c->item[(c->first + i + 1) % VCSTREAM_DEPTH_MAX];
+		}
+		c->count--;
+	}
+
+	k = (c->first + c->count) % VCSTREAM_DEPTH_MAX;
+	c->item[k] = *in;
+	__sync_fetch_and_add(&in->slot->refCount, 1);
+	c->count++;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sends the queued Frames of a Client until its Socket is full.
+*
+*  Header and planes go out by one scatter-gather sendmsg() straight
+*  from the slot, with MSG_ZEROCOPY if the socket accepted SO_ZEROCOPY.
+*  Returns -1 if the connection failed.
+*/
+/*-----------------------------------------------------------------------------*/
+static int  stream_client_send(VCStreamClient *c)
+{
+	VCStreamItem  *it;
+	struct msghdr  msg;
+	struct iovec   iov[VCSTREAM_IOV_MAX];
+	U8            *base[VCSTREAM_IOV_MAX];
+	size_t         len[VCSTREAM_IOV_MAX], off;
+	ssize_t        rc;
+	I32            i, flags, partCount;
+	U64            now;
+
+	while(c->sentCount < c->count)
+	{
+		it = &c->item[(c->first + c->sentCount) % VCSTREAM_DEPTH_MAX];
+		if(0==c->sentBytes)
+		{
+			it->hdr.sendNS    = timestamp_ns();
+			it->hdr.dropCount = (U32)c->dropCount;
+			it->wire          = it->hdr;
+			vcstream_header_to_le(&it->wire);
+		}
+
+		partCount = stream_frame_parts(&it->hdr, &it->wire, it->slot, base, len);
+
+		// Skip what was sent already.
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		off         = c->sentBytes;
+		for(i= 0; i< partCount; i++)
+		{
+			if(off >= len[i]){ off -= len[i]; continue; }
+			iov[msg.msg_iovlen].iov_base = base[i] + off;
+			iov[msg.msg_iovlen].iov_len  = len[i]  - off;
+			msg.msg_iovlen++;
+			off = 0;
+		}
+
+		flags = MSG_DONTWAIT | MSG_NOSIGNAL | ((1==c->zeroCopyIff1)?(MSG_ZEROCOPY):(0));
+		rc    = sendmsg(c->fd, &msg, flags);
+		if((rc<0)&&(ENOBUFS==errno)&&(0!=(flags & MSG_ZEROCOPY)))
+		{
+			// Out of notification memory: this one is copied.
+			flags &= ~MSG_ZEROCOPY;
+			rc     = sendmsg(c->fd, &msg, flags);
+		}
+		if(rc<0)
+		{
+			if((EAGAIN==errno)||(EWOULDBLOCK==errno)){ break; }
+			return(-1);
+		}
+
+		if(0!=(flags & MSG_ZEROCOPY))
+		{
+			c->zcNext++;
+			c->zcCount++;
+		}
+		it->zcEnd     = c->zcNext;
+		c->sentBytes += rc;
+		c->byteCount += rc;
+
+		if(c->sentBytes == sizeof(VCStreamHeader) + it->hdr.payloadBytes)
+		{
+			now = timestamp_ns();
+			if((0!=it->hdr.captureNS)&&(now > it->hdr.captureNS)){ latency_stats_add(&c->latSend, now - it->hdr.captureNS); }
+			c->frameCount++;
+			c->sentCount++;
+			c->sentBytes = 0;
+		}
+	}
+
+	stream_client_retire(c);
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Throughput and Latency of a Stream Client.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stream_client_print_stats(const VCStreamClient *c)
+{
+	F64  seconds = (F64)(timestamp_ns() - c->connectNS) / 1000000000;
+
+	printf("  Stream client %-21s %llu Frames, %llu dropped, %.1f MB in %.1fs (%.1f Mbit/s), %llu zerocopy sends (%llu copied).\n",
+			c->acPeer, (unsigned long long)c->frameCount, (unsigned long long)c->dropCount,
+			(F64)c->byteCount / 1000000, seconds, (F64)c->byteCount * 8 / 1000000 / max(seconds, 0.001),
+			(unsigned long long)c->zcCount, (unsigned long long)c->zcCopiedCount);
+	latency_stats_print("Capture to sent", (VCLatencyStats*)&c->latSend);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Disconnects a Stream Client and releases its Frames.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stream_client_close(VCStreamServer *srv, VCStreamClient *c)
+{
+	I32  i;
+
+	stream_client_print_stats(c);
+
+	epoll_ctl(srv->epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	c->fd = -1;
+
+	// Pages still pinned by zerocopy sends stay valid, the arena outlives the server.
+	for(i= 0; i< c->count; i++)
+	{
+		frame_slot_release(c->item[(c->first + i) % VCSTREAM_DEPTH_MAX].slot);
+	}
+	c->count     = 0;
+	c->sentCount = 0;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Accepts all pending Connections of the Stream Server.
+*
+*  Connections beyond clientMax are closed right away.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stream_accept(VCStreamServer *srv)
+{
+	I32                 fd, i, one = 1;
+	struct sockaddr_in  addr;
+	socklen_t           addrLen;
+	struct epoll_event  ev;
+	VCStreamClient     *c;
+	char                acHost[INET_ADDRSTRLEN];
+
+	while(1)
+	{
+		addrLen = sizeof(addr);
+		fd = accept4(srv->listenFd, (struct sockaddr*)&addr, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd<0){ break; }
+
+		for(i= 0; (i< srv->clientMax)&&(srv->client[i].fd>=0); i++);
+		if(i>=srv->clientMax)
+		{
+			close(fd);
+			srv->refuseCount++;
+			continue;
+		}
+
+		c = &srv->client[i];
+		memset(c, 0, sizeof(VCStreamClient));
+		c->fd = fd;
+		inet_ntop(AF_INET, &addr.sin_addr, acHost, sizeof(acHost));
+		snprintf(c->acPeer, sizeof(c->acPeer), "%s:%d", acHost, ntohs(addr.sin_port));
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		if(1==srv->zeroCopyIff1)
+		{
+			c->zeroCopyIff1 = (0==setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)))?(1):(0);
+		}
+
+		// Edge triggered: the sender runs after every wakeup anyway.
+		ev.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.u32 = i;
+		if(epoll_ctl(srv->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		{
+			close(fd);
+			c->fd = -1;
+			srv->refuseCount++;
+			continue;
+		}
+
+		c->connectNS = timestamp_ns();
+		srv->acceptCount++;
+		printf("Stream client %s connected%s.\n", c->acPeer, (1==c->zeroCopyIff1)?(", zerocopy"):(""));
+	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Main Loop of the Stream Server Thread.
+*
+*  Accepts clients, distributes the posted frames to their queues,
+*  sends and reaps zerocopy notifications, all from one epoll loop.
+*/
+/*-----------------------------------------------------------------------------*/
+static void *stream_main(void *pvArg)
 {
-	int      fd;  /*!<  File Descriptor of the opened Sensor Device.  */
+	VCStreamServer     *srv = (VCStreamServer*)pvArg;
+	struct epoll_event  ev[VCSTREAM_CLIENT_MAX + 2];
+	VCStreamItem        inbox[VCCAM_MAX];
+	VCStreamClient     *c;
+	I32                 n, e, i, k, quitIff1 = 0;
+	U64                 counter;
+	char                acDiscard[256];
+
+	while(0==quitIff1)
+	{
+		n = epoll_wait(srv->epollFd, ev, VCSTREAM_CLIENT_MAX + 2, -1);
+		if((n<0)&&(EINTR!=errno)){ break; }
 
-	QBuf    *qbuf; /*!<  Queue Buffers where Images are recorded to.  */
-	U32      qbufCount; /*!<  Number of Queue Buffers available.      */
+		for(e= 0; e< n; e++)
+		{
+			if(VCSTREAM_EV_LISTEN==ev[e].data.u32)
+			{
+				stream_accept(srv);
+			}
+			else if(VCSTREAM_EV_POST==ev[e].data.u32)
+			{
+				if(read(srv->eventFd, &counter, sizeof(counter)) < 0){ /* Reset by an earlier read. */ }
 
-	struct v4l2_pix_format  pix;  /*!<  Sensor Attributes.            */
-} VCMipiSenCfg;
-#define NULL_VCMipiSenCfg  { -1, NULL,0, {0} }
+				pthread_mutex_lock(&srv->mutex);
+				memcpy(inbox, srv->inbox, sizeof(inbox));
+				for(k= 0; k< VCCAM_MAX; k++){ srv->inbox[k].slot = NULL; }
+				quitIff1 = srv->quitIff1;
+				pthread_mutex_unlock(&srv->mutex);
 
+				for(k= 0; k< VCCAM_MAX; k++)
+				{
+					if(NULL==inbox[k].slot){ continue; }
+					for(i= 0; i< srv->clientMax; i++)
+					{
+						if(srv->client[i].fd>=0){ stream_client_enqueue(srv, &srv->client[i], &inbox[k]); }
+					}
+					frame_slot_release(inbox[k].slot);
+				}
+			}
+			else
+			{
+				c = &srv->client[ev[e].data.u32];
+				if(c->fd<0){ continue; }
 
-int  change_options_by_commandline(int argc, char *argv[], int *shutter, float *gain, int *fbOutIff1, char *pcFramebufferDev, int *stdOutIff1, int *fileOutIff1, int *bufCount);
-int  sensor_open(char *dev_video_device, VCMipiSenCfg *sen, int qBufCount);
-int  sensor_close(VCMipiSenCfg *sen);
-int  sensor_set_parameters(VCMipiSenCfg  *sen, int newGain, int newShutter);
-int  sensor_streaming_start(VCMipiSenCfg *sen);
-int  sensor_streaming_stop(VCMipiSenCfg *sen);
-int  capture_buffer_enqueue(I32 bufIdx, VCMipiSenCfg *sen);
-int  capture_buffer_dequeue(I32 *bufIdx, VCMipiSenCfg *sen);
-int  wait_for_next_capture(VCMipiSenCfg  *sen, int timeoutUS);
-int  imgnet_connect(VCImgNetCfg *imgnetCfg, U32 pixelformat, int dx, int dy);
-int  imgnet_disconnect(VCImgNetCfg *imgnetCfg);
-int  process_capture(unsigned int pixelformat, void *st, int dx, int dy, int pitch, int stdOutIff1, int netSrvOutIff1, VCImgNetCfg *imgnetCfg, int fbOutIff1, int fileOutIff1, int frameNr, char *pcFramebufferDev);
-I32  copy_grey_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
-I32  convert_raw10_to_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
-I32  convert_raw10_and_debayer_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
-I32  simple_debayer_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes);
-int  copy_image(image *in, image *out);
-int  copy_image_to_framebuffer(char *pcFramebufferDev, const void *pvDataGREY_OR_R, const void *pvDataGREY_OR_G, const void *pvDataGREY_OR_B, I32 dy, I32 pitch);
-I32  write_image_as_pnm(char *path, image *img);
-void print_image_to_stdout(image *img, int stp, int goUpIff1);
-void timemeasurement_start(struct  timeval *timer);
-void timemeasurement_stop(struct  timeval *timer, I64 *s, I64 *us);
+				if(0!=(ev[e].events & EPOLLERR))
+				{
+					stream_client_reap(c);
+				}
+				// Clients send nothing, reading just notices the hang-up.
+				if(0!=(ev[e].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+				{
+					while((k= read(c->fd, acDiscard, sizeof(acDiscard))) > 0);
+					if((0==k)||((k<0)&&(EAGAIN!=errno)&&(EWOULDBLOCK!=errno)))
+					{
+						stream_client_close(srv, c);
+					}
+				}
+			}
+		}
+
+		for(i= 0; i< srv->clientMax; i++)
+		{
+			c = &srv->client[i];
+			if(c->fd<0){ continue; }
+
+			if(stream_client_send(c) < 0)
+			{
+				stream_client_close(srv, c);
+			}
+		}
+	}
+
+	for(i= 0; i< srv->clientMax; i++)
+	{
+		if(srv->client[i].fd>=0){ stream_client_close(srv, &srv->client[i]); }
+	}
+
+	return(NULL);
+}
 
 
 
@@ -114,220 +10095,337 @@ void timemeasurement_stop(struct  timeval *timer, I64 *s, I64 *us);
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Main Function of vcmipidemo.
+* @brief  Starts the Stream Server: listens at its Port and starts its Thread.
 *
-*  This is the main function of the vcmipidemo.
+*  port, depth, clientMax and zeroCopyIff1 of srv are kept, everything
+*  else is reset. The thread runs at all CPUs except excludedCpu (if >= 0).
 */
 /*-----------------------------------------------------------------------------*/
-int  main(int argc, char *argv[])
+int  stream_start(VCStreamServer *srv, I32 excludedCpu)
 {
-	char           acVideoDev[]       = "/dev/video0";
-	char           acFramebufferDev[] = "/dev/fb0";
-	int            timeoutUS          = 10000;
+	I32                 ee, rc = 0, i, one = 1;
+	VCStreamServer      cfg = *srv;
+	struct sockaddr_in  addr;
+	struct epoll_event  ev;
+
+	memset(srv, 0, sizeof(VCStreamServer));
+	srv->port         = cfg.port;
+	srv->depth        = min(max(cfg.depth, 1), VCSTREAM_DEPTH_MAX);
+	srv->clientMax    = min(max(cfg.clientMax, 1), VCSTREAM_CLIENT_MAX);
+	srv->zeroCopyIff1 = cfg.zeroCopyIff1;
+	srv->listenFd     = -1;
+	srv->epollFd      = -1;
+	srv->eventFd      = -1;
+	for(i= 0; i< VCSTREAM_CLIENT_MAX; i++)
+	{
+		srv->client[i].fd = -1;
+	}
+	pthread_mutex_init(&srv->mutex, NULL);
 
-	#ifdef DURATION_TEST
-		struct timeval timer;
-		I64            seconds, useconds;
-		int            timerCycles = 100;
-		int            run=0;
-	#endif
+	srv->listenFd =  socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(srv->listenFd<0){ee=-1; goto fail;}
 
-	int            ee, rc=0, bufIdx;
-	int            netSrvIff1 = 0;
-	int            frameNr=0;
-	int            optShutter, optFBOutIff1, optStdOutIff1, optBufCount, optFileOutIff1;
-	float          optGain;
-	VCMipiSenCfg   sen       = NULL_VCMipiSenCfg;
-	VCImgNetCfg    imgnetCfg = NULL_VCImgNetCfg;
+	setsockopt(srv->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
 
-	// Set up configuration and apply command line parameters if set.
-	{
-		optStdOutIff1= +1;
-		optFBOutIff1 = -1;
-		optShutter   = 5000;
-		optGain      = 10;
-		optBufCount  = 3;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(srv->port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
 
-		rc =  change_options_by_commandline(argc, argv, &optShutter, &optGain, &optFBOutIff1, acFramebufferDev, &optStdOutIff1, &optFileOutIff1, &optBufCount);
-		if(rc>0){ee=0; goto quit;}
-		if(rc<0){ee=-1+100*rc; goto quit;}
-	}
+	rc =  bind(srv->listenFd, (struct sockaddr*)&addr, sizeof(addr));
+	if(rc<0){ee=-2; goto fail;}
 
+	rc =  listen(srv->listenFd, VCSTREAM_CLIENT_MAX);
+	if(rc<0){ee=-2; goto fail;}
 
-	// Gets capture dimensions for imgnet_connect().
-	rc =  sensor_open(acVideoDev, &sen, optBufCount);
-	if(rc<0){ee=-2+100*rc; goto quit;}
+	srv->epollFd =  epoll_create1(EPOLL_CLOEXEC);
+	if(srv->epollFd<0){ee=-3; goto fail;}
 
-	// If vcimgnetsrv is started in background, this connects to it to transfer the captures.
-	rc =  imgnet_connect(&imgnetCfg, sen.pix.pixelformat, sen.pix.width, sen.pix.height);
-	if(rc!=0){ netSrvIff1=0; }
-	else     { netSrvIff1=1; }
+	srv->eventFd =  eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(srv->eventFd<0){ee=-3; goto fail;}
 
+	ev.events   = EPOLLIN;
+	ev.data.u32 = VCSTREAM_EV_LISTEN;
+	rc =  epoll_ctl(srv->epollFd, EPOLL_CTL_ADD, srv->listenFd, &ev);
+	if(rc<0){ee=-3; goto fail;}
 
-	// Apply new Shutter and Gain Settings
-	{
-		rc =  sensor_set_parameters(&sen, optGain, optShutter);
-		if(rc<0){ee=-3+100*rc; goto quit;}
-	}
+	ev.events   = EPOLLIN;
+	ev.data.u32 = VCSTREAM_EV_POST;
+	rc =  epoll_ctl(srv->epollFd, EPOLL_CTL_ADD, srv->eventFd, &ev);
+	if(rc<0){ee=-3; goto fail;}
 
+	rc =  thread_create_sched(&srv->thread, stream_main, srv, 0, excludedCpu);
+	if(rc!=0){ee=-4; goto fail;}
 
-	// Pre-Enqueue all capture buffers into the capture queue
+	ee=0;
+fail:
+	switch(ee)
 	{
-		for(bufIdx= 0; bufIdx< sen.qbufCount; bufIdx++)
-		{
-			rc =  capture_buffer_enqueue(bufIdx, &sen);
-			if(rc<0){ee=-4+100*rc; goto quit;}
-		}
+		case 0:
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  Could not listen at port %d (%d(%s))!\n", __FUNCTION__, srv->port, errno, strerror(errno));
+			break;
+		case -4:
+			syslog(LOG_ERR, "%s():  pthread_create() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			break;
+		default:
+			syslog(LOG_ERR, "%s():  Could not set up the server sockets (%d, %d(%s))!\n", __FUNCTION__, ee, errno, strerror(errno));
+			break;
+	}
+	if(ee<0)
+	{
+		if(srv->eventFd>=0) { close(srv->eventFd);  srv->eventFd  = -1; }
+		if(srv->epollFd>=0) { close(srv->epollFd);  srv->epollFd  = -1; }
+		if(srv->listenFd>=0){ close(srv->listenFd); srv->listenFd = -1; }
+		pthread_mutex_destroy(&srv->mutex);
 	}
 
-	rc =  sensor_streaming_start(&sen);
-	if(rc<0){ee=-5+100*rc; goto quit;}
+	return(ee);
+}
 
-	#ifdef DURATION_TEST
-		timemeasurement_start(&timer);
-	#endif
-	while(1)
-	{
-		rc =  wait_for_next_capture(&sen, timeoutUS);
-		if(rc<0){ee=-6+100*rc; goto quit;}
 
-		rc =  capture_buffer_dequeue(&bufIdx, &sen);
-		if(rc>0){continue;} //buffer not yet available, wait again.
-		if(rc<0){ee=-7+100*rc; goto quit;}
 
-		rc =  process_capture(sen.pix.pixelformat, sen.qbuf[bufIdx].st, sen.pix.width, sen.pix.height, sen.pix.bytesperline, optStdOutIff1, netSrvIff1, &imgnetCfg, optFBOutIff1, optFileOutIff1, frameNr++, acFramebufferDev);
-		if(rc<0){ee=-8+100*rc; goto quit;}
 
-		rc =  capture_buffer_enqueue(bufIdx, &sen);
-		if(rc<0){ee=-9+100*rc; goto quit;}
 
-		#ifdef DURATION_TEST
-			// Print Out Duration.
-			if(((timerCycles)-1)==(run%(timerCycles)))
-			{
-				timemeasurement_stop(&timer, &seconds, &useconds);
-				printf("Acquisiton&Copy Duration:%11llds%11lldus  for %d Cycles ==  %ffps.\n\n", seconds, useconds, (run%timerCycles)+1, (F32)1000000 * ((run%timerCycles)+1)/(seconds * 1000000 + useconds));
-				if(1!=netSrvIff1){ printf("\033[%dA", 2); }
-				timemeasurement_start(&timer);
-			}
-			run++;
-		#endif
-	}
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Frames posted to the Stream Server and its Clients.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stream_print_stats(const VCStreamServer *srv)
+{
+	printf("  Stream port %-5d %llu Frames posted, %llu replaced before taken, %llu clients accepted, %llu refused.\n",
+			srv->port, (unsigned long long)srv->postCount, (unsigned long long)srv->inboxDropCount,
+			(unsigned long long)srv->acceptCount, (unsigned long long)srv->refuseCount);
+}
 
-	rc =  sensor_streaming_stop(&sen);
-	if(rc<0){ee=-10+100*rc; goto quit;}
 
 
-	ee=0;
-quit:
-	if(ee!=0){ printf("\n  '%s' quits with error code: %d\n\n", argv[0], ee); }
 
-	sensor_close(&sen);
 
-	if(1==netSrvIff1)
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Stops the Stream Server, disconnects its Clients.
+*/
+/*-----------------------------------------------------------------------------*/
+void  stream_stop(VCStreamServer *srv)
+{
+	U64  one = 1;
+	I32  k;
+
+	pthread_mutex_lock(&srv->mutex);
+	srv->quitIff1 = 1;
+	pthread_mutex_unlock(&srv->mutex);
+	if(write(srv->eventFd, &one, sizeof(one)) < 0){ /* The counter is already set. */ }
+
+	pthread_join(srv->thread, NULL);
+
+	stream_print_stats(srv);
+
+	for(k= 0; k< VCCAM_MAX; k++)
 	{
-		imgnet_disconnect(&imgnetCfg);
+		if(NULL!=srv->inbox[k].slot){ frame_slot_release(srv->inbox[k].slot); srv->inbox[k].slot = NULL; }
 	}
 
-	return(0);
+	close(srv->eventFd);
+	close(srv->epollFd);
+	close(srv->listenFd);
+	srv->eventFd  = -1;
+	srv->epollFd  = -1;
+	srv->listenFd = -1;
+	pthread_mutex_destroy(&srv->mutex);
 }
 
 
 
 
 
+
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Processes a Capture: Copy it to several Outputs.
+* @brief  Opens the Socket of the Multicast Output.
 *
-*  This function processes a capture image by copying it to selected outputs.
+*  Looped back, so receivers on the same host get the frames as well.
 */
 /*-----------------------------------------------------------------------------*/
-int  process_capture(unsigned int pixelformat, void *st, int dx, int dy, int pitch, int stdOutIff1, int netSrvOutIff1, VCImgNetCfg *imgnetCfg, int fbOutIff1, int fileOutIff1, int frameNr, char *pcFramebufferDev)
+int  multicast_open(VCMulticast *mc)
 {
-	int    rc, ee;
-	image  imgConverted = NULL_IMAGE;
-	char   acFilename[256];
-
-	// Allocate temporary image
+	I32             ee, rc, one = 1, size = VCMCAST_SNDBUF;
+	U8              ttl = (U8)min(max(mc->ttl, 0), 255);
+	struct in_addr  iface;
+
+	mc->mtu          = min(max(mc->mtu, VCMCAST_MTU_MIN), VCMCAST_DATAGRAM_MAX + 28);
+	mc->frameId      = 0;
+	mc->frameCount   = 0;
+	mc->datagramCount= 0;
+	mc->byteCount    = 0;
+	mc->callCount    = 0;
+	mc->errorCount   = 0;
+	memset(&mc->latSend, 0, sizeof(VCLatencyStats));
+
+	memset(&mc->addr, 0, sizeof(mc->addr));
+	mc->addr.sin_family = AF_INET;
+	mc->addr.sin_port   = htons(mc->port);
+	if((1!=inet_pton(AF_INET, mc->acGroup, &mc->addr.sin_addr))||(!IN_MULTICAST(ntohl(mc->addr.sin_addr.s_addr)))){ee=-1; goto fail;}
+
+	mc->fd =  socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if(mc->fd<0){ee=-2; goto fail;}
+
+	setsockopt(mc->fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	setsockopt(mc->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+	setsockopt(mc->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+
+	if('\0'!=mc->acIface[0])
 	{
-		imgConverted.type = (V4L2_PIX_FMT_SRGGB10P==pixelformat)?(IMAGE_RGB):(IMAGE_GREY);
-		imgConverted.dx   = dx;
-		imgConverted.dy   = dy;
-		imgConverted.pitch= imgConverted.dx;
-		imgConverted.ccmp1= malloc(sizeof(U8) * imgConverted.dy * imgConverted.pitch);
-		if(NULL==imgConverted.ccmp1){ee=-1; goto fail;}
-		imgConverted.ccmp2= malloc(sizeof(U8) * imgConverted.dy * imgConverted.pitch);
-		if(NULL==imgConverted.ccmp2){ee=-2; goto fail;}
-		imgConverted.st   =  malloc(sizeof(U8) * imgConverted.dy * imgConverted.pitch);
-		if(NULL==imgConverted.st   ){ee=-3; goto fail;}
+		if(1!=inet_pton(AF_INET, mc->acIface, &iface)){ee=-1; goto fail;}
+
+		rc =  setsockopt(mc->fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface));
+		if(rc<0){ee=-3; goto fail;}
 	}
 
-	switch(pixelformat)
+	ee=0;
+fail:
+	switch(ee)
 	{
-		case V4L2_PIX_FMT_GREY:
-				rc =  copy_grey_to_image(&imgConverted,  st,  0, 0, dx, dy, dx, 0);
-				if(rc<0){ee=-4+100*rc; goto fail;}
-			break;
-		case V4L2_PIX_FMT_Y10:
-				rc =  convert_raw10_to_image(&imgConverted,  st, 0,  0, 0, dx, dy, dx, pitch - (10 * dx)/8);
-				if(rc<0){ee=-5+100*rc; goto fail;}
+		case 0:
 			break;
-		case V4L2_PIX_FMT_SRGGB10P:
-				rc =  convert_raw10_and_debayer_image(&imgConverted, st, 0,  0, 0, dx, dy, dx, pitch - (10 * dx)/8);
-				if(rc<0){ee=-6+100*rc; goto fail;}
+		case -1:
+			syslog(LOG_ERR, "%s():  Invalid multicast group '%s' or interface '%s'!\n", __FUNCTION__, mc->acGroup, mc->acIface);
 			break;
 		default:
-			printf("Error, Pixelformat unsupported: %c%c%c%c (0x%08x)\n",
-					(char)((pixelformat >>  0)&0xFF),
-					(char)((pixelformat >>  8)&0xFF),
-					(char)((pixelformat >> 16)&0xFF),
-					(char)((pixelformat >> 24)&0xFF),
-					pixelformat);
-			ee=-7; goto fail;
+			syslog(LOG_ERR, "%s():  Could not set up the multicast socket (%d, %d(%s))!\n", __FUNCTION__, ee, errno, strerror(errno));
+			break;
 	}
-
-
-	if(1==stdOutIff1)
+	if(ee<0)
 	{
-		print_image_to_stdout(&imgConverted, 50, 1);
+		if(mc->fd>=0){ close(mc->fd); }
+		mc->fd = -1;
 	}
 
-	if(1==netSrvOutIff1)
-	{
-		rc =  copy_image(&imgConverted, &(imgnetCfg->img));
-		if(rc<0){ee=-8+100*rc; goto fail;}
-	}
+	return(ee);
+}
+
+
 
-	if(1==fbOutIff1)
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Sends a Frame to the Multicast Group.
+*
+*  The frame is cut into datagrams of at most mtu bytes, each a
+*  fragment header followed by its slice of the stream header and the
+*  planes, gathered straight from the slot. VCMCAST_BATCH datagrams go
+*  out per sendmmsg(). Consumer of the multicast mailbox.
+*/
+/*-----------------------------------------------------------------------------*/
+int  output_send_multicast(const VCOutputCfg *out, VCFrameSlot *slot)
+{
+	VCMulticast        *mc = out->mcast;
+	VCStreamHeader      hdr, wire;
+	VCMcastFragHeader  *fh;
+	U8                 *base[VCSTREAM_IOV_MAX];
+	size_t              len[VCSTREAM_IOV_MAX], take, rest, pos, chunk;
+	I32                 part, n, k, f, fragCount, sent, rc;
+	U32                 frameBytes;
+	U64                 now;
+
+	stream_header_fill(&hdr, out, slot);
+	hdr.sendNS = timestamp_ns();
+	wire       = hdr;
+	vcstream_header_to_le(&wire);
+
+	stream_frame_parts(&hdr, &wire, slot, base, len);
+	frameBytes = sizeof(VCStreamHeader) + hdr.payloadBytes;
+	chunk      = mc->mtu - 28 - sizeof(VCMcastFragHeader);
+	fragCount  = (frameBytes + chunk - 1) / chunk;
+	if(fragCount > 0xFFFF){ mc->errorCount++; return(-1); }
+
+	part = 0;
+	pos  = 0;
+	for(f= 0; f< fragCount; )
 	{
-		if(IMAGE_GREY==imgConverted.type)
+		// Up to a batch of datagrams, each gathering its slice of the parts.
+		for(n= 0; (n< VCMCAST_BATCH)&&(f< fragCount); n++, f++)
 		{
-			rc =  copy_image_to_framebuffer(pcFramebufferDev, imgConverted.st, imgConverted.st,    imgConverted.st,    imgConverted.dy, imgConverted.pitch);
+			fh = &mc->frag[n];
+			fh->magic       = VCMCAST_MAGIC;
+			fh->version     = VCMCAST_VERSION;
+			fh->headerBytes = sizeof(VCMcastFragHeader);
+			fh->frameId     = mc->frameId;
+			fh->frameBytes  = frameBytes;
+			fh->offset      = f * chunk;
+			fh->fragIdx     = f;
+			fh->fragCount   = fragCount;
+			vcmcast_frag_to_le(fh);
+
+			mc->iov[n][0].iov_base = fh;
+			mc->iov[n][0].iov_len  = sizeof(VCMcastFragHeader);
+			k    = 1;
+			rest = min(chunk, frameBytes - f * chunk);
+			while(rest>0)
+			{
+				take = min(rest, len[part] - pos);
+				mc->iov[n][k].iov_base = base[part] + pos;
+				mc->iov[n][k].iov_len  = take;
+				k++;
+				rest -= take;
+				pos  += take;
+				if(pos==len[part]){ part++; pos = 0; }
+			}
+
+			memset(&mc->msg[n], 0, sizeof(struct mmsghdr));
+			mc->msg[n].msg_hdr.msg_name    = &mc->addr;
+			mc->msg[n].msg_hdr.msg_namelen = sizeof(mc->addr);
+			mc->msg[n].msg_hdr.msg_iov     = mc->iov[n];
+			mc->msg[n].msg_hdr.msg_iovlen  = k;
 		}
-		else
+
+		// A datagram the kernel refuses is skipped, receivers count it lost.
+		for(sent= 0; sent< n; )
 		{
-			rc =  copy_image_to_framebuffer(pcFramebufferDev, imgConverted.st, imgConverted.ccmp1, imgConverted.ccmp2, imgConverted.dy, imgConverted.pitch);
+			rc = sendmmsg(mc->fd, &mc->msg[sent], n - sent, 0);
+			mc->callCount++;
+			if(rc<0)
+			{
+				if(EINTR==errno){ continue; }
+				mc->errorCount++;
+				sent++;
+				continue;
+			}
+			for(k= sent; k< sent + rc; k++)
+			{
+				mc->byteCount += mc->msg[k].msg_len;
+			}
+			mc->datagramCount += rc;
+			sent              += rc;
 		}
-		if(rc<0){ee=-9+100*rc; goto fail;}
 	}
+	mc->frameId++;
+	mc->frameCount++;
 
-	if(1==fileOutIff1)
-	{
-		snprintf(acFilename, 255, "img%05d", frameNr);
+	now = timestamp_ns();
+	if((0!=hdr.captureNS)&&(now > hdr.captureNS)){ latency_stats_add(&mc->latSend, now - hdr.captureNS); }
 
-		rc =  write_image_as_pnm(acFilename, &imgConverted);
-		if(rc<0){ee=-10+100*rc; goto fail;}
-	}
+	return(0);
+}
 
 
-	ee=0;
-fail:
-	if(NULL!=imgConverted.st   ){ free(imgConverted.st   );  imgConverted.st   =NULL; }
-	if(NULL!=imgConverted.ccmp1){ free(imgConverted.ccmp1);  imgConverted.ccmp1=NULL; }
-	if(NULL!=imgConverted.ccmp2){ free(imgConverted.ccmp2);  imgConverted.ccmp2=NULL; }
 
-	return(ee);
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Frames and Datagrams sent to the Multicast Group.
+*/
+/*-----------------------------------------------------------------------------*/
+void  multicast_print_stats(VCMulticast *mc)
+{
+	printf("  Multicast %s:%d mtu %d: %llu Frames, %llu datagrams in %llu sendmmsg() calls, %.1f MB, %llu datagrams refused.\n",
+			mc->acGroup, mc->port, mc->mtu, (unsigned long long)mc->frameCount, (unsigned long long)mc->datagramCount,
+			(unsigned long long)mc->callCount, (F64)mc->byteCount / 1000000, (unsigned long long)mc->errorCount);
+	latency_stats_print("Capture to multicast", &mc->latSend);
 }
 
 
@@ -336,51 +10434,147 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Parses Command Line Parameters.
+* @brief  Closes the Socket of the Multicast Output.
+*/
+/*-----------------------------------------------------------------------------*/
+void  multicast_close(VCMulticast *mc)
+{
+	if(mc->fd>=0){ close(mc->fd); }
+	mc->fd = -1;
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Reads one Sample of the IMU through the UVC Extension Unit.
 *
-*  This function parses command line parameters.
+*  Same access as IMU_DataAccess() of imu_test: six big endian 16 bit values,
+*  gyro x, y, z followed by accel x, y, z, and the 32 bit device timestamp
+*  at byte 12. The host time of the sample is the middle of the request.
+*/
+/*-----------------------------------------------------------------------------*/
+int  imu_read(int fd, VCImuSample *s)
+{
+	struct uvc_xu_control_query  query;
+	U8   data[VCIMU_XU_DATA_SIZE];
+	U64  t0, t1;
+	I32  k, rc;
+
+	memset(&query, 0, sizeof(query));
+	memset(data,   0, sizeof(data));
+	query.unit     = VCIMU_XU_UNIT;
+	query.selector = VCIMU_XU_SEL_DATA;
+	query.query    = UVC_GET_CUR;
+	query.size     = VCIMU_XU_DATA_SIZE;
+	query.data     = data;
+
+	t0 =  timestamp_ns();
+	rc =  ioctl(fd, UVCIOC_CTRL_QUERY, &query);
+	t1 =  timestamp_ns();
+	if(rc<0){ return(-1); }
+
+	for(k= 0; k< 3; k++)
+	{
+		s->gyro[k]  = (F32)(I16)((data[2*k+0] << 8) | data[2*k+1]) * VCIMU_GYRO_DPS;
+		s->accel[k] = (F32)(I16)((data[2*k+6] << 8) | data[2*k+7]) * VCIMU_ACCEL_MS2;
+	}
+	s->deviceTS = ((U32)data[12] << 24) | ((U32)data[13] << 16) | ((U32)data[14] << 8) | (U32)data[15];
+	s->monoNS   = t0 + (t1 - t0) / 2;
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Main Loop of the IMU Thread.
+*
+*  Polls the IMU as fast as the device answers, or every periodUS.
+*  A read returning the device timestamp of the previous one is no new
+*  sample. Gaps of the device timestamp larger than the smallest step
+*  seen so far are counted as dropped samples. Each new sample also
+*  feeds the estimator of the device clock.
 */
 /*-----------------------------------------------------------------------------*/
-int  change_options_by_commandline(int argc, char *argv[], int *shutter, float *gain, int *fbOutIff1, char *pcFramebufferDev, int *stdOutIff1, int *fileOutIff1, int *bufCount)
+static void *imu_thread_main(void *pvArg)
 {
-	int  opt;
+	VCImu       *imu = (VCImu*)pvArg;
+	VCImuSample  s, *prev;
+	U64          t0, head;
+	U32          delta;
+	I32          k;
 
-	while((opt =  getopt(argc, argv, "g:s:fab:o")) != -1)
+	while(0==imu->quitIff1)
 	{
-		switch(opt)
+		t0 = timestamp_ns();
+		imu->readCount++;
+
+		if(imu_read(imu->fd, &s)<0)
 		{
-			default:
-				printf("_______________________________________________________________________________\n");
-				printf("                                                                               \n");
-				printf("  %s v.%d.%d.%d.\n", DEMO_NAME, DEMO_MAINVERSION, DEMO_VERSION, DEMO_SUBVERSION);
-				printf("  -----------------------------------------------------------------------------\n");
-				printf("                                                                               \n");
-				printf("  Usage: %s [-s sh] [-g gain] [-f] [-a]\n", argv[0]);
-				printf("                                                                               \n");
-				printf("  -s,  Shutter Time.                                                           \n");
-				printf("  -g,  Gain Value.                                                             \n");
-				printf("  -b,  Buffer Count to use.                                                    \n");
-				printf("  -f,  Output Capture to framebuffer %s.                                       \n", pcFramebufferDev);
-				printf("  -o,  Output Captures to file in PGM or PPM format (openable by e.g. GIMP)    \n");
-				printf("  -a,  Suppress ASCII capture at stdout.                                       \n");
-				printf("_______________________________________________________________________________\n");
-				printf("                                                                               \n");
-				return(+1);
-			case 's':  *shutter    = atol(optarg);  printf("Setting Shutter Value to %d.\n",*shutter);  break;
-			case 'g':  *gain       = atof(optarg);  printf("Setting Gain Value to %f.\n",   *gain   );  break;
-			case 'f':  *fbOutIff1  = 1;             printf("Activating /dev/fb0 framebuffer output.\n");break;
-			case 'a':  *stdOutIff1 = 0;             printf("Suppressing ASCII capture at stdout.\n" );  break;
-			case 'o':  *fileOutIff1=1;             printf("Activating file output of captures.\n" );   break;
-			case 'b':  *bufCount   = atol(optarg);  printf("Setting Buffer Count to %d.\n",*bufCount);  break;
+			imu->errorCount++;
+			usleep(1000);
+			continue;
 		}
-	}
 
-	if(argc<2)
-	{
-		printf("  Hint: Activate framebuffer output by command line option (see:  %s -? )\n", argv[0]);
+		head = imu->head;
+		prev = &imu->ring[(head-1) % VCIMU_RING_SIZE];
+		if((head>0)&&(s.deviceTS==prev->deviceTS))
+		{
+			imu->duplicateCount++;
+		}
+		else
+		{
+			if(head>0)
+			{
+				delta = s.deviceTS - prev->deviceTS;
+				if((0==imu->minDelta)||(delta < imu->minDelta)){ imu->minDelta = delta; }
+				if(delta > imu->minDelta + imu->minDelta/2)
+				{
+					imu->dropCount += (delta + imu->minDelta/2) / imu->minDelta - 1;
+				}
+
+				// Trapezoidal running integrals over the device ticks.
+				s.deviceTicks = prev->deviceTicks + delta;
+				for(k= 0; k< 3; k++)
+				{
+					s.gyroSum[k]  = prev->gyroSum[k]  + 0.5 * (prev->gyro[k]  + s.gyro[k])  * delta;
+					s.accelSum[k] = prev->accelSum[k] + 0.5 * (prev->accel[k] + s.accel[k]) * delta;
+				}
+			}
+			else
+			{
+				imu->firstNS  = s.monoNS;
+				s.deviceTicks = s.deviceTS;
+				for(k= 0; k< 3; k++)
+				{
+					s.gyroSum[k]  = 0;
+					s.accelSum[k] = 0;
+				}
+			}
+			imu->lastNS = s.monoNS;
+			clock_sync_add(&imu->sync, s.deviceTicks, s.monoNS);
+
+			// Publish: the sample is complete before head covers it, and the
+			// previous head is visible before the slot is overwritten.
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+			imu->ring[head % VCIMU_RING_SIZE] = s;
+			__atomic_store_n(&imu->head, head + 1, __ATOMIC_RELEASE);
+		}
+
+		if(imu->periodUS>0)
+		{
+			t0 = timestamp_ns() - t0;
+			if(t0 < (U64)imu->periodUS * 1000){ usleep(imu->periodUS - t0/1000); }
+		}
 	}
 
-	return(0);
+	return(NULL);
 }
 
 
@@ -389,27 +10583,45 @@ int  change_options_by_commandline(int argc, char *argv[], int *shutter, float *
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Connects to a running vcimgnetsrv.
+* @brief  Starts the IMU Thread.
 *
-*  This function connects to a running vcimgnetsrv.
-*  Normally the vcimgnetsrv application is started beforehand in background
-*  using the following command:
+*  The thread reads the IMU of the module opened as fd.
 *
-*   vcimgnetsrv &
+* @param  periodUS    Minimum time between two reads, 0 to poll at the device rate.
+* @param  priority    SCHED_FIFO priority of the thread, 0 for SCHED_OTHER.
+* @param  excludedCpu CPU the thread must not run at, -1 for none.
 */
 /*-----------------------------------------------------------------------------*/
-int  imgnet_connect(VCImgNetCfg *imgnetCfg, U32 pixelformat, int dx, int dy)
+int  imu_start(VCImu *imu, int fd, I32 periodUS, I32 priority, I32 excludedCpu)
 {
-	//predefine dimensions for the image to be transferred
-	imgnetCfg->img.type  = (V4L2_PIX_FMT_SRGGB10P==pixelformat)?(IMAGE_RGB):(IMAGE_GREY);
-	imgnetCfg->img.dx    = dx;
-	imgnetCfg->img.dy    = dy;
-	imgnetCfg->img.pitch = imgnetCfg->img.dx;
-	imgnetCfg->img.st    = NULL;
-	imgnetCfg->img.ccmp1 = NULL;
-	imgnetCfg->img.ccmp2 = NULL;
+	I32          ee, rc;
+	VCImuSample  s;
 
-	return(vcimgnet_attach(&(imgnetCfg->img), imgnetCfg));
+	memset(imu, 0, sizeof(VCImu));
+	imu->fd       = fd;
+	imu->periodUS = periodUS;
+
+	rc =  imu_read(fd, &s);
+	if(rc<0){ee=-1; goto fail;}
+
+	rc =  thread_create_sched(&imu->thread, imu_thread_main, imu, priority, excludedCpu);
+	if(rc!=0){ee=-2; goto fail;}
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			syslog(LOG_ERR, "%s():  Could not read the IMU (%d(%s))!\n", __FUNCTION__, errno, strerror(errno));
+			break;
+		case -2:
+			syslog(LOG_ERR, "%s():  pthread_create() throws Error (%d(%s))!\n", __FUNCTION__, rc, strerror(rc));
+			break;
+	}
+
+	return(ee);
 }
 
 
@@ -418,15 +10630,13 @@ int  imgnet_connect(VCImgNetCfg *imgnetCfg, U32 pixelformat, int dx, int dy)
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Disconnects from a running vcimgnetsrv.
-*
-*  This function disconnects from a running vcimgnetsrv.
-*  The vcimgnetsrv application will keep running.
+* @brief  Stops and Joins the IMU Thread.
 */
 /*-----------------------------------------------------------------------------*/
-int  imgnet_disconnect(VCImgNetCfg *imgnetCfg)
+void  imu_stop(VCImu *imu)
 {
-	return(vcimgnet_detach(imgnetCfg));
+	imu->quitIff1 = 1;
+	pthread_join(imu->thread, NULL);
 }
 
 
@@ -435,72 +10645,124 @@ int  imgnet_disconnect(VCImgNetCfg *imgnetCfg)
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Tells the Sensor to Start Streaming Recordings.
+* @brief  Takes the Samples up to a Time from the IMU Ring.
 *
-*  This function tells the sensor to start streaming recordings.
-*  To get access to the streamed images
-*  buffers (which will be filled by the stream) must be enqueued,
-*  waited until one is filled, and dequeued.
+*  This function copies the samples from *cursor on, which were read
+*  at or before toNS, and advances *cursor behind them. Lock-free:
+*  the IMU thread keeps writing, samples it overwrote while or before
+*  they were copied are skipped and counted as overrun. If more than
+*  maxCount samples are due, only the latest maxCount are returned.
+*
+* @param  cursor      Sequence Number of the next Sample, one per Consumer, initially 0.
+* @return Number of Samples copied to out.
 */
 /*-----------------------------------------------------------------------------*/
-int  sensor_streaming_start(VCMipiSenCfg *sen)
+I32  imu_collect(VCImu *imu, U64 *cursor, U64 toNS, VCImuSample *out, I32 maxCount)
 {
-	I32                 ee, rc;
-	enum v4l2_buf_type  type;
+	U64  head = __atomic_load_n(&imu->head, __ATOMIC_ACQUIRE);
+	U64  seq, end;
+	I32  n = 0;
 
+	if(head - *cursor > VCIMU_RING_SIZE)
+	{
+		imu->overrunCount += head - VCIMU_RING_SIZE - *cursor;
+		*cursor = head - VCIMU_RING_SIZE;
+	}
 
-	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	// Samples are in time order, find the first one after toNS.
+	for(end= *cursor; (end< head)&&(imu->ring[end % VCIMU_RING_SIZE].monoNS <= toNS); end++);
 
-	rc =  ioctl(sen->fd, VIDIOC_STREAMON, &type);
-	if(rc<0){ee=-1; goto fail;}
+	if(end - *cursor > (U64)maxCount)
+	{
+		imu->truncCount += end - *cursor - maxCount;
+		*cursor = end - maxCount;
+	}
 
+	for(seq= *cursor; seq< end; seq++)
+	{
+		out[n++] = imu->ring[seq % VCIMU_RING_SIZE];
+	}
 
- 	ee=0;
-fail:
-	switch(ee)
+	// Samples the writer reached meanwhile, incl. the one it writes now, may be torn.
+	// The fence keeps the copies above from being read after head.
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&imu->head, __ATOMIC_ACQUIRE) + 1;
+	if(head > VCIMU_RING_SIZE + *cursor)
 	{
-		case 0:
-			break;
-		case -1:
-			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_STREAMON) throws Error!\n", __FUNCTION__);
-			break;
+		seq = min(head - VCIMU_RING_SIZE - *cursor, (U64)n);
+		memmove(out, out + seq, sizeof(VCImuSample) * (n - seq));
+		n                 -= seq;
+		imu->overrunCount += seq;
 	}
-	return(ee);
+
+	*cursor = end;
+	imu->attachedCount += n;
+
+	return(n);
 }
 
 
 
 
+
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Tells the Sensor to Stop Streaming Recordings.
+* @brief  Adds a Pair of Timestamps of two Clocks to the Clock Estimator.
 *
-*  This function tells the sensor to stop streaming recordings.
+*  Exponentially weighted linear regression of the CLOCK_MONOTONIC time y
+*  over the other clock's time x, the window is about VCSYNC_WINDOW pairs.
+*  After VCSYNC_WARMUP pairs, pairs off by more than VCSYNC_OUTLIER times
+*  the residual deviation (late USB transfers) are skipped.
+*  The fit is published like the LUTs of VCToneMap, so readers need no lock.
+*  Only one thread may add pairs.
 */
 /*-----------------------------------------------------------------------------*/
-int  sensor_streaming_stop(VCMipiSenCfg *sen)
+void  clock_sync_add(VCClockSync *cs, U64 x, U64 y)
 {
-	I32                 ee, rc;
-	enum v4l2_buf_type  type;
+	VCClockFit  *fit;
+	F64          dx, dy, r, a;
 
+	if(0==cs->count)
+	{
+		cs->x0 = x;
+		cs->y0 = y;
+		cs->count++;
+		return;
+	}
 
-	type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	dx = (F64)(I64)(x - cs->x0) - cs->mx;
+	dy = (F64)(I64)(y - cs->y0) - cs->my;
+	a  = max(1.0 / (cs->count + 1), 1.0 / VCSYNC_WINDOW);
 
-	rc =  ioctl(sen->fd, VIDIOC_STREAMOFF, &type);
-	if(rc<0){ee=-1; goto fail;}
+	if(cs->count>=2)
+	{
+		r = dy - cs->rate * dx;
+		if((cs->count>=VCSYNC_WARMUP)&&(r*r > VCSYNC_OUTLIER*VCSYNC_OUTLIER*cs->vrr))
+		{
+			cs->outlierCount++;
+			return;
+		}
+		cs->vrr = (1-a) * (cs->vrr + a*r*r);
+	}
 
+	cs->mx  += a * dx;
+	cs->my  += a * dy;
+	cs->vxx  = (1-a) * (cs->vxx + a*dx*dx);
+	cs->vxy  = (1-a) * (cs->vxy + a*dx*dy);
+	cs->count++;
+	if(cs->vxx>0){ cs->rate = cs->vxy / cs->vxx; }
 
- 	ee=0;
-fail:
-	switch(ee)
+	if(cs->count>=VCSYNC_WARMUP)
 	{
-		case 0:
-			break;
-		case -1:
-			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_STREAMOFF) throws Error!\n", __FUNCTION__);
-			break;
+		fit = (cs->active==&cs->fit[0])?(&cs->fit[1]):(&cs->fit[0]);
+		fit->x0     = cs->x0;
+		fit->y0     = cs->y0;
+		fit->mx     = cs->mx;
+		fit->my     = cs->my;
+		fit->rate   = cs->rate;
+		fit->jitter = sqrt(cs->vrr);
+		__atomic_store_n(&cs->active, fit, __ATOMIC_RELEASE);
 	}
-	return(ee);
 }
 
 
@@ -509,166 +10771,180 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Opens the Capture Device and Retreives its Attributes.
+* @brief  Maps a Time of the other Clock to CLOCK_MONOTONIC.
 *
-*  This function opens the capture device and retreives its attributes.
+* @return 0, or -1 if the estimator has not settled yet.
 */
 /*-----------------------------------------------------------------------------*/
-int  sensor_open(char *dev_video_device, VCMipiSenCfg *sen, int qbufCount)
+I32  clock_sync_map(VCClockSync *cs, U64 x, U64 *y)
 {
-	I32    ee, rc, i;
+	VCClockFit  fit;
+	VCClockFit *pFit = __atomic_load_n(&cs->active, __ATOMIC_ACQUIRE);
 
+	if(NULL==pFit){ return(-1); }
+	fit = *pFit;
 
-	// Reset Allocation Markers
-	// prohibits closing of un-open device and prevents wrong deallocation or unmapping.
-	{
-		sen->fd        =   -1;
-		sen->qbuf      = NULL;
-		sen->qbufCount =   -1;
-	}
+	*y = fit.y0 + (I64)(fit.my + fit.rate * ((F64)(I64)(x - fit.x0) - fit.mx));
 
+	return(0);
+}
 
-	// Open the Device.
-	{
-		sen->fd =  open(dev_video_device, O_RDWR, 0);
-		if(sen->fd<0){ee=-1; goto fail;}
-	}
 
 
-	// Check the Capabilities of the Device.
-	{
-		struct v4l2_capability  cap;
 
-		rc =  ioctl(sen->fd, VIDIOC_QUERYCAP, &cap);
-		if(rc<0){ee=-2; goto fail;}
 
-		// Check if device can Capture Videos and supports mmap access.
-		if(0==(cap.capabilities & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING)))
-		{ee=-3; goto fail;}
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Maps a CLOCK_MONOTONIC Time to the other Clock.
+*
+* @return 0, or -1 if the estimator has not settled yet.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  clock_sync_unmap(VCClockSync *cs, U64 y, U64 *x)
+{
+	VCClockFit  fit;
 
-		syslog(LOG_DEBUG, "%s:  Initialized Capture Device '%s' (fd:%d):\n", __FILE__, dev_video_device, sen->fd);
-	}
+	if(clock_sync_fit(cs, &fit)<0){ return(-1); }
 
+	return(clock_fit_unmap(&fit, y, x));
+}
 
-	// Retreive Dimensions of the Camera Device.
-	{
-		struct v4l2_format  format;
 
-		format.type                = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		format.fmt.pix.width       = UINT_MAX;
-		format.fmt.pix.height      = UINT_MAX;
-		format.fmt.pix.pixelformat = V4L2_PIX_FMT_Y10;
 
-		rc = ioctl(sen->fd, VIDIOC_G_FMT, &format);
-		if(rc<0){ee=-4; goto fail;}
 
-		sen->pix = format.fmt.pix;
 
-		syslog(LOG_DEBUG, "%s:    Pixel Format used:        %d          \n", __FILE__, sen->pix.pixelformat );
-		syslog(LOG_DEBUG, "%s:    Maximum Pixel Width:      %d          \n", __FILE__, sen->pix.width       );
-		syslog(LOG_DEBUG, "%s:    Maximum Pixel Height:     %d          \n", __FILE__, sen->pix.height      );
-		syslog(LOG_DEBUG, "%s:    Bytes Per Line:           %d          \n", __FILE__, sen->pix.bytesperline);
-	}
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Copies the published Fit of a Clock Estimator.
+*
+*  Several times mapped with the copy refer to the same fit, even if the
+*  estimator publishes a new one in between.
+*
+* @return 0, or -1 if the estimator has not settled yet.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  clock_sync_fit(VCClockSync *cs, VCClockFit *fit)
+{
+	VCClockFit *pFit = __atomic_load_n(&cs->active, __ATOMIC_ACQUIRE);
 
+	if((NULL==pFit)||(pFit->rate<=0)){ return(-1); }
+	*fit = *pFit;
 
-	// Allocate Capture Buffer Pointer 'Array'
-	{
-		QBuf  imgBufNuller = NULL_QBuf;
+	return(0);
+}
 
-		sen->qbuf =  malloc(sizeof(QBuf) * qbufCount);
-		if(NULL==sen->qbuf){ee=-99; goto fail;}
 
-		for(i= 0; i< qbufCount; i++)
-		{
-			sen->qbuf[i] = imgBufNuller;
-		}
-	}
 
-	// Request the Count of Capture Buffers
-	{
-		struct v4l2_requestbuffers  req;
 
-		memset(&req, 0, sizeof(struct v4l2_requestbuffers));
-		req.memory = V4L2_MEMORY_MMAP;
-		req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		req.count  = qbufCount;
 
-		rc =  ioctl(sen->fd, VIDIOC_REQBUFS, &req);
-		if(rc<0){ee=-5; goto fail;}
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Maps a CLOCK_MONOTONIC Time to the other Clock with a copied Fit.
+*
+* @return 0, or -1 if there is no fit.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  clock_fit_unmap(const VCClockFit *fit, U64 y, U64 *x)
+{
+	if((NULL==fit)||(fit->rate<=0)){ return(-1); }
 
-		if(req.count != qbufCount){ee=-6; goto fail;}
-	}
+	*x = fit->x0 + (I64)(fit->mx + ((F64)(I64)(y - fit->y0) - fit->my) / fit->rate);
 
-	// Map the capture buffer memory addresses to the Capture Buffer Pointer 'Array'
-	{
-		struct v4l2_buffer  buf;
+	return(0);
+}
 
-		sen->qbufCount = 0;
-		for(i= 0; i< qbufCount; i++)
-		{
-			memset(&buf, 0, sizeof(struct v4l2_buffer));
-			buf.memory = V4L2_MEMORY_MMAP;
-			buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-			buf.index  = sen->qbufCount;
 
-			rc =  ioctl(sen->fd, VIDIOC_QUERYBUF, &buf);
-			if(rc<0){ee=-7; goto fail;}
 
-			sen->qbuf[sen->qbufCount].byteCount = buf.length;
-			sen->qbuf[sen->qbufCount].st        = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, sen->fd, buf.m.offset);
-			if(MAP_FAILED==sen->qbuf[sen->qbufCount].st){ee=-8; goto fail;}
 
-			sen->qbufCount++;
-		}
-	}
 
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Offset, Drift and Jitter of a Clock Estimator.
+*
+* @param  nominalNS   Nominal Nanoseconds per Tick of the other Clock, the drift refers to it.
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  clock_sync_print(const char *pcName, VCClockSync *cs, F64 nominalNS)
+{
+	VCClockFit *fit = __atomic_load_n(&cs->active, __ATOMIC_ACQUIRE);
 
-	ee = 0;
-fail:
-	if(ee<0)
+	if(NULL==fit)
 	{
-		sensor_close(sen);
+		printf("  %-22s not settled, %llu pairs.\n", pcName, (unsigned long long)cs->count);
+		return(1);
 	}
-	switch(ee)
-	{
-		case 0:
-			break;
-		case -1:
-			syslog(LOG_ERR, "%s():  Could not open device '%s' for Reading/Writing!\n", __FUNCTION__, dev_video_device);
-			break;
-		case -2:
-			if(errno == EINVAL)
-				syslog(LOG_ERR, "%s():  Device '%s' is no V4L2 Device!\n", __FUNCTION__, dev_video_device);
-			else
-				syslog(LOG_ERR, "%s():  ioctl(VIDIOC_QUERYCAP) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
-			break;
-		case -3:
-			syslog(LOG_ERR, "%s():  Device '%s' is no Capture Device or doesn't support mmap as IO Method!\n", __FUNCTION__, dev_video_device);
-			break;
-		case -4:
-			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_G_FMT) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
-			break;
-		case -5:
-			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_REQBUFS) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
-			break;
-		case -6:
-			syslog(LOG_ERR, "%s():  Requested buffers differ from returned buffers!\n", __FUNCTION__);
-			break;
-		case -7:
-			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_QUERYBUF) throws Error on Device '%s'!\n", __FUNCTION__, dev_video_device);
-			break;
-		case -8:
-			syslog(LOG_ERR, "%s():  mmap() failed for Buffer %d!\n", __FUNCTION__, sen->qbufCount);
-			break;
-		case -99:
-			syslog(LOG_ERR, "%s():  Out of Memory!\n", __FUNCTION__);
-			break;
-		default:
-			syslog(LOG_ERR, "%s():  Unknown error code: %d!\n", __FUNCTION__, ee);
-			break;
+
+	printf("  %-22s offset %+12.3fms, %10.5fns/tick (%+8.1fppm), jitter %8.1fus, %llu pairs, %llu outliers.\n", pcName,
+			((F64)fit->y0 + fit->my - ((F64)fit->x0 + fit->mx) * nominalNS) / 1000000,
+			fit->rate, (fit->rate / nominalNS - 1) * 1000000, fit->jitter / 1000,
+			(unsigned long long)cs->count, (unsigned long long)cs->outlierCount);
+
+	return(1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Interpolates the IMU at a CLOCK_MONOTONIC Time.
+*
+*  The time is mapped to the IMU device clock, the two samples around it
+*  are found by binary search over the ring, O(log n), and interpolated
+*  linearly, incl. the integrals of gyro and accel.
+*
+* @param  fit         Copy of the clock fit, see clock_sync_fit().
+* @return 0, or -1 if the time is not covered by the ring or there is no fit.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  imu_sample_at(VCImu *imu, const VCClockFit *fit, U64 monoNS, VCImuSample *out)
+{
+	VCImuSample  s0, s1;
+	U64          ticks, head, lo, hi, mid;
+	F64          w;
+	I32          k;
+
+	if(clock_fit_unmap(fit, monoNS, &ticks)<0){ return(-1); }
+
+	head = __atomic_load_n(&imu->head, __ATOMIC_ACQUIRE);
+	if(head<2){ return(-1); }
+
+	// Oldest sample which cannot be overwritten while searching.
+	lo = (head > VCIMU_RING_SIZE - 1)?(head - VCIMU_RING_SIZE + 1):(0);
+	hi = head - 1;
+	if((ticks < imu->ring[lo % VCIMU_RING_SIZE].deviceTicks)||(ticks > imu->ring[hi % VCIMU_RING_SIZE].deviceTicks)){ return(-1); }
+
+	// Last sample at or before ticks.
+	while(lo < hi)
+	{
+		mid = lo + (hi - lo + 1) / 2;
+		if(imu->ring[mid % VCIMU_RING_SIZE].deviceTicks <= ticks){ lo = mid;     }
+		else                                                       { hi = mid - 1; }
 	}
+	s0 = imu->ring[lo % VCIMU_RING_SIZE];
+	s1 = imu->ring[min(lo + 1, head - 1) % VCIMU_RING_SIZE];
 
-	return(ee);
+	// As in imu_collect(), the copies are read before head.
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&imu->head, __ATOMIC_ACQUIRE) + 1;
+	if(head > VCIMU_RING_SIZE + lo){ return(-1); }
+
+	w = (s1.deviceTicks > s0.deviceTicks)?((F64)(ticks - s0.deviceTicks) / (s1.deviceTicks - s0.deviceTicks)):(0);
+
+	out->monoNS      = monoNS;
+	out->deviceTicks = ticks;
+	out->deviceTS    = (U32)ticks;
+	for(k= 0; k< 3; k++)
+	{
+		out->gyro[k]     = s0.gyro[k]     + (F32)w * (s1.gyro[k]     - s0.gyro[k]);
+		out->accel[k]    = s0.accel[k]    + (F32)w * (s1.accel[k]    - s0.accel[k]);
+		out->gyroSum[k]  = s0.gyroSum[k]  +      w * (s1.gyroSum[k]  - s0.gyroSum[k]);
+		out->accelSum[k] = s0.accelSum[k] +      w * (s1.accelSum[k] - s0.accelSum[k]);
+	}
+
+	return(0);
 }
 
 
@@ -677,46 +10953,77 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Closes the Capture Device.
+* @brief  Integrates the IMU between two CLOCK_MONOTONIC Times.
 *
-*  This function closes the capture device.
+*  Difference of the running integrals at both times, O(log n). Both
+*  times and the tick rate use one copy of the clock fit.
+*
+* @param  dAngle      Rotation in deg around x, y, z.
+* @param  dVelocity   Change of velocity in m/s along x, y, z (incl. gravity).
+* @return 0, or -1 if there is no clock fit or a time is not covered, see imu_sample_at().
 */
 /*-----------------------------------------------------------------------------*/
-int  sensor_close(VCMipiSenCfg *sen)
+I32  imu_integrate(VCImu *imu, U64 t0NS, U64 t1NS, F32 *dAngle, F32 *dVelocity)
 {
-	I32  ee, rc, i;
+	VCImuSample  s0, s1;
+	VCClockFit   fit;
+	F64          secPerTick;
+	I32          k;
 
+	if(clock_sync_fit(&imu->sync, &fit)<0){ return(-1); }
+	if(imu_sample_at(imu, &fit, t0NS, &s0)<0){ return(-1); }
+	if(imu_sample_at(imu, &fit, t1NS, &s1)<0){ return(-1); }
 
-	// checks if device has been opened (see sensor_open() and NULL_VCMipiSenCfg)
-	if(sen->fd>=0)
+	secPerTick = fit.rate / 1000000000;
+	for(k= 0; k< 3; k++)
 	{
-		//rc = uninit_mmap();
-		if(NULL!=sen->qbuf)
-		{
-			for(i=sen->qbufCount; i> 0; i--)
-			{
-				rc =  munmap(sen->qbuf[i-1].st, sen->qbuf[i-1].byteCount);
-				if(rc<0){ee=-1-10*i; goto fail;}
+		dAngle[k]    = (F32)((s1.gyroSum[k]  - s0.gyroSum[k])  * secPerTick);
+		dVelocity[k] = (F32)((s1.accelSum[k] - s0.accelSum[k]) * secPerTick);
+	}
 
-				sen->qbufCount--;
-			}
+	return(0);
+}
 
-			free(sen->qbuf);
-			sen->qbuf = NULL;
-		}
 
-		// Close Video Device.
-		{
-			rc =  close(sen->fd);
-			if(rc<0){return -2;}
 
-			sen->fd = -1;
-		}
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Interpolates and integrates the IMU over the Exposure of a Capture.
+*
+*  The sensor has a global shutter and the V4L2 timestamp is taken as the
+*  end of the exposure, which started shutter before it. The IMU is
+*  interpolated at the middle of the exposure and integrated over it.
+*  The results are stored in the QBuf.
+*
+* @param  shutter     Exposure Time of the Capture in VCSHUTTER_NS.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  imu_at_exposure(VCImu *imu, QBuf *qbuf, I64 shutter)
+{
+	U64         t1NS = (0!=qbuf->timestampNS)?(qbuf->timestampNS):(qbuf->dequeueNS);
+	U64         t0NS = t1NS - (U64)shutter * VCSHUTTER_NS;
+	U64         t    = timestamp_ns();
+	I32         rc;
+	VCClockFit  fit;
+
+	rc =  clock_sync_fit(&imu->sync, &fit);
+	if(rc>=0)
+	{
+		rc =  imu_sample_at(imu, &fit, t0NS + (t1NS - t0NS) / 2, &qbuf->imuMid);
+	}
+	if(rc>=0)
+	{
+		rc =  imu_integrate(imu, t0NS, t1NS, qbuf->imuDeltaAngle, qbuf->imuDeltaVelocity);
 	}
+	qbuf->imuMidValidIff1 = (rc>=0)?(1):(0);
 
-	ee=0;
-fail:
-	return(ee);
+	imu->queryNS += timestamp_ns() - t;
+	imu->queryCount++;
+	if(rc<0){ imu->queryMissCount++; }
+
+	return(rc);
 }
 
 
@@ -725,45 +11032,54 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Enqueues a Buffer into the Capture Queue.
-*
-*  This function enqueues a buffer into the capture queue.
+* @brief  Prints the Clock Estimators and the Cost of the Exposure Queries.
 *
-*  If the sensor acquires images, e.g. by being in streaming mode,
-*  buffers enqueued at the capture queue will be filled with recorded data.
-*  After successful waiting for a recording,
-*  the image can be accessed by dequeuing the buffer from the capture queue.
+* @return Count of lines printed.
 */
 /*-----------------------------------------------------------------------------*/
-int  capture_buffer_enqueue(I32 bufIdx, VCMipiSenCfg *sen)
+I32  imu_print_sync_stats(I32 camIdx, VCImu *imu, VCClockSync *frameSync)
 {
-	I32                 ee, rc;
-	struct v4l2_buffer  buf;
+	char  acName[64];
+	I32   lines;
+
+	snprintf(acName, sizeof(acName), "%d: IMU Clock", camIdx);
+	lines  = clock_sync_print(acName, &imu->sync, VCIMU_TICK_NS);
+	snprintf(acName, sizeof(acName), "%d: Frame Clock", camIdx);
+	lines += clock_sync_print(acName, frameSync, 1);
+	printf("  %d: %-19s %8llu Queries, %8.2fus mean, %llu not covered by the IMU.\n", camIdx, "IMU at Exposure",
+			(unsigned long long)imu->queryCount, (imu->queryCount>0)?((F32)imu->queryNS / imu->queryCount / 1000):(0.0f),
+			(unsigned long long)imu->queryMissCount);
+
+	return(lines + 1);
+}
 
-	memset(&buf, 0, sizeof(struct v4l2_buffer));
-	buf.memory = V4L2_MEMORY_MMAP;
-	buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	buf.index  = bufIdx;
 
-	rc =  ioctl(sen->fd, VIDIOC_QBUF, &buf);
-	if(rc<0){ee=-9; goto fail;}
 
 
-	ee = 0;
-fail:
-	switch(ee)
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Sample Rate, dropped and overrun Samples of the IMU.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  imu_print_stats(const char *pcName, const VCImu *imu)
+{
+	U64  count = imu->head;
+	F32  rate  = 0;
+
+	if(imu->lastNS > imu->firstNS)
 	{
-		case 0:
-			break;
-		case -9:
-			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_QBUF) throws Error!\n", __FUNCTION__);
-			break;
-		default:
-			syslog(LOG_ERR, "%s():  Unknown error code: %d!\n", __FUNCTION__, ee);
-			break;
+		rate = (F32)(count - 1) * 1000000000 / (imu->lastNS - imu->firstNS);
 	}
 
-	return(ee);
+	printf("  %-22s %8llu Samples, %8.1fHz, %llu dropped, %llu overrun, %llu truncated, %llu of %llu reads duplicate, %llu failed.\n", pcName,
+			(unsigned long long)count, rate, (unsigned long long)imu->dropCount, (unsigned long long)imu->overrunCount,
+			(unsigned long long)imu->truncCount, (unsigned long long)imu->duplicateCount,
+			(unsigned long long)imu->readCount, (unsigned long long)imu->errorCount);
+
+	return(1);
 }
 
 
@@ -772,61 +11088,48 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Dequeues a Buffer from the Capture Queue.
-*
-*  This function dequeues a buffer from the capture queue.
-*
-*  If the sensor acquires images, e.g. by being in streaming mode,
-*  buffers enqueued at the capture queue will be filled with recorded data.
-*  After successful waiting for a recording,
-*  the image can be accessed by dequeuing the buffer from the capture queue.
+* @brief  Adds a Latency Sample to the Statistics.
 */
 /*-----------------------------------------------------------------------------*/
-int  capture_buffer_dequeue(I32 *bufIdx, VCMipiSenCfg *sen)
+void  latency_stats_add(VCLatencyStats *lat, U64 ns)
 {
-	I32                 ee, rc;
-	struct v4l2_buffer  buf;
+	I32  i;
+	U64  us = ns / 1000;
 
-	memset(&buf, 0, sizeof(struct v4l2_buffer));
-	buf.memory = V4L2_MEMORY_MMAP;
-	buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	lat->count++;
+	lat->sumNS += ns;
+	if(ns > lat->maxNS){ lat->maxNS = ns; }
 
-	rc =  ioctl(sen->fd, VIDIOC_DQBUF, &buf);
-	if(rc<0)
-	{
-		if(EAGAIN==errno){ee=+1; goto fail;} // Buffer is not available.
-		else             {ee=-1; goto fail;}
-	}
+	for(i= 0; (i< VCLAT_BUCKETS-1)&&(us >= (64ULL << i)); i++);
+	lat->bucket[i]++;
+}
 
-	if(buf.index >= sen->qbufCount)
-	{
-		ee=-2; goto fail;
-	}
 
-	*bufIdx = buf.index;
 
 
-	ee = 0;
-fail:
-	switch(ee)
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Mean, Worst-Case and Histogram of Latency Statistics.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  latency_stats_print(const char *pcName, VCLatencyStats *lat)
+{
+	I32  i;
+
+	printf("  %-22s %8llu Frames, mean %8.3fms, worst %8.3fms, [<64us", pcName, (unsigned long long)lat->count,
+			(F32)lat->sumNS / 1000000 / max(1, lat->count), (F32)lat->maxNS / 1000000);
+	for(i= 0; i< VCLAT_BUCKETS; i++)
 	{
-		case +1:
-			syslog(LOG_ERR, "%s():  Buffer not available.\n", __FUNCTION__);
-			break;
-		case 0:
-			break;
-		case -1:
-			syslog(LOG_ERR, "%s():  ioctl(VIDIOC_DQBUF) throws Error!\n", __FUNCTION__);
-			break;
-		case -2:
-			syslog(LOG_ERR, "%s():  Buffer index returned exceeds limits: %d>=%d!\n", __FUNCTION__, buf.index, sen->qbufCount);
-			break;
-		default:
-			syslog(LOG_ERR, "%s():  Unknown error code: %d!\n", __FUNCTION__, ee);
-			break;
+		if(i==VCLAT_BUCKETS-1){ printf(" >=%lluus", 64ULL << (i-1)); }
+		else if(i>0)          { printf(" <%lluus",  64ULL << i);     }
+		printf(":%llu", (unsigned long long)lat->bucket[i]);
 	}
+	printf("]\n");
 
-	return(ee);
+	return(1);
 }
 
 
@@ -835,59 +11138,124 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Waits for a Buffer at the Capture Queue to be filled with captured Data.
+* @brief  Orders the Cameras by descending Priority.
 *
-*  This function waits for a buffer at the capture queue to be filled with
-*  data of a recording.
-*
-*  If the sensor acquires images, e.g. by being in streaming mode,
-*  buffers enqueued at the capture queue will be filled with recorded data.
-*  After successful waiting for a recording,
-*  the image can be accessed by dequeuing the buffer from the capture queue.
+*  Cameras of equal priority keep their command line order.
 */
 /*-----------------------------------------------------------------------------*/
-int  wait_for_next_capture(VCMipiSenCfg  *sen, int timeoutUS)
+void  camera_schedule_order(VCCamera *cam, I32 camCount, I32 *order)
 {
-	I32             ee, rc;
-	fd_set          fdSet;
-	struct timeval  tv;
+	I32  i, k, tmp;
 
-	while(1)
+	for(i= 0; i< camCount; i++)
 	{
-		FD_ZERO(&fdSet);
-		FD_SET(sen->fd, &fdSet);
-		tv.tv_sec  = (timeoutUS/1000000);
-		tv.tv_usec = (timeoutUS%1000000);
+		order[i] = i;
+	}
 
-		// Wait for data.
-		rc =  select(sen->fd + 1, &fdSet, NULL, NULL, &tv);
-		if(rc<0)
+	for(i= 1; i< camCount; i++)
+	{
+		for(k= i; (k> 0)&&(cam[order[k-1]].priority < cam[order[k]].priority); k--)
 		{
-			// Ignore interrupt based select returns.
-			if(EINTR==errno){continue;        }
-			else            {ee=-1; goto fail;}
+			tmp = order[k-1]; order[k-1] = order[k]; order[k] = tmp;
 		}
-		if(0==rc){ee=+1; goto fail;} //select() timeout.
+	}
+}
 
-		// New data is available.
-		break;
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Dequeues, Processes and Re-Enqueues the next Capture of a Camera.
+*
+*  This function returns +1 if no filled buffer is queued.
+*  Gaps of the driver's sequence numbers are counted as dropped frames.
+*/
+/*-----------------------------------------------------------------------------*/
+int  camera_process_next(VCCamera *c, VCWorkerPool *pool)
+{
+	I32          ee, rc, bufIdx, frameNr;
+	QBuf        *qbuf;
+	VCAeMeasure  ae;
+	VCProcessCfg proc = NULL_VCProcessCfg;
+	U64          captureNS;
+
+	rc =  capture_buffer_dequeue(&bufIdx, &c->sen);
+	if(rc>0){ee=+1; goto fail;} //no more buffers filled, wait again.
+	if(rc<0){ee=-1+100*rc; goto fail;}
+
+	qbuf = &c->sen.qbuf[bufIdx];
+
+	if((1==c->sequenceValidIff1)&&(qbuf->sequence - c->lastSequence > 1))
+	{
+		c->dropCount += qbuf->sequence - c->lastSequence - 1;
+	}
+	c->lastSequence      = qbuf->sequence;
+	c->sequenceValidIff1 = 1;
+
+	// The frame carries the IMU samples read since the previous one.
+	// and the IMU over its exposure, at the shutter last set.
+	if(NULL!=c->imu)
+	{
+		qbuf->imuCount = imu_collect(c->imu, &c->imuCursor, (0!=qbuf->timestampNS)?(qbuf->timestampNS):(qbuf->dequeueNS), qbuf->imu, VCIMU_FRAME_MAX);
+		imu_at_exposure(c->imu, qbuf, c->sen.ctrl[VCSENCTRL_EXPOSURE].value);
+	}
+	if(0!=qbuf->timestampNS)
+	{
+		clock_sync_add(&c->frameSync, qbuf->timestampNS, qbuf->dequeueNS);
 	}
 
+	frameNr   = c->frameNr++;
+	captureNS = (0!=qbuf->timestampNS)?(qbuf->timestampNS):(qbuf->dequeueNS);
+	c->rect.captureNS = captureNS;
+	c->out.captureNS  = captureNS;
 
-	ee = 0;
-fail:
-	switch(ee)
+	if(1==c->sched.enabledIff1)
 	{
-		case +1:
-			syslog(LOG_ERR, "%s():  select() timeout.\n", __FUNCTION__);
-			break;
-		case 0:
-			break;
-		case -1:
-			syslog(LOG_ERR, "%s():  select() failed!\n", __FUNCTION__);
-			break;
+		output_sched_update(&c->sched, &c->out, captureNS);
+	}
+
+	proc.arena  = &c->sen.arena;
+	proc.pipe   = c->sen.pipe;
+	proc.ae     = (1==c->ae.enabledIff1)?(&ae):(NULL);
+	proc.stats  = (1==c->statsIff1)?(&c->stats):(NULL);
+	proc.lut    = tone_map_lut(&c->tone);
+	proc.ingest = &c->sen.ingest;
+	proc.rect   = (c->rect.eyeCount>0)?(&c->rect):(NULL);
+	proc.gate   = (1==c->gate.enabledIff1)?(&c->gate):(NULL);
+	proc.sched  = (1==c->sched.enabledIff1)?(&c->sched):(NULL);
+
+	rc =  process_capture(pool, &proc, &c->out, qbuf->st, c->sen.pix.width, c->sen.pix.height, c->sen.pix.bytesperline, frameNr);
+	if(rc<0){ee=-2+100*rc; goto fail;}
+
+	if(1==c->ae.enabledIff1)
+	{
+		rc =  auto_exposure_update(&c->ae, &c->sen, &ae, frameNr);
+		if(rc<0){ee=-4+100*rc; goto fail;}
+	}
+
+	// The equalization of the next frame follows this frame's histogram.
+	if(VCTONE_CLAHE==c->tone.kind)
+	{
+		tone_map_update(&c->tone, &c->stats);
+	}
+
+	// Capture to dequeue and dequeue to processed latencies.
+	{
+		if((0!=qbuf->timestampNS)&&(qbuf->dequeueNS > qbuf->timestampNS)){ latency_stats_add(&c->latWakeup, qbuf->dequeueNS - qbuf->timestampNS); }
+		latency_stats_add(&c->latProcess, timestamp_ns() - qbuf->dequeueNS);
+
+		if(0==c->frameCount){ c->firstNS = qbuf->dequeueNS; }
+		c->lastNS = qbuf->dequeueNS;
+		c->frameCount++;
 	}
 
+	rc =  capture_buffer_enqueue(bufIdx, &c->sen);
+	if(rc<0){ee=-3+100*rc; goto fail;}
+
+	ee=0;
+fail:
 	return(ee);
 }
 
@@ -897,98 +11265,126 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Requests new Settings to the Sensor Device.
+* @brief  Processes all queued Captures of the ready Cameras.
 *
-*  This function requests new Settings to the Sensor Device
-*  like an exposure time or gain.
-*  When the settings become operational depends on the sensor and its configuration.
+*  Weighted round robin: in each round every ready camera, in order of
+*  priority, processes up to priority captures. Rounds repeat until no
+*  camera has filled buffers left, so a camera streaming at a higher
+*  frame rate cannot starve the others of the shared worker pool.
 */
 /*-----------------------------------------------------------------------------*/
-int  sensor_set_parameters(VCMipiSenCfg  *sen, int newGain, int newShutter)
+int  camera_process_ready(VCCamera *cam, I32 camCount, const I32 *order, VCWorkerPool *pool, VCEventLoop *loop)
 {
-	I32    ee, rc, target;
-	U32    ctlID, val;
-	char   a10cTarget[11];
-	struct v4l2_control  ctl;
-
+	I32        ee, rc, i, n, busyIff1;
+	VCCamera  *c;
 
-	for(target= 0; target< 2; target++)
+	do
 	{
-		switch(target)
-		{
-			case 0:  sprintf(a10cTarget,"Gain"    );  ctlID = V4L2_CID_GAIN;      val = newGain;     break;
-			case 1:  sprintf(a10cTarget,"Exposure");  ctlID = V4L2_CID_EXPOSURE;  val = newShutter;  break;
-		}
+		busyIff1 = 0;
 
-		// Only needed for debugging: Get old value.
+		for(i= 0; i< camCount; i++)
 		{
-			memset(&ctl, 0, sizeof(ctl));
-			ctl.id = ctlID;
+			c = &cam[order[i]];
 
-			rc =  ioctl(sen->fd, VIDIOC_G_CTRL, &ctl);
-			if(rc<0)
+			for(n= 0; (n< c->priority)&&(1==c->readyIff1); n++)
 			{
-				if(EINVAL!=errno){ee=-1; goto fail;} //general error.
-				else             {ee=-2; goto fail;} //unsupported.
-			}
+				rc =  camera_process_next(c, pool);
+				if(rc>0){ c->readyIff1 = 0; break; }
+				if(rc<0){ee=-1+100*rc; goto fail;}
 
-			syslog(LOG_DEBUG, "%s():  Old %s Value: %d.\n", __FUNCTION__, a10cTarget, ctl.value);
+				loop->frameCount++;
+				busyIff1 = 1;
+			}
 		}
+	}
+	while(1==busyIff1);
 
-		// Set new value.
-		{
-			memset(&ctl, 0, sizeof(ctl));
-			ctl.id    = ctlID;
-			ctl.value = val;
+	ee=0;
+fail:
+	return(ee);
+}
 
-			rc = ioctl(sen->fd, VIDIOC_S_CTRL, &ctl);
-			if(rc<0)
-			{
-				if((EINVAL!=errno)&&(ERANGE!=errno)){ee=-3; goto fail;} //general error.
-				else                                {ee=-4; goto fail;} //Value out of Range Error.
-			}
 
-			syslog(LOG_DEBUG, "%s():  Requested New %s Value: %d.\n", __FUNCTION__, a10cTarget, val);
-		}
 
-		// Only needed for debugging: Get new value.
-		{
-			memset(&ctl, 0, sizeof(ctl));
-			ctl.id = ctlID;
 
-			rc =  ioctl(sen->fd, VIDIOC_G_CTRL, &ctl);
-			if(rc<0)
-			{
-				if(EINVAL!=errno){ee=-5; goto fail;} //general error.
-				else             {ee=-6; goto fail;} //unsupported.
-			}
 
-			syslog(LOG_DEBUG, "%s():  New %s Value: %d.\n", __FUNCTION__, a10cTarget, ctl.value);
-		}
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints Frame Rate, dropped Frames and Latencies of a Camera.
+*
+* @return Count of lines printed.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  camera_print_stats(VCCamera *c)
+{
+	char  acName[64];
+	F32   fps = 0;
+	I32   lines = 1;
+
+	if(c->lastNS > c->firstNS)
+	{
+		fps = (F32)(c->frameCount - 1) * 1000000000 / (c->lastNS - c->firstNS);
 	}
 
+	printf("  Camera %d %-16s %8llu Frames, %8.3ffps, %llu dropped, %llu without a free slot.\n", c->idx, c->acVideoDev,
+			(unsigned long long)c->frameCount, fps, (unsigned long long)c->dropCount, (unsigned long long)c->sen.arena.exhaustCount);
 
-	ee = 0;
-fail:
-	switch(ee)
+	snprintf(acName, sizeof(acName), "%d: Capture to Dequeue", c->idx);
+	lines += latency_stats_print(acName, &c->latWakeup);
+	snprintf(acName, sizeof(acName), "%d: Dequeue to Processed", c->idx);
+	lines += latency_stats_print(acName, &c->latProcess);
+	snprintf(acName, sizeof(acName), "%d: Ingest", c->idx);
+	lines += ingest_print_stats(acName, &c->sen.ingest);
+	if(c->rect.eyeCount>0)
 	{
-		case 0:
-			break;
-		case -1:
-		case -3:
-		case -5:
-			syslog(LOG_ERR, "%s():  ioctl(%s) throws Error (%d(%s))!\n", __FUNCTION__, (-3==ee)?("VIDIOC_S_CTRL"):("VIDIOC_G_CTRL"), errno, strerror(errno));
-			break;
-		case -2:
-		case -6:
-			syslog(LOG_ERR, "%s():  V4L2_CID_.. is unsupported!\n", __FUNCTION__);
-			break;
-		case -4:
-			syslog(LOG_ERR, "%s():  %s Value is out of range (or V4L2_CID_.. is invalid)!\n", __FUNCTION__, a10cTarget);
-			break;
+		snprintf(acName, sizeof(acName), "%d: Rectification", c->idx);
+		lines += latency_stats_print(acName, &c->rect.latRectify);
+	}
+	// Printed once, by the camera of the left eye.
+	if((NULL!=c->rect.stereo)&&(0==c->rect.eye[0]))
+	{
+		snprintf(acName, sizeof(acName), "%d: Disparity", c->idx);
+		lines += stereo_print_stats(acName, c->rect.stereo);
+	}
+	if(NULL!=c->imu)
+	{
+		snprintf(acName, sizeof(acName), "%d: IMU", c->idx);
+		lines += imu_print_stats(acName, c->imu);
+		lines += imu_print_sync_stats(c->idx, c->imu, &c->frameSync);
+	}
+	if(1==c->ae.enabledIff1)
+	{
+		snprintf(acName, sizeof(acName), "%d: Auto Exposure", c->idx);
+		lines += auto_exposure_print_stats(acName, &c->ae);
+	}
+	if(1==c->sched.enabledIff1)
+	{
+		snprintf(acName, sizeof(acName), "%d: Output Rates", c->idx);
+		lines += output_sched_print_stats(acName, &c->sched);
+	}
+	if(1==c->gate.enabledIff1)
+	{
+		snprintf(acName, sizeof(acName), "%d: Change Gate", c->idx);
+		lines += change_gate_print_stats(acName, &c->gate);
+	}
+	if(NULL!=c->out.jpeg)
+	{
+		snprintf(acName, sizeof(acName), "%d: JPEG", c->idx);
+		lines += jpeg_print_stats(acName, c->out.jpeg);
+	}
+	if(NULL!=c->out.preview)
+	{
+		snprintf(acName, sizeof(acName), "%d: ASCII View", c->idx);
+		lines += preview_print_stats(acName, c->out.preview);
+	}
+	if(1==c->statsIff1)
+	{
+		printf("  %d: %-19s mean %6.1f, min %4u, max %4u, saturated %6u, sharpness %8.1f (10 bit).\n", c->idx, "Latest Frame",
+				c->stats.mean, c->stats.minimum, c->stats.maximum, c->stats.saturatedCount, c->stats.sharpness);
+		lines++;
 	}
 
-	return(ee);
+	return(lines);
 }
 
 
@@ -997,47 +11393,75 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Copies an Image Buffer to another Image Buffer.
+* @brief  Samples a Band of the converted Image for the Auto Exposure.
 *
-*  This function copies an image buffer to another image buffer.
+*  Every VCAE_SUBSAMPLE-th pixel of every VCAE_SUBSAMPLE-th row is added
+*  to the histogram, for colour images the green channel is used.
+*  The rows were just written by the conversion, so they are still in cache.
 */
 /*-----------------------------------------------------------------------------*/
-int copy_image(image *in, image *out)
+void  auto_exposure_measure_band(VCAeMeasure *m, image *img, I32 y0, I32 y1)
 {
-	int  ee, y;
-	int  dx=min(in->dx,out->dx);
-	int  dy=min(in->dy,out->dy);
+	I32  x, y;
+	U8  *pLine, *pR, *pB, *pPlane;
+	I32  stride = image_pixel_stride(img);
 
-	if(in->type != out->type) { ee=-1; goto fail; }
+	image_channels(img, &pR, &pPlane, &pB);
 
-	#if _OPENMP
-	#   pragma omp parallel for
-	#endif
-	for(y= 0; y< dy; y++)
-	{
-		memcpy((U8*)out->st + y * out->pitch, (U8*)in->st + y * in->pitch, dx);
-	}
-	if(IMAGE_RGB==out->type)
-	{
-		#if _OPENMP
-		#   pragma omp parallel for
-		#endif
-		for(y= 0; y< dy; y++)
-		{
-			memcpy((U8*)out->ccmp1 + y * out->pitch,  (U8*)in->ccmp1 + y * in->pitch, dx);
-		}
+	y0 = ((y0 + VCAE_SUBSAMPLE-1) / VCAE_SUBSAMPLE) * VCAE_SUBSAMPLE;
+	y1 = min(y1, img->dy);
 
-		#if _OPENMP
-		#   pragma omp parallel for
-		#endif
-		for(y= 0; y< dy; y++)
+	for(y= y0; y< y1; y+= VCAE_SUBSAMPLE)
+	{
+		pLine = pPlane + y * img->pitch;
+		for(x= 0; x< img->dx * stride; x+= VCAE_SUBSAMPLE * stride)
 		{
-			memcpy((U8*)out->ccmp2 + y * out->pitch,  (U8*)in->ccmp2 + y * in->pitch, dx);
+			m->sum += pLine[x];
+			m->hist[pLine[x] * VCAE_HIST_BINS / 256]++;
 		}
+		m->count += (img->dx + VCAE_SUBSAMPLE-1) / VCAE_SUBSAMPLE;
 	}
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Initializes the Auto Exposure of a Camera.
+*
+*  This function copies the settings of cfg and takes the shutter and
+*  gain limits from the cached sensor controls, so sensor_open() has to
+*  be called before.
+*/
+/*-----------------------------------------------------------------------------*/
+int  auto_exposure_init(VCAutoExposure *ae, const VCAutoExposure *cfg, VCMipiSenCfg *sen, F32 gain, I32 shutter)
+{
+	I32  ee;
+
+	*ae = *cfg;
+
+	if((1!=sen->ctrl[VCSENCTRL_GAIN].supportedIff1)||(1!=sen->ctrl[VCSENCTRL_EXPOSURE].supportedIff1)){ee=-1; goto fail;}
+
+	ae->shutterMin = sen->ctrl[VCSENCTRL_EXPOSURE].minimum;
+	ae->shutterMax = sen->ctrl[VCSENCTRL_EXPOSURE].maximum;
+	ae->gainMin    = max(1, sen->ctrl[VCSENCTRL_GAIN].minimum);
+	ae->gainMax    = sen->ctrl[VCSENCTRL_GAIN].maximum;
+	ae->shutter    = min(max(shutter, ae->shutterMin), ae->shutterMax);
+	ae->gain       = min(max(gain,    ae->gainMin   ), ae->gainMax   );
+	ae->period     = max(1, ae->period);
+	ae->latency    = max(0, ae->latency);
+	ae->startNS    = timestamp_ns();
 
 	ee=0;
 fail:
+	if(ee<0)
+	{
+		ae->enabledIff1 = 0;
+		syslog(LOG_ERR, "%s():  Sensor lacks gain or exposure control, auto exposure disabled!\n", __FUNCTION__);
+	}
+
 	return(ee);
 }
 
@@ -1047,84 +11471,75 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Outputs Image Pixels to a Framebuffer Device.
+* @brief  Runs the Auto Exposure Control Law on the Measurement of a Frame.
 *
-*  This function outputs Image Pixels to to a framebuffer device.
+*  The exposure (shutter times relative gain) is scaled by the damped ratio
+*  of target and measured mean, the shutter is raised first, the gain only
+*  beyond the shutter limit. Less than 1% clipped highlights are tolerated.
+*  After a change, the frames exposed before the sensor applied it
+*  (control latency) are not used, and changes are made at most every
+*  period frames.
 *
-* @param  stp        Print only each  @p stp  pixel.
-* @param  goUpIff1   Overwrite old ASCII image, works only on recent terminals,
-*                    and needs no other data lines to be printed.
+* @param  frameNr  Number of the measured frame, counting up.
 */
 /*-----------------------------------------------------------------------------*/
-int  copy_image_to_framebuffer(char *pcFramebufferDev, const void *pvDataGREY_OR_R, const void *pvDataGREY_OR_G, const void *pvDataGREY_OR_B, I32 dy, I32 pitch)
+int  auto_exposure_update(VCAutoExposure *ae, VCMipiSenCfg *sen, const VCAeMeasure *m, I32 frameNr)
 {
-	I32                       rc, ee;
+	I32  ee, rc, inToleranceIff1;
+	U64  t0, dt;
+	F32  mean, ratio, exposure, clipped;
 
-	U8                       *pInR   = NULL, *pInG   = NULL, *pInB   = NULL;
-	U8                       *pOut   = NULL;
-	int                       fbufFd = 0;
-	U8                       *fbufSt = NULL;
-	struct fb_var_screeninfo  fbufVars;
-	struct fb_fix_screeninfo  fbufConsts;
-	U32                       fbufByteCount;
-	I32                       x, y, scaler;
+	t0 = timestamp_ns();
 
+	if(0==m->count){ee=0; goto fail;}
 
-	// Open the framebuffer for reading and writing
+	mean    = (F32)m->sum / m->count;
+	clipped = (F32)m->hist[VCAE_HIST_BINS-1] / m->count;
+	ae->mean = mean;
+
+	// Convergence time: from start or from leaving the tolerance until back in it.
+	inToleranceIff1 = ((mean - ae->target <=  ae->tolerance * ae->target)
+	                 &&(mean - ae->target >= -ae->tolerance * ae->target)
+	                 &&(clipped < 0.01f))?(1):(0);
+	if((1==inToleranceIff1)&&(0==ae->convergedIff1))
 	{
-		fbufFd =  open(pcFramebufferDev, O_RDWR);
-		if(fbufFd<0){ee=-1; goto fail;}
+		ae->convergedIff1 = 1;
+		ae->settleNS      = t0 - ae->startNS;
+		ae->settleCount++;
 	}
-
-	// Get framebuffer information
+	if((0==inToleranceIff1)&&(1==ae->convergedIff1))
 	{
-		// Variable information
-		rc =  ioctl(fbufFd, FBIOGET_VSCREENINFO, &fbufVars  );
-		if(rc<0){ee=-2+10*rc; goto fail;}
-
-		// Constant information
-		rc =  ioctl(fbufFd, FBIOGET_FSCREENINFO, &fbufConsts);
-		if(rc<0){ee=-3+10*rc; goto fail;}
+		ae->convergedIff1 = 0;
+		ae->startNS       = t0;
 	}
 
-	// Map the framebuffer to memory
-	{
-		fbufByteCount = fbufVars.xres * fbufVars.yres * fbufVars.bits_per_pixel / 8;
+	if((1==inToleranceIff1)||(frameNr < ae->nextFrame)){ee=0; goto fail;}
 
-		fbufSt =  mmap(NULL, fbufByteCount, PROT_READ | PROT_WRITE, MAP_SHARED, fbufFd, 0);
-		if(fbufSt<0){ee=-4; goto fail;}
-	}
 
-	// Approx. scale up/down to framebuffer size.
-	scaler =  max(1,  min(pitch/fbufVars.xres, dy/fbufVars.yres));
+	ratio = ae->target / max(mean, 1.0f);
+	if(clipped >= 0.01f){ ratio = min(ratio, 0.5f); }
+	ratio = min(max(ratio, 0.25f), 4.0f);
+	ratio = 1.0f + ae->damping * (ratio - 1.0f);
 
-	// Write pixel per pixel (slow)
-	for(y = 0; y < min(fbufVars.yres, dy); y++)
-	{
-		pInR = ((U8*)pvDataGREY_OR_R) + (scaler * y) * pitch;
-		pInG = ((U8*)pvDataGREY_OR_G) + (scaler * y) * pitch;
-		pInB = ((U8*)pvDataGREY_OR_B) + (scaler * y) * pitch;
-		pOut =       fbufSt  + (y + fbufVars.yoffset) * fbufConsts.line_length
-		                     +      fbufVars.xoffset  * fbufVars.bits_per_pixel/8;
+	exposure    = (F32)ae->shutter * ae->gain / ae->gainMin * ratio;
+	ae->shutter = min(max((I32)exposure, ae->shutterMin), ae->shutterMax);
+	ae->gain    = min(max(ae->gainMin * exposure / ae->shutter, ae->gainMin), ae->gainMax);
 
-		for(x = 0; x < min(fbufVars.xres, pitch); x++)
-		{
-			*((U32*) pOut) = ((*pInR) << 16) | ((*pInG) << 8) | ((*pInB) << 0);
+	rc =  sensor_set_parameters(sen, ae->gain, ae->shutter);
+	if(rc<0){ee=-1+100*rc; goto fail;}
 
-			pInR += scaler;
-			pInG += scaler;
-			pInB += scaler;
-			pOut += fbufVars.bits_per_pixel/8;
-		}
-	}
+	ae->applyCount++;
+	ae->nextFrame = frameNr + max(ae->period, ae->latency + 1);
 
 
 	ee=0;
 fail:
-	if(NULL!=fbufSt){  munmap(fbufSt, fbufByteCount);  fbufSt = NULL; }
-	close(fbufFd);
+	dt = timestamp_ns() - t0;
+	ae->costNS += dt;
+	ae->costCount++;
+	if(dt > ae->costMaxNS){ ae->costMaxNS = dt; }
 
-	return ee;
+	return(ee);
 }
 
 
@@ -1133,74 +11548,142 @@ fail:
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Outputs Image Pixels to stdout.
-*
-*  This function outputs Image Pixels to stdout.
+* @brief  Prints State, Convergence Time and Control Cost of the Auto Exposure.
 *
-* @param  stp        Print only each  @p stp  pixel.
-* @param  goUpIff1   Overwrite old ASCII image, works only on recent terminals,
-*                    and needs no other data lines to be printed.
+* @return Count of lines printed.
 */
 /*-----------------------------------------------------------------------------*/
-void  print_image_to_stdout(image *img,  int stp, int goUpIff1)
+I32  auto_exposure_print_stats(const char *pcName, VCAutoExposure *ae)
 {
-	static U8 noUpAtFirst = 1;
+	char  acSettle[64];
+
+	if(ae->settleCount>0){ snprintf(acSettle, sizeof(acSettle), "%.1fms", (F32)ae->settleNS / 1000000); }
+	else                 { snprintf(acSettle, sizeof(acSettle), "-");                                   }
+
+	printf("  %-22s mean %5.1f/%3.0f, shutter %6d, gain %5.1f, %llu changes, %s, last settled in %s, cost mean %.1fus worst %.1fus.\n", pcName,
+			ae->mean, ae->target, ae->shutter, ae->gain, (unsigned long long)ae->applyCount,
+			(1==ae->convergedIff1)?("converged"):("settling"), acSettle,
+			(F32)ae->costNS / 1000 / max(1, ae->costCount), (F32)ae->costMaxNS / 1000);
 
-	I32 y,x;
-	unsigned char *px=NULL;
-	U8  c;
+	return(1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Initializes the Change Gate of a Camera.
+*
+*  This function copies the thresholds of cfg and allocates the block
+*  sums and the references for captures of dx x dy pixels.
+*/
+/*-----------------------------------------------------------------------------*/
+int  change_gate_init(VCChangeGate *gate, const VCChangeGate *cfg, I32 dx, I32 dy)
+{
+	I32  ee, o;
 
-	if((1==goUpIff1)&&(noUpAtFirst!=1))
-		printf("\033[%dA", img->dy/stp+1 +1);
+	*gate = *cfg;
+	gate->dx = dx;
+	gate->dy = dy;
+	gate->bx = (dx + VCGATE_BLOCK-1) / VCGATE_BLOCK;
+	gate->by = (dy + VCGATE_BLOCK-1) / VCGATE_BLOCK;
+	if(gate->bx > VCGATE_BLOCKS_X_MAX){ee=-1; goto fail;}
 
-	if(1==noUpAtFirst){ noUpAtFirst=0; }
+	gate->blockSum = (U32*)frame_arena_alloc_plane(gate->bx * gate->by * sizeof(U32), 1);
+	if(NULL==gate->blockSum){ee=-2; goto fail;}
 
-	printf("//");
-	for(x= 0; x< img->dx; x+=stp)
+	for(o= 0; o< VCGATE_OUT_COUNT; o++)
 	{
-		printf("==");
+		gate->ref[o] = frame_arena_alloc_plane(gate->bx * gate->by, 1);
+		if(NULL==gate->ref[o]){ee=-2; goto fail;}
 	}
-	printf("\\\\\n");
 
-	for(y= 0; y< img->dy; y+=stp)
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case  0:  break;
+		case -1:  syslog(LOG_ERR, "%s():  Captures of %d pixels per row are too wide!\n", __FUNCTION__, dx);  break;
+		default:  syslog(LOG_ERR, "%s():  Out of memory!\n", __FUNCTION__);  break;
+	}
+	if(ee<0)
 	{
-		px = (unsigned char *) img->st + y * img->pitch;
+		change_gate_destroy(gate);
+	}
 
-		printf("||");
+	return(ee);
+}
 
-		for(x= 0; x< img->dx; x+=stp)
-		{
-			c =  (*(px+x)< 40)?(' ')
-				:(*(px+x)< 89)?('-')
-				:(*(px+x)<138)?('+')
-				:(*(px+x)<178)?('*')
-				:(*(px+x)<216)?('X')
-				:(              '#');
 
-			printf("%c%c", c, c);
-		}
 
-		printf("||\n");
-	}
 
-	printf("\\\\");
-	for(x= 0; x< img->dx; x+=stp)
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Frees the Block Sums and References of the Change Gate.
+*/
+/*-----------------------------------------------------------------------------*/
+void  change_gate_destroy(VCChangeGate *gate)
+{
+	I32  o;
+
+	free(gate->blockSum);
+	gate->blockSum = NULL;
+	for(o= 0; o< VCGATE_OUT_COUNT; o++)
 	{
-		printf("==");
+		free(gate->ref[o]);
+		gate->ref[o] = NULL;
 	}
-	printf("//\r\n");
+	gate->enabledIff1 = 0;
 }
 
 
 
 
 
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Adds a Band of the converted Image to the Block Sums.
+*
+*  Every VCGATE_SUBSAMPLE-th pixel of every VCGATE_SUBSAMPLE-th row,
+*  green channel of colour images, while the rows are still in cache.
+*  Blocks may span bands, so each block row is added atomically once.
+*/
+/*-----------------------------------------------------------------------------*/
+void  change_gate_measure_band(VCChangeGate *gate, image *img, I32 y0, I32 y1)
+{
+	U32  acc[VCGATE_BLOCKS_X_MAX];
+	U8  *pLine, *pR, *pB, *pPlane;
+	I32  stride = image_pixel_stride(img);
+	I32  x, y, b, by;
 
+	image_channels(img, &pR, &pPlane, &pB);
 
+	y  = ((y0 + VCGATE_SUBSAMPLE-1) / VCGATE_SUBSAMPLE) * VCGATE_SUBSAMPLE;
+	y1 = min(y1, img->dy);
 
+	while(y < y1)
+	{
+		by = y / VCGATE_BLOCK;
+		memset(acc, 0, gate->bx * sizeof(U32));
 
+		for(; (y< y1)&&(y< (by+1) * VCGATE_BLOCK); y+= VCGATE_SUBSAMPLE)
+		{
+			pLine = pPlane + y * img->pitch;
+			for(x= 0; x< img->dx; x+= VCGATE_SUBSAMPLE)
+			{
+				acc[x / VCGATE_BLOCK] += pLine[x * stride];
+			}
+		}
 
-
+		for(b= 0; b< gate->bx; b++)
+		{
+			__atomic_add_fetch(&gate->blockSum[by * gate->bx + b], acc[b], __ATOMIC_RELAXED);
+		}
+	}
+}
 
 
 
@@ -1208,48 +11691,15 @@ void  print_image_to_stdout(image *img,  int stp, int goUpIff1)
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Converts One Line from RAW10 to 8 Bit Grey Value (Offset-Free).
-*
-*  This function converts one line of an image from RAW10 to an 8 bit grey value.
-*
-*  The RAW10 format has four bytes with each containing the uppermost 8 bits
-*  of the pixels followed by one byte with the two lowermost bits of each of
-*  the four preceeding pixels packed together:
-*
-*    X0, X1, X2, X3, LowerBitsOfX0..3,  X4, X5, X6, X7, LowerBitsOfX4..7, etc.
-*
-*  The algorithm simply copies the first four Bytes and skips over the following
-*  byte with the lowermost bit information.
-*
-*  Since the starting position is relevant to know where the byte with the
-*  lower bits is and to jump over it, this function needs the byte with the
-*  lower bits at fifth position, like being shown at the example above.
-*
-*   there is   so it is important where the buffer begins: trackOffset==0->X0,trackOffset<4->X1..3.
-*
-* @param  count      Length of the conversion, should be the width of the output image.
-* @param  bufIn      RAW10 encoded data: if the output image has width bytes,
-*                    this buffer should have at least (width * 10)/8 bytes.
-* @param  bufOut     8 Bit Grey Value Output Address.
+* @brief  Mean of a Block of the current Capture.
 */
 /*-----------------------------------------------------------------------------*/
-inline void  FL_CPY_RAW10P_U8P_NOOFFS(U32 count, char *bufIn, U8 *bufOut)
+static inline I32  change_gate_block_mean(const VCChangeGate *gate, I32 bx, I32 by)
 {
-	while(count >= 4)
-	{
-		*((U32*)bufOut) = *((U32*)bufIn);
-		bufIn+=5;
-		bufOut+=4;
+	I32  nx = (min(VCGATE_BLOCK, gate->dx - bx * VCGATE_BLOCK) + VCGATE_SUBSAMPLE-1) / VCGATE_SUBSAMPLE;
+	I32  ny = (min(VCGATE_BLOCK, gate->dy - by * VCGATE_BLOCK) + VCGATE_SUBSAMPLE-1) / VCGATE_SUBSAMPLE;
 
-		count -= 4;
-	}
-
-	while(count--)
-	{
-		*bufOut = (U8)(*bufIn);
-		bufIn++;
-		bufOut++;
-	}
+	return((gate->blockSum[by * gate->bx + bx] + (nx * ny)/2) / (nx * ny));
 }
 
 
@@ -1258,380 +11708,353 @@ inline void  FL_CPY_RAW10P_U8P_NOOFFS(U32 count, char *bufIn, U8 *bufOut)
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Converts One Line from RAW10 to 8 Bit Grey Value.
-*
-*  This function converts one line of an image from RAW10 to an 8 bit grey value.
+* @brief  Score of the current Capture for Output o.
 *
-*  The RAW10 format has four bytes with each containing the uppermost 8 bits
-*  of the pixels followed by one byte with the two lowermost bits of each of
-*  the four preceeding pixels packed together:
-*
-*    X0, X1, X2, X3, LowerBitsOfX0..3,  X4, X5, X6, X7, LowerBitsOfX4..7, etc.
-*
-*  The algorithm simply copies the first four Bytes and skips over the following
-*  byte with the lowermost bit information.
-*
-*  Since the starting position is relevant to know where the byte with the
-*  lower bits is and to jump over it, the trackOffset parameter encodes this:
-*
-*  - If trackOffset==0 the first byte is X0.
-*  - If trackOffset==1 the first byte is X1.
-*  - If trackOffset==2 the first byte is X2.
-*  - If trackOffset==3 the first byte is X3.
-*  - Values of trackOffset > 3 are not allowed, especially the input buffer
-*    is not allowed to start at the lowermost bits byte.
-*
-* @param  count       Length of the conversion, should be the width of the output image.
-* @param  bufIn       RAW10 encoded data: if the output image has width bytes,
-*                     this buffer should have at least (width * 10)/8 bytes.
-* @param  trackOffset See text.
-* @param  bufOut      8 Bit Grey Value Output Address.
+* @return Blocks whose mean differs from the last frame output, in 1/1000.
 */
 /*-----------------------------------------------------------------------------*/
-inline void  FL_CPY_RAW10P_U8P(U32 count, U8 trackOffset, char *bufIn, U8 *bufOut)
+I32  change_gate_score(const VCChangeGate *gate, I32 o)
 {
-	while((trackOffset<4)&&(count-- > 0))
-	{
-		*bufOut = (U8)(*bufIn);
-		bufIn++;
-		bufOut++;
-		trackOffset+=1;
-	}
+	I32  bx, by, changed = 0;
 
-	bufIn++;
-
-	while(count >= 4)
+	for(by= 0; by< gate->by; by++)
 	{
-		*((U32*)bufOut) = *((U32*)bufIn);
-		bufIn+=5;
-		bufOut+=4;
-
-		count -= 4;
+		for(bx= 0; bx< gate->bx; bx++)
+		{
+			if(abs(change_gate_block_mean(gate, bx, by) - gate->ref[o][by * gate->bx + bx]) > VCGATE_NOISE){ changed++; }
+		}
 	}
 
-	while(count--)
-	{
-		*bufOut = (U8)(*bufIn);
-		bufIn++;
-		bufOut++;
-	}
+	return((changed * 1000) / (gate->bx * gate->by));
 }
 
 
 
 
 
-
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Converts Image from RAW10 Format to 8 Bit Grey Value.
-*
-*  This function converts an image from RAW10 format to 8 bit grey value.
-*
-*  The RAW10 format has four bytes with each containing the uppermost 8 bits
-*  of the pixels followed by one byte with the two lowermost bits of each of
-*  the four preceeding pixels packed together:
-*
-*    X0, X1, X2, X3, LowerBitsOfX0..3,  X4, X5, X6, X7, LowerBitsOfX4..7, etc.
-*
-*  Since the starting position is relevant to know where the byte with the
-*  lower bits is and to jump over it, the trackOffset parameter encodes this:
-*
-*  - If trackOffset==0 the first byte is X0.
-*  - If trackOffset==1 the first byte is X1.
-*  - If trackOffset==2 the first byte is X2.
-*  - If trackOffset==3 the first byte is X3.
-*  - Values of trackOffset > 3 are not allowed, especially the input buffer
-*    is not allowed to start at the lowermost bits byte.
+* @brief  Checks whether Output o is due for the current Capture.
 *
-* @param  bufIn       RAW10 encoded data: if the output image has width*height bytes,
-*                     this buffer should have at least height*(width * 10)/8 bytes.
-* @param  trackOffset See text.
-* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
-* @param  v4lDx,v4lDy Dimensions of the input buffer.
-* @param  v4lPitch    Currently the same as v4lDx.
-* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
-* @param  imgOut      8 Bit Grey Value Output image.
+*  Does not change the gate, so the bands of a gated stage and the
+*  following change_gate_update() decide alike.
 */
 /*-----------------------------------------------------------------------------*/
-I32  convert_raw10_to_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+I32  change_gate_due(const VCChangeGate *gate, I32 o)
 {
-	I32   dx = min(imgOut->dx, v4lDx - v4lX0);
-	I32   y;
-
-	if(IMAGE_GREY!=imgOut->type)
-	{
-		return(ERR_TYPE);
-	}
-	if(v4lDx > v4lPitch)
-	{
-		return(ERR_PARAM);
-	}
-	if((v4lX0 >= v4lDx)||(v4lY0 >= v4lDy))
-	{
-		return(ERR_PARAM);
-	}
-	if(trackOffset > 3)
-	{
-		return(ERR_PARAM);
-	}
+	if((0==gate->threshold[o])||(0==gate->refValidIff1[o])){ return(1); }
+	if((gate->keepAlive>0)&&(gate->sinceOutput[o]+1 >= gate->keepAlive)){ return(1); }
 
+	return((change_gate_score(gate, o) >= gate->threshold[o])?(1):(0));
+}
 
-	if((0==trackOffset)&&(0==v4lX0)&&(0==v4lY0))
-	{
-		#if _OPENMP
-		#   pragma omp parallel for
-		#endif
-		for(y= 0; y< min(imgOut->dy,v4lDy); y++)
-		{
-			char *in  =       bufIn + y * ((v4lPitch*5)/4 + v4lPaddingBytes);
-			U8   *out =  imgOut->st + y * imgOut->pitch;
 
-			FL_CPY_RAW10P_U8P_NOOFFS(dx, in, out);
-		}
-	}
-	else
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Decides the Outputs of the current Capture and updates their References.
+*
+*  Outputs not in activeMask are left alone. An output due takes the
+*  block means of the capture as its reference, others count a skip.
+*
+* @return Mask of the outputs due, 1 << VCGATE_OUT_...
+*/
+/*-----------------------------------------------------------------------------*/
+U32  change_gate_update(VCChangeGate *gate, U32 activeMask)
+{
+	U32  dueMask = 0;
+	I32  o, bx, by;
+
+	if(0==activeMask){ return(0); }
+	gate->frameCount++;
+
+	for(o= 0; o< VCGATE_OUT_COUNT; o++)
 	{
-		char *in  = bufIn;
-		U8   *out = imgOut->st;
+		if(0==(activeMask & (1u<<o))){ continue; }
 
-		for(y= 0; y< v4lDy; y++)
+		gate->score[o] = (1==gate->refValidIff1[o])?(change_gate_score(gate, o)):(1000);
+		if(1==change_gate_due(gate, o))
 		{
-			in          =          in  + (         v4lX0) + ((trackOffset%4)+(         v4lX0))/4;
-			trackOffset = (trackOffset + (         v4lX0))%4;
-
-			if((y >= v4lY0)&&(y - v4lY0 < imgOut->dy))
+			for(by= 0; by< gate->by; by++)
 			{
-				FL_CPY_RAW10P_U8P(dx, trackOffset, in, out);
-
-				out = out + imgOut->pitch;
+				for(bx= 0; bx< gate->bx; bx++)
+				{
+					gate->ref[o][by * gate->bx + bx] = (U8)change_gate_block_mean(gate, bx, by);
+				}
 			}
-
-			in          =          in  + (v4lPitch-v4lX0) + ((trackOffset%4)+(v4lPitch-v4lX0))/4 + v4lPaddingBytes;
-			trackOffset = (trackOffset + (v4lPitch-v4lX0))%4;
+			gate->refValidIff1[o] = 1;
+			gate->sinceOutput[o]  = 0;
+			dueMask |= 1u<<o;
+		}
+		else
+		{
+			gate->sinceOutput[o]++;
+			gate->skipCount[o]++;
 		}
 	}
 
-	return(ERR_NONE);
+	return(dueMask);
 }
 
 
+
+
+
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Copys Image from GREY Format to 8 Bit Grey Value.
-*
-*  This function copys an image from GREY format to 8 bit grey value.
-*  It is just a copy routine, since the data format is already the same.
+* @brief  Prints the Frames skipped per Output and the latest Scores.
 *
-* @param  bufIn       GREY encoded data.
-* @param  ignoredTrackOffset Ignored.
-* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
-* @param  v4lDx,v4lDy Dimensions of the input buffer.
-* @param  v4lPitch    Currently the same as v4lDx.
-* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
-* @param  imgOut      8 Bit Grey Value Output image.
+* @return Count of lines printed.
 */
 /*-----------------------------------------------------------------------------*/
-I32  copy_grey_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+I32  change_gate_print_stats(const char *pcName, const VCChangeGate *gate)
 {
-	I32   dx = min(imgOut->dx, v4lDx - v4lX0);
-	I32   y;
+	printf("  %-22s %8llu Frames, skipped file %llu, framebuffer %llu, vcimgnetsrv %llu, scores %d %d %d of 1000.\n", pcName,
+			(unsigned long long)gate->frameCount, (unsigned long long)gate->skipCount[VCGATE_OUT_FILE],
+			(unsigned long long)gate->skipCount[VCGATE_OUT_FB], (unsigned long long)gate->skipCount[VCGATE_OUT_NET],
+			gate->score[VCGATE_OUT_FILE], gate->score[VCGATE_OUT_FB], gate->score[VCGATE_OUT_NET]);
 
-	if(IMAGE_GREY!=imgOut->type)
-	{
-		return(ERR_TYPE);
-	}
-	if(v4lDx > v4lPitch)
-	{
-		return(ERR_PARAM);
-	}
-	if((v4lX0 >= v4lDx)||(v4lY0 >= v4lDy))
-	{
-		return(ERR_PARAM);
-	}
+	return(1);
+}
 
 
-	#if _OPENMP
-	#   pragma omp parallel for
-	#endif
-	for(y= 0; y< min(imgOut->dy,v4lDy); y++)
-	{
-		char *in  =       bufIn + v4lX0 + (y + v4lY0) * (v4lPitch + v4lPaddingBytes);
-		U8   *out =  imgOut->st + y * imgOut->pitch;
 
-		memcpy(out, in, dx);
-	}
 
 
-	return(ERR_NONE);
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Initializes the Output Scheduler of a Camera.
+*
+*  This function copies the rate rules of cfg and orders the outputs
+*  by descending priority, outputs of equal priority in VCSINK_.. order.
+*/
+/*-----------------------------------------------------------------------------*/
+void  output_sched_init(VCOutputSched *sched, const VCOutputSched *cfg)
+{
+	I32  i, k, s;
+
+	*sched = *cfg;
+	for(i= 0; i< VCSINK_COUNT; i++)
+	{
+		s = i;
+		for(k= i; (k>0)&&(sched->sink[sched->order[k-1]].priority < sched->sink[s].priority); k--)
+		{
+			sched->order[k] = sched->order[k-1];
+		}
+		sched->order[k] = s;
+
+		sched->sink[i].nextNS    = 0;
+		sched->sink[i].dueCount  = 0;
+		sched->sink[i].skipCount = 0;
+	}
+	sched->frameCount       = 0;
+	sched->dueMask          = 0;
+	sched->convertSkipCount = 0;
 }
 
 
 
 
+
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Direct conversion from raw10 Bayer RGB data to IMAGE_RGB.
-*
-*  This function does a direct conversion from raw10 Bayer RGB data to IMAGE_RGB.
+* @brief  Decides which enabled Outputs are due for the next Capture.
 *
-* @param  bufIn       Bayer encoded data.
-* @param  ignoredTrackOffset Ignored.
-* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
-* @param  v4lDx,v4lDy Dimensions of the input buffer.
-* @param  v4lPitch    Currently the same as v4lDx.
-* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
-* @param  imgOut      8 Bit RGB Value Output image.
+*  An output is due on every every-th capture, and with a period not
+*  before its next due time. That advances by whole periods, so the
+*  mean rate holds while captures jitter around it, and restarts from
+*  the capture if a period was missed.
 */
 /*-----------------------------------------------------------------------------*/
-I32  convert_raw10_and_debayer_image(image *imgOut, char *bufIn, U8 trackOffset, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+void  output_sched_update(VCOutputSched *sched, const VCOutputCfg *out, U64 captureNS)
 {
-	int    rc, ee;
-	image  imgU8 = NULL_IMAGE;
+	I32          s, enabledIff1, dueIff1;
+	VCSinkRate  *r;
 
-	// Allocate temporary image
+	sched->dueMask = 0;
+	for(s= 0; s< VCSINK_COUNT; s++)
 	{
-		imgU8.type = IMAGE_GREY;
-		imgU8.dx   = v4lDx;
-		imgU8.dy   = v4lDy;
-		imgU8.pitch= imgU8.dx;
-		imgU8.ccmp1= NULL;
-		imgU8.ccmp2= NULL;
-		imgU8.st   =  malloc(sizeof(U8) * imgU8.dy * imgU8.pitch);
-		if(NULL==imgU8.st){ee=-1; goto fail;}
-	}
+		switch(s)
+		{
+			case VCSINK_FILE:    enabledIff1 = out->fileOutIff1;    break;
+			case VCSINK_FB:      enabledIff1 = out->fbOutIff1;      break;
+			case VCSINK_NET:     enabledIff1 = out->netSrvOutIff1;  break;
+			case VCSINK_STREAM:  enabledIff1 = (NULL!=out->stream)?(1):(0); break;
+			case VCSINK_MCAST:   enabledIff1 = (NULL!=out->mcast)?(1):(0);  break;
+			default:             enabledIff1 = out->stdOutIff1;     break;
+		}
+		if(1!=enabledIff1){ continue; }
 
-	rc =  convert_raw10_to_image(&imgU8,  bufIn, trackOffset,  v4lX0, v4lY0, v4lDx, v4lDy, v4lPitch, v4lPaddingBytes);
-	if(rc<0){ee=-2+10*rc; goto fail;}
+		r       = &sched->sink[s];
+		dueIff1 = (0==sched->frameCount % r->every)?(1):(0);
+		if((1==dueIff1)&&(r->periodNS>0))
+		{
+			if(captureNS < r->nextNS){ dueIff1 = 0; }
+			else if(captureNS - r->nextNS < r->periodNS){ r->nextNS += r->periodNS;       }
+			else                                        { r->nextNS  = captureNS + r->periodNS; }
+		}
+
+		if(1==dueIff1){ sched->dueMask |= 1u<<s; r->dueCount++;  }
+		else          {                          r->skipCount++; }
+	}
+	sched->frameCount++;
+}
 
-	rc =  simple_debayer_to_image(imgOut, (char*)imgU8.st,  0, 0, imgU8.dx, imgU8.dy, imgU8.pitch, 0);
-	if(rc<0){ee=-3+10*rc; goto fail;}
 
- 	ee=0;
-fail:
-	if(NULL!=imgU8.st){ free(imgU8.st);  imgU8.st=NULL; }
 
-	return(ee);
-}
 
 
 /*--*FUNCTION*-----------------------------------------------------------------*/
 /**
-* @brief  Simple and SLOW debayering for sensor image data.
-*
-*  This function does a simple and SLOW debayering for sensor image data.
+* @brief  Prints the Frames each Output was due for and skipped.
 *
-* @param  bufIn       GREY encoded data.
-* @param  ignoredTrackOffset Ignored.
-* @param  v4lX0,v4lY0 Offset of the top-left pixel relative to the current bufIn pointer.
-* @param  v4lDx,v4lDy Dimensions of the input buffer.
-* @param  v4lPitch    Currently the same as v4lDx.
-* @param  v4lPaddingBytes  Additional bytes to v4lDx to get to a pixel one row down.
-* @param  imgOut      8 Bit Grey Value Output image.
+* @return Count of lines printed.
 */
 /*-----------------------------------------------------------------------------*/
-I32  simple_debayer_to_image(image *imgOut, char *bufIn, I32 v4lX0, I32 v4lY0, I32 v4lDx, I32 v4lDy, I32 v4lPitch, I32 v4lPaddingBytes)
+I32  output_sched_print_stats(const char *pcName, const VCOutputSched *sched)
 {
-	I32   dx = min(imgOut->dx, v4lDx - v4lX0);
-	I32   dy = min(imgOut->dy, v4lDy - v4lY0);
-	I32   y;
+	char  acSink[VCSINK_COUNT][48];
+	I32   i, s;
 
-	if(IMAGE_RGB!=imgOut->type)
-	{
-		return(ERR_TYPE);
-	}
-	if(v4lDx > v4lPitch)
-	{
-		return(ERR_PARAM);
-	}
-	if((v4lX0 >= v4lDx)||(v4lY0 >= v4lDy))
+	for(i= 0; i< VCSINK_COUNT; i++)
 	{
-		return(ERR_PARAM);
+		s = sched->order[i];
+		snprintf(acSink[i], sizeof(acSink[i]), "%s %llu/%llu", sinkName[s],
+				(unsigned long long)sched->sink[s].dueCount, (unsigned long long)(sched->sink[s].dueCount + sched->sink[s].skipCount));
 	}
 
-	#if _OPENMP
-	#   pragma omp parallel for
-	#endif
-	for(y= 0; y< dy; y+=2)
-	{
-		I32   x;
-		U8   *in = NULL, *out= NULL;
-		U8   *or= NULL, *og= NULL, *ob= NULL;
+	printf("  %-22s %s, %s, %s, %s, %s, %s, %llu not converted.\n", pcName, acSink[0], acSink[1], acSink[2], acSink[3], acSink[4], acSink[5],
+			(unsigned long long)sched->convertSkipCount);
 
-		//first line input
-		in  =  (U8*)bufIn + v4lX0 + ((y+0) + v4lY0) * (v4lPitch + v4lPaddingBytes);
-		or  =  imgOut->st    + (y+0) * imgOut->pitch;
-		og  =  imgOut->ccmp1 + (y+0) * imgOut->pitch;
-		ob  =  imgOut->ccmp2 + (y+0) * imgOut->pitch;
+	return(1);
+}
 
-		for(x= 0; x< dx; x+=2)
-		{
-			*or = *in;
-			or++;
-			*or = *in;
-			or++;
 
-			in++;
 
-			*og = *in;
-			og++;
-			*og = *in;
-			og++;
 
-			in++;
-		}
 
-		//next line input
-		in  =  (U8*)bufIn + v4lX0 + ((y+1) + v4lY0) * (v4lPitch + v4lPaddingBytes);
-		og  =  imgOut->ccmp1 + (y+1) * imgOut->pitch;
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Initializes the Tone Mapping of a Camera and builds its first LUT.
+*
+*  A clip-limited equalization (VCTONE_CLAHE) starts with a linear LUT
+*  and adapts from the first frame statistics on.
+*/
+/*-----------------------------------------------------------------------------*/
+void  tone_map_init(VCToneMap *tm, const VCToneMap *cfg)
+{
+	*tm = *cfg;
+	tm->active     = NULL;
+	tm->blackLevel = min(max(tm->blackLevel, 0), VCSTATS_BINS-2);
+
+	tone_map_update(tm, NULL);
+}
 
-		for(x= 0; x< dx; x+=2)
-		{
-			*og = *in;
-			og++;
-			*og = *in;
-			og++;
 
-			in++;
 
-			*ob = *in;
-			ob++;
-			*ob = *in;
-			ob++;
 
-			in++;
-		}
 
-		//copy to second line
-		//Red
-		in  =  imgOut->st    + (y+0) * imgOut->pitch;
-		out =  imgOut->st    + (y+1) * imgOut->pitch;
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Builds a new Tone Mapping LUT and publishes it.
+*
+*  The LUT is built in the inactive buffer and published by an atomic
+*  pointer store, process_capture() reads the pointer once per frame,
+*  so a frame is always mapped by one complete LUT. Call it from the
+*  capture thread between frames only, so the buffer being rebuilt
+*  is not in use.
+*
+* @param  stats  Statistics of the last frame, used by VCTONE_CLAHE, may be NULL.
+*/
+/*-----------------------------------------------------------------------------*/
+void  tone_map_update(VCToneMap *tm, const VCFrameStats *stats)
+{
+	I32   i, range = VCSTATS_BINS-1 - tm->blackLevel;
+	U8   *lut;
+	F32   x, scale;
+	U32   clip, excess, bonus, sum, total;
 
-		memcpy(out, in, dx);
+	// Static curves are built once, the equalization follows every frame.
+	if(VCTONE_NONE==tm->kind){ return; }
+	if((NULL!=tm->active)&&((VCTONE_CLAHE!=tm->kind)||(NULL==stats)||(0==stats->count))){ return; }
 
-		//Blue
-		in  =  imgOut->ccmp2 + (y+0) * imgOut->pitch;
-		out =  imgOut->ccmp2 + (y+1) * imgOut->pitch;
+	lut = (tm->active==tm->lut[0])?(tm->lut[1]):(tm->lut[0]);
 
-		memcpy(out, in, dx);
+	for(i= 0; i< tm->blackLevel; i++)
+	{
+		lut[i] = 0;
 	}
 
-	return(ERR_NONE);
-}
+	switch(tm->kind)
+	{
+		case VCTONE_GAMMA:
+			for(i= tm->blackLevel; i< VCSTATS_BINS; i++)
+			{
+				x      = (F32)(i - tm->blackLevel) / range;
+				lut[i] = (U8)(255 * powf(x, tm->param) + 0.5f);
+			}
+			break;
+		case VCTONE_LOG:
+			scale = 255 / logf(1 + tm->param);
+			for(i= tm->blackLevel; i< VCSTATS_BINS; i++)
+			{
+				x      = (F32)(i - tm->blackLevel) / range;
+				lut[i] = (U8)(scale * logf(1 + tm->param * x) + 0.5f);
+			}
+			break;
+		case VCTONE_CLAHE:
+			if((NULL==stats)||(0==stats->count))
+			{
+				for(i= tm->blackLevel; i< VCSTATS_BINS; i++)
+				{
+					lut[i] = (U8)(255 * (i - tm->blackLevel) / range);
+				}
+				break;
+			}
 
-void  timemeasurement_start(struct  timeval *timer)
-{
-	gettimeofday(timer,(struct timezone *)0);
+			// Clip the histogram above the black level at param times the
+			// mean bin count, spread the excess evenly, equalize by the CDF.
+			total = 0;
+			for(i= tm->blackLevel; i< VCSTATS_BINS; i++)
+			{
+				total += stats->hist[i];
+			}
+			clip   = max(1, (U32)(tm->param * total / (range+1)));
+			excess = 0;
+			for(i= tm->blackLevel; i< VCSTATS_BINS; i++)
+			{
+				if(stats->hist[i] > clip){ excess += stats->hist[i] - clip; }
+			}
+			bonus = excess / (range+1);
+
+			sum   = 0;
+			total = max(1, total - excess + bonus * (range+1));
+			for(i= tm->blackLevel; i< VCSTATS_BINS; i++)
+			{
+				sum   += min(stats->hist[i], clip) + bonus;
+				lut[i] = (U8)(((U64)255 * min(sum, total)) / total);
+			}
+			break;
+	}
+
+	__atomic_store_n(&tm->active, lut, __ATOMIC_RELEASE);
+	tm->buildCount++;
 }
 
-void  timemeasurement_stop(struct  timeval *timer, I64 *s, I64 *us)
-{
-	struct  timeval  end;
 
-	gettimeofday(&end,(struct timezone *)0);
-	*s  = end.tv_sec  - timer->tv_sec;
-	*us = end.tv_usec - timer->tv_usec;
-	if(*us < 0){ *us += 1000000; *s = *s - 1; }
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns the LUT to map the next Frame by, NULL to keep the upper 8 Bits.
+*/
+/*-----------------------------------------------------------------------------*/
+const U8 *tone_map_lut(VCToneMap *tm)
+{
+	return(__atomic_load_n(&tm->active, __ATOMIC_ACQUIRE));
 }
 
 
@@ -1652,7 +12075,7 @@ void  timemeasurement_stop(struct  timeval *timer, I64 *s, I64 *us)
 *  You can open this files for example with the GIMP (Gnu Image Manipulation Program).
 *
 * @param  path        The Filename with its path, extension will be added by type.
-* @param  img         8 Bit Grey or RGB Value image to be stored.
+* @param  img         8 Bit Grey or RGB Value image to be stored, planar or interleaved.
 */
 /*-----------------------------------------------------------------------------*/
 I32  write_image_as_pnm(char *path, image *img)
@@ -1662,8 +12085,10 @@ I32  write_image_as_pnm(char *path, image *img)
 	I32   headerBytes, wroteBytes;
 	char  acHeader[256], *pcFilename=NULL;
 	char *pcLine=NULL;
+	I32   stride = image_pixel_stride(img);
+	U8   *r, *g, *b;
 
-	if((IMAGE_GREY!=img->type)&&(IMAGE_RGB!=img->type)){ee=-1; goto fail;}
+	if((IMAGE_GREY!=img->type)&&(IMAGE_RGB!=img->type)&&(1==stride)){ee=-1; goto fail;}
 
 
 	pcFilename =  malloc(sizeof(char) * (strlen(path)+4+2));
@@ -1694,18 +12119,30 @@ I32  write_image_as_pnm(char *path, image *img)
 			}
 		}
 		break;
-		case IMAGE_RGB:
+		case VCIMAGE_RGB24:
+		{
+			// Already the PPM layout, rows are written in place.
+			for(y= 0; y< img->dy; y++)
+			{
+				wroteBytes =  write(fd, (U8*)img->st + y * img->pitch, 3 * img->dx);
+				if(wroteBytes!=3 * img->dx){ee=-8; goto fail;}
+			}
+		}
+		break;
+		default:
 		{
 			pcLine =  malloc(sizeof(U8) * 3 * img->dx);
 			if(NULL==pcLine){ee=-7; goto fail;}
 
+			image_channels(img, &r, &g, &b);
+
 			for(y= 0; y< img->dy; y++)
 			{
 				for(x= 0; x< img->dx; x++)
 				{
-					pcLine[3*x+0] = *((U8*)img->st    + y * img->pitch + x);
-					pcLine[3*x+1] = *((U8*)img->ccmp1 + y * img->pitch + x);
-					pcLine[3*x+2] = *((U8*)img->ccmp2 + y * img->pitch + x);
+					pcLine[3*x+0] = r[y * img->pitch + x * stride];
+					pcLine[3*x+1] = g[y * img->pitch + x * stride];
+					pcLine[3*x+2] = b[y * img->pitch + x * stride];
 				}
 
 				wroteBytes =  write(fd, pcLine, 3 * img->dx);
@@ -1713,7 +12150,6 @@ I32  write_image_as_pnm(char *path, image *img)
 			}
 		}
 		break;
-		default: ee=-9; goto fail;
 	}
 
 	ee=0;
@@ -1728,3 +12164,83 @@ fail:
 	return(ee);
 }
 
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Writes a Disparity Image as 16 Bit PGM.
+*
+*  Values are 1/16 pixels, VCDISP_INVALID for unmatched pixels,
+*  big endian as PGM demands.
+*
+* @param  path  The Filename with its path, ".pgm" will be added.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  write_disparity_as_pgm(char *path, const U16 *disp, I32 dx, I32 dy)
+{
+	I32   ee, x, y;
+	I32   fd = -1;
+	I32   headerBytes;
+	char  acHeader[64], acFilename[256];
+	U8   *pcLine = NULL;
+
+	snprintf(acFilename, sizeof(acFilename), "%s.pgm", path);
+
+	fd =  open(acFilename, O_WRONLY | O_CREAT | O_TRUNC, 00644);
+	if(fd<0){ee=-1; goto fail;}
+
+	headerBytes =  snprintf(acHeader, sizeof(acHeader), "P5 %d %d %d ", dx, dy, 65535);
+	if(headerBytes!=write(fd, acHeader, headerBytes)){ee=-2; goto fail;}
+
+	pcLine =  malloc(2 * dx);
+	if(NULL==pcLine){ee=-3; goto fail;}
+
+	for(y= 0; y< dy; y++)
+	{
+		for(x= 0; x< dx; x++)
+		{
+			pcLine[2*x+0] = disp[y * dx + x] >> 8;
+			pcLine[2*x+1] = disp[y * dx + x] & 0xFF;
+		}
+		if(2 * dx!=write(fd, pcLine, 2 * dx)){ee=-4; goto fail;}
+	}
+
+	ee=0;
+fail:
+	if(fd>=0){ close(fd); }
+	free(pcLine);
+
+	return(ee);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Writes a JPEG to path with the Extension .jpg.
+*/
+/*-----------------------------------------------------------------------------*/
+I32  write_jpeg(char *path, const U8 *data, U32 byteCount)
+{
+	I32   ee;
+	I32   fd = -1;
+	char  acFilename[256];
+
+	snprintf(acFilename, sizeof(acFilename), "%s.jpg", path);
+
+	fd =  open(acFilename, O_WRONLY | O_CREAT | O_TRUNC, 00644);
+	if(fd<0){ee=-1; goto fail;}
+
+	if((ssize_t)byteCount!=write(fd, data, byteCount)){ee=-2; goto fail;}
+
+	ee=0;
+fail:
+	if(fd>=0){ close(fd); }
+
+	return(ee);
+}
@@ -0,0 +1,239 @@
+/**********************************************************************//**
+***************************************************************************
+*** @file    vcstream.h
+***
+*** @brief   Wire Format of the vcmipidemo Frame Streams and Multicast Receiver.
+***
+*** @author  Copyright (c) 2018 Vision Components.
+*** @author  All rights reserved.
+*** @author  This software embodies materials and concepts which are
+***          confidential to Vision Components.
+***
+***  A frame is a VCStreamHeader followed by planeCount planes of
+***  pitch*dy bytes (grey, or red, green, blue), by one plane of pixels
+***  interleaved as given by layout, or by a JPEG file of
+***  payloadBytes if codec is VCSTREAM_CODEC_JPEG. All fields are little
+***  endian on the wire, the functions below convert the headers from and
+***  to host byte order. The TCP stream (-P) sends frames back to back. The UDP
+***  multicast (-U) cuts each frame into datagrams, each starting with
+***  a VCMcastFragHeader; vcmcastrecv.c reassembles them.
+***
+***************************************************************************
+***************************************************************************/
+#ifndef VCSTREAM_H
+#define VCSTREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <endian.h>
+#include <sys/socket.h>
+
+
+#define  VCSTREAM_MAGIC        (0x53464356)  /**<  "VCFS", first Word of each Frame.              */
+#define  VCSTREAM_VERSION      (3)           /**<  2: codec added, 3: layout added.               */
+#define  VCSTREAM_CODEC_RAW    (0)           /**<  Payload is the Planes.                         */
+#define  VCSTREAM_CODEC_JPEG   (1)           /**<  Payload is a baseline JPEG (vcmipidemo -J).    */
+#define  VCSTREAM_LAYOUT_PLANAR (0)          /**<  planeCount Planes of one Byte per Pixel.       */
+#define  VCSTREAM_LAYOUT_RGB24  (1)          /**<  One Plane of R, G, B per Pixel (vcmipidemo -C rgb).       */
+#define  VCSTREAM_LAYOUT_BGR24  (2)          /**<  One Plane of B, G, R per Pixel (vcmipidemo -C bgr).       */
+#define  VCSTREAM_LAYOUT_RGBA32 (3)          /**<  One Plane of R, G, B, 255 per Pixel (vcmipidemo -C rgba). */
+#define  VCSTREAM_LAYOUT_BGRA32 (4)          /**<  One Plane of B, G, R, 255 per Pixel (vcmipidemo -C bgra). */
+#define  VCMCAST_MAGIC         (0x4D464356)  /**<  "VCFM", first Word of each Datagram.           */
+#define  VCMCAST_VERSION       (1)
+#define  VCMCAST_BATCH         (32)          /**<  Datagrams per sendmmsg() and recvmmsg().       */
+#define  VCMCAST_DATAGRAM_MAX  (65507)       /**<  UDP Payload of a Datagram at most.             */
+#define  VCMCAST_PENDING       (4)           /**<  Frames a Receiver reassembles at once.         */
+#define  VCMCAST_FRAME_MAX     (64 << 20)    /**<  Frames larger than this are rejected.          */
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Header sent ahead of each Frame.
+*
+*    Both times are CLOCK_MONOTONIC of the server, so a client
+*    on the same host gets its latency from them.
+*/
+typedef struct
+{
+	uint32_t  magic;         /*!<  VCSTREAM_MAGIC.                               */
+	uint16_t  version;       /*!<  VCSTREAM_VERSION.                             */
+	uint16_t  headerBytes;   /*!<  Later versions may append fields.             */
+	uint32_t  camIdx;
+	uint32_t  frameNr;
+	uint64_t  captureNS;     /*!<  Capture Time.                                 */
+	uint64_t  sendNS;        /*!<  Time the Server started sending the Frame.    */
+	uint16_t  planeCount;    /*!<  1: grey or interleaved, 3: red, green, blue.  */
+	uint16_t  dx;
+	uint16_t  dy;
+	uint16_t  pitch;         /*!<  Bytes per Row.                                */
+	uint32_t  payloadBytes;  /*!<  planeCount * pitch * dy.                      */
+	uint32_t  dropCount;     /*!<  Frames the Client missed so far.              */
+	uint32_t  codec;         /*!<  VCSTREAM_CODEC_...                            */
+	uint32_t  layout;        /*!<  VCSTREAM_LAYOUT_..., raw codec only.          */
+} VCStreamHeader;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Header of each Multicast Datagram.
+*
+*    The datagram carries the bytes offset.. of the frame, that is
+*    of its VCStreamHeader and planes. frameId counts the frames sent
+*    to the group, so gaps are frames lost completely.
+*/
+typedef struct
+{
+	uint32_t  magic;         /*!<  VCMCAST_MAGIC.                                */
+	uint16_t  version;       /*!<  VCMCAST_VERSION.                              */
+	uint16_t  headerBytes;   /*!<  Later versions may append fields.             */
+	uint32_t  frameId;
+	uint32_t  frameBytes;    /*!<  Stream Header and Planes.                     */
+	uint32_t  offset;        /*!<  Position of the Data in the Frame.            */
+	uint16_t  fragIdx;
+	uint16_t  fragCount;
+} VCMcastFragHeader;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Frame reassembled by a Multicast Receiver.
+*/
+typedef struct
+{
+	int              activeIff1;
+	uint32_t         frameId;
+	uint32_t         frameBytes;
+	uint32_t         fragCount;
+	uint32_t         fragReceived;
+	uint8_t         *data;         /*!<  Stream Header and Planes.                  */
+	size_t           dataSize;
+	uint8_t         *fragMask;     /*!<  Bit per Fragment received.                 */
+	size_t           maskSize;
+	VCStreamHeader  *hdr;          /*!<  Set when complete.                         */
+	uint8_t         *payload;      /*!<  Planes, set when complete.                 */
+} VCMcastFrame;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Receiver of a Multicast Frame Stream.
+*
+*    Fragments of a frame older than all frames pending, or of a frame
+*    already delivered or given up, are counted late. A frame still
+*    incomplete when VCMCAST_PENDING newer ones are pending is given up.
+*/
+typedef struct
+{
+	int              fd;
+	VCMcastFrame     frame[VCMCAST_PENDING];
+	int              deliveredIdx;   /*!<  Frame returned last, reused by the next Call. */
+	int              highestValidIff1;
+	uint32_t         highestId;      /*!<  Newest frameId seen.                      */
+	uint8_t         *dgram;          /*!<  VCMCAST_BATCH Datagrams.                  */
+	struct iovec     iov[VCMCAST_BATCH];
+	struct mmsghdr   msg[VCMCAST_BATCH];
+	int              batchCount;
+	int              batchIdx;
+	uint64_t         frameCount;     /*!<  Frames delivered.                         */
+	uint64_t         lostFrameCount; /*!<  Frames of which no Fragment arrived.      */
+	uint64_t         incompleteCount;/*!<  Frames given up with Fragments missing.   */
+	uint64_t         fragCount;      /*!<  Fragments received.                       */
+	uint64_t         lostFragCount;  /*!<  Fragments missing of the given up Frames. */
+	uint64_t         lateFragCount;
+	uint64_t         dupFragCount;
+	uint64_t         badCount;       /*!<  Datagrams not of this Protocol.           */
+} VCMcastReceiver;
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts a Stream Header in Place from Host Byte Order to Little Endian.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  vcstream_header_to_le(VCStreamHeader *hdr)
+{
+	hdr->magic        = htole32(hdr->magic);
+	hdr->version      = htole16(hdr->version);
+	hdr->headerBytes  = htole16(hdr->headerBytes);
+	hdr->camIdx       = htole32(hdr->camIdx);
+	hdr->frameNr      = htole32(hdr->frameNr);
+	hdr->captureNS    = htole64(hdr->captureNS);
+	hdr->sendNS       = htole64(hdr->sendNS);
+	hdr->planeCount   = htole16(hdr->planeCount);
+	hdr->dx           = htole16(hdr->dx);
+	hdr->dy           = htole16(hdr->dy);
+	hdr->pitch        = htole16(hdr->pitch);
+	hdr->payloadBytes = htole32(hdr->payloadBytes);
+	hdr->dropCount    = htole32(hdr->dropCount);
+	hdr->codec        = htole32(hdr->codec);
+	hdr->layout       = htole32(hdr->layout);
+}
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts a received Stream Header in Place from Little Endian to Host Byte Order.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  vcstream_header_from_le(VCStreamHeader *hdr)
+{
+	hdr->magic        = le32toh(hdr->magic);
+	hdr->version      = le16toh(hdr->version);
+	hdr->headerBytes  = le16toh(hdr->headerBytes);
+	hdr->camIdx       = le32toh(hdr->camIdx);
+	hdr->frameNr      = le32toh(hdr->frameNr);
+	hdr->captureNS    = le64toh(hdr->captureNS);
+	hdr->sendNS       = le64toh(hdr->sendNS);
+	hdr->planeCount   = le16toh(hdr->planeCount);
+	hdr->dx           = le16toh(hdr->dx);
+	hdr->dy           = le16toh(hdr->dy);
+	hdr->pitch        = le16toh(hdr->pitch);
+	hdr->payloadBytes = le32toh(hdr->payloadBytes);
+	hdr->dropCount    = le32toh(hdr->dropCount);
+	hdr->codec        = le32toh(hdr->codec);
+	hdr->layout       = le32toh(hdr->layout);
+}
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts a Multicast Fragment Header in Place from Host Byte Order to Little Endian.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  vcmcast_frag_to_le(VCMcastFragHeader *fh)
+{
+	fh->magic       = htole32(fh->magic);
+	fh->version     = htole16(fh->version);
+	fh->headerBytes = htole16(fh->headerBytes);
+	fh->frameId     = htole32(fh->frameId);
+	fh->frameBytes  = htole32(fh->frameBytes);
+	fh->offset      = htole32(fh->offset);
+	fh->fragIdx     = htole16(fh->fragIdx);
+	fh->fragCount   = htole16(fh->fragCount);
+}
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Converts a received Multicast Fragment Header in Place from Little Endian to Host Byte Order.
+*/
+/*-----------------------------------------------------------------------------*/
+static inline void  vcmcast_frag_from_le(VCMcastFragHeader *fh)
+{
+	fh->magic       = le32toh(fh->magic);
+	fh->version     = le16toh(fh->version);
+	fh->headerBytes = le16toh(fh->headerBytes);
+	fh->frameId     = le32toh(fh->frameId);
+	fh->frameBytes  = le32toh(fh->frameBytes);
+	fh->offset      = le32toh(fh->offset);
+	fh->fragIdx     = le16toh(fh->fragIdx);
+	fh->fragCount   = le16toh(fh->fragCount);
+}
+
+
+int  vcmcast_open(VCMcastReceiver *rx, const char *pcGroup, int port, const char *pcIface);
+int  vcmcast_receive(VCMcastReceiver *rx, VCMcastFrame **frame, int timeoutMS);
+void vcmcast_print_stats(const VCMcastReceiver *rx);
+void vcmcast_close(VCMcastReceiver *rx);
+
+#endif
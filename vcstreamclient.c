@@ -0,0 +1,442 @@
+/**********************************************************************//**
+***************************************************************************
+*** @file    vcstreamclient.c
+***
+*** @brief   Reference Client of the vcmipidemo Frame Streams (-P, -U).
+***
+*** @author  Copyright (c) 2018 Vision Components.
+*** @author  All rights reserved.
+*** @author  This software embodies materials and concepts which are
+***          confidential to Vision Components.
+***
+***  Build:  gcc -O2 -o vcstreamclient vcstreamclient.c vcmcastrecv.c
+***
+***  Receives the TCP stream, or joins the multicast group with the
+***  receiver of vcmcastrecv.c. See vcstream.h for the wire format.
+***  Latencies are only meaningful on the host of the server, since
+***  both use CLOCK_MONOTONIC.
+***
+***************************************************************************
+***************************************************************************/
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "vcstream.h"
+
+
+typedef uint8_t   U8;
+typedef uint16_t  U16;
+typedef uint32_t  U32;
+typedef uint64_t  U64;
+typedef int32_t   I32;
+typedef double    F64;
+
+
+/*--*STRUCT*----------------------------------------------------------*/
+/**
+*  @brief  Statistics of the received Frames.
+*/
+typedef struct
+{
+	U64   frameCount;
+	U64   byteCount;
+	U64   dropCount;       /*!<  Frames missed as reported by the Server.      */
+	U64   rejectCount;     /*!<  Frames not written, planes exceed the payload. */
+	U64   latCount;
+	U64   latSumNS;        /*!<  Capture to received.                          */
+	U64   latMaxNS;
+	U64   sendSumNS;       /*!<  Server started sending to received.           */
+	U64   firstNS;
+	U64   lastNS;
+} VCStreamStats;
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Returns CLOCK_MONOTONIC in Nanoseconds.
+*/
+/*-----------------------------------------------------------------------------*/
+static U64  timestamp_ns(void)
+{
+	struct timespec  ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return((U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Receives exactly byteCount Bytes.
+*
+*  Returns 0 if the server closed the connection before.
+*/
+/*-----------------------------------------------------------------------------*/
+static int  recv_all(int fd, void *buf, size_t byteCount)
+{
+	size_t   got = 0;
+	ssize_t  rc;
+
+	while(got < byteCount)
+	{
+		rc = recv(fd, (U8*)buf + got, byteCount - got, MSG_WAITALL);
+		if(rc==0){ return(0); }
+		if(rc<0)
+		{
+			if(EINTR==errno){ continue; }
+			return(-1);
+		}
+		got += rc;
+	}
+
+	return(1);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Connects to the Stream Server.
+*/
+/*-----------------------------------------------------------------------------*/
+static int  stream_connect(const char *pcHost, const char *pcPort)
+{
+	struct addrinfo   hints, *res, *ai;
+	int               fd = -1, one = 1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if(0!=getaddrinfo(pcHost, pcPort, &hints, &res)){ return(-1); }
+
+	for(ai= res; NULL!=ai; ai= ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if(fd<0){ continue; }
+		if(0==connect(fd, ai->ai_addr, ai->ai_addrlen)){ break; }
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if(fd>=0){ setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); }
+
+	return(fd);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Receives the next Frame of the TCP Stream.
+*
+*  The payload buffer grows as needed. Returns 0 if the server closed
+*  the connection, -2 on a header of another protocol.
+*/
+/*-----------------------------------------------------------------------------*/
+static int  stream_receive_tcp(int fd, VCStreamHeader *hdr, U8 **payload, size_t *payloadSize)
+{
+	int  rc;
+	U8   acExtra[256];
+
+	rc = recv_all(fd, hdr, sizeof(VCStreamHeader));
+	if(rc<=0){ return(rc); }
+	vcstream_header_from_le(hdr);
+
+	if((VCSTREAM_MAGIC!=hdr->magic)||(VCSTREAM_VERSION>hdr->version)||(hdr->headerBytes<sizeof(VCStreamHeader))){ return(-2); }
+
+	// Fields appended by later versions are skipped.
+	if(hdr->headerBytes > sizeof(VCStreamHeader))
+	{
+		if(hdr->headerBytes - sizeof(VCStreamHeader) > sizeof(acExtra)){ return(-2); }
+		rc = recv_all(fd, acExtra, hdr->headerBytes - sizeof(VCStreamHeader));
+		if(rc<=0){ return(rc); }
+	}
+
+	if(hdr->payloadBytes > *payloadSize)
+	{
+		free(*payload);
+		*payloadSize = hdr->payloadBytes;
+		*payload     = malloc(*payloadSize);
+		if(NULL==*payload){ *payloadSize = 0; return(-1); }
+	}
+
+	return(recv_all(fd, *payload, hdr->payloadBytes));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Writes a received Frame as PGM, PPM or JPEG File.
+*
+*  Planar colour and interleaved layouts are written as PPM in R, G, B order.
+*  This function returns +1 without writing a file if the layout is
+*  unknown or the planes of the header do not fit into the payload.
+*/
+/*-----------------------------------------------------------------------------*/
+static int  write_frame(const VCStreamHeader *hdr, const U8 *payload)
+{
+	// Bytes per pixel and position of red of each VCSTREAM_LAYOUT_...
+	static const I32  layoutStride[] = { 1, 3, 3, 4, 4 };
+	static const I32  layoutRed[]    = { 0, 0, 2, 0, 2 };
+
+	char   acFilename[64];
+	FILE  *fp;
+	I32    x, y, p, stride = 1, colourIff1;
+	size_t plane = (size_t)hdr->pitch * hdr->dy;
+	const U8  *row;
+
+	if(VCSTREAM_CODEC_JPEG!=hdr->codec)
+	{
+		if(hdr->layout > VCSTREAM_LAYOUT_BGRA32)       { return(+1); }
+		stride = layoutStride[hdr->layout];
+		if(VCSTREAM_LAYOUT_PLANAR==hdr->layout)
+		{
+			if((1!=hdr->planeCount)&&(3!=hdr->planeCount)){ return(+1); }
+		}
+		else if(1!=hdr->planeCount)                    { return(+1); }
+		if(hdr->pitch < hdr->dx * stride)              { return(+1); }
+		if(hdr->planeCount * plane > hdr->payloadBytes){ return(+1); }
+	}
+	colourIff1 = ((3==hdr->planeCount)||(VCSTREAM_LAYOUT_PLANAR!=hdr->layout))?(1):(0);
+
+	snprintf(acFilename, sizeof(acFilename), "stream%u_%05u.%s", hdr->camIdx, hdr->frameNr,
+			(VCSTREAM_CODEC_JPEG==hdr->codec)?("jpg"):((1==colourIff1)?("ppm"):("pgm")));
+
+	fp = fopen(acFilename, "wb");
+	if(NULL==fp){ return(-1); }
+
+	if(VCSTREAM_CODEC_JPEG==hdr->codec)
+	{
+		fwrite(payload, 1, hdr->payloadBytes, fp);
+		fclose(fp);
+		return(0);
+	}
+
+	fprintf(fp, "P%d\n%d %d\n255\n", (1==colourIff1)?(6):(5), hdr->dx, hdr->dy);
+	for(y= 0; y< hdr->dy; y++)
+	{
+		row = payload + (size_t)y * hdr->pitch;
+		if(0==colourIff1)
+		{
+			fwrite(row, 1, hdr->dx, fp);
+			continue;
+		}
+		for(x= 0; x< hdr->dx; x++)
+		{
+			for(p= 0; p< 3; p++)
+			{
+				if(VCSTREAM_LAYOUT_PLANAR==hdr->layout){ fputc(row[p * plane + x], fp); }
+				else{ fputc(row[x * stride + ((0==layoutRed[hdr->layout])?(p):(2 - p))], fp); }
+			}
+		}
+	}
+	fclose(fp);
+
+	return(0);
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Prints the Statistics of the received Frames.
+*/
+/*-----------------------------------------------------------------------------*/
+static void  stream_print_stats(const VCStreamStats *st)
+{
+	F64  seconds = (F64)(st->lastNS - st->firstNS) / 1000000000;
+
+	printf("  %llu Frames, %llu missed, %llu rejected, %.1f MB in %.1fs (%.1f fps, %.1f Mbit/s), latency capture to received mean %.3fms worst %.3fms, sent to received mean %.3fms.\n",
+			(unsigned long long)st->frameCount, (unsigned long long)st->dropCount, (unsigned long long)st->rejectCount, (F64)st->byteCount / 1000000, seconds,
+			(seconds>0)?((st->frameCount - 1) / seconds):(0.0), (seconds>0)?((F64)st->byteCount * 8 / 1000000 / seconds):(0.0),
+			(F64)st->latSumNS / 1000000 / ((st->latCount>0)?(st->latCount):(1)), (F64)st->latMaxNS / 1000000,
+			(F64)st->sendSumNS / 1000000 / ((st->latCount>0)?(st->latCount):(1)));
+}
+
+
+
+
+
+/*--*FUNCTION*-----------------------------------------------------------------*/
+/**
+* @brief  Main Function of vcstreamclient.
+*
+*  Receives frames until the server disconnects, the given count is
+*  reached, or no multicast frame arrived for two seconds.
+*/
+/*-----------------------------------------------------------------------------*/
+int  main(int argc, char *argv[])
+{
+	int              ee, rc, opt, fd = -1;
+	const char      *pcHost      = "127.0.0.1";
+	const char      *pcPort      = "5000";
+	char             acGroup[128] = "";
+	char            *pcIface     = NULL;
+	char            *pcParam;
+	long             optFrames   = 0;
+	int              optFileIff1 = 0;
+	long             optWaitMS   = 0;
+	VCStreamHeader   hdrTcp;
+	const VCStreamHeader *hdr    = NULL;
+	U8              *payloadTcp  = NULL;
+	const U8        *payload     = NULL;
+	size_t           payloadSize = 0;
+	VCMcastReceiver  rx;
+	int              rxIff1      = 0;
+	VCMcastFrame    *mf;
+	VCStreamStats    st;
+	U64              now;
+
+	while((opt = getopt(argc, argv, "h:p:m:n:ow:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'h':  pcHost      = optarg;                    break;
+			case 'p':  pcPort      = optarg;                    break;
+			case 'm':  snprintf(acGroup, sizeof(acGroup), "%s", optarg);  break;
+			case 'n':  optFrames   = atol(optarg);              break;
+			case 'o':  optFileIff1 = 1;                         break;
+			case 'w':  optWaitMS   = atol(optarg);              break;
+			default:
+				printf("  Usage: %s [-h host] [-p port] [-m group:port[:iface]] [-n frames] [-o] [-w ms]\n", argv[0]);
+				printf("  -h,  Host of vcmipidemo -P (default: 127.0.0.1).\n");
+				printf("  -p,  Port (default: 5000).\n");
+				printf("  -m,  Join the multicast group of vcmipidemo -U instead, e.g. 239.255.0.1:5001,\n");
+				printf("       optionally at the interface of the given address, e.g. :127.0.0.1.\n");
+				printf("  -n,  Quit after this many frames (default: until disconnected).\n");
+				printf("  -o,  Write the frames as PGM, PPM or JPEG files.\n");
+				printf("  -w,  Wait after each frame, to watch a slow client miss frames.\n");
+				return(1);
+		}
+	}
+
+	memset(&st, 0, sizeof(st));
+
+	if('\0'!=acGroup[0])
+	{
+		pcParam = strchr(acGroup, ':');
+		if(NULL==pcParam){ee=-6; goto fail;}
+		*pcParam++ = '\0';
+		pcIface = strchr(pcParam, ':');
+		if(NULL!=pcIface){ *pcIface++ = '\0'; }
+
+		rc = vcmcast_open(&rx, acGroup, atoi(pcParam), pcIface);
+		if(rc<0){ee=-7; goto fail;}
+		rxIff1 = 1;
+		printf("Joined %s:%s.\n", acGroup, pcParam);
+	}
+	else
+	{
+		fd = stream_connect(pcHost, pcPort);
+		if(fd<0){ee=-1; goto fail;}
+		printf("Connected to %s:%s.\n", pcHost, pcPort);
+	}
+
+	while((0==optFrames)||((long)st.frameCount < optFrames))
+	{
+		if(1==rxIff1)
+		{
+			rc = vcmcast_receive(&rx, &mf, (0==st.frameCount)?(-1):(2000));
+			if(rc==0){ break; }
+			if(rc<0){ee=-2; goto fail;}
+			hdr     = mf->hdr;
+			payload = mf->payload;
+		}
+		else
+		{
+			rc = stream_receive_tcp(fd, &hdrTcp, &payloadTcp, &payloadSize);
+			if(rc==0){ break; }
+			if(rc==-2){ee=-3; goto fail;}
+			if(rc<0){ee=-2; goto fail;}
+			hdr     = &hdrTcp;
+			payload = payloadTcp;
+		}
+
+		now = timestamp_ns();
+		if(0==st.frameCount){ st.firstNS = now; }
+		st.lastNS = now;
+		st.frameCount++;
+		st.byteCount += hdr->headerBytes + hdr->payloadBytes;
+		st.dropCount  = hdr->dropCount;
+		if((0!=hdr->captureNS)&&(now > hdr->captureNS)&&(now > hdr->sendNS))
+		{
+			st.latCount++;
+			st.latSumNS  += now - hdr->captureNS;
+			st.sendSumNS += now - hdr->sendNS;
+			if(now - hdr->captureNS > st.latMaxNS){ st.latMaxNS = now - hdr->captureNS; }
+		}
+
+		if(1==optFileIff1)
+		{
+			rc = write_frame(hdr, payload);
+			if(rc<0){ee=-5; goto fail;}
+			if(rc>0){ st.rejectCount++; }
+		}
+
+		if(optWaitMS>0){ usleep(optWaitMS * 1000); }
+	}
+
+	ee=0;
+fail:
+	switch(ee)
+	{
+		case 0:
+			break;
+		case -1:
+			printf("Error, could not connect to %s:%s.\n", pcHost, pcPort);
+			break;
+		case -3:
+			printf("Error, unexpected header (magic 0x%08x, version %u).\n", hdrTcp.magic, hdrTcp.version);
+			break;
+		case -6:
+			printf("Error, port of group '%s' missing.\n", acGroup);
+			break;
+		case -7:
+			printf("Error, could not join group %s (%s).\n", acGroup, strerror(errno));
+			break;
+		default:
+			printf("Error %d (%s).\n", ee, strerror(errno));
+			break;
+	}
+
+	if(st.frameCount>0){ stream_print_stats(&st); }
+	if(1==rxIff1)
+	{
+		vcmcast_print_stats(&rx);
+		vcmcast_close(&rx);
+	}
+
+	if(fd>=0){ close(fd); }
+	free(payloadTcp);
+
+	return((ee<0)?(1):(0));
+}